@@ -13,6 +13,7 @@
 #include <sstream>
 #include <sys/time.h>
 #include <cassert>
+#include <cmath>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -71,6 +72,14 @@ extern const int DEFAULT_REINFER_INTERVAL = G_MAXINT;
   (DS_NVINFER_IMPL(nvinfer)->m_InitParams->networkType == NvDsInferNetworkType_Classifier)
 #define IS_SEGMENTATION_INSTANCE(nvinfer) \
   (DS_NVINFER_IMPL(nvinfer)->m_InitParams->networkType == NvDsInferNetworkType_Segmentation)
+#define IS_EMBEDDING_INSTANCE(nvinfer) \
+  (DS_NVINFER_IMPL(nvinfer)->m_InitParams->networkType == NvDsInferNetworkType_Embedding)
+/* Instances whose results are cached in the object history and reattached
+ * to tracked objects that are not reinferred: classifiers and embedding
+ * instances matching a gallery. */
+#define USES_OBJECT_HISTORY(nvinfer) \
+  (IS_CLASSIFIER_INSTANCE (nvinfer) || \
+      (IS_EMBEDDING_INSTANCE (nvinfer) && (nvinfer)->gallery_file_path))
 
 static GQuark _dsmeta_quark = 0;
 
@@ -87,6 +96,28 @@ static GQuark _dsmeta_quark = 0;
 #define DEFAULT_GPU_DEVICE_ID 0
 #define DEFAULT_OUTPUT_WRITE_TO_FILE FALSE
 #define DEFAULT_OUTPUT_TENSOR_META FALSE
+#define DEFAULT_GALLERY_TOP_K 1
+#define DEFAULT_GALLERY_MATCH_THRESHOLD 0.5
+#define DEFAULT_GALLERY_IVF_LISTS 0
+#define DEFAULT_GALLERY_IVF_PROBES 8
+#define DEFAULT_GALLERY_RELOAD_INTERVAL 0
+#define DEFAULT_TILE_COLUMNS 1
+#define DEFAULT_TILE_ROWS 1
+#define DEFAULT_TILE_OVERLAP 0.2
+#define DEFAULT_TILE_MERGE_THRESHOLD 0.6
+#define DEFAULT_MOTION_THRESHOLD 0
+#define DEFAULT_MOTION_PIXEL_DELTA 16
+#define DEFAULT_MOTION_MAX_STALE_FRAMES 30
+#define DEFAULT_ADAPTIVE_INTERVAL_MAX 0
+#define DEFAULT_ADAPTIVE_INTERVAL_BUSY_OBJECTS 1
+
+/* Resolution of the luma thumbnails compared by the motion gate. */
+#define MOTION_THUMBNAIL_WIDTH 64
+#define MOTION_THUMBNAIL_HEIGHT 36
+
+/* Minimum IOU for a detection to be considered the same object as one in the
+ * previous inferred frame of the source. */
+#define ADAPTIVE_INTERVAL_MATCH_IOU 0.3
 
 /* By default NVIDIA Hardware allocated memory flows through the pipeline. We
  * will be processing on this type of memory only. */
@@ -306,6 +337,22 @@ gst_nvinfer_class_init (GstNvinfercustomClass * klass)
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
               GST_PARAM_MUTABLE_READY)));
 
+  g_object_class_install_property (gobject_class, PROP_GALLERY_FILE,
+      g_param_spec_string ("gallery-file", "Gallery File",
+          "Path to the identity gallery file for embedding networks.\n"
+          "\t\t\tSetting it while playing loads the gallery without "
+          "pausing inference",
+          "",
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+
+  g_object_class_install_property (gobject_class, PROP_SOURCE_INTERVALS,
+      g_param_spec_boxed ("source-intervals", "Source Intervals",
+          "Current adaptive interval of each source, as a structure with a "
+          "\"source-<pad-index>\" field per source",
+          GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
   /** install signal MODEL_UPDATED */
   gst_nvinfer_signals[SIGNAL_MODEL_UPDATED] =
       g_signal_new ("model-updated",
@@ -361,6 +408,33 @@ gst_nvinfer_init (GstNvinfercustom * nvinfer)
 
   nvinfer->untracked_object_warn_pts = GST_CLOCK_TIME_NONE;
 
+  nvinfer->gallery_file_path = nullptr;
+  nvinfer->gallery_top_k = DEFAULT_GALLERY_TOP_K;
+  nvinfer->gallery_match_threshold = DEFAULT_GALLERY_MATCH_THRESHOLD;
+  nvinfer->gallery_ivf_lists = DEFAULT_GALLERY_IVF_LISTS;
+  nvinfer->gallery_ivf_probes = DEFAULT_GALLERY_IVF_PROBES;
+  nvinfer->gallery_index_file_path = nullptr;
+  nvinfer->gallery_reload_interval = DEFAULT_GALLERY_RELOAD_INTERVAL;
+
+  nvinfer->tile_columns = DEFAULT_TILE_COLUMNS;
+  nvinfer->tile_rows = DEFAULT_TILE_ROWS;
+  nvinfer->tile_overlap = DEFAULT_TILE_OVERLAP;
+  nvinfer->tile_include_full_frame = FALSE;
+  nvinfer->tile_merge_threshold = DEFAULT_TILE_MERGE_THRESHOLD;
+
+  nvinfer->motion_threshold = DEFAULT_MOTION_THRESHOLD;
+  nvinfer->motion_pixel_delta = DEFAULT_MOTION_PIXEL_DELTA;
+  nvinfer->motion_max_stale_frames = DEFAULT_MOTION_MAX_STALE_FRAMES;
+  nvinfer->motion_surf = nullptr;
+
+  nvinfer->adaptive_interval_max = DEFAULT_ADAPTIVE_INTERVAL_MAX;
+  nvinfer->adaptive_interval_busy_objects =
+      DEFAULT_ADAPTIVE_INTERVAL_BUSY_OBJECTS;
+
+  nvinfer->fallback_engine_file_path = nullptr;
+  nvinfer->fallback_batch_size = 0;
+  nvinfer->model_update_keep_history = FALSE;
+
   /* Set the default pre-processing transform params. */
   nvinfer->transform_config_params.compute_mode = NvBufSurfTransformCompute_Default;
   nvinfer->transform_params.transform_filter = NvBufSurfTransformInter_Default;
@@ -388,6 +462,9 @@ gst_nvinfer_finalize (GObject * object)
   delete nvinfer->perClassColorParams;
   delete nvinfer->is_prop_set;
   g_free (nvinfer->config_file_path);
+  g_free (nvinfer->gallery_file_path);
+  g_free (nvinfer->gallery_index_file_path);
+  g_free (nvinfer->fallback_engine_file_path);
   delete nvinfer->operate_on_class_ids;
   delete nvinfer->filter_out_class_ids;
 
@@ -511,6 +588,23 @@ gst_nvinfer_set_property (GObject * object, guint prop_id,
     case PROP_OUTPUT_TENSOR_META:
       nvinfer->output_tensor_meta = g_value_get_boolean (value);
       break;
+    case PROP_GALLERY_FILE:
+      {
+        LockGMutex lock (nvinfer->process_lock);
+        const gchar *path = g_value_get_string (value);
+        g_free (nvinfer->gallery_file_path);
+        nvinfer->gallery_file_path =
+            (path && path[0]) ? g_strdup (path) : nullptr;
+        /* The element is running. Load the gallery from the new file in
+         * the gallery reload thread. */
+        if (nvinfer->gallery_file_path && impl->isContextReady () &&
+            !impl->triggerGalleryReload (nvinfer->gallery_file_path)) {
+          GST_ELEMENT_WARNING (nvinfer, LIBRARY, SETTINGS,
+              ("Gallery matching is applicable for embedding networks only. "
+                  "Ignoring gallery file"), (nullptr));
+        }
+      }
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -585,6 +679,27 @@ gst_nvinfer_get_property (GObject * object, guint prop_id,
     case PROP_OUTPUT_TENSOR_META:
       g_value_set_boolean (value, nvinfer->output_tensor_meta);
       break;
+    case PROP_GALLERY_FILE:
+      {
+        LockGMutex lock (nvinfer->process_lock);
+        g_value_set_string (value, nvinfer->gallery_file_path);
+      }
+      break;
+    case PROP_SOURCE_INTERVALS:
+      {
+        GstStructure *intervals = gst_structure_new_empty ("source-intervals");
+        LockGMutex lock (nvinfer->process_lock);
+        if (nvinfer->source_info) {
+          for (auto &source : *nvinfer->source_info) {
+            gchar *name = g_strdup_printf ("source-%d", source.first);
+            gst_structure_set (intervals, name, G_TYPE_UINT,
+                source.second.adaptive_interval, nullptr);
+            g_free (name);
+          }
+        }
+        g_value_take_boxed (value, intervals);
+      }
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -703,8 +818,13 @@ gst_nvinfer_sink_event (GstBaseTransform * trans, GstEvent * event)
     guint source_id;
     gst_nvevent_parse_stream_eos (event, &source_id);
     auto result = nvinfer->source_info->find (source_id);
-    if (result != nvinfer->source_info->end ())
+    if (result != nvinfer->source_info->end ()) {
       result->second.object_history_map.clear ();
+      result->second.motion_thumbnail.clear ();
+      result->second.last_detections = GstNvinfercustomDetections ();
+      result->second.adaptive_interval = 0;
+      result->second.adaptive_skipped_frames = 0;
+    }
   }
 
   if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
@@ -715,6 +835,41 @@ gst_nvinfer_sink_event (GstBaseTransform * trans, GstEvent * event)
   return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
 }
 
+/* Number of batch entries each full frame is sliced into. */
+static inline guint
+get_num_tiles (GstNvinfercustom * nvinfer)
+{
+  guint num_tiles = nvinfer->tile_columns * nvinfer->tile_rows;
+  if (num_tiles > 1 && nvinfer->tile_include_full_frame)
+    num_tiles++;
+  return num_tiles;
+}
+
+/* Create a NvDsInferContext from the fallback engine. Apart from the engine
+ * and the batch size, it uses the init params of the config. */
+static NvDsInferStatus
+create_fallback_context (GstNvinfercustom * nvinfer,
+    NvDsInferContextHandle * handle)
+{
+  DsNvInferImpl *impl = DS_NVINFER_IMPL (nvinfer);
+
+  /* Shallow copy, NvDsInferContext copies what it keeps of the params. */
+  NvDsInferContextInitParams params = *impl->m_InitParams;
+  g_strlcpy (params.modelEngineFilePath, nvinfer->fallback_engine_file_path,
+      _PATH_MAX);
+  params.engineCacheDir[0] = '\0';
+  params.loadEngineOnly = TRUE;
+  if (nvinfer->fallback_batch_size &&
+      nvinfer->fallback_batch_size < params.maxBatchSize)
+    params.maxBatchSize = nvinfer->fallback_batch_size;
+
+  NvDsInferStatus status = createNvDsInferContext (handle, params, nvinfer,
+      gst_nvinfer_logger);
+  if (status == NVDSINFER_SUCCESS)
+    nvinfer->infer_batch_size = params.maxBatchSize;
+  return status;
+}
+
 /**
  * Initialize all resources and start the output thread
  */
@@ -754,6 +909,11 @@ gst_nvinfer_start (GstBaseTransform * btrans)
 
   nvinfer->interval_counter = 0;
 
+  /* Replayed tensors and CPU inference are in host memory, no GPU is used. */
+  nvinfer->cpu_inference = init_params->useCpuInference;
+  nvinfer->host_memory = (init_params->replayTensorsFilePath[0] != '\0') ||
+      nvinfer->cpu_inference;
+
     int inputsize = 3 * 112 * 112 * sizeof(float);
     nvinfer->cpuBuffers = (float*)malloc(inputsize);
     memset(nvinfer->cpuBuffers, 0, inputsize);
@@ -779,6 +939,8 @@ gst_nvinfer_start (GstBaseTransform * btrans)
 #else
     create_params.memType = NVBUF_MEM_CUDA_UNIFIED;
 #endif
+    if (nvinfer->host_memory)
+        create_params.memType = NVBUF_MEM_SYSTEM;
 
     if (NvBufSurfaceCreate (&nvinfer->inter_buf, 1,
                             &create_params) != 0) {
@@ -787,9 +949,13 @@ gst_nvinfer_start (GstBaseTransform * btrans)
 
 
     /* Create host memory for storing converted/scaled interleaved RGB data */
-    CHECK_CUDA_STATUS (cudaMallocHost (&nvinfer->host_rgb_buf,
-                                       nvinfer->processing_width * nvinfer->processing_height *
-                                       RGB_BYTES_PER_PIXEL), "Could not allocate cuda host buffer");
+    if (nvinfer->host_memory)
+        nvinfer->host_rgb_buf = g_malloc0 (nvinfer->processing_width *
+                                           nvinfer->processing_height * RGB_BYTES_PER_PIXEL);
+    else
+        CHECK_CUDA_STATUS (cudaMallocHost (&nvinfer->host_rgb_buf,
+                                           nvinfer->processing_width * nvinfer->processing_height *
+                                           RGB_BYTES_PER_PIXEL), "Could not allocate cuda host buffer");
 
     GST_DEBUG_OBJECT (nvinfer, "allocated cuda buffer %p \n",
                       nvinfer->host_rgb_buf);
@@ -821,13 +987,40 @@ gst_nvinfer_start (GstBaseTransform * btrans)
    * Should allocate more buffers if the output tensor buffers will be attached
    * as meta to GstBuffers and pushed downstream. */
   init_params->outputBufferPoolSize = NVDSINFER_MIN_OUTPUT_BUFFERPOOL_SIZE;
-  if (nvinfer->output_tensor_meta || IS_SEGMENTATION_INSTANCE (nvinfer))
+  if (nvinfer->output_tensor_meta || IS_SEGMENTATION_INSTANCE (nvinfer) ||
+      IS_EMBEDDING_INSTANCE (nvinfer))
       init_params->outputBufferPoolSize = NVDSINFER_CTX_OUT_POOL_SIZE_FLOW_META;
 
+  /* With a fallback engine, only use the engine for the config if it has
+   * already been built. Otherwise infer with the fallback engine and build the
+   * engine in the model load thread, it replaces the fallback when done. */
+  nvinfer->infer_batch_size = nvinfer->max_batch_size;
+  gboolean build_in_background = FALSE;
+  if (nvinfer->fallback_engine_file_path) {
+    init_params->loadEngineOnly = TRUE;
+    status = createNvDsInferContext (&infer_context, *init_params,
+        nvinfer, gst_nvinfer_logger);
+    init_params->loadEngineOnly = FALSE;
+
+    if (status != NVDSINFER_SUCCESS) {
+      status = create_fallback_context (nvinfer, &infer_context);
+      if (status == NVDSINFER_SUCCESS) {
+        GST_INFO_OBJECT (nvinfer, "Inferring with fallback engine %s while "
+            "building the model engine", nvinfer->fallback_engine_file_path);
+        build_in_background = TRUE;
+      } else {
+        GST_ELEMENT_WARNING (nvinfer, RESOURCE, FAILED,
+            ("Failed to load fallback engine, building the model engine"),
+            ("Fallback engine path: %s", nvinfer->fallback_engine_file_path));
+      }
+    }
+  }
+
   /* Create the NvDsInferContext instance. */
-  status =
-      createNvDsInferContext (&infer_context, *init_params,
-      nvinfer, gst_nvinfer_logger);
+  if (!infer_context)
+    status =
+        createNvDsInferContext (&infer_context, *init_params,
+        nvinfer, gst_nvinfer_logger);
   if (status != NVDSINFER_SUCCESS) {
     GST_ELEMENT_ERROR (nvinfer, RESOURCE, FAILED,
         ("Failed to create NvDsInferContext instance"),
@@ -852,6 +1045,28 @@ gst_nvinfer_start (GstBaseTransform * btrans)
       nvinfer->output_layers_info->push_back (layer);
   }
 
+  /* Load the identity gallery for embedding instances. */
+  if (nvinfer->gallery_file_path) {
+    if (!IS_EMBEDDING_INSTANCE (nvinfer)) {
+      GST_ELEMENT_WARNING (nvinfer, LIBRARY, SETTINGS,
+          ("Gallery matching is applicable for embedding networks only. "
+              "Ignoring gallery file"), (nullptr));
+    } else {
+      std::string error;
+      std::shared_ptr<Gallery> gallery =
+          impl->createGallery (nvinfer->gallery_file_path, error);
+      if (!gallery) {
+        GST_ELEMENT_ERROR (nvinfer, RESOURCE, FAILED,
+            ("%s", error.c_str ()),
+            ("Gallery file path: %s", nvinfer->gallery_file_path));
+        return FALSE;
+      }
+      impl->setGallery (gallery);
+      GST_INFO_OBJECT (nvinfer, "Loaded gallery of %u identities from %s",
+          gallery->size (), nvinfer->gallery_file_path);
+    }
+  }
+
   nvinfer->file_write_batch_num = 0;
 
   /* Create process queue and input queue to transfer data between threads.
@@ -903,7 +1118,7 @@ gst_nvinfer_start (GstBaseTransform * btrans)
   std::unique_ptr<GstAllocator, decltype(allocator_deleter)> allocator_ptr (
       gst_nvinfer_allocator_new (nvinfer->network_width,
       nvinfer->network_height, color_format, nvinfer->max_batch_size,
-      nvinfer->gpu_id),
+      nvinfer->gpu_id, nvinfer->host_memory),
       allocator_deleter);
   memset (&allocation_params, 0, sizeof (allocation_params));
   gst_buffer_pool_config_set_allocator (config_ptr.get (), allocator_ptr.get (),
@@ -923,23 +1138,25 @@ gst_nvinfer_start (GstBaseTransform * btrans)
     return FALSE;
   }
 
-  cudaReturn = cudaSetDevice (nvinfer->gpu_id);
-  if (cudaReturn != cudaSuccess) {
-    GST_ELEMENT_ERROR (nvinfer, RESOURCE, FAILED,
-        ("Failed to set cuda device %d", nvinfer->gpu_id),
-        ("cudaSetDevice failed with error %s", cudaGetErrorName (cudaReturn)));
-    return FALSE;
-  }
+  if (!nvinfer->host_memory) {
+    cudaReturn = cudaSetDevice (nvinfer->gpu_id);
+    if (cudaReturn != cudaSuccess) {
+      GST_ELEMENT_ERROR (nvinfer, RESOURCE, FAILED,
+          ("Failed to set cuda device %d", nvinfer->gpu_id),
+          ("cudaSetDevice failed with error %s", cudaGetErrorName (cudaReturn)));
+      return FALSE;
+    }
 
-  cudaReturn =
-      cudaStreamCreateWithFlags (&nvinfer->convertStream,
-      cudaStreamNonBlocking);
-  if (cudaReturn != cudaSuccess) {
-    GST_ELEMENT_ERROR (nvinfer, RESOURCE, FAILED,
-        ("Failed to create cuda stream"),
-        ("cudaStreamCreateWithFlags failed with error %s",
-            cudaGetErrorName (cudaReturn)));
-    return FALSE;
+    cudaReturn =
+        cudaStreamCreateWithFlags (&nvinfer->convertStream,
+        cudaStreamNonBlocking);
+    if (cudaReturn != cudaSuccess) {
+      GST_ELEMENT_ERROR (nvinfer, RESOURCE, FAILED,
+          ("Failed to create cuda stream"),
+          ("cudaStreamCreateWithFlags failed with error %s",
+              cudaGetErrorName (cudaReturn)));
+      return FALSE;
+    }
   }
 
   /* Set the NvBufSurfTransform config parameters. */
@@ -977,6 +1194,44 @@ gst_nvinfer_start (GstBaseTransform * btrans)
     }
   }
 
+  if (nvinfer->tile_columns * nvinfer->tile_rows > 1) {
+    if (!nvinfer->process_full_frame || !IS_DETECTOR_INSTANCE (nvinfer)) {
+      GST_ELEMENT_WARNING (nvinfer, LIBRARY, SETTINGS,
+          ("Tiling is applicable for full-frame detectors only. "
+              "Turning off tiling"), (nullptr));
+      nvinfer->tile_columns = nvinfer->tile_rows = 1;
+    } else if (get_num_tiles (nvinfer) > nvinfer->infer_batch_size) {
+      GST_ELEMENT_ERROR (nvinfer, LIBRARY, SETTINGS,
+          ("Number of tiles per frame (%u) exceeds batch-size (%u)",
+              get_num_tiles (nvinfer), nvinfer->infer_batch_size), (nullptr));
+      return FALSE;
+    }
+  }
+
+  if (nvinfer->motion_threshold > 0 && nvinfer->host_memory) {
+    GST_ELEMENT_WARNING (nvinfer, LIBRARY, SETTINGS,
+        ("Motion gating needs a GPU to scale frames. "
+            "Turning off motion gating while inferring without a GPU"),
+        (nullptr));
+    nvinfer->motion_threshold = 0;
+  }
+
+  if (nvinfer->motion_threshold > 0 &&
+      (!nvinfer->process_full_frame || !IS_DETECTOR_INSTANCE (nvinfer))) {
+    GST_ELEMENT_WARNING (nvinfer, LIBRARY, SETTINGS,
+        ("Motion gating is applicable for full-frame detectors only. "
+            "Turning off motion gating"), (nullptr));
+    nvinfer->motion_threshold = 0;
+  }
+
+  if (nvinfer->adaptive_interval_max > 0 &&
+      (!nvinfer->process_full_frame || !IS_DETECTOR_INSTANCE (nvinfer))) {
+    GST_ELEMENT_WARNING (nvinfer, LIBRARY, SETTINGS,
+        ("Adaptive interval is applicable for full-frame detectors only. "
+            "Turning off adaptive interval"), (nullptr));
+    nvinfer->adaptive_interval_max = 0;
+  }
+
   /* Start a thread which will pop output from the algorithm, form NvDsMeta and
    * push buffers to the next element. */
   nvinfer->output_thread =
@@ -996,6 +1251,14 @@ gst_nvinfer_start (GstBaseTransform * btrans)
           ("NvInfer start loading model thread failed."), (nullptr));
       return FALSE;
   }
+  /* Embedding instances started without a gallery load one when the
+   * "gallery-file" property is set. */
+  if (IS_EMBEDDING_INSTANCE (nvinfer)) {
+    impl->startGalleryReload (nvinfer->gallery_file_path ?
+        nvinfer->gallery_file_path : "", nvinfer->gallery_reload_interval);
+  }
+  if (build_in_background)
+    impl->triggerNewModel (nvinfer->config_file_path, MODEL_LOAD_FROM_CONFIG);
 
   nvinfer->nvtx_domain = nvtx_domain_ptr.release ();
   nvinfer->pool = pool_ptr.release ();
@@ -1034,6 +1297,8 @@ gst_nvinfer_stop (GstBaseTransform * btrans)
   g_thread_join (nvinfer->input_queue_thread);
   g_thread_join (nvinfer->output_thread);
 
+  impl->setGallery (nullptr);
+
   nvinfer->stop = FALSE;
 
   delete nvinfer->source_info;
@@ -1044,10 +1309,11 @@ gst_nvinfer_stop (GstBaseTransform * btrans)
   delete[] nvinfer->transform_params.dst_rect;
   delete[] nvinfer->tmp_surf.surfaceList;
 
-  cudaSetDevice (nvinfer->gpu_id);
-
-  if (nvinfer->convertStream)
+  if (nvinfer->convertStream) {
+    cudaSetDevice (nvinfer->gpu_id);
     cudaStreamDestroy (nvinfer->convertStream);
+    nvinfer->convertStream = nullptr;
+  }
 
   /* Free up the memory allocated by pool. */
   gst_object_unref (nvinfer->pool);
@@ -1058,10 +1324,133 @@ gst_nvinfer_stop (GstBaseTransform * btrans)
         NvBufSurfaceDestroy(nvinfer->inter_buf);
     nvinfer->inter_buf = NULL;
 
+  if (nvinfer->motion_surf) {
+    NvBufSurfaceUnMap (nvinfer->motion_surf, -1, 0);
+    NvBufSurfaceDestroy (nvinfer->motion_surf);
+  }
+  nvinfer->motion_surf = nullptr;
+
   return TRUE;
 }
 
 
+/* Index of a packed color format in the host color conversion table, or -1 if
+ * the format can't be converted with a single cvtColor. */
+static gint
+host_color_format_index (NvBufSurfaceColorFormat format)
+{
+  switch (format) {
+    case NVBUF_COLOR_FORMAT_GRAY8:
+      return 0;
+    case NVBUF_COLOR_FORMAT_RGB:
+      return 1;
+    case NVBUF_COLOR_FORMAT_BGR:
+      return 2;
+    case NVBUF_COLOR_FORMAT_RGBA:
+    case NVBUF_COLOR_FORMAT_RGBx:
+      return 3;
+    case NVBUF_COLOR_FORMAT_BGRA:
+    case NVBUF_COLOR_FORMAT_BGRx:
+      return 4;
+    default:
+      return -1;
+  }
+}
+
+/**
+ * Host memory counterpart of NvBufSurfTransform used for CPU inference. Crops
+ * src_rect out of the source frame, converts it to the color format of
+ * dest_mat (GRAY, RGB or RGBA) and scales it into dst_rect of dest_mat. The
+ * rest of dest_mat is padded with black. The source frame must be in system or
+ * CPU mappable memory.
+ */
+static GstFlowReturn
+convert_frame_on_host (GstNvinfercustom * nvinfer, NvBufSurface * src_surf,
+    guint idx, const NvBufSurfTransformRect & src_rect, cv::Mat & dest_mat,
+    const NvBufSurfTransformRect & dst_rect)
+{
+  /* Indexed by source format and destination channels (1, 3, 4). -1 when
+   * the crop can be scaled as is. */
+  static const int conversion_codes[5][3] = {
+    {-1, cv::COLOR_GRAY2RGB, cv::COLOR_GRAY2RGBA},
+    {cv::COLOR_RGB2GRAY, -1, cv::COLOR_RGB2RGBA},
+    {cv::COLOR_BGR2GRAY, cv::COLOR_BGR2RGB, cv::COLOR_BGR2RGBA},
+    {cv::COLOR_RGBA2GRAY, cv::COLOR_RGBA2RGB, -1},
+    {cv::COLOR_BGRA2GRAY, cv::COLOR_BGRA2RGB, cv::COLOR_BGRA2RGBA},
+  };
+  static const int format_channels[5] = {1, 3, 3, 4, 4};
+  NvBufSurfaceParams *src_frame = &src_surf->surfaceList[idx];
+  gint src_index = host_color_format_index (src_frame->colorFormat);
+  gint dest_index = dest_mat.channels () == 1 ? 0 :
+      (dest_mat.channels () == 3 ? 1 : 2);
+  gboolean mapped = (src_surf->memType != NVBUF_MEM_SYSTEM);
+  cv::Rect crop (src_rect.left, src_rect.top, src_rect.width, src_rect.height);
+  void *planes[2];
+  cv::Mat luma, converted, dest_roi;
+
+  if (src_index < 0 && src_frame->colorFormat != NVBUF_COLOR_FORMAT_NV12) {
+    GST_ERROR_OBJECT (nvinfer,
+        "Color format %d is not supported by CPU conversion",
+        src_frame->colorFormat);
+    return GST_FLOW_ERROR;
+  }
+
+  /* System memory is CPU accessible as is, other memory types are mapped. */
+  if (mapped) {
+    if (NvBufSurfaceMap (src_surf, idx, -1, NVBUF_MAP_READ) != 0) {
+      GST_ERROR_OBJECT (nvinfer,
+          "Failed to map frame for CPU conversion, input frames must be in "
+          "CPU mappable memory when inferring on the CPU");
+      return GST_FLOW_ERROR;
+    }
+    NvBufSurfaceSyncForCpu (src_surf, idx, -1);
+    planes[0] = src_frame->mappedAddr.addr[0];
+    planes[1] = src_frame->mappedAddr.addr[1];
+  } else {
+    planes[0] = (uint8_t *) src_frame->dataPtr +
+        src_frame->planeParams.offset[0];
+    planes[1] = (uint8_t *) src_frame->dataPtr +
+        src_frame->planeParams.offset[1];
+  }
+
+  if (src_index < 0) {
+    /* NV12: the luma plane is the gray image, color needs both planes. */
+    luma = cv::Mat (src_frame->height, src_frame->width, CV_8UC1, planes[0],
+        src_frame->planeParams.pitch[0]);
+    if (dest_index == 0) {
+      converted = luma (crop);
+    } else {
+      cv::Mat chroma (src_frame->height / 2, src_frame->width / 2, CV_8UC2,
+          planes[1], src_frame->planeParams.pitch[1]);
+      cv::Rect chroma_crop (crop.x / 2, crop.y / 2, crop.width / 2,
+          crop.height / 2);
+      cv::cvtColorTwoPlane (luma (crop), chroma (chroma_crop), converted,
+          dest_index == 1 ? cv::COLOR_YUV2RGB_NV12 : cv::COLOR_YUV2RGBA_NV12);
+    }
+  } else {
+    cv::Mat src_mat (src_frame->height, src_frame->width,
+        CV_8UC (format_channels[src_index]), planes[0],
+        src_frame->planeParams.pitch[0]);
+    int code = conversion_codes[src_index][dest_index];
+    if (code < 0)
+      converted = src_mat (crop);
+    else
+      cv::cvtColor (src_mat (crop), converted, code);
+  }
+
+  /* Pad with black and scale into the destination ROI. */
+  dest_mat.setTo (0);
+  dest_roi = dest_mat (cv::Rect (dst_rect.left, dst_rect.top, dst_rect.width,
+          dst_rect.height));
+  cv::resize (converted, dest_roi, dest_roi.size (), 0, 0, cv::INTER_LINEAR);
+
+  if (mapped)
+    NvBufSurfaceUnMap (src_surf, idx, -1);
+
+  return GST_FLOW_OK;
+}
+
+
 /**
  * Scale the entire frame to the processing resolution maintaining aspect ratio.
  * Or crop and scale objects to the processing resolution maintaining the aspect
@@ -1106,6 +1495,34 @@ get_converted_mat (GstNvinfercustom * nvinfer, NvBufSurface *src_surf, gint idx,
         dest_height = nvinfer->processing_height;
     }
 
+    /* Replayed tensors don't depend on the input, the mat keeps its previous
+     * contents. */
+    if (nvinfer->host_memory && !nvinfer->cpu_inference) {
+        ratio = MIN (1.0 * dest_width/ src_width, 1.0 * dest_height / src_height);
+        return GST_FLOW_OK;
+    }
+
+    /* CPU inference scales and converts the frame with OpenCV into the
+     * system memory intermediate buffer. */
+    if (nvinfer->cpu_inference) {
+        ratio = MIN (1.0 * dest_width/ src_width, 1.0 * dest_height / src_height);
+        src_rect = {(guint)src_top, (guint)src_left, (guint)src_width, (guint)src_height};
+        dst_rect = {0, 0, (guint)dest_width, (guint)dest_height};
+        in_mat =
+                cv::Mat (nvinfer->processing_height, nvinfer->processing_width,
+                         CV_8UC4, nvinfer->inter_buf->surfaceList[0].dataPtr,
+                         nvinfer->inter_buf->surfaceList[0].pitch);
+        if (convert_frame_on_host (nvinfer, src_surf, idx, src_rect, in_mat,
+                dst_rect) != GST_FLOW_OK)
+            goto error;
+#if (CV_MAJOR_VERSION >= 4)
+        cv::cvtColor (in_mat, *nvinfer->cvmat, cv::COLOR_RGBA2BGR);
+#else
+        cv::cvtColor (in_mat, *nvinfer->cvmat, CV_RGBA2BGR);
+#endif
+        return GST_FLOW_OK;
+    }
+
     /* Configure transform session parameters for the transformation */
     transform_config_params.compute_mode = NvBufSurfTransformCompute_Default;
     transform_config_params.gpu_id = nvinfer->gpu_id;
@@ -1227,7 +1644,6 @@ get_converted_buffer (GstNvinfercustom * nvinfer, NvBufSurface * src_surf,
   guint dest_width, dest_height;
 
   if (nvinfer->maintain_aspect_ratio) {
-      printf("fsfdskgskgjdskfjdksjg\n");
     /* Calculate the destination width and height required to maintain
      * the aspect ratio. */
     double hdest = dest_frame->width * src_height / (double) src_width;
@@ -1259,20 +1675,29 @@ get_converted_buffer (GstNvinfercustom * nvinfer, NvBufSurface * src_surf,
         break;
     }
 
-    /* Pad the scaled image with black color. */
-    cudaReturn =cudaMemset2DAsync ((uint8_t *) destCudaPtr + pixel_size * dest_width,dest_frame->planeParams.pitch[0], 0,pixel_size * (dest_frame->width - dest_width), dest_frame->height,nvinfer->convertStream);
-    if (cudaReturn != cudaSuccess) {
-      GST_ERROR_OBJECT (nvinfer,
-          "cudaMemset2DAsync failed with error %s while converting buffer",
-          cudaGetErrorName (cudaReturn));
-      return GST_FLOW_ERROR;
-    }
-    cudaReturn =cudaMemset2DAsync ((uint8_t *) destCudaPtr +dest_frame->planeParams.pitch[0] * dest_height,dest_frame->planeParams.pitch[0], 0, pixel_size * dest_width,dest_frame->height - dest_height, nvinfer->convertStream);
-    if (cudaReturn != cudaSuccess) {
-      GST_ERROR_OBJECT (nvinfer,
-          "cudaMemset2DAsync failed with error %s while converting buffer",
-          cudaGetErrorName (cudaReturn));
-      return GST_FLOW_ERROR;
+    /* Pad the scaled image with black color. Without a GPU the padding is
+     * done by the CPU conversion, or not needed for replayed tensors. */
+    if (!nvinfer->host_memory) {
+      cudaReturn = cudaMemset2DAsync ((uint8_t *) destCudaPtr +
+          pixel_size * dest_width, dest_frame->planeParams.pitch[0], 0,
+          pixel_size * (dest_frame->width - dest_width), dest_frame->height,
+          nvinfer->convertStream);
+      if (cudaReturn != cudaSuccess) {
+        GST_ERROR_OBJECT (nvinfer,
+            "cudaMemset2DAsync failed with error %s while converting buffer",
+            cudaGetErrorName (cudaReturn));
+        return GST_FLOW_ERROR;
+      }
+      cudaReturn = cudaMemset2DAsync ((uint8_t *) destCudaPtr +
+          dest_frame->planeParams.pitch[0] * dest_height,
+          dest_frame->planeParams.pitch[0], 0, pixel_size * dest_width,
+          dest_frame->height - dest_height, nvinfer->convertStream);
+      if (cudaReturn != cudaSuccess) {
+        GST_ERROR_OBJECT (nvinfer,
+            "cudaMemset2DAsync failed with error %s while converting buffer",
+            cudaGetErrorName (cudaReturn));
+        return GST_FLOW_ERROR;
+      }
     }
   } else {
     dest_width = nvinfer->network_width;
@@ -1280,6 +1705,8 @@ get_converted_buffer (GstNvinfercustom * nvinfer, NvBufSurface * src_surf,
   }
 
     ////////////////////////////////////////////////////////
+  /* Full frames and tiles have no aligned face. */
+  if (!alignedFace.empty ()) {
     alignedFace.convertTo(alignedFace, CV_32FC3);
     std::vector<cv::Mat> input_channels;
     float* inputData = nvinfer->cpuBuffers;
@@ -1289,7 +1716,11 @@ get_converted_buffer (GstNvinfercustom * nvinfer, NvBufSurface * src_surf,
         inputData += dest_width * dest_height;
     }
     cv::split(alignedFace, input_channels);
-    cudaMemcpy((uint8_t *) destCudaPtr + 3 * dest_width, nvinfer->cpuBuffers, dest_width * dest_height * 3 * sizeof(float), cudaMemcpyHostToDevice);
+    if (nvinfer->host_memory)
+      memcpy((uint8_t *) destCudaPtr + 3 * dest_width, nvinfer->cpuBuffers, dest_width * dest_height * 3 * sizeof(float));
+    else
+      cudaMemcpy((uint8_t *) destCudaPtr + 3 * dest_width, nvinfer->cpuBuffers, dest_width * dest_height * 3 * sizeof(float), cudaMemcpyHostToDevice);
+  }
     ///////////////////////////////////////////////////////
   /* Calculate the scaling ratio of the frame / object crop. This will be
    * required later for rescaling the detector output boxes to input resolution.
@@ -1297,6 +1728,24 @@ get_converted_buffer (GstNvinfercustom * nvinfer, NvBufSurface * src_surf,
   ratio_x = (double) dest_width / src_width;
   ratio_y = (double) dest_height / src_height;
 
+  /* CPU inference converts the frame right away, there is no batched
+   * transform. */
+  if (nvinfer->cpu_inference) {
+    NvBufSurfTransformRect src_rect = {src_top, src_left, src_width, src_height};
+    NvBufSurfTransformRect dst_rect = {0, 0, dest_width, dest_height};
+    int channels = 1;
+
+    if (dest_frame->colorFormat == NVBUF_COLOR_FORMAT_RGBA)
+      channels = 4;
+    else if (dest_frame->colorFormat == NVBUF_COLOR_FORMAT_RGB)
+      channels = 3;
+    cv::Mat dest_mat (dest_frame->height, dest_frame->width, CV_8UC (channels),
+        destCudaPtr, dest_frame->planeParams.pitch[0]);
+
+    return convert_frame_on_host (nvinfer, src_surf,
+        src_frame - src_surf->surfaceList, src_rect, dest_mat, dst_rect);
+  }
+
   /* Create temporary src and dest surfaces for NvBufSurfTransform API. */
   nvinfer->tmp_surf.surfaceList[nvinfer->tmp_surf.numFilled] = *src_frame;
 
@@ -1342,7 +1791,10 @@ gst_nvinfer_input_queue_loop (gpointer data)
       continue;
     }
     batch = (GstNvinfercustomBatch *) g_queue_pop_head (nvinfer->input_queue);
-    NvDsInferContextPtr nvdsinfer_ctx = impl->m_InferCtx;
+    /* Bind the batch to the current context, the output thread dequeues its
+     * output from the same context even if the model is updated meanwhile. */
+    batch->infer_context = impl->m_InferCtx;
+    NvDsInferContextPtr nvdsinfer_ctx = batch->infer_context;
 
     /* Check if this is a push buffer or event marker batch. If yes, no need to
      * queue the input for inferencing. */
@@ -1418,7 +1870,8 @@ convert_batch_and_push_to_input_thread (GstNvinfercustom *nvinfer,
 
   /* Set the transform session parameters for the conversions executed in this
    * thread. */
-  err = NvBufSurfTransformSetSessionParams (&nvinfer->transform_config_params);
+  if (!nvinfer->host_memory)
+    err = NvBufSurfTransformSetSessionParams (&nvinfer->transform_config_params);
   if (err != NvBufSurfTransformError_Success) {
     GST_ELEMENT_ERROR (nvinfer, STREAM, FAILED,
         ("NvBufSurfTransformSetSessionParams failed with error %d", err), (NULL));
@@ -1436,7 +1889,9 @@ convert_batch_and_push_to_input_thread (GstNvinfercustom *nvinfer,
 
   nvtxDomainRangePushEx(nvinfer->nvtx_domain, &eventAttrib);
 
-  if (batch->frames.size() > 0) {
+  /* Without a GPU, frames are either not needed (replayed tensors) or were
+   * already converted on the CPU. */
+  if (batch->frames.size() > 0 && !nvinfer->host_memory) {
     /* Batched tranformation. */
     err = NvBufSurfTransform (&nvinfer->tmp_surf, mem->surf,
               &nvinfer->transform_params);
@@ -1525,7 +1980,7 @@ should_infer_object (GstNvinfercustom * nvinfer, GstBuffer * inbuf,
   }
 
   /* History is irrevelavant for detectors. */
-  if (history && IS_CLASSIFIER_INSTANCE (nvinfer)) {
+  if (history && USES_OBJECT_HISTORY (nvinfer)) {
     gboolean should_reinfer = FALSE;
 
     /* Do not reinfer if the object area has not grown by the reinference area
@@ -1547,6 +2002,345 @@ should_infer_object (GstNvinfercustom * nvinfer, GstBuffer * inbuf,
 }
 #define NVDS_USER_FRAME_META_EXAMPLE (nvds_get_user_meta_type("NVIDIA.NVINFER.USER_META"))
 
+/* Computes the regions of a frame to be inferred on. This is the entire frame
+ * unless tiling is configured, in which case tiles of equal size are spread
+ * evenly so that the first and last tile of each row / column touch the frame
+ * edges. Tile origins are kept even since get_converted_buffer() aligns the
+ * source ROI to even pixels and the same origins are used to map the
+ * detections back to the frame. */
+static void
+get_frame_tiles (GstNvinfercustom * nvinfer, guint frame_width,
+    guint frame_height, std::vector<NvOSD_RectParams> & tiles)
+{
+  guint columns = nvinfer->tile_columns;
+  guint rows = nvinfer->tile_rows;
+  NvOSD_RectParams rect_params;
+
+  memset (&rect_params, 0, sizeof (rect_params));
+  tiles.clear ();
+
+  if (columns * rows == 1 || nvinfer->tile_include_full_frame) {
+    rect_params.width = frame_width;
+    rect_params.height = frame_height;
+    tiles.push_back (rect_params);
+    if (columns * rows == 1)
+      return;
+  }
+
+  /* Size of a tile such that neighbouring tiles share the configured overlap
+   * fraction. */
+  guint tile_width = GST_ROUND_UP_2 ((guint) ceil (frame_width /
+          (columns - (columns - 1) * nvinfer->tile_overlap)));
+  guint tile_height = GST_ROUND_UP_2 ((guint) ceil (frame_height /
+          (rows - (rows - 1) * nvinfer->tile_overlap)));
+  tile_width = MIN (tile_width, GST_ROUND_DOWN_2 (frame_width));
+  tile_height = MIN (tile_height, GST_ROUND_DOWN_2 (frame_height));
+
+  for (guint r = 0; r < rows; r++) {
+    for (guint c = 0; c < columns; c++) {
+      rect_params.left = (columns > 1) ?
+          GST_ROUND_DOWN_2 ((frame_width - tile_width) * c / (columns - 1)) : 0;
+      rect_params.top = (rows > 1) ?
+          GST_ROUND_DOWN_2 ((frame_height - tile_height) * r / (rows - 1)) : 0;
+      rect_params.width = tile_width;
+      rect_params.height = tile_height;
+      tiles.push_back (rect_params);
+    }
+  }
+}
+
+/* Scales all the frames of the input batch to luma thumbnails for the motion
+ * gate. The thumbnails are read by the CPU once this returns. */
+static gboolean
+get_motion_thumbnails (GstNvinfercustom * nvinfer, NvBufSurface * in_surf)
+{
+  NvBufSurfTransform_Error err;
+  NvBufSurfTransformParams transform_params;
+  std::vector<NvBufSurfTransformRect> src_rects (in_surf->numFilled);
+  std::vector<NvBufSurfTransformRect> dst_rects (in_surf->numFilled,
+      NvBufSurfTransformRect {0, 0, MOTION_THUMBNAIL_WIDTH,
+          MOTION_THUMBNAIL_HEIGHT});
+
+  if (nvinfer->motion_surf &&
+      nvinfer->motion_surf->batchSize < in_surf->numFilled) {
+    NvBufSurfaceUnMap (nvinfer->motion_surf, -1, 0);
+    NvBufSurfaceDestroy (nvinfer->motion_surf);
+    nvinfer->motion_surf = nullptr;
+  }
+
+  if (!nvinfer->motion_surf) {
+    NvBufSurfaceCreateParams create_params;
+
+    memset (&create_params, 0, sizeof (create_params));
+    create_params.gpuId = nvinfer->gpu_id;
+    create_params.width = MOTION_THUMBNAIL_WIDTH;
+    create_params.height = MOTION_THUMBNAIL_HEIGHT;
+    create_params.layout = NVBUF_LAYOUT_PITCH;
+    /* Only the luma plane is read. */
+#ifdef IS_TEGRA
+    create_params.colorFormat = NVBUF_COLOR_FORMAT_NV12;
+    create_params.memType = NVBUF_MEM_DEFAULT;
+#else
+    create_params.colorFormat = NVBUF_COLOR_FORMAT_GRAY8;
+    create_params.memType = NVBUF_MEM_CUDA_UNIFIED;
+#endif
+
+    if (NvBufSurfaceCreate (&nvinfer->motion_surf,
+            MAX (in_surf->batchSize, in_surf->numFilled), &create_params) != 0) {
+      nvinfer->motion_surf = nullptr;
+      GST_ELEMENT_ERROR (nvinfer, RESOURCE, FAILED,
+          ("Failed to allocate motion thumbnail buffer"), (nullptr));
+      return FALSE;
+    }
+    if (NvBufSurfaceMap (nvinfer->motion_surf, -1, 0, NVBUF_MAP_READ) != 0) {
+      GST_ELEMENT_ERROR (nvinfer, RESOURCE, FAILED,
+          ("Failed to map motion thumbnail buffer"), (nullptr));
+      return FALSE;
+    }
+  }
+
+  for (guint i = 0; i < in_surf->numFilled; i++) {
+    src_rects[i] = {0, 0, in_surf->surfaceList[i].width,
+        in_surf->surfaceList[i].height};
+  }
+  nvinfer->motion_surf->numFilled = in_surf->numFilled;
+
+  transform_params.src_rect = src_rects.data ();
+  transform_params.dst_rect = dst_rects.data ();
+  transform_params.transform_flag =
+      NVBUFSURF_TRANSFORM_FILTER | NVBUFSURF_TRANSFORM_CROP_SRC |
+      NVBUFSURF_TRANSFORM_CROP_DST;
+  transform_params.transform_filter = NvBufSurfTransformInter_Bilinear;
+  transform_params.transform_flip = NvBufSurfTransform_None;
+
+  err = NvBufSurfTransformSetSessionParams (&nvinfer->transform_config_params);
+  if (err == NvBufSurfTransformError_Success)
+    err = NvBufSurfTransform (in_surf, nvinfer->motion_surf, &transform_params);
+  if (err != NvBufSurfTransformError_Success) {
+    GST_ELEMENT_ERROR (nvinfer, STREAM, FAILED,
+        ("NvBufSurfTransform failed with error %d while scaling motion "
+            "thumbnails", err), (NULL));
+    return FALSE;
+  }
+
+  cudaStreamSynchronize (nvinfer->convertStream);
+  NvBufSurfaceSyncForCpu (nvinfer->motion_surf, -1, 0);
+
+  return TRUE;
+}
+
+/* Motion gate. Decides whether a frame should be inferred on by comparing its
+ * luma thumbnail with the one of the last frame of the source inferred on.
+ * The thumbnail of an inferred frame becomes the new reference, so that slow
+ * changes accumulate until they are detected. */
+static gboolean
+should_infer_frame (GstNvinfercustom * nvinfer,
+    GstNvinfercustomSourceInfo * source_info, guint batch_id)
+{
+  NvBufSurfaceParams *thumbnail = nvinfer->motion_surf->surfaceList + batch_id;
+  const guint8 *luma = (const guint8 *) thumbnail->mappedAddr.addr[0];
+  guint pitch = thumbnail->planeParams.pitch[0];
+  std::vector<guint8> &reference = source_info->motion_thumbnail;
+
+  if (!reference.empty () && (nvinfer->motion_max_stale_frames == 0 ||
+          source_info->motion_skipped_frames <
+          nvinfer->motion_max_stale_frames)) {
+    guint changed = 0;
+
+    for (guint y = 0; y < MOTION_THUMBNAIL_HEIGHT; y++) {
+      const guint8 *row = luma + y * pitch;
+      const guint8 *ref_row = reference.data () + y * MOTION_THUMBNAIL_WIDTH;
+      for (guint x = 0; x < MOTION_THUMBNAIL_WIDTH; x++)
+        changed += ((guint) abs (row[x] - ref_row[x]) >
+            nvinfer->motion_pixel_delta);
+    }
+
+    if (changed < nvinfer->motion_threshold *
+        (MOTION_THUMBNAIL_WIDTH * MOTION_THUMBNAIL_HEIGHT)) {
+      source_info->motion_skipped_frames++;
+      return FALSE;
+    }
+  }
+
+  reference.resize (MOTION_THUMBNAIL_WIDTH * MOTION_THUMBNAIL_HEIGHT);
+  for (guint y = 0; y < MOTION_THUMBNAIL_HEIGHT; y++) {
+    memcpy (reference.data () + y * MOTION_THUMBNAIL_WIDTH, luma + y * pitch,
+        MOTION_THUMBNAIL_WIDTH);
+  }
+  source_info->motion_skipped_frames = 0;
+
+  return TRUE;
+}
+
+/* Process on full frames. Every frame is scaled to the network resolution, or
+ * sliced into overlapping tiles each scaled to the network resolution. All the
+ * tiles of a frame are always submitted in the same batch so that the output
+ * thread can merge their detections. */
+static GstFlowReturn
+gst_nvinfer_process_full_frame (GstNvinfercustom * nvinfer, GstBuffer * inbuf,
+    NvBufSurface * in_surf)
+{
+  std::unique_ptr<GstNvinfercustomBatch> batch (nullptr);
+  GstBuffer *conv_gst_buf = nullptr;
+  GstNvinfercustomMemory *memory = nullptr;
+  GstFlowReturn flow_ret;
+  gdouble scale_ratio_x, scale_ratio_y;
+  std::vector<NvOSD_RectParams> tiles;
+  gboolean skip_batch;
+  gboolean motion_gate = (nvinfer->motion_threshold > 0);
+
+  /* Process batch only when interval_counter is 0. */
+  skip_batch = (nvinfer->interval_counter++ % (nvinfer->interval + 1) > 0);
+  if (skip_batch) {
+    return GST_FLOW_OK;
+  }
+
+  if (motion_gate && !get_motion_thumbnails (nvinfer, in_surf)) {
+    return GST_FLOW_ERROR;
+  }
+
+  NvDsBatchMeta *batch_meta = gst_buffer_get_nvds_batch_meta (inbuf);
+  if (batch_meta == nullptr) {
+    GST_ELEMENT_ERROR (nvinfer, STREAM, FAILED,
+        ("NvDsBatchMeta not found for input buffer."), (NULL));
+    return GST_FLOW_ERROR;
+  }
+
+  for (NvDsMetaList * l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    NvDsFrameMeta *frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    NvBufSurfaceParams *src_frame = in_surf->surfaceList + frame_meta->batch_id;
+    GstNvinfercustomSourceInfo *source_info = nullptr;
+    gboolean infer_frame = TRUE;
+
+    auto iter = nvinfer->source_info->find (frame_meta->pad_index);
+    if (iter != nvinfer->source_info->end ())
+      source_info = &iter->second;
+
+    /* Skip the frame if the source has not reached its adaptive interval.
+     * Like with "interval", nothing is attached to skipped frames. */
+    if (source_info && nvinfer->adaptive_interval_max > 0) {
+      LockGMutex locker (nvinfer->process_lock);
+      if (source_info->adaptive_skipped_frames <
+          source_info->adaptive_interval) {
+        source_info->adaptive_skipped_frames++;
+        continue;
+      }
+      source_info->adaptive_skipped_frames = 0;
+    }
+
+    if (motion_gate && source_info)
+      infer_frame = should_infer_frame (nvinfer, source_info,
+          frame_meta->batch_id);
+
+    get_frame_tiles (nvinfer, src_frame->width, src_frame->height, tiles);
+
+    /* Submit the current batch first if the tiles of this frame do not fit
+     * in it. */
+    if (infer_frame && batch &&
+        batch->frames.size () + tiles.size () > nvinfer->infer_batch_size) {
+      if (!convert_batch_and_push_to_input_thread (nvinfer, batch.get(), memory)) {
+        return GST_FLOW_ERROR;
+      }
+      batch.release ();
+      conv_gst_buf = nullptr;
+      nvinfer->tmp_surf.numFilled = 0;
+    }
+
+    /* No existing GstNvinfercustomBatch structure. Allocate a new structure,
+     * acquire a buffer from our internal pool for conversions. */
+    if (batch == nullptr) {
+      batch.reset (new GstNvinfercustomBatch);
+      batch->push_buffer = FALSE;
+      batch->inbuf = inbuf;
+      batch->inbuf_batch_num = nvinfer->current_batch_num;
+
+      flow_ret =
+          gst_buffer_pool_acquire_buffer (nvinfer->pool, &conv_gst_buf,
+          nullptr);
+      if (flow_ret != GST_FLOW_OK) {
+        return flow_ret;
+      }
+      memory = gst_nvinfer_buffer_get_memory (conv_gst_buf);
+      if (!memory) {
+        return GST_FLOW_ERROR;
+      }
+      batch->conv_buf = conv_gst_buf;
+    }
+
+    /* Static frame. The output thread attaches the last detections of the
+     * source. */
+    if (!infer_frame) {
+      GstNvinfercustomFrame frame;
+      frame.scale_ratio_x = frame.scale_ratio_y = 1;
+      frame.frame_meta = frame_meta;
+      frame.frame_num = frame_meta->frame_num;
+      frame.batch_index = frame_meta->batch_id;
+      frame.input_surf_params = src_frame;
+      batch->frames_pending_meta_attach.push_back (frame);
+      continue;
+    }
+
+    for (guint t = 0; t < tiles.size (); t++) {
+      guint idx = batch->frames.size ();
+
+      /* Crop, scale and convert the buffer. */
+      if (get_converted_buffer (nvinfer, in_surf, src_frame, &tiles[t],
+              memory->surf, memory->surf->surfaceList + idx, scale_ratio_x,
+              scale_ratio_y, memory->frame_memory_ptrs[idx], cv::Mat ())
+          != GST_FLOW_OK) {
+        GST_ELEMENT_ERROR (nvinfer, STREAM, FAILED, ("Buffer conversion failed"),
+            (NULL));
+        return GST_FLOW_ERROR;
+      }
+
+      /* Adding a frame to the current batch. Set the frames members. */
+      GstNvinfercustomFrame frame;
+      frame.converted_frame_ptr = memory->frame_memory_ptrs[idx];
+      frame.scale_ratio_x = scale_ratio_x;
+      frame.scale_ratio_y = scale_ratio_y;
+      frame.obj_meta = nullptr;
+      frame.frame_meta = frame_meta;
+      frame.frame_num = frame_meta->frame_num;
+      frame.batch_index = frame_meta->batch_id;
+      frame.input_surf_params = src_frame;
+      frame.tile_left = tiles[t].left;
+      frame.tile_top = tiles[t].top;
+      frame.num_tiles = (t == 0) ? tiles.size () : 1;
+      batch->frames.push_back (frame);
+    }
+
+    /* Submit batch if the batch size has reached infer_batch_size. */
+    if (batch->frames.size () == nvinfer->infer_batch_size) {
+      if (!convert_batch_and_push_to_input_thread (nvinfer, batch.get(), memory)) {
+        return GST_FLOW_ERROR;
+      }
+      /* Batch submitted. Set batch to nullptr so that a new GstNvinfercustomBatch
+       * structure can be allocated if required. */
+      batch.release ();
+      conv_gst_buf = nullptr;
+      nvinfer->tmp_surf.numFilled = 0;
+    }
+  }
+
+  /* Submit a non-full batch. */
+  if (batch) {
+    /* All the frames of this batch were skipped by the motion gate. Return
+     * intermediate memory to pool. */
+    if (batch->frames.size() == 0)
+      gst_buffer_unref (batch->conv_buf);
+
+    if (!convert_batch_and_push_to_input_thread (nvinfer, batch.get(), memory)) {
+      return GST_FLOW_ERROR;
+    }
+    conv_gst_buf = nullptr;
+    batch.release ();
+    nvinfer->tmp_surf.numFilled = 0;
+  }
+
+  return GST_FLOW_OK;
+}
+
 /* Process on objects detected by upstream detectors.
  *
  * Secondary classifiers can work in asynchronous mode as well. In this mode,
@@ -1632,7 +2426,7 @@ gst_nvinfer_process_objects (GstNvinfercustom * nvinfer, GstBuffer * inbuf,
       if (!needs_infer) {
         /* Should not infer again. */
 
-        if (IS_CLASSIFIER_INSTANCE (nvinfer) && obj_history != nullptr) {
+        if (USES_OBJECT_HISTORY (nvinfer) && obj_history != nullptr) {
           /* Working in synchronous mode. Defer attachment of classifier metadata
            * in the object history to the output thread. */
           if (!nvinfer->classifier_async_mode) {
@@ -1731,24 +2525,39 @@ gst_nvinfer_process_objects (GstNvinfercustom * nvinfer, GstBuffer * inbuf,
             continue;
         }
         NvDsUserMeta *user_meta = NULL;
-        gint16 *user_meta_data = NULL;
         std::vector<cv::Point2f> landmarks;
-        for (NvDsMetaList *l_user_meta = frame_meta->frame_user_meta_list; l_user_meta != NULL; l_user_meta = l_user_meta->next) {
+        /* Landmarks attached to the object by an upstream detector with a
+         * landmarks parser, relative to the object crop. */
+        for (NvDsMetaList *l_user_meta = object_meta->obj_user_meta_list; l_user_meta != NULL; l_user_meta = l_user_meta->next) {
             user_meta = (NvDsUserMeta *) (l_user_meta->data);
-            if(user_meta->base_meta.meta_type == NVDS_USER_FRAME_META_EXAMPLE)
-            {
-                user_meta_data = (gint16 *)user_meta->user_meta_data;
-                for(int i = 0; i < 5; i++) {
-                    cv::Point2f p1 = cv::Point(cv::Point((float)user_meta_data[i*2] - object_meta->rect_params.left, (float)user_meta_data[i*2+1] - object_meta->rect_params.top));
-                    landmarks.emplace_back(p1);
-                    cv::circle(*nvinfer->cvmat, cv::Point((float)user_meta_data[i*2] - object_meta->rect_params.left, (float)user_meta_data[i*2+1] - object_meta->rect_params.top), 2, cv::Scalar(255, 0, 0), 2);
+            if (user_meta->base_meta.meta_type == NVDSINFER_LANDMARKS_META) {
+                NvDsInferLandmarksMeta *landmarks_meta =
+                    (NvDsInferLandmarksMeta *) user_meta->user_meta_data;
+                for (guint i = 0; i < landmarks_meta->num_landmarks; i++) {
+                    landmarks.emplace_back (
+                        landmarks_meta->landmarks[i * 2] - object_meta->rect_params.left,
+                        landmarks_meta->landmarks[i * 2 + 1] - object_meta->rect_params.top);
+                }
+                break;
+            }
+        }
+        /* Fall back to the frame-level landmarks of upstream components which
+         * do not attach them to the objects. */
+        if (landmarks.empty ()) {
+            for (NvDsMetaList *l_user_meta = frame_meta->frame_user_meta_list; l_user_meta != NULL; l_user_meta = l_user_meta->next) {
+                user_meta = (NvDsUserMeta *) (l_user_meta->data);
+                if(user_meta->base_meta.meta_type == NVDS_USER_FRAME_META_EXAMPLE)
+                {
+                    gint16 *user_meta_data = (gint16 *)user_meta->user_meta_data;
+                    for(int i = 0; i < 5; i++) {
+                        landmarks.emplace_back ((float)user_meta_data[i*2] - object_meta->rect_params.left, (float)user_meta_data[i*2+1] - object_meta->rect_params.top);
+                    }
                 }
             }
         }
         cv::Mat alignedFace;
         cv::cvtColor (*nvinfer->cvmat, *nvinfer->cvmat, cv::COLOR_RGBA2RGB);
         nvinfer->aligner.AlignFace(*nvinfer->cvmat, landmarks, &alignedFace);
-        cv::imwrite("/mnt/hdd/CLionProjects/face_ds/a.png", alignedFace);
       /* Crop, scale and convert the buffer. */
       ///////////////////////////////////////////////////
       if (get_converted_buffer (nvinfer, in_surf,in_surf->surfaceList + frame_meta->batch_id, &object_meta->rect_params, memory->surf,memory->surf->surfaceList + idx, scale_ratio_x, scale_ratio_y,memory->frame_memory_ptrs[idx], alignedFace) != GST_FLOW_OK) {
@@ -1771,8 +2580,8 @@ gst_nvinfer_process_objects (GstNvinfercustom * nvinfer, GstBuffer * inbuf,
           frame_meta->batch_id);
       batch->frames.push_back (frame);
 
-      /* Submit batch if the batch size has reached max_batch_size. */
-      if (batch->frames.size () == nvinfer->max_batch_size) {
+      /* Submit batch if the batch size has reached infer_batch_size. */
+      if (batch->frames.size () == nvinfer->infer_batch_size) {
       if (!convert_batch_and_push_to_input_thread (nvinfer, batch.get(), memory)) {
         return GST_FLOW_ERROR;
       }
@@ -1855,7 +2664,11 @@ gst_nvinfer_submit_input_buffer (GstBaseTransform * btrans,
 
   nvds_set_input_system_timestamp(inbuf, GST_ELEMENT_NAME(nvinfer));
 
-  flow_ret = gst_nvinfer_process_objects (nvinfer, inbuf, in_surf);
+  if (nvinfer->process_full_frame) {
+    flow_ret = gst_nvinfer_process_full_frame (nvinfer, inbuf, in_surf);
+  } else {
+    flow_ret = gst_nvinfer_process_objects (nvinfer, inbuf, in_surf);
+  }
 
   /* Unmap the input buffer contents. */
   if (in_map_info.data)
@@ -1924,6 +2737,40 @@ gst_nvinfer_generate_output (GstBaseTransform * btrans, GstBuffer ** outbuf)
   return nvinfer->last_flow_ret;
 }
 
+/** Describes the bound layers of the files written by
+ * gst_nvinfer_output_generated_file_write, for replaying them with the
+ * replay-tensors config key. One line per layer:
+ * "layer <binding index> <input|output> <data type> <CxHxW> <layer name>". */
+static void
+gst_nvinfer_layers_manifest_write (NvDsInferLayerInfo * layers_info,
+    guint num_layers, GstNvinfercustom * nvinfer)
+{
+  guint i, j;
+  gchar file_name[256];
+  FILE *file;
+
+  g_snprintf (file_name, 256, "gstnvdsinfer_uid-%02d_layers.txt",
+      nvinfer->unique_id);
+
+  file = fopen (file_name, "w");
+  if (!file) {
+    g_printerr ("Could not open file '%s' for writing:%s\n",
+        file_name, strerror (errno));
+    return;
+  }
+  fprintf (file, "max-batch-size %u\n", nvinfer->max_batch_size);
+  for (i = 0; i < num_layers; i++) {
+    NvDsInferLayerInfo *info = &layers_info[i];
+
+    fprintf (file, "layer %d %s %d ", info->bindingIndex,
+        info->isInput ? "input" : "output", (int) info->dataType);
+    for (j = 0; j < info->inferDims.numDims; j++)
+      fprintf (file, j ? "x%u" : "%u", info->inferDims.d[j]);
+    fprintf (file, " %s\n", info->layerName);
+  }
+  fclose (file);
+}
+
 /** Writes contents of the bound input and output layers to files. */
 static void
 gst_nvinfer_output_generated_file_write (GstBuffer * buf,
@@ -1934,6 +2781,9 @@ gst_nvinfer_output_generated_file_write (GstBuffer * buf,
   gchar file_name[256];
   gchar *iter;
 
+  if (nvinfer->file_write_batch_num == 0)
+    gst_nvinfer_layers_manifest_write (layers_info, num_layers, nvinfer);
+
   for (i = 0; i < num_layers; i++) {
     NvDsInferLayerInfo *info = &layers_info[i];
     gsize layer_size = info->inferDims.numElements * batch_size;
@@ -1978,6 +2828,69 @@ gst_nvinfer_tensoroutput_free (GstMiniObject * obj)
   delete output_obj;
 }
 
+/* Updates the adaptive interval of a source from the detections of its latest
+ * inferred frame. The source is busy if enough objects are detected or if
+ * objects appeared or disappeared since its previous inferred frame, and is
+ * then inferred on every frame. Otherwise the interval backs off
+ * exponentially up to adaptive-interval-max. */
+static void
+update_adaptive_interval (GstNvinfercustom * nvinfer,
+    GstNvinfercustomSourceInfo & source_info,
+    GstNvinfercustomDetections & detections)
+{
+  std::vector<NvDsInferObject> &previous = source_info.last_detections.objects;
+  std::vector<bool> matched (previous.size (), false);
+  guint churn = 0;
+
+  for (auto &obj : detections.objects) {
+    gboolean found = FALSE;
+    for (guint j = 0; j < previous.size () && !found; j++) {
+      NvDsInferObject &prev = previous[j];
+      if (matched[j] || prev.classIndex != obj.classIndex)
+        continue;
+      float overlap_w = MIN (obj.left + obj.width, prev.left + prev.width) -
+          MAX (obj.left, prev.left);
+      float overlap_h = MIN (obj.top + obj.height, prev.top + prev.height) -
+          MAX (obj.top, prev.top);
+      if (overlap_w <= 0 || overlap_h <= 0)
+        continue;
+      float overlap = overlap_w * overlap_h;
+      float union_area = obj.width * obj.height + prev.width * prev.height -
+          overlap;
+      if (overlap > ADAPTIVE_INTERVAL_MATCH_IOU * union_area)
+        matched[j] = found = TRUE;
+    }
+    if (!found)
+      churn++;
+  }
+  for (guint j = 0; j < previous.size (); j++) {
+    if (!matched[j])
+      churn++;
+  }
+
+  if (churn > 0 ||
+      detections.objects.size () >= nvinfer->adaptive_interval_busy_objects) {
+    source_info.adaptive_interval = 0;
+  } else {
+    source_info.adaptive_interval = MIN (nvinfer->adaptive_interval_max,
+        source_info.adaptive_interval * 2 + 1);
+  }
+}
+
+/* Attach the last detections of their source to the frames skipped by the
+ * motion gate. */
+static void
+attach_metadata_motion_skipped (GstNvinfercustom * nvinfer,
+    GstNvinfercustomBatch * batch)
+{
+  for (auto &frame : batch->frames_pending_meta_attach) {
+    auto iter = nvinfer->source_info->find (frame.frame_meta->pad_index);
+    if (iter != nvinfer->source_info->end ())
+      attach_metadata_detections (nvinfer, nullptr, frame,
+          iter->second.last_detections);
+  }
+}
+
 /**
  * Output loop used to pop output from inference, attach the output to the
  * buffer in form of NvDsMeta and push the buffer to downstream element.
@@ -2025,10 +2938,14 @@ gst_nvinfer_output_loop (gpointer data)
       for (auto &hist : batch->objs_pending_meta_attach) {
         GstNvinfercustomFrame frame;
         frame.obj_meta = hist.second;
-        std::weak_ptr<GstNvinfercustomObjectHistory> obj_history = hist.first;
+        /* The history is gone if it was cleared by a model update. */
+        auto obj_history = hist.first.lock ();
+        if (!obj_history)
+          continue;
         attach_metadata_classifier (nvinfer, nullptr, frame,
-            obj_history.lock()->cached_info);
+            obj_history->cached_info);
       }
+      attach_metadata_motion_skipped (nvinfer, batch.get ());
       continue;
     }
 
@@ -2069,7 +2986,7 @@ gst_nvinfer_output_loop (gpointer data)
     eventAttrib.message.ascii = nvtx_str.c_str();
     nvtxDomainRangePushEx(nvinfer->nvtx_domain, &eventAttrib);
 
-    NvDsInferContextPtr nvdsinfer_ctx = impl->m_InferCtx;
+    NvDsInferContextPtr nvdsinfer_ctx = batch->infer_context;
 
     /* Create and initialize the object for managing the usage of batch_output. */
     auto tensor_deleter = [] (GstNvinfercustomTensorOutputObject *o) {
@@ -2094,6 +3011,8 @@ gst_nvinfer_output_loop (gpointer data)
               NvDsInferStatus2Str (status)), (nullptr));
       continue;
     }
+    GST_LOG_OBJECT (nvinfer, "batch of %u frames inferred with profile %d",
+        batch_output->numFrames, batch_output->profileIndex);
 
     /* Get the host buffer pointers from the latest dequeued output. */
     for (auto & layer:*nvinfer->layers_info) {
@@ -2119,6 +3038,29 @@ gst_nvinfer_output_loop (gpointer data)
 
 
 
+    /* Match the embeddings of the whole batch against the gallery at once. */
+    std::shared_ptr<Gallery> gallery = impl->getGallery ();
+    std::vector<GalleryMatch> gallery_matches;
+    if (IS_EMBEDDING_INSTANCE (nvinfer) && gallery) {
+      guint num_queries = batch->frames.size ();
+      if (impl->m_InitParams->embeddingInt8) {
+        std::vector<const int8_t *> queries (num_queries);
+        std::vector<float> scales (num_queries);
+        for (guint i = 0; i < num_queries; i++) {
+          queries[i] = batch_output->frames[i].embeddingOutput.embeddingInt8;
+          scales[i] = batch_output->frames[i].embeddingOutput.scale;
+        }
+        gallery->searchS8 (queries.data (), scales.data (), num_queries,
+            nvinfer->gallery_top_k, gallery_matches);
+      } else {
+        std::vector<const float *> queries (num_queries);
+        for (guint i = 0; i < num_queries; i++)
+          queries[i] = batch_output->frames[i].embeddingOutput.embedding;
+        gallery->search (queries.data (), num_queries,
+            nvinfer->gallery_top_k, gallery_matches);
+      }
+    }
+
     /* For each frame attach metadata output. */
     for (guint i = 0; i < batch->frames.size (); i++) {
       GstNvinfercustomFrame & frame = batch->frames[i];
@@ -2135,8 +3077,28 @@ gst_nvinfer_output_loop (gpointer data)
       }
 
       if (IS_DETECTOR_INSTANCE (nvinfer)) {
-        attach_metadata_detector (nvinfer, GST_MINI_OBJECT (tensor_out_object.get()),
-                frame, frame_output.detectionOutput);
+        gboolean keep_detections = nvinfer->motion_threshold > 0 ||
+            nvinfer->adaptive_interval_max > 0;
+        if (frame.num_tiles > 1 || keep_detections) {
+          GstNvinfercustomDetections detections;
+          /* Merge the detections of all the tiles of the frame. */
+          get_frame_detections (nvinfer, &batch->frames[i],
+              &batch_output->frames[i], frame.num_tiles, detections);
+          attach_metadata_detections (nvinfer,
+              GST_MINI_OBJECT (tensor_out_object.get()), frame, detections);
+          /* Keep the detections for the following static frames and for
+           * measuring the churn of the source. */
+          auto iter = nvinfer->source_info->find (frame.frame_meta->pad_index);
+          if (keep_detections && iter != nvinfer->source_info->end ()) {
+            if (nvinfer->adaptive_interval_max > 0)
+              update_adaptive_interval (nvinfer, iter->second, detections);
+            iter->second.last_detections = std::move (detections);
+          }
+          i += frame.num_tiles - 1;
+        } else {
+          attach_metadata_detector (nvinfer, GST_MINI_OBJECT (tensor_out_object.get()),
+                  frame, frame_output.detectionOutput);
+        }
       } else if (IS_CLASSIFIER_INSTANCE (nvinfer)) {
         NvDsInferClassificationOutput &classification_output = frame_output.classificationOutput;
         GstNvinfercustomObjectInfo new_info;
@@ -2165,6 +3127,24 @@ gst_nvinfer_output_loop (gpointer data)
       } else if (IS_SEGMENTATION_INSTANCE (nvinfer)) {
         attach_metadata_segmentation (nvinfer, GST_MINI_OBJECT (tensor_out_object.get()),
             frame, frame_output.segmentationOutput);
+      } else if (IS_EMBEDDING_INSTANCE (nvinfer)) {
+        attach_metadata_embedding (nvinfer, GST_MINI_OBJECT (tensor_out_object.get()),
+            frame, frame_output.embeddingOutput);
+        if (gallery) {
+          GstNvinfercustomObjectInfo new_info;
+          get_gallery_object_info (*gallery, &gallery_matches[i * nvinfer->gallery_top_k],
+              nvinfer->gallery_top_k, nvinfer->gallery_match_threshold, new_info);
+          /* The cached labels point into the gallery, keep it alive for as
+           * long as they are reattached. */
+          new_info.label_owner = gallery;
+
+          /* Cache the identity so that it is attached to the object on the
+           * frames it is not reinferred on. */
+          if (obj_history != nullptr)
+            obj_history->cached_info = new_info;
+          attach_metadata_classifier (nvinfer, GST_MINI_OBJECT (tensor_out_object.get()),
+              frame, new_info);
+        }
       }
     }
 
@@ -2173,10 +3153,13 @@ gst_nvinfer_output_loop (gpointer data)
     for (auto &hist : batch->objs_pending_meta_attach) {
       GstNvinfercustomFrame frame;
       frame.obj_meta = hist.second;
-      std::weak_ptr<GstNvinfercustomObjectHistory> obj_history = hist.first;
+      auto obj_history = hist.first.lock ();
+      if (!obj_history)
+        continue;
       attach_metadata_classifier (nvinfer, nullptr, frame,
-          obj_history.lock()->cached_info);
+          obj_history->cached_info);
     }
+    attach_metadata_motion_skipped (nvinfer, batch.get ());
 
     if (nvinfer->output_tensor_meta && !nvinfer->classifier_async_mode) {
       /* Attach the tensor output as meta. */
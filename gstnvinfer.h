@@ -76,6 +76,8 @@ enum
   PROP_OUTPUT_CALLBACK,
   PROP_OUTPUT_CALLBACK_USERDATA,
   PROP_OUTPUT_TENSOR_META,
+  PROP_GALLERY_FILE,
+  PROP_SOURCE_INTERVALS,
   PROP_LAST
 };
 
@@ -120,6 +122,9 @@ typedef struct {
   std::vector<NvDsInferAttribute> attributes;
   /** Cached string label. */
   std::string label;
+  /** Keeps the storage the attribute labels point into alive, e.g. the
+   * gallery the identity was matched in. Null for classifier labels. */
+  std::shared_ptr<const void> label_owner;
 } GstNvinfercustomObjectInfo;
 
 /**
@@ -145,6 +150,19 @@ typedef struct _GstNvinfercustomObjectHistory
 /** Map type for maintaing inference history for objects based on their tracking ids.*/
 typedef std::unordered_map<guint64, std::shared_ptr<GstNvinfercustomObjectHistory>> GstNvinfercustomObjectHistoryMap;
 
+/**
+ * Holds the detections of one frame in frame co-ordinates along with the
+ * labels and landmarks of the objects. The label and landmarks pointers of the
+ * objects are only set when the detections are attached.
+ */
+typedef struct
+{
+  std::vector<NvDsInferObject> objects;
+  std::vector<std::string> labels;
+  std::vector<size_t> landmarks_offsets;
+  std::vector<float> landmarks;
+} GstNvinfercustomDetections;
+
 /**
  * Holds source-specific information.
  */
@@ -156,6 +174,18 @@ typedef struct
   gulong last_cleanup_frame_num;
   /** Frame number of the frame which . */
   gulong last_seen_frame_num;
+  /** Luma thumbnail of the last frame inferred on. Used by the motion gate. */
+  std::vector<guint8> motion_thumbnail;
+  /** Number of consecutive frames skipped by the motion gate. */
+  guint motion_skipped_frames;
+  /** Detections of the last frame inferred on, re-attached to the frames
+   * skipped by the motion gate. */
+  GstNvinfercustomDetections last_detections;
+  /** Current adaptive interval of the source, i.e. number of frames skipped
+   * after each inferred frame. */
+  guint adaptive_interval;
+  /** Number of frames skipped since the last frame inferred on. */
+  guint adaptive_skipped_frames;
 } GstNvinfercustomSourceInfo;
 
 /**
@@ -171,6 +201,9 @@ struct _GstNvinfercustom
 
   /** Maximum batch size. */
   guint max_batch_size;
+  /** Maximum batch size of the NvDsInferContext in use. Smaller than
+   * max_batch_size while a fallback engine is in use. */
+  guint infer_batch_size;
 
   /**
    * Unique ID of the element. The labels generated by the element will be
@@ -216,6 +249,14 @@ struct _GstNvinfercustom
   /** ID of the GPU this element uses for conversions / inference. */
   guint gpu_id;
 
+  /** Boolean indicating if the context infers without a GPU, by replaying
+   * recorded tensors or on the CPU. Buffers are then in system memory. */
+  gboolean host_memory;
+
+  /** Boolean indicating if the context infers on the CPU. Frames are then
+   * converted to the network input with OpenCV instead of NvBufSurfTransform. */
+  gboolean cpu_inference;
+
   /** Cuda Stream to launch npp operations on. */
   cudaStream_t convertStream;
 
@@ -236,6 +277,48 @@ struct _GstNvinfercustom
   /** Frame interval after which objects should be reinferred on. */
   guint secondary_reinfer_interval;
 
+  /** Grid of overlapping tiles each full frame is sliced into. Every tile is
+   * inferred as a separate batch entry and the detections of all tiles of a
+   * frame are merged before being attached. */
+  guint tile_columns;
+  guint tile_rows;
+  /** Fraction of the tile size shared by neighbouring tiles. */
+  gfloat tile_overlap;
+  /** Also infer on the whole (downscaled) frame to catch objects larger than
+   * a tile. */
+  gboolean tile_include_full_frame;
+  /** Minimum intersection over the smaller box for two detections from
+   * different tiles to be merged. */
+  gfloat tile_merge_threshold;
+
+  /** Fraction of the pixels of a source's luma thumbnail that must have
+   * changed since the last inferred frame for a frame to be inferred on.
+   * 0 disables the motion gate. */
+  gfloat motion_threshold;
+  /** Luma difference above which a thumbnail pixel counts as changed. */
+  guint motion_pixel_delta;
+  /** Maximum number of consecutive frames of a source reusing the results of
+   * the last inferred frame, 0 for no limit. */
+  guint motion_max_stale_frames;
+  /** Batched luma thumbnails of the input frames. */
+  NvBufSurface *motion_surf;
+
+  /** Maximum per-source interval idle sources back off to, 0 to disable the
+   * adaptive interval. */
+  guint adaptive_interval_max;
+  /** Number of detected objects from which a source is considered busy and
+   * inferred on every frame. */
+  guint adaptive_interval_busy_objects;
+
+  /** Serialized engine inferring while the engine for the config is built in
+   * the background, null to build the engine synchronously on start. */
+  gchar *fallback_engine_file_path;
+  /** Maximum batch size of the fallback engine, 0 for max_batch_size. */
+  guint fallback_batch_size;
+  /** Boolean indicating if the object history is kept when the model is
+   * updated with one having the same layers. */
+  gboolean model_update_keep_history;
+
   /** Input object size-based filtering parameters for object processing mode. */
   guint min_input_object_width;
   guint min_input_object_height;
@@ -301,6 +384,25 @@ struct _GstNvinfercustom
   /** NVTX Domain. */
   nvtxDomainHandle_t nvtx_domain;
 
+  /** Identity gallery used to label embeddings. Only used by embedding
+   * instances. With a gallery, tracked objects are reinferred like they are
+   * by classifiers and keep their last identity in between. */
+  gchar *gallery_file_path;
+  /** Number of gallery matches attached per embedding. */
+  guint gallery_top_k;
+  /** Minimum cosine similarity for a gallery match to be attached. */
+  gfloat gallery_match_threshold;
+  /** Number of IVF lists of the approximate gallery index, 0 to search the
+   * gallery exhaustively. */
+  guint gallery_ivf_lists;
+  /** Number of IVF lists scanned per query. */
+  guint gallery_ivf_probes;
+  /** Path to persist the approximate gallery index to. */
+  gchar *gallery_index_file_path;
+  /** Interval in seconds at which the gallery file is checked for being
+   * replaced, 0 to reload only when the "gallery-file" property is set. */
+  guint gallery_reload_interval;
+
   GstNvinfercustomImpl *impl;
 
     // Resolution at which frames/objects should be processed
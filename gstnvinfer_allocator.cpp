@@ -43,6 +43,8 @@ struct _GstNvinfercustomAllocator
   guint height;
   NvBufSurfaceColorFormat color_format;
   guint gpu_id;
+  /** Allocate in system memory, for contexts inferring without a GPU. */
+  gboolean host_memory;
 };
 
 struct _GstNvinfercustomAllocatorClass
@@ -94,7 +96,8 @@ gst_nvinfer_allocator_alloc (GstAllocator * allocator, gsize size,
   create_params.isContiguous = 1;
   create_params.colorFormat = inferallocator->color_format;
   create_params.layout = NVBUF_LAYOUT_PITCH;
-  create_params.memType = NVBUF_MEM_DEFAULT;
+  create_params.memType =
+      inferallocator->host_memory ? NVBUF_MEM_SYSTEM : NVBUF_MEM_DEFAULT;
 
   if (NvBufSurfaceCreate (&tmem->surf, inferallocator->batch_size,
           &create_params) != 0) {
@@ -102,6 +105,16 @@ gst_nvinfer_allocator_alloc (GstAllocator * allocator, gsize size,
     return nullptr;
   }
 
+  tmem->frame_memory_ptrs.assign (inferallocator->batch_size, nullptr);
+
+  /* System memory frames are accessed directly, there is nothing to register
+   * in CUDA. */
+  if (inferallocator->host_memory) {
+    for (guint i = 0; i < inferallocator->batch_size; i++)
+      tmem->frame_memory_ptrs[i] = (char *) tmem->surf->surfaceList[i].dataPtr;
+    goto done;
+  }
+
 #ifdef IS_TEGRA
   if (NvBufSurfaceMapEglImage (tmem->surf, -1) != 0) {
     GST_ERROR ("Error: Could not map EglImage from NvBufSurface for nvinfer");
@@ -114,8 +127,6 @@ gst_nvinfer_allocator_alloc (GstAllocator * allocator, gsize size,
   tmem->cuda_resources.resize (inferallocator->batch_size);
 #endif
 
-  tmem->frame_memory_ptrs.assign (inferallocator->batch_size, nullptr);
-
   for (guint i = 0; i < inferallocator->batch_size; i++) {
 #ifdef IS_TEGRA
     if (cuGraphicsEGLRegisterImage (&tmem->cuda_resources[i],
@@ -138,6 +149,7 @@ gst_nvinfer_allocator_alloc (GstAllocator * allocator, gsize size,
 #endif
   }
 
+done:
   /* Initialize the GStreamer memory structure. */
   gst_memory_init ((GstMemory *) nvmem, (GstMemoryFlags) 0, allocator, nullptr,
       size, params->align, 0, size);
@@ -152,14 +164,14 @@ gst_nvinfer_allocator_free (GstAllocator * allocator, GstMemory * memory)
   GstNvinfercustomMem *nvmem = (GstNvinfercustomMem *) memory;
   GstNvinfercustomMemory *tmem = &nvmem->mem_infer;
 #ifdef IS_TEGRA
-  GstNvinfercustomAllocator *inferallocator = GST_NVINFER_ALLOCATOR (allocator);
-
-  for (size_t i = 0; i < inferallocator->batch_size; i++) {
+  /* Only registered for non system memory, empty otherwise. */
+  for (size_t i = 0; i < tmem->cuda_resources.size (); i++) {
     cuGraphicsUnregisterResource (tmem->cuda_resources[i]);
   }
 #endif
 
-  NvBufSurfaceUnMapEglImage (tmem->surf, -1);
+  if (!GST_NVINFER_ALLOCATOR (allocator)->host_memory)
+    NvBufSurfaceUnMapEglImage (tmem->surf, -1);
   NvBufSurfaceDestroy (tmem->surf);
 
   delete nvmem;
@@ -206,7 +218,8 @@ gst_nvinfer_allocator_init (GstNvinfercustomAllocator * allocator)
  * members. */
 GstAllocator *
 gst_nvinfer_allocator_new (guint width, guint height,
-    NvBufSurfaceColorFormat color_format, guint batch_size, guint gpu_id)
+    NvBufSurfaceColorFormat color_format, guint batch_size, guint gpu_id,
+    gboolean host_memory)
 {
   GstNvinfercustomAllocator *allocator = (GstNvinfercustomAllocator *)
       g_object_new (GST_TYPE_NVINFER_ALLOCATOR,
@@ -217,6 +230,7 @@ gst_nvinfer_allocator_new (guint width, guint height,
   allocator->batch_size = batch_size;
   allocator->gpu_id = gpu_id;
   allocator->color_format = color_format;
+  allocator->host_memory = host_memory;
 
   return (GstAllocator *) allocator;
 }
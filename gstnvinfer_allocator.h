@@ -64,10 +64,12 @@ GstNvinfercustomMemory *gst_nvinfer_buffer_get_memory (GstBuffer * buffer);
  * @param color_format Color format of the buffers in the pool.
  * @param batch_size Max size of batch that will be inferred.
  * @param gpu_id ID of the gpu where the batch memory will be allocated.
+ * @param host_memory Allocate the batch memory in system memory instead.
  *
  * @return Pointer to the GstNvinfercustomAllocator structure cast as GstAllocator
  */
 GstAllocator *gst_nvinfer_allocator_new (guint width, guint height,
-    NvBufSurfaceColorFormat color_format, guint batch_size, guint gpu_id);
+    NvBufSurfaceColorFormat color_format, guint batch_size, guint gpu_id,
+    gboolean host_memory);
 
 #endif
@@ -0,0 +1,720 @@
+/**
+ * Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <glib.h>
+
+#include "gstnvinfer_gallery.h"
+#include "nvdsinfer_simd.h"
+
+/* Number of gallery rows scored against all queries of a batch before moving
+ * on. 256 rows of 512-d float embeddings is 512KB, which stays in L2. */
+#define GALLERY_BLOCK_ROWS 256
+
+using namespace nvdsinfer;
+
+namespace gstnvinfer
+{
+
+/* Insert a match into a top-k list sorted by descending score. */
+static inline void
+insert_top_k (GalleryMatch * top, uint32_t k, int32_t index, float score)
+{
+  if (score <= top[k - 1].score)
+    return;
+
+  uint32_t j = k - 1;
+  while (j > 0 && top[j - 1].score < score) {
+    top[j] = top[j - 1];
+    j--;
+  }
+  top[j] = GalleryMatch {index, score};
+}
+
+std::shared_ptr<Gallery>
+Gallery::load (const std::string &path)
+{
+  char magic[sizeof (((GalleryFileHeader *) nullptr)->magic)] = { 0 };
+  {
+    std::ifstream file (path, std::ios::binary);
+    if (!file.good ()) {
+      g_printerr ("Error: Could not open gallery file %s\n", path.c_str ());
+      return nullptr;
+    }
+    file.read (magic, sizeof (magic));
+  }
+
+  if (!memcmp (magic, GALLERY_FILE_MAGIC, sizeof (GALLERY_FILE_MAGIC)))
+    return loadBinary (path);
+  return loadText (path);
+}
+
+std::shared_ptr<Gallery>
+Gallery::loadText (const std::string &path)
+{
+  std::ifstream file (path);
+  if (!file.good ()) {
+    g_printerr ("Error: Could not open gallery file %s\n", path.c_str ());
+    return nullptr;
+  }
+
+  std::shared_ptr<Gallery> gallery (new Gallery);
+  std::vector<float> row;
+  std::string line;
+  uint32_t line_num = 0;
+
+  gallery->m_LabelOffsetStore.push_back (0);
+  while (std::getline (file, line)) {
+    line_num++;
+    if (line.empty () || line[0] == '#')
+      continue;
+
+    std::istringstream iss (line);
+    std::string label;
+    float val;
+    if (!(iss >> label))
+      continue;
+
+    row.clear ();
+    while (iss >> val)
+      row.push_back (val);
+
+    if (row.empty () || (gallery->m_Dims && row.size () != gallery->m_Dims)) {
+      g_printerr ("Error: Gallery file %s line %u has %zu elements, "
+          "expected %u\n", path.c_str (), line_num, row.size (),
+          gallery->m_Dims);
+      return nullptr;
+    }
+    gallery->m_Dims = row.size ();
+
+    /* Normalize so that cosine similarity is just the dot product. */
+    simdL2Normalize (row.data (), row.size ());
+    gallery->m_Embeddings.insert (gallery->m_Embeddings.end (), row.begin (),
+        row.end ());
+    gallery->m_LabelTableStore.insert (gallery->m_LabelTableStore.end (),
+        label.c_str (), label.c_str () + label.size () + 1);
+    gallery->m_LabelOffsetStore.push_back (gallery->m_LabelTableStore.size ());
+    gallery->m_Size++;
+  }
+
+  if (!gallery->m_Size) {
+    g_printerr ("Error: Gallery file %s has no identities\n", path.c_str ());
+    return nullptr;
+  }
+
+  gallery->m_Matrix = gallery->m_Embeddings.data ();
+  gallery->m_LabelOffsets = gallery->m_LabelOffsetStore.data ();
+  gallery->m_LabelTable = gallery->m_LabelTableStore.data ();
+  return gallery;
+}
+
+/* Check that [offset, offset + size) lies in a file of fileSize bytes. */
+static bool
+section_in_file (uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+  return offset % GALLERY_FILE_ALIGNMENT == 0 && offset <= fileSize &&
+      size <= fileSize - offset;
+}
+
+std::shared_ptr<Gallery>
+Gallery::loadBinary (const std::string &path)
+{
+  int fd = open (path.c_str (), O_RDONLY);
+  if (fd < 0) {
+    g_printerr ("Error: Could not open gallery file %s\n", path.c_str ());
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat (fd, &st) || (size_t) st.st_size < sizeof (GalleryFileHeader)) {
+    g_printerr ("Error: Gallery file %s is truncated\n", path.c_str ());
+    close (fd);
+    return nullptr;
+  }
+
+  /* The mapping stays valid after the descriptor is closed. A file replaced
+   * by rename keeps its old pages alive until the mapping is released. */
+  size_t file_size = st.st_size;
+  void *addr = mmap (nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    g_printerr ("Error: Could not map gallery file %s\n", path.c_str ());
+    close (fd);
+    return nullptr;
+  }
+
+  std::shared_ptr<Gallery> gallery = mapBinary (path, addr, file_size);
+  if (!gallery) {
+    munmap (addr, file_size);
+    close (fd);
+    return nullptr;
+  }
+
+  /* The contents were validated against the size mapped. Reject a file that
+   * was written to while it was being loaded, the gallery releases the
+   * mapping. */
+  struct stat st_after;
+  bool changed = fstat (fd, &st_after) || st_after.st_ino != st.st_ino ||
+      st_after.st_size != st.st_size ||
+      st_after.st_mtim.tv_sec != st.st_mtim.tv_sec ||
+      st_after.st_mtim.tv_nsec != st.st_mtim.tv_nsec;
+  close (fd);
+  if (changed) {
+    g_printerr ("Error: Gallery file %s changed while it was loaded\n",
+        path.c_str ());
+    return nullptr;
+  }
+  return gallery;
+}
+
+/* Validate the header and sections of a binary gallery mapped at addr and
+ * create a gallery that owns the mapping. Returns nullptr, leaving the
+ * mapping to the caller, if the file is malformed. */
+std::shared_ptr<Gallery>
+Gallery::mapBinary (const std::string &path, void *addr, size_t file_size)
+{
+  const uint8_t *base = (const uint8_t *) addr;
+  const GalleryFileHeader *header = (const GalleryFileHeader *) base;
+  if (header->version != GALLERY_FILE_VERSION) {
+    g_printerr ("Error: Gallery file %s has unsupported version %u\n",
+        path.c_str (), header->version);
+    return nullptr;
+  }
+  if (header->dataType != GALLERY_DATA_FLOAT &&
+      header->dataType != GALLERY_DATA_INT8) {
+    g_printerr ("Error: Gallery file %s has unsupported data type %u\n",
+        path.c_str (), header->dataType);
+    return nullptr;
+  }
+  bool has_scales = header->flags & GALLERY_FLAG_ROW_SCALE;
+  if (has_scales && header->dataType != GALLERY_DATA_INT8) {
+    g_printerr ("Error: Gallery file %s: row scales are only supported for "
+        "int8 galleries\n", path.c_str ());
+    return nullptr;
+  }
+
+  uint64_t num_rows = header->numRows;
+  uint64_t elem_size =
+      header->dataType == GALLERY_DATA_INT8 ? sizeof (int8_t) : sizeof (float);
+  if (!num_rows || !header->dims ||
+      !section_in_file (header->labelOffsetsOffset,
+          (num_rows + 1) * sizeof (uint32_t), file_size) ||
+      !section_in_file (header->labelTableOffset, header->labelTableSize,
+          file_size) ||
+      !section_in_file (header->matrixOffset,
+          num_rows * header->dims * elem_size, file_size) ||
+      (has_scales && !section_in_file (header->scalesOffset,
+              num_rows * sizeof (float), file_size))) {
+    g_printerr ("Error: Gallery file %s is empty or malformed\n",
+        path.c_str ());
+    return nullptr;
+  }
+
+  /* Every label must be a NUL-terminated string inside the label table. */
+  const uint32_t *offsets =
+      (const uint32_t *) (base + header->labelOffsetsOffset);
+  const char *table = (const char *) (base + header->labelTableOffset);
+  for (uint64_t i = 0; i < num_rows; i++) {
+    if (offsets[i] >= offsets[i + 1] ||
+        offsets[i + 1] > header->labelTableSize ||
+        table[offsets[i + 1] - 1] != '\0') {
+      g_printerr ("Error: Gallery file %s has an invalid label %lu\n",
+          path.c_str (), (unsigned long) i);
+      return nullptr;
+    }
+  }
+
+  /* Int8 search requires elements in [-127, 127]. */
+  if (header->dataType == GALLERY_DATA_INT8 &&
+      memchr (base + header->matrixOffset, 0x80,
+          num_rows * header->dims) != nullptr) {
+    g_printerr ("Error: Gallery file %s has int8 elements of -128\n",
+        path.c_str ());
+    return nullptr;
+  }
+
+  std::shared_ptr<Gallery> gallery (new Gallery);
+  gallery->m_Mapping.reset (addr, [file_size] (const void *p) {
+        munmap ((void *) p, file_size);
+      });
+  gallery->m_Dims = header->dims;
+  gallery->m_Size = num_rows;
+  gallery->m_DataType = (GalleryDataType) header->dataType;
+  gallery->m_Matrix = base + header->matrixOffset;
+  gallery->m_Scales =
+      has_scales ? (const float *) (base + header->scalesOffset) : nullptr;
+  gallery->m_LabelOffsets = offsets;
+  gallery->m_LabelTable = table;
+  return gallery;
+}
+
+/* Blocked top-k search of numQueries queries over numRows rows.
+ * score4 (row, queries, nq, scores) scores one row against the first nq of
+ * four queries. matches must hold numQueries * k entries initialized by the
+ * caller. */
+template <typename T, typename ScoreFn>
+static void
+search_rows (uint32_t numRows, const T *const *queries,
+    uint32_t numQueries, uint32_t k, GalleryMatch * matches, ScoreFn score4)
+{
+  for (uint32_t row0 = 0; row0 < numRows; row0 += GALLERY_BLOCK_ROWS) {
+    uint32_t row_end = std::min (row0 + GALLERY_BLOCK_ROWS, numRows);
+
+    for (uint32_t q = 0; q < numQueries; q += 4) {
+      /* Pad the last group of queries by repeating the last query. The
+       * padded scores are not used. */
+      uint32_t nq = std::min (4u, numQueries - q);
+      const T *group[4];
+      for (uint32_t i = 0; i < 4; i++)
+        group[i] = queries[q + std::min (i, nq - 1)];
+
+      for (uint32_t row = row0; row < row_end; row++) {
+        float scores[4];
+        score4 (row, group, nq, scores);
+        for (uint32_t i = 0; i < nq; i++)
+          insert_top_k (&matches[(q + i) * k], k, row, scores[i]);
+      }
+    }
+  }
+}
+
+/* search_rows over a row-major float matrix. */
+static void
+search_float_rows (const float *rows, uint32_t numRows, uint32_t dims,
+    const float *const *queries, uint32_t numQueries, uint32_t k,
+    GalleryMatch * matches)
+{
+  search_rows (numRows, queries, numQueries, k, matches,
+      [rows, dims] (uint32_t row, const float *const *group, uint32_t,
+          float *scores) {
+        simdDot4 (rows + (size_t) row * dims, group, dims, scores);
+      });
+}
+
+void
+Gallery::search (const float *const *queries, uint32_t numQueries,
+    uint32_t k, std::vector<GalleryMatch> &matches) const
+{
+  matches.assign (numQueries * k, GalleryMatch {-1, -FLT_MAX});
+  if (numQueries == 0 || k == 0)
+    return;
+
+  if (m_DataType == GALLERY_DATA_INT8) {
+    search_rows (size (), queries, numQueries, k, matches.data (),
+        [this] (uint32_t row, const float *const *group, uint32_t,
+            float *scores) {
+          simdDot4S8 (rowS8 (row), group, m_Dims, scores);
+          float s = scale (row);
+          for (uint32_t i = 0; i < 4; i++)
+            scores[i] *= s;
+        });
+  } else {
+    search_float_rows (row (0), size (), m_Dims, queries, numQueries, k,
+        matches.data ());
+  }
+}
+
+void
+Gallery::searchS8 (const int8_t *const *queries, const float *scales,
+    uint32_t numQueries, uint32_t k, std::vector<GalleryMatch> &matches) const
+{
+  if (m_DataType != GALLERY_DATA_INT8) {
+    /* Dequantize the queries, the float search may be overridden by an
+     * index. */
+    std::vector<float> buffer ((size_t) numQueries * m_Dims);
+    std::vector<const float *> float_queries (numQueries);
+    for (uint32_t q = 0; q < numQueries; q++) {
+      float *dst = &buffer[(size_t) q * m_Dims];
+      for (uint32_t d = 0; d < m_Dims; d++)
+        dst[d] = queries[q][d] * scales[q];
+      float_queries[q] = dst;
+    }
+    search (float_queries.data (), numQueries, k, matches);
+    return;
+  }
+
+  matches.assign (numQueries * k, GalleryMatch {-1, -FLT_MAX});
+  if (numQueries == 0 || k == 0)
+    return;
+
+  /* Integer dot products scaled by the row scale. The query scale does not
+   * change the ranking and is applied to the final scores only. */
+  search_rows (size (), queries, numQueries, k, matches.data (),
+      [this] (uint32_t row, const int8_t *const *group, uint32_t nq,
+          float *scores) {
+        float s = scale (row);
+        for (uint32_t i = 0; i < nq; i++)
+          scores[i] = simdDotS8 (rowS8 (row), group[i], m_Dims) * s;
+      });
+
+  for (uint32_t q = 0; q < numQueries; q++) {
+    for (uint32_t i = 0; i < k; i++) {
+      if (matches[q * k + i].index >= 0)
+        matches[q * k + i].score *= scales[q];
+    }
+  }
+}
+
+/* FNV-1a hash of the gallery contents, stored in index files to detect an
+ * index built from a different gallery. */
+uint64_t
+Gallery::hash () const
+{
+  uint64_t hash = 14695981039346656037ULL;
+  auto update = [&hash] (const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *) data;
+    for (size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+  };
+  size_t elem_size =
+      m_DataType == GALLERY_DATA_INT8 ? sizeof (int8_t) : sizeof (float);
+  update (m_Matrix, (size_t) m_Size * m_Dims * elem_size);
+  if (m_Scales)
+    update (m_Scales, m_Size * sizeof (float));
+  update (m_LabelTable, m_LabelOffsets[m_Size]);
+  return hash;
+}
+
+/* Find the nearest of numRows rows for each of numQueries queries, splitting
+ * the queries over the available cores. Only used while building an index. */
+static void
+assign_nearest (const float *rows, uint32_t numRows, uint32_t dims,
+    const float *const *queries, uint32_t numQueries, int32_t * nearest)
+{
+  uint32_t num_threads = std::max (1u, std::thread::hardware_concurrency ());
+  uint32_t chunk = (numQueries + num_threads - 1) / num_threads;
+  std::vector<std::thread> threads;
+
+  for (uint32_t start = 0; start < numQueries; start += chunk) {
+    uint32_t count = std::min (chunk, numQueries - start);
+    threads.emplace_back ([=] () {
+      std::vector<GalleryMatch> matches (count, GalleryMatch {-1, -FLT_MAX});
+      search_float_rows (rows, numRows, dims, queries + start, count, 1,
+          matches.data ());
+      for (uint32_t i = 0; i < count; i++)
+        nearest[start + i] = matches[i].index;
+    });
+  }
+  for (auto & t : threads)
+    t.join ();
+}
+
+/* Portable LCG so that index builds are identical across standard library
+ * implementations. */
+static inline uint32_t
+next_random (uint64_t & state)
+{
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (uint32_t) (state >> 33);
+}
+
+#define IVF_INDEX_MAGIC "NVDSIVF"
+#define IVF_INDEX_VERSION 1
+#define IVF_TRAIN_POINTS_PER_LIST 64
+#define IVF_TRAIN_ITERATIONS 10
+#define IVF_RANDOM_SEED 1234
+/* Search exhaustively when the lists probed by a batch hold more than
+ * NUM / DEN of the gallery rows. */
+#define IVF_EXHAUSTIVE_NUM 7
+#define IVF_EXHAUSTIVE_DEN 8
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t dims;
+  uint32_t numRows;
+  uint32_t numLists;
+  uint64_t galleryHash;
+} IvfIndexHeader;
+
+IvfGallery::IvfGallery (Gallery && base, uint32_t numProbes)
+  : Gallery (std::move (base)), m_NumProbes (numProbes)
+{
+}
+
+std::shared_ptr<Gallery>
+IvfGallery::create (Gallery && base, uint32_t numLists, uint32_t numProbes,
+    const std::string &indexPath)
+{
+  if (base.dataType () != GALLERY_DATA_FLOAT) {
+    g_printerr ("Error: IVF index requires a float gallery\n");
+    return nullptr;
+  }
+  if (numLists == 0 || numLists > base.size ()) {
+    g_printerr ("Error: Number of IVF lists (%u) should be in the range "
+        "[1, %u]\n", numLists, base.size ());
+    return nullptr;
+  }
+
+  std::shared_ptr<IvfGallery> gallery (new IvfGallery (std::move (base),
+          std::min (numProbes, numLists)));
+  uint64_t hash = gallery->hash ();
+
+  if (!indexPath.empty () && gallery->readIndex (indexPath, numLists, hash)) {
+    g_print ("Info: Loaded gallery index %s\n", indexPath.c_str ());
+  } else {
+    gallery->build (numLists);
+    if (!indexPath.empty () && !gallery->writeIndex (indexPath, hash))
+      g_printerr ("Warn: Could not write gallery index %s\n",
+          indexPath.c_str ());
+  }
+  return gallery;
+}
+
+/* Spherical k-means over a deterministic sample of the gallery. */
+void
+IvfGallery::build (uint32_t numLists)
+{
+  const uint32_t num_rows = size ();
+  uint64_t state = IVF_RANDOM_SEED;
+
+  /* Deterministic partial Fisher-Yates shuffle to pick the training sample,
+   * the first numLists sampled rows seed the centroids. */
+  uint32_t num_train = std::min (num_rows, numLists * IVF_TRAIN_POINTS_PER_LIST);
+  std::vector<uint32_t> perm (num_rows);
+  for (uint32_t i = 0; i < num_rows; i++)
+    perm[i] = i;
+  for (uint32_t i = 0; i < num_train; i++)
+    std::swap (perm[i], perm[i + next_random (state) % (num_rows - i)]);
+
+  std::vector<const float *> train (num_train);
+  for (uint32_t i = 0; i < num_train; i++)
+    train[i] = row (perm[i]);
+
+  m_Centroids.resize ((size_t) numLists * m_Dims);
+  for (uint32_t l = 0; l < numLists; l++)
+    std::copy (train[l], train[l] + m_Dims, &m_Centroids[(size_t) l * m_Dims]);
+
+  std::vector<int32_t> assign (num_train);
+  std::vector<uint32_t> counts (numLists);
+  for (uint32_t iter = 0; iter < IVF_TRAIN_ITERATIONS; iter++) {
+    assign_nearest (m_Centroids.data (), numLists, m_Dims, train.data (),
+        num_train, assign.data ());
+
+    std::fill (m_Centroids.begin (), m_Centroids.end (), 0.0f);
+    std::fill (counts.begin (), counts.end (), 0);
+    for (uint32_t i = 0; i < num_train; i++) {
+      float *c = &m_Centroids[(size_t) assign[i] * m_Dims];
+      for (uint32_t d = 0; d < m_Dims; d++)
+        c[d] += train[i][d];
+      counts[assign[i]]++;
+    }
+    for (uint32_t l = 0; l < numLists; l++) {
+      float *c = &m_Centroids[(size_t) l * m_Dims];
+      /* Re-seed empty lists with a random training point. */
+      if (counts[l] == 0) {
+        const float *p = train[next_random (state) % num_train];
+        std::copy (p, p + m_Dims, c);
+      }
+      simdL2Normalize (c, m_Dims);
+    }
+  }
+
+  /* Assign every gallery row to its list. */
+  std::vector<const float *> rows (num_rows);
+  for (uint32_t i = 0; i < num_rows; i++)
+    rows[i] = row (i);
+  std::vector<int32_t> lists (num_rows);
+  assign_nearest (m_Centroids.data (), numLists, m_Dims, rows.data (),
+      num_rows, lists.data ());
+
+  m_ListOffsets.assign (numLists + 1, 0);
+  for (uint32_t i = 0; i < num_rows; i++)
+    m_ListOffsets[lists[i] + 1]++;
+  for (uint32_t l = 0; l < numLists; l++)
+    m_ListOffsets[l + 1] += m_ListOffsets[l];
+
+  std::vector<uint32_t> fill (m_ListOffsets.begin (), m_ListOffsets.end () - 1);
+  m_RowIds.resize (num_rows);
+  for (uint32_t i = 0; i < num_rows; i++)
+    m_RowIds[fill[lists[i]]++] = i;
+}
+
+bool
+IvfGallery::readIndex (const std::string &path, uint32_t numLists,
+    uint64_t hash)
+{
+  std::ifstream file (path, std::ios::binary);
+  if (!file.good ())
+    return false;
+
+  IvfIndexHeader header;
+  if (!file.read ((char *) &header, sizeof (header)) ||
+      strncmp (header.magic, IVF_INDEX_MAGIC, sizeof (header.magic)) ||
+      header.version != IVF_INDEX_VERSION || header.dims != m_Dims ||
+      header.numRows != size () || header.numLists != numLists ||
+      header.galleryHash != hash) {
+    g_print ("Info: Gallery index %s does not match the gallery, "
+        "rebuilding\n", path.c_str ());
+    return false;
+  }
+
+  m_Centroids.resize ((size_t) numLists * m_Dims);
+  m_ListOffsets.resize (numLists + 1);
+  m_RowIds.resize (size ());
+  if (!file.read ((char *) m_Centroids.data (),
+          m_Centroids.size () * sizeof (float)) ||
+      !file.read ((char *) m_ListOffsets.data (),
+          m_ListOffsets.size () * sizeof (uint32_t)) ||
+      !file.read ((char *) m_RowIds.data (),
+          m_RowIds.size () * sizeof (uint32_t)) ||
+      m_ListOffsets.back () != size ()) {
+    g_printerr ("Warn: Gallery index %s is truncated, rebuilding\n",
+        path.c_str ());
+    return false;
+  }
+
+  /* The lists must partition the rows: offsets non-decreasing from 0 and
+   * every gallery row exactly once, else search would read
+   * out of bounds. */
+  bool valid = (m_ListOffsets[0] == 0);
+  for (uint32_t l = 0; valid && l < numLists; l++)
+    valid = (m_ListOffsets[l] <= m_ListOffsets[l + 1]);
+  std::vector<bool> seen (size (), false);
+  for (uint32_t i = 0; valid && i < m_RowIds.size (); i++) {
+    valid = (m_RowIds[i] < size () && !seen[m_RowIds[i]]);
+    if (valid)
+      seen[m_RowIds[i]] = true;
+  }
+  if (!valid) {
+    g_printerr ("Warn: Gallery index %s is corrupt, rebuilding\n",
+        path.c_str ());
+    return false;
+  }
+  return true;
+}
+
+bool
+IvfGallery::writeIndex (const std::string &path, uint64_t hash) const
+{
+  IvfIndexHeader header;
+  memset (&header, 0, sizeof (header));
+  strncpy (header.magic, IVF_INDEX_MAGIC, sizeof (header.magic));
+  header.version = IVF_INDEX_VERSION;
+  header.dims = m_Dims;
+  header.numRows = size ();
+  header.numLists = m_ListOffsets.size () - 1;
+  header.galleryHash = hash;
+
+  /* Write to a temporary file and rename so that readers never see a
+   * partially written index. */
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file (tmp_path, std::ios::binary | std::ios::trunc);
+    file.write ((const char *) &header, sizeof (header));
+    file.write ((const char *) m_Centroids.data (),
+        m_Centroids.size () * sizeof (float));
+    file.write ((const char *) m_ListOffsets.data (),
+        m_ListOffsets.size () * sizeof (uint32_t));
+    file.write ((const char *) m_RowIds.data (),
+        m_RowIds.size () * sizeof (uint32_t));
+    if (!file.good ())
+      return false;
+  }
+  return rename (tmp_path.c_str (), path.c_str ()) == 0;
+}
+
+void
+IvfGallery::search (const float *const *queries, uint32_t numQueries,
+    uint32_t k, std::vector<GalleryMatch> &matches) const
+{
+  const uint32_t num_lists = m_ListOffsets.size () - 1;
+  if (m_NumProbes >= num_lists) {
+    Gallery::search (queries, numQueries, k, matches);
+    return;
+  }
+
+  matches.assign (numQueries * k, GalleryMatch {-1, -FLT_MAX});
+  if (numQueries == 0 || k == 0)
+    return;
+
+  /* Coarse search: the closest lists for the whole batch at once. */
+  std::vector<GalleryMatch> probes (numQueries * m_NumProbes,
+      GalleryMatch {-1, -FLT_MAX});
+  search_float_rows (m_Centroids.data (), num_lists, m_Dims, queries,
+      numQueries, m_NumProbes, probes.data ());
+
+  /* Group the queries by probed list: the queries probing list l are at
+   * [list_start[l], list_start[l + 1]) of list_queries. */
+  std::vector<uint32_t> list_start (num_lists + 1, 0);
+  for (const GalleryMatch & probe : probes) {
+    if (probe.index >= 0)
+      list_start[probe.index + 1]++;
+  }
+
+  /* A batch probing most of the lists reads most of the matrix anyway, and
+   * a sequential scan of it is faster than gathering the rows list by
+   * list. */
+  uint64_t probed_rows = 0;
+  for (uint32_t l = 0; l < num_lists; l++) {
+    if (list_start[l + 1])
+      probed_rows += m_ListOffsets[l + 1] - m_ListOffsets[l];
+  }
+  if (probed_rows * IVF_EXHAUSTIVE_DEN > (uint64_t) size () * IVF_EXHAUSTIVE_NUM) {
+    Gallery::search (queries, numQueries, k, matches);
+    return;
+  }
+
+  for (uint32_t l = 0; l < num_lists; l++)
+    list_start[l + 1] += list_start[l];
+  std::vector<uint32_t> fill (list_start.begin (), list_start.end () - 1);
+  std::vector<uint32_t> list_queries (list_start.back ());
+  for (uint32_t i = 0; i < probes.size (); i++) {
+    if (probes[i].index >= 0)
+      list_queries[fill[probes[i].index]++] = i / m_NumProbes;
+  }
+
+  /* Fine search: scan each probed list once for all the queries probing it,
+   * blocked like the exhaustive search. The rows are read in place through
+   * m_RowIds. */
+  for (uint32_t l = 0; l < num_lists; l++) {
+    const uint32_t *lq = &list_queries[list_start[l]];
+    uint32_t num_lq = list_start[l + 1] - list_start[l];
+    if (!num_lq)
+      continue;
+
+    for (uint32_t pos0 = m_ListOffsets[l]; pos0 < m_ListOffsets[l + 1];
+        pos0 += GALLERY_BLOCK_ROWS) {
+      uint32_t pos_end = std::min (pos0 + GALLERY_BLOCK_ROWS,
+          m_ListOffsets[l + 1]);
+
+      for (uint32_t j = 0; j < num_lq; j += 4) {
+        uint32_t nq = std::min (4u, num_lq - j);
+        const float *group[4];
+        for (uint32_t i = 0; i < 4; i++)
+          group[i] = queries[lq[j + std::min (i, nq - 1)]];
+
+        for (uint32_t pos = pos0; pos < pos_end; pos++) {
+          uint32_t row_id = m_RowIds[pos];
+          float scores[4];
+          simdDot4 (row (row_id), group, m_Dims, scores);
+          for (uint32_t i = 0; i < nq; i++)
+            insert_top_k (&matches[lq[j + i] * k], k, row_id, scores[i]);
+        }
+      }
+    }
+  }
+}
+
+}
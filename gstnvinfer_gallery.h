@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __GSTNVINFER_GALLERY_H__
+#define __GSTNVINFER_GALLERY_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gstnvinfer {
+
+/** Holds one gallery match for a query embedding. */
+struct GalleryMatch
+{
+  /** Row of the matched identity in the gallery, -1 if the slot is unused. */
+  int32_t index;
+  /** Cosine similarity between the query and the identity. */
+  float score;
+};
+
+/** Element type of the gallery embedding matrix. */
+typedef enum
+{
+  GALLERY_DATA_FLOAT = 0,
+  GALLERY_DATA_INT8 = 1
+} GalleryDataType;
+
+#define GALLERY_FILE_MAGIC "NVDSGAL"
+#define GALLERY_FILE_VERSION 1
+#define GALLERY_FILE_ALIGNMENT 64
+/** The binary gallery file has per-row scales. */
+#define GALLERY_FLAG_ROW_SCALE 0x1
+
+/** Header of a binary gallery file. */
+typedef struct
+{
+  /** GALLERY_FILE_MAGIC, NUL padded. */
+  char magic[8];
+  uint32_t version;
+  /** One of GalleryDataType. */
+  uint32_t dataType;
+  uint32_t dims;
+  uint32_t numRows;
+  /** Bitwise OR of GALLERY_FLAG_* values. */
+  uint32_t flags;
+  uint32_t reserved;
+  uint64_t labelOffsetsOffset;
+  uint64_t labelTableOffset;
+  uint64_t labelTableSize;
+  uint64_t matrixOffset;
+  uint64_t scalesOffset;
+} GalleryFileHeader;
+
+/* Identity gallery used by embedding instances to label objects in-process.
+ *
+ * The gallery holds one L2-normalized embedding per identity, so the cosine
+ * similarity is a plain dot product. A batch of queries is matched as a
+ * blocked matrix product: a block of gallery rows is kept hot in cache and
+ * scored against all the queries of the batch, four queries at a time.
+ *
+ * Two file formats are supported. Text gallery files have one identity per
+ * line:
+ *   <label> <v0> <v1> ... <vN-1>
+ * Labels cannot contain white space. Empty lines and lines starting with '#'
+ * are ignored. All rows must have the same number of elements. Text rows are
+ * parsed into the heap and normalized on load.
+ *
+ * Binary gallery files are memory-mapped read-only and used in place, so
+ * processes loading the same file share its pages. A mapped file must never be
+ * modified or truncated: publish a new gallery by writing it to a temporary
+ * file and renaming it over the old one. The file is little-endian
+ * and starts with a GalleryFileHeader. All offsets are in bytes from the
+ * start of the file and sections are aligned to GALLERY_FILE_ALIGNMENT:
+ *   - label offsets: numRows + 1 uint32 offsets into the label table, label i
+ *     is the NUL-terminated string at [offsets[i], offsets[i + 1])
+ *   - label table: the concatenated labels
+ *   - matrix: numRows x dims row-major float32 or int8 elements, int8
+ *     elements in [-127, 127]
+ *   - scales: numRows float32 per-row scales, int8 matrices only, present if
+ *     GALLERY_FLAG_ROW_SCALE is set. Without it the scale is 1/127.
+ * Embedding i is scales[i] * matrix[i] and must be L2-normalized, binary rows
+ * are not modified on load. */
+class Gallery
+{
+public:
+  virtual ~Gallery () = default;
+
+  /** Load a text or binary gallery file, detected from the file contents.
+   * Returns nullptr on failure. */
+  static std::shared_ptr<Gallery> load (const std::string &path);
+
+  uint32_t dims () const { return m_Dims; }
+  uint32_t size () const { return m_Size; }
+  GalleryDataType dataType () const { return m_DataType; }
+  const char *label (uint32_t index) const {
+    return m_LabelTable + m_LabelOffsets[index];
+  }
+
+  /** Find the top-k identities for each of the numQueries normalized query
+   * embeddings. matches is resized to numQueries * k, the matches for query q
+   * are at [q * k, (q + 1) * k) sorted by descending score. */
+  virtual void search (const float *const *queries, uint32_t numQueries,
+      uint32_t k, std::vector<GalleryMatch> &matches) const;
+
+  /** Same as search for int8 quantized queries, query q is approximately
+   * scales[q] * queries[q]. int8 galleries are matched with integer dot
+   * products, float galleries with dequantized queries. */
+  virtual void searchS8 (const int8_t *const *queries, const float *scales,
+      uint32_t numQueries, uint32_t k,
+      std::vector<GalleryMatch> &matches) const;
+
+protected:
+  Gallery () = default;
+  Gallery (Gallery &&) = default;
+
+  static std::shared_ptr<Gallery> loadText (const std::string &path);
+  static std::shared_ptr<Gallery> loadBinary (const std::string &path);
+  static std::shared_ptr<Gallery> mapBinary (const std::string &path,
+      void *addr, size_t fileSize);
+
+  /** Row accessors, valid for GALLERY_DATA_FLOAT / GALLERY_DATA_INT8
+   * galleries respectively. */
+  const float *row (uint32_t index) const {
+    return (const float *) m_Matrix + (size_t) index * m_Dims;
+  }
+  const int8_t *rowS8 (uint32_t index) const {
+    return (const int8_t *) m_Matrix + (size_t) index * m_Dims;
+  }
+  float scale (uint32_t index) const {
+    return m_Scales ? m_Scales[index] : 1.0f / 127.0f;
+  }
+
+  /** Hash of the gallery contents. */
+  uint64_t hash () const;
+
+  uint32_t m_Dims = 0;
+  uint32_t m_Size = 0;
+  GalleryDataType m_DataType = GALLERY_DATA_FLOAT;
+  /** Row-major m_Size x m_Dims matrix of normalized embeddings. */
+  const void *m_Matrix = nullptr;
+  /** Per-row scales of an int8 matrix, may be null. */
+  const float *m_Scales = nullptr;
+  const uint32_t *m_LabelOffsets = nullptr;
+  const char *m_LabelTable = nullptr;
+
+  /** Storage backing the pointers above: heap vectors for text galleries,
+   * a read-only file mapping for binary galleries. */
+  std::vector<float> m_Embeddings;
+  std::vector<uint32_t> m_LabelOffsetStore;
+  std::vector<char> m_LabelTableStore;
+  std::shared_ptr<const void> m_Mapping;
+};
+
+/* Inverted file (IVF) index for galleries too large for exhaustive search.
+ * Only float galleries can be indexed. The rows are read in place through the
+ * list order, so a binary gallery stays shared between processes.
+ *
+ * The gallery is partitioned into numLists clusters with spherical k-means.
+ * A query is only compared against the rows of the numProbes lists whose
+ * centroids are closest to it, which trades recall for speed: more probes
+ * give higher recall and higher latency, numProbes == numLists is exhaustive.
+ * The queries of a batch are grouped by probed list and each list is scanned
+ * once for all of them.
+ *
+ * The build is deterministic for a given gallery and number of lists. When
+ * an index path is given the centroids and list assignment are persisted
+ * there and reused on the next start if they match the gallery contents. */
+class IvfGallery : public Gallery
+{
+public:
+  /** Build (or load from indexPath) an IVF index over the gallery. Returns
+   * nullptr on failure. */
+  static std::shared_ptr<Gallery> create (Gallery &&base, uint32_t numLists,
+      uint32_t numProbes, const std::string &indexPath);
+
+  void search (const float *const *queries, uint32_t numQueries,
+      uint32_t k, std::vector<GalleryMatch> &matches) const override;
+
+private:
+  IvfGallery (Gallery &&base, uint32_t numProbes);
+
+  void build (uint32_t numLists);
+  bool readIndex (const std::string &path, uint32_t numLists, uint64_t hash);
+  bool writeIndex (const std::string &path, uint64_t hash) const;
+
+  uint32_t m_NumProbes = 0;
+  /** Row-major numLists x m_Dims matrix of normalized list centroids. */
+  std::vector<float> m_Centroids;
+  /** Rows of list l are at [m_ListOffsets[l], m_ListOffsets[l + 1]). */
+  std::vector<uint32_t> m_ListOffsets;
+  /** Gallery row of each position in list order. */
+  std::vector<uint32_t> m_RowIds;
+};
+
+}
+
+#endif
@@ -9,9 +9,11 @@
  *
  */
 
+#include <sys/stat.h>
 #include <vector>
 #include <sstream>
 #include <cassert>
+#include <chrono>
 
 #include "gstnvinfer_impl.h"
 #include "gstnvinfer.h"
@@ -117,6 +119,7 @@ DsNvInferImpl::start ()
 void
 DsNvInferImpl::stop ()
 {
+  m_GalleryLoadThread.reset ();
   m_ModelLoadThread.reset ();
   m_InferCtx.reset ();
 }
@@ -133,6 +136,183 @@ DsNvInferImpl::triggerNewModel (const std::string & modelPath,
   return true;
 }
 
+/** Start the gallery reload thread. */
+DsNvInferImpl::GalleryLoadThread::GalleryLoadThread (DsNvInferImpl & impl,
+    const std::string & path, guint checkInterval)
+  : m_Impl (impl), m_Path (path), m_CheckInterval (checkInterval)
+{
+  m_Thread = std::thread (&DsNvInferImpl::GalleryLoadThread::Run, this);
+}
+
+/** Stop and join the gallery reload thread. */
+DsNvInferImpl::GalleryLoadThread::~GalleryLoadThread ()
+{
+  if (m_Thread.joinable ()) {
+    {
+      std::unique_lock<std::mutex> lock (m_Mutex);
+      m_Stop = true;
+    }
+    m_Cond.notify_one ();
+    m_Thread.join ();
+  }
+}
+
+void
+DsNvInferImpl::GalleryLoadThread::queueGallery (const std::string & path)
+{
+  {
+    std::unique_lock<std::mutex> lock (m_Mutex);
+    m_PendingPath = path;
+  }
+  m_Cond.notify_one ();
+}
+
+/* Galleries are published by writing a new file and renaming it over the
+ * old one, which gives the path a new inode. Binary galleries are searched in
+ * their file mapping, so a file edited in place is not reloaded. */
+static bool
+gallery_file_replaced (const struct stat &prev, const struct stat &cur)
+{
+  return prev.st_ino != cur.st_ino || prev.st_dev != cur.st_dev;
+}
+
+static bool
+gallery_file_modified (const struct stat &prev, const struct stat &cur)
+{
+  return prev.st_size != cur.st_size ||
+      prev.st_mtim.tv_sec != cur.st_mtim.tv_sec ||
+      prev.st_mtim.tv_nsec != cur.st_mtim.tv_nsec;
+}
+
+/** Callable function for the thread. Waits for a reload request or, if
+ * polling is enabled, for the gallery file to change. */
+void
+DsNvInferImpl::GalleryLoadThread::Run ()
+{
+  struct stat last_stat = {};
+  stat (m_Path.c_str (), &last_stat);
+
+  std::unique_lock<std::mutex> lock (m_Mutex);
+  auto wake = [this] () { return m_Stop || !m_PendingPath.empty (); };
+
+  while (true) {
+    if (m_CheckInterval)
+      m_Cond.wait_for (lock, std::chrono::seconds (m_CheckInterval), wake);
+    else
+      m_Cond.wait (lock, wake);
+
+    if (m_Stop)
+      break;
+
+    bool reload = false;
+    if (!m_PendingPath.empty ()) {
+      m_Path.swap (m_PendingPath);
+      m_PendingPath.clear ();
+      reload = true;
+    }
+    std::string path = m_Path;
+    lock.unlock ();
+
+    struct stat cur_stat = {};
+    if (stat (path.c_str (), &cur_stat) == 0) {
+      if (gallery_file_replaced (last_stat, cur_stat)) {
+        reload = true;
+      } else if (!reload && gallery_file_modified (last_stat, cur_stat)) {
+        GST_ELEMENT_WARNING (m_Impl.m_GstInfer, RESOURCE, FAILED,
+            ("[UID %d]: Gallery %s was modified in place and is not "
+                "reloaded, replace it by renaming a new file over it",
+                m_Impl.m_GstInfer->unique_id, path.c_str ()), (nullptr));
+        last_stat = cur_stat;
+      }
+    }
+    /* Keep the previous stat on failure so that a file still being written
+     * is retried at the next check. */
+    if (reload && m_Impl.reloadGallery (path))
+      last_stat = cur_stat;
+
+    lock.lock ();
+  }
+}
+
+std::shared_ptr<Gallery>
+DsNvInferImpl::createGallery (const std::string & path, std::string & error)
+{
+  std::shared_ptr<Gallery> gallery = Gallery::load (path);
+  if (!gallery) {
+    error = "Failed to load gallery";
+    return nullptr;
+  }
+
+  /* The reload thread may run while a model update replaces the layers
+   * info, read the embedding size under the lock. */
+  unsigned int embedding_size = 0;
+  {
+    LockGMutex lock (m_GstInfer->process_lock);
+    if (!m_GstInfer->output_layers_info->empty ())
+      embedding_size =
+          m_GstInfer->output_layers_info->at (0).inferDims.numElements;
+  }
+  if (gallery->dims () != embedding_size) {
+    error = "Gallery embedding size " + std::to_string (gallery->dims ()) +
+        " does not match the network output";
+    return nullptr;
+  }
+
+  /* Replace exhaustive search by an approximate index for large galleries. */
+  if (m_GstInfer->gallery_ivf_lists > 0) {
+    gallery = IvfGallery::create (std::move (*gallery),
+        m_GstInfer->gallery_ivf_lists, m_GstInfer->gallery_ivf_probes,
+        m_GstInfer->gallery_index_file_path ?
+        m_GstInfer->gallery_index_file_path : "");
+    if (!gallery) {
+      error = "Failed to create gallery index";
+      return nullptr;
+    }
+  }
+  return gallery;
+}
+
+void
+DsNvInferImpl::startGalleryReload (const std::string & path,
+    guint checkInterval)
+{
+  m_GalleryLoadThread.reset (new GalleryLoadThread (*this, path,
+          checkInterval));
+}
+
+/* Queue a gallery reload. */
+bool
+DsNvInferImpl::triggerGalleryReload (const std::string & path)
+{
+  if (!m_GalleryLoadThread.get ()) {
+    return false;
+  }
+  m_GalleryLoadThread->queueGallery (path);
+  return true;
+}
+
+/* Load a new gallery and swap it in. The output thread picks the new gallery
+ * up on its next batch, batches being processed keep the old one alive. On
+ * failure the current gallery stays in use. */
+bool
+DsNvInferImpl::reloadGallery (const std::string & path)
+{
+  std::string error;
+  std::shared_ptr<Gallery> gallery = createGallery (path, error);
+  if (!gallery) {
+    GST_ELEMENT_WARNING (m_GstInfer, RESOURCE, FAILED,
+        ("[UID %d]: Reload gallery:%s failed, reason: %s",
+            m_GstInfer->unique_id, path.c_str (), error.c_str ()),
+        (nullptr));
+    return false;
+  }
+
+  setGallery (gallery);
+  GST_INFO_OBJECT (m_GstInfer, "[UID %d]: Reloaded gallery of %u identities "
+      "from %s", m_GstInfer->unique_id, gallery->size (), path.c_str ());
+  return true;
+}
+
 /* Load the new model - Try to create a new NvDsInferContext instance with new
  * parameters and store the instance in m_NextContextReplacement. */
 void
@@ -234,6 +414,11 @@ DsNvInferImpl::initNewInferModelParams (NvDsInferContextInitParams & newParams,
       newParams.networkInputFormat = oldParams.networkInputFormat;
       newParams.numOffsets = oldParams.numOffsets;
       memcpy (newParams.offsets, oldParams.offsets, sizeof (newParams.offsets));
+      newParams.warmupIterations = oldParams.warmupIterations;
+      newParams.numExecutionContexts = oldParams.numExecutionContexts;
+      memcpy (newParams.profileBatchSizes, oldParams.profileBatchSizes,
+          sizeof (newParams.profileBatchSizes));
+      newParams.numProfileBatchSizes = oldParams.numProfileBatchSizes;
       break;
 
     default:
@@ -244,6 +429,22 @@ DsNvInferImpl::initNewInferModelParams (NvDsInferContextInitParams & newParams,
       return false;
   }
 
+  /* Buffers of the element are allocated for the memory of the running
+   * context, host memory when replaying tensors or inferring on the CPU. */
+  if (string_empty (newParams.replayTensorsFilePath) !=
+      string_empty (oldParams.replayTensorsFilePath)) {
+    GST_WARNING_OBJECT (m_GstInfer,
+        "[UID %d]: new model %s can not turn tensor replay on or off.",
+        m_GstInfer->unique_id, newModelPath.c_str ());
+    return false;
+  }
+  if (!newParams.useCpuInference != !oldParams.useCpuInference) {
+    GST_WARNING_OBJECT (m_GstInfer,
+        "[UID %d]: new model %s can not turn CPU inference on or off.",
+        m_GstInfer->unique_id, newModelPath.c_str ());
+    return false;
+  }
+
   newParams.maxBatchSize = oldParams.maxBatchSize;
   newParams.gpuID = oldParams.gpuID;
   newParams.uniqueID = oldParams.uniqueID;
@@ -251,6 +452,10 @@ DsNvInferImpl::initNewInferModelParams (NvDsInferContextInitParams & newParams,
   newParams.useDBScan = oldParams.useDBScan;
   newParams.classifierThreshold = oldParams.classifierThreshold;
   newParams.segmentationThreshold = oldParams.segmentationThreshold;
+  newParams.segmentationClassMapU8 = oldParams.segmentationClassMapU8;
+  newParams.segmentationThreads = oldParams.segmentationThreads;
+  newParams.outputInt8Scale = oldParams.outputInt8Scale;
+  newParams.embeddingInt8 = oldParams.embeddingInt8;
   newParams.copyInputToHostBuffers = oldParams.copyInputToHostBuffers;
   newParams.outputBufferPoolSize = oldParams.outputBufferPoolSize;
   if (string_empty (newParams.labelsFilePath)
@@ -301,6 +506,31 @@ DsNvInferImpl::isNewContextValid (INvDsInferContext & newCtx,
   return true;
 }
 
+/* Check that the new model binds the same layers as the current one. The
+ * output of batches still in flight on the current context can then be
+ * handled with the layers info of the new context. */
+bool
+DsNvInferImpl::isLayersInfoCompatible (INvDsInferContext & newCtx)
+{
+  std::vector<NvDsInferLayerInfo> newLayers;
+  newCtx.fillLayersInfo (newLayers);
+
+  const std::vector<NvDsInferLayerInfo> &curLayers = *m_GstInfer->layers_info;
+  if (newLayers.size () != curLayers.size ())
+    return false;
+
+  for (size_t i = 0; i < newLayers.size (); i++) {
+    const NvDsInferLayerInfo &n = newLayers[i];
+    const NvDsInferLayerInfo &c = curLayers[i];
+    if (n.isInput != c.isInput || n.bindingIndex != c.bindingIndex ||
+        n.dataType != c.dataType ||
+        n.inferDims.numElements != c.inferDims.numElements ||
+        g_strcmp0 (n.layerName, c.layerName))
+      return false;
+  }
+  return true;
+}
+
 /* Notify the app of model load status using GObject signal. */
 void
 DsNvInferImpl::notifyLoadModelStatus (const ModelStatus & res)
@@ -365,10 +595,6 @@ DsNvInferImpl::flushDataUnlock (LockGMutex & lock)
 
   g_cond_broadcast (&m_GstInfer->process_cond);
 
-  for (auto & si:*(m_GstInfer->source_info)) {
-    si.second.object_history_map.clear ();
-  }
-
   return NVDSINFER_SUCCESS;
 }
 
@@ -386,6 +612,9 @@ DsNvInferImpl::resetContextUnlock (NvDsInferContextPtr ctx,
   GstNvinfercustom *nvinfer = m_GstInfer;
   g_free (nvinfer->config_file_path);
   nvinfer->config_file_path = g_strdup (path.c_str ());
+  /* New contexts are checked for the full batch size, this also ends the use
+   * of a smaller fallback engine. */
+  nvinfer->infer_batch_size = nvinfer->max_batch_size;
   /* Get the network resolution. */
   ctx->getNetworkInfo (nvinfer->network_info);
   nvinfer->network_width = nvinfer->network_info.width;
@@ -403,9 +632,10 @@ DsNvInferImpl::resetContextUnlock (NvDsInferContextPtr ctx,
   return NVDSINFER_SUCCESS;
 }
 
-/* Check if a new model has been loaded. If yes, ensure synchronization by
- * waiting till all the queued buffers are processed and then do the actual
- * model replacement. */
+/* Check if a new model has been loaded. If yes, replace the current model.
+ * If the new model binds the same layers, the batches in flight finish on the
+ * current context, which is released with its last batch output. Otherwise
+ * wait till all the queued buffers are processed before the replacement. */
 NvDsInferStatus
 DsNvInferImpl::ensureReplaceNextContext ()
 {
@@ -424,12 +654,22 @@ DsNvInferImpl::ensureReplaceNextContext ()
   const std::string path = std::get <2> (*nextReplacement);
 
   /* Wait for current processing to finish. */
-  err = flushDataUnlock (lock);
-  if (err != NVDSINFER_SUCCESS) {
-    notifyLoadModelStatus (ModelStatus {
-        err, path, "Model update failed while flushing data"}
-    );
-    return err;
+  bool compatible = isLayersInfoCompatible (*nextCtx);
+  if (!compatible) {
+    err = flushDataUnlock (lock);
+    if (err != NVDSINFER_SUCCESS) {
+      notifyLoadModelStatus (ModelStatus {
+          err, path, "Model update failed while flushing data"}
+      );
+      return err;
+    }
+  }
+
+  /* Cached results of the previous model are only reused if requested. */
+  if (!compatible || !m_GstInfer->model_update_keep_history) {
+    for (auto & si:*(m_GstInfer->source_info)) {
+      si.second.object_history_map.clear ();
+    }
   }
 
   /* Replace the model to be used for inferencing. */
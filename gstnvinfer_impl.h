@@ -19,6 +19,7 @@
 
 #include <vector>
 #include <list>
+#include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -29,6 +30,7 @@
 #include "nvdsinfer_func_utils.h"
 #include "nvdsmeta.h"
 #include "nvtx3/nvToolsExt.h"
+#include "gstnvinfer_gallery.h"
 
 G_BEGIN_DECLS
 typedef struct _GstNvinfercustom GstNvinfercustom;
@@ -72,6 +74,13 @@ typedef struct {
   /** Pointer to the structure holding inference history for the object. Should
    * be NULL when inferencing on frames. */
   std::weak_ptr<GstNvinfercustomObjectHistory> history;
+  /** Origin of the tile in the input frame when the frame is sliced into
+   * tiles. */
+  guint tile_left = 0;
+  guint tile_top = 0;
+  /** Number of consecutive batch entries holding the tiles of this frame. Only
+   * set on the first tile of a frame. */
+  guint num_tiles = 1;
 
 } GstNvinfercustomFrame;
 
@@ -99,11 +108,18 @@ typedef struct {
   gboolean event_marker = FALSE;
   /** Buffer containing the intermediate conversion output for the batch. */
   GstBuffer *conv_buf = nullptr;
+  /** NvDsInferContext the batch has been queued to. The output is dequeued
+   * from the same context, the batches in flight during a model update finish
+   * on the replaced context. */
+  NvDsInferContextPtr infer_context;
   nvtxRangeId_t nvtx_complete_buf_range = 0;
 
   /** List of objects not inferred on in the current batch but pending
    * attachment of lastest available classification metadata. */
   std::vector <GstNvinfercustomObjHistory_MetaPair> objs_pending_meta_attach;
+  /** Frames skipped by the motion gate. The last detections of their source
+   * are attached to them in the output thread. */
+  std::vector <GstNvinfercustomFrame> frames_pending_meta_attach;
 } GstNvinfercustomBatch;
 
 
@@ -225,7 +241,52 @@ public:
   /** NvDsInferContext initialization params. */
   NvDsInferContextInitParamsPtr m_InitParams;
 
+  /** Load a gallery file and prepare it for matching with the element's
+   * gallery settings. Returns nullptr on failure with the reason in error. */
+  std::shared_ptr<Gallery> createGallery (const std::string &path,
+      std::string &error);
+
+  /** Identity gallery for embedding instances, null if not configured. The
+   * gallery may be swapped by the reload thread at any time, users must hold
+   * the returned reference for as long as they access the gallery. */
+  std::shared_ptr<Gallery> getGallery () const {
+    return std::atomic_load (&m_Gallery);
+  }
+  void setGallery (std::shared_ptr<Gallery> gallery) {
+    std::atomic_store (&m_Gallery, gallery);
+  }
+
+  /** Start the gallery reload thread for the gallery loaded from path.
+   * checkInterval is the file change polling interval in seconds, 0 to only
+   * reload on request. */
+  void startGalleryReload (const std::string &path, guint checkInterval);
+  /** Queue a gallery reload from path in the reload thread. */
+  bool triggerGalleryReload (const std::string &path);
+
 private:
+  /** Class implementation of separate thread for gallery reload. A new
+   * gallery is loaded in this thread and swapped in atomically, inference
+   * keeps using the previous gallery until then. */
+  class GalleryLoadThread
+  {
+  public:
+    GalleryLoadThread (DsNvInferImpl &impl, const std::string &path,
+        guint checkInterval);
+    ~GalleryLoadThread ();
+    void queueGallery (const std::string &path);
+  private:
+    void Run ();
+
+    DsNvInferImpl &m_Impl;
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Cond;
+    std::string m_Path;
+    std::string m_PendingPath;
+    guint m_CheckInterval;
+    bool m_Stop = false;
+  };
+
   /** Class implementation of separate thread for runtime model load. */
   class ModelLoadThread
   {
@@ -251,10 +312,12 @@ private:
       const NvDsInferContextInitParams &oldParams);
   bool isNewContextValid (
       INvDsInferContext &newCtx, NvDsInferContextInitParams &newParam);
+  bool isLayersInfoCompatible (INvDsInferContext &newCtx);
   bool triggerContextReplace (
       NvDsInferContextPtr ctx, NvDsInferContextInitParamsPtr params,
       const std::string &path);
   void loadModel (const std::string &path, ModelLoadType loadType);
+  bool reloadGallery (const std::string &path);
 
   ContextReplacementPtr getNextReplacementUnlock ();
   NvDsInferStatus flushDataUnlock (LockGMutex &lock);
@@ -266,6 +329,9 @@ private:
   /** Updating model thread. */
   std::unique_ptr<ModelLoadThread> m_ModelLoadThread;
   ContextReplacementPtr m_NextContextReplacement;
+  std::shared_ptr<Gallery> m_Gallery;
+  /** Gallery reload thread. */
+  std::unique_ptr<GalleryLoadThread> m_GalleryLoadThread;
 };
 
 }
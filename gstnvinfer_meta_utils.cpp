@@ -9,7 +9,9 @@
  *
  */
 
+#include <algorithm>
 #include <cstring>
+#include <vector>
 #include "gstnvinfer_meta_utils.h"
 
 static inline int
@@ -29,6 +31,67 @@ get_element_size (NvDsInferDataType data_type)
   }
 }
 
+static void
+release_landmarks_meta (gpointer data, gpointer user_data)
+{
+  NvDsUserMeta *user_meta = (NvDsUserMeta *) data;
+  NvDsInferLandmarksMeta *meta = (NvDsInferLandmarksMeta *) user_meta->user_meta_data;
+  g_free (meta->landmarks);
+  g_free (meta);
+}
+
+static gpointer
+copy_landmarks_meta (gpointer data, gpointer user_data)
+{
+  NvDsUserMeta *src_user_meta = (NvDsUserMeta *) data;
+  NvDsInferLandmarksMeta *src_meta = (NvDsInferLandmarksMeta *) src_user_meta->user_meta_data;
+  NvDsInferLandmarksMeta *meta = (NvDsInferLandmarksMeta *) g_malloc (sizeof (NvDsInferLandmarksMeta));
+
+  meta->unique_id = src_meta->unique_id;
+  meta->num_landmarks = src_meta->num_landmarks;
+  meta->landmarks = (gfloat *) g_memdup (src_meta->landmarks,
+      meta->num_landmarks * 2 * sizeof (gfloat));
+
+  return meta;
+}
+
+/**
+ * Attach the landmarks of a detected object as object user meta, scaled and
+ * offset to frame coordinates like the object's rect_params.
+ */
+static void
+attach_metadata_landmarks (GstNvinfercustom * nvinfer,
+    GstNvinfercustomFrame & frame, NvDsObjectMeta * obj_meta,
+    NvDsInferObject & obj)
+{
+  NvDsObjectMeta *parent_obj_meta = frame.obj_meta;
+  NvDsBatchMeta *batch_meta = frame.frame_meta->base_meta.batch_meta;
+  NvDsUserMeta *user_meta = nvds_acquire_user_meta_from_pool (batch_meta);
+  NvDsInferLandmarksMeta *meta = (NvDsInferLandmarksMeta *) g_malloc (sizeof (NvDsInferLandmarksMeta));
+  gfloat offset_x = 0, offset_y = 0;
+
+  if (!nvinfer->process_full_frame) {
+    offset_x = parent_obj_meta->rect_params.left;
+    offset_y = parent_obj_meta->rect_params.top;
+  }
+
+  meta->unique_id = nvinfer->unique_id;
+  meta->num_landmarks = obj.numLandmarks;
+  meta->landmarks = (gfloat *) g_malloc (obj.numLandmarks * 2 * sizeof (gfloat));
+  for (guint i = 0; i < obj.numLandmarks; i++) {
+    meta->landmarks[i * 2] =
+        obj.landmarks[i * 2] / frame.scale_ratio_x + offset_x;
+    meta->landmarks[i * 2 + 1] =
+        obj.landmarks[i * 2 + 1] / frame.scale_ratio_y + offset_y;
+  }
+
+  user_meta->user_meta_data = meta;
+  user_meta->base_meta.meta_type = NVDSINFER_LANDMARKS_META;
+  user_meta->base_meta.release_func = release_landmarks_meta;
+  user_meta->base_meta.copy_func = copy_landmarks_meta;
+  nvds_add_user_meta_to_obj (obj_meta, user_meta);
+}
+
 /**
  * Attach metadata for the detector. We will be adding a new metadata.
  */
@@ -130,10 +193,124 @@ attach_metadata_detector (GstNvinfercustom * nvinfer, GstMiniObject * tensor_out
     text_params.font_params.font_color = (NvOSD_ColorParams) {
     1, 1, 1, 1};
     nvds_add_obj_meta_to_frame (frame_meta, obj_meta, parent_obj_meta);
+
+    if (obj.numLandmarks > 0)
+      attach_metadata_landmarks (nvinfer, frame, obj_meta, obj);
   }
   nvds_release_meta_lock (batch_meta);
 }
 
+/**
+ * Get the detections of a frame in frame co-ordinates. A frame inferred as
+ * tiles has the detections of all its tiles mapped to the frame and, per
+ * class, a detection is dropped if most of it is covered by a more confident
+ * one. Objects cut by a tile edge are then replaced by the complete detection
+ * from a neighbouring tile, hence the overlap is measured over the smaller of
+ * the two boxes.
+ */
+void
+get_frame_detections (GstNvinfercustom * nvinfer,
+    GstNvinfercustomFrame * frames, NvDsInferFrameOutput * frame_outputs,
+    guint num_tiles, GstNvinfercustomDetections & detections)
+{
+  std::vector<NvDsInferObject> objects;
+  std::vector<size_t> landmarks_offsets;
+
+  detections.objects.clear ();
+  detections.labels.clear ();
+  detections.landmarks_offsets.clear ();
+  detections.landmarks.clear ();
+
+  for (guint t = 0; t < num_tiles; t++) {
+    GstNvinfercustomFrame & tile = frames[t];
+    NvDsInferDetectionOutput & detection_output =
+        frame_outputs[t].detectionOutput;
+
+    for (guint i = 0; i < detection_output.numObjects; i++) {
+      NvDsInferObject obj = detection_output.objects[i];
+
+      obj.left = obj.left / tile.scale_ratio_x + tile.tile_left;
+      obj.top = obj.top / tile.scale_ratio_y + tile.tile_top;
+      obj.width /= tile.scale_ratio_x;
+      obj.height /= tile.scale_ratio_y;
+
+      landmarks_offsets.push_back (detections.landmarks.size ());
+      for (guint j = 0; j < obj.numLandmarks; j++) {
+        detections.landmarks.push_back (obj.landmarks[j * 2] /
+            tile.scale_ratio_x + tile.tile_left);
+        detections.landmarks.push_back (obj.landmarks[j * 2 + 1] /
+            tile.scale_ratio_y + tile.tile_top);
+      }
+      objects.push_back (obj);
+    }
+  }
+
+  std::vector<guint> order (objects.size ());
+  for (guint i = 0; i < order.size (); i++)
+    order[i] = i;
+  if (num_tiles > 1) {
+    std::stable_sort (order.begin (), order.end (),
+        [&objects] (guint a, guint b) {
+          return objects[a].confidence > objects[b].confidence;
+        });
+  }
+
+  std::vector<bool> suppressed (objects.size (), false);
+  for (guint i = 0; i < order.size (); i++) {
+    if (suppressed[order[i]])
+      continue;
+    NvDsInferObject & obj = objects[order[i]];
+    detections.objects.push_back (obj);
+    detections.labels.push_back (obj.label ? obj.label : "");
+    detections.landmarks_offsets.push_back (landmarks_offsets[order[i]]);
+
+    if (num_tiles == 1)
+      continue;
+    for (guint j = i + 1; j < order.size (); j++) {
+      NvDsInferObject & other = objects[order[j]];
+      if (suppressed[order[j]] || other.classIndex != obj.classIndex)
+        continue;
+      float overlap_w = MIN (obj.left + obj.width, other.left + other.width) -
+          MAX (obj.left, other.left);
+      float overlap_h = MIN (obj.top + obj.height, other.top + other.height) -
+          MAX (obj.top, other.top);
+      if (overlap_w <= 0 || overlap_h <= 0)
+        continue;
+      float min_area = MIN (obj.width * obj.height, other.width * other.height);
+      if (overlap_w * overlap_h > nvinfer->tile_merge_threshold * min_area)
+        suppressed[order[j]] = true;
+    }
+  }
+}
+
+/**
+ * Attach metadata for detections already in frame co-ordinates.
+ */
+void
+attach_metadata_detections (GstNvinfercustom * nvinfer, GstMiniObject * tensor_out_object,
+    GstNvinfercustomFrame & frame, GstNvinfercustomDetections & detections)
+{
+  std::vector<NvDsInferObject> objects (detections.objects);
+
+  for (guint i = 0; i < objects.size (); i++) {
+    objects[i].label = detections.labels[i].empty () ? nullptr :
+        (char *) detections.labels[i].c_str ();
+    objects[i].landmarks = (objects[i].numLandmarks > 0) ?
+        detections.landmarks.data () + detections.landmarks_offsets[i] : nullptr;
+  }
+
+  GstNvinfercustomFrame frame_copy = frame;
+  frame_copy.scale_ratio_x = frame_copy.scale_ratio_y = 1;
+  frame_copy.tile_left = frame_copy.tile_top = 0;
+  frame_copy.num_tiles = 1;
+
+  NvDsInferDetectionOutput detection_output;
+  detection_output.objects = objects.data ();
+  detection_output.numObjects = objects.size ();
+  attach_metadata_detector (nvinfer, tensor_out_object, frame_copy,
+      detection_output);
+}
+
 /**
  * Update string label in an existing object metadata. If processing on full
  * frames, need to attach a new metadata. Assume only one label per object is generated.
@@ -265,9 +442,10 @@ release_segmentation_meta (gpointer data, gpointer user_data)
     gst_mini_object_unref (GST_MINI_OBJECT (meta->priv_data));
   } else {
     g_free (meta->class_map);
+    g_free (meta->class_map_u8);
     g_free (meta->class_probabilities_map);
   }
-  delete meta;
+  g_free (meta);
 }
 
 static gpointer
@@ -280,7 +458,10 @@ copy_segmentation_meta (gpointer data, gpointer user_data)
   meta->classes = src_meta->classes;
   meta->width = src_meta->width;
   meta->height = src_meta->height;
-  meta->class_map = (gint *) g_memdup(src_meta->class_map, meta->width * meta->height * sizeof (gint));
+  meta->class_map = src_meta->class_map ?
+      (gint *) g_memdup(src_meta->class_map, meta->width * meta->height * sizeof (gint)) : NULL;
+  meta->class_map_u8 = src_meta->class_map_u8 ?
+      (guint8 *) g_memdup(src_meta->class_map_u8, meta->width * meta->height) : NULL;
   meta->class_probabilities_map = (gfloat *) g_memdup(src_meta->class_probabilities_map, meta->classes * meta->width * meta->height * sizeof (gfloat));
   meta->priv_data = NULL;
 
@@ -301,6 +482,7 @@ attach_metadata_segmentation (GstNvinfercustom * nvinfer, GstMiniObject * tensor
   meta->width = segmentation_output.width;
   meta->height = segmentation_output.height;
   meta->class_map = segmentation_output.class_map;
+  meta->class_map_u8 = segmentation_output.class_map_u8;
   meta->class_probabilities_map = segmentation_output.class_probability_map;
   meta->priv_data = gst_mini_object_ref (tensor_out_object);
 
@@ -316,6 +498,106 @@ attach_metadata_segmentation (GstNvinfercustom * nvinfer, GstMiniObject * tensor
   }
 }
 
+/**
+ * Convert the top-k gallery matches of an embedding into classifier results.
+ * Each match above the threshold becomes one attribute: attributeIndex is the
+ * rank, attributeValue the gallery row and attributeConfidence the cosine
+ * similarity. The label is the best matching identity.
+ */
+void
+get_gallery_object_info (const gstnvinfer::Gallery & gallery,
+    const gstnvinfer::GalleryMatch * matches, guint num_matches,
+    gfloat threshold, GstNvinfercustomObjectInfo & object_info)
+{
+  for (guint i = 0; i < num_matches; i++) {
+    const gstnvinfer::GalleryMatch & match = matches[i];
+    if (match.index < 0 || match.score < threshold)
+      break;
+
+    NvDsInferAttribute attr;
+    attr.attributeIndex = i;
+    attr.attributeValue = match.index;
+    attr.attributeConfidence = match.score;
+    /* The label is copied by attach_metadata_classifier, the gallery
+     * outlives the call. */
+    attr.attributeLabel = (char *) gallery.label (match.index);
+    object_info.attributes.push_back (attr);
+  }
+  if (!object_info.attributes.empty ())
+    object_info.label = object_info.attributes[0].attributeLabel;
+}
+
+static void
+release_embedding_meta (gpointer data, gpointer user_data)
+{
+  NvDsUserMeta *user_meta = (NvDsUserMeta *) data;
+  NvDsInferEmbeddingMeta *meta = (NvDsInferEmbeddingMeta *) user_meta->user_meta_data;
+  if (meta->priv_data) {
+    gst_mini_object_unref (GST_MINI_OBJECT (meta->priv_data));
+  } else {
+    g_free (meta->embedding);
+    g_free (meta->embedding_int8);
+  }
+  g_free (meta);
+}
+
+/* A copied meta does not share the inference output buffer, so the embedding
+ * is duplicated instead of taking another reference on the batch output. */
+static gpointer
+copy_embedding_meta (gpointer data, gpointer user_data)
+{
+  NvDsUserMeta *src_user_meta = (NvDsUserMeta *) data;
+  NvDsInferEmbeddingMeta *src_meta = (NvDsInferEmbeddingMeta *) src_user_meta->user_meta_data;
+  NvDsInferEmbeddingMeta *meta = (NvDsInferEmbeddingMeta *) g_malloc (sizeof (NvDsInferEmbeddingMeta));
+
+  meta->unique_id = src_meta->unique_id;
+  meta->dims = src_meta->dims;
+  meta->embedding = src_meta->embedding ?
+      (gfloat *) g_memdup (src_meta->embedding, meta->dims * sizeof (gfloat)) : NULL;
+  meta->norm = src_meta->norm;
+  meta->embedding_int8 = src_meta->embedding_int8 ?
+      (gint8 *) g_memdup (src_meta->embedding_int8, meta->dims) : NULL;
+  meta->scale = src_meta->scale;
+  meta->priv_data = NULL;
+
+  return meta;
+}
+
+/**
+ * Attach the embedding for the frame/object. The meta references the
+ * normalized vector in the batch output host buffer and holds a ref on the
+ * tensor output object so the buffer is not recycled while the meta is alive.
+ */
+void
+attach_metadata_embedding (GstNvinfercustom * nvinfer, GstMiniObject * tensor_out_object,
+    GstNvinfercustomFrame & frame, NvDsInferEmbeddingOutput & embedding_output)
+{
+  NvDsBatchMeta *batch_meta = (nvinfer->process_full_frame) ?
+    frame.frame_meta->base_meta.batch_meta : frame.obj_meta->base_meta.batch_meta;
+
+  NvDsUserMeta *user_meta = nvds_acquire_user_meta_from_pool (batch_meta);
+  NvDsInferEmbeddingMeta *meta = (NvDsInferEmbeddingMeta *) g_malloc (sizeof (NvDsInferEmbeddingMeta));
+
+  meta->unique_id = nvinfer->unique_id;
+  meta->dims = embedding_output.dims;
+  meta->embedding = embedding_output.embedding;
+  meta->norm = embedding_output.norm;
+  meta->embedding_int8 = embedding_output.embeddingInt8;
+  meta->scale = embedding_output.scale;
+  meta->priv_data = gst_mini_object_ref (tensor_out_object);
+
+  user_meta->user_meta_data = meta;
+  user_meta->base_meta.meta_type = NVDSINFER_EMBEDDING_META;
+  user_meta->base_meta.release_func = release_embedding_meta;
+  user_meta->base_meta.copy_func = copy_embedding_meta;
+
+  if (nvinfer->process_full_frame) {
+    nvds_add_user_meta_to_frame (frame.frame_meta, user_meta);
+  } else {
+    nvds_add_user_meta_to_obj (frame.obj_meta, user_meta);
+  }
+}
+
 /* Called when NvDsUserMeta for each frame/object is released. Reduce the
  * refcount of the mini_object by 1 and free other memory. */
 static void
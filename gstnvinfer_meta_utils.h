@@ -15,6 +15,16 @@
 void attach_metadata_detector (GstNvinfercustom * nvinfer, GstMiniObject * tensor_out_object,
         GstNvinfercustomFrame & frame, NvDsInferDetectionOutput & detection_output);
 
+/* Gets the detections of a frame inferred as num_tiles consecutive batch
+ * entries in frame co-ordinates, merging the detections of overlapping
+ * tiles. */
+void get_frame_detections (GstNvinfercustom * nvinfer,
+        GstNvinfercustomFrame * frames, NvDsInferFrameOutput * frame_outputs,
+        guint num_tiles, GstNvinfercustomDetections & detections);
+
+void attach_metadata_detections (GstNvinfercustom * nvinfer, GstMiniObject * tensor_out_object,
+        GstNvinfercustomFrame & frame, GstNvinfercustomDetections & detections);
+
 void attach_metadata_classifier (GstNvinfercustom * nvinfer, GstMiniObject * tensor_out_object,
         GstNvinfercustomFrame & frame, GstNvinfercustomObjectInfo & object_info);
 
@@ -24,6 +34,15 @@ void merge_classification_output (GstNvinfercustomObjectHistory & history,
 void attach_metadata_segmentation (GstNvinfercustom * nvinfer, GstMiniObject * tensor_out_object,
         GstNvinfercustomFrame & frame, NvDsInferSegmentationOutput & segmentation_output);
 
+/* Fills the object info with the gallery matches above the threshold, to be
+ * attached with attach_metadata_classifier. */
+void get_gallery_object_info (const gstnvinfer::Gallery & gallery,
+        const gstnvinfer::GalleryMatch * matches, guint num_matches,
+        gfloat threshold, GstNvinfercustomObjectInfo & object_info);
+
+void attach_metadata_embedding (GstNvinfercustom * nvinfer, GstMiniObject * tensor_out_object,
+        GstNvinfercustomFrame & frame, NvDsInferEmbeddingOutput & embedding_output);
+
 /* Attaches the raw tensor output to the GstBuffer as metadata. */
 void attach_tensor_output_meta (GstNvinfercustom *nvinfer, GstMiniObject * tensor_out_object,
         GstNvinfercustomBatch *batch, NvDsInferContextBatchOutput *batch_output);
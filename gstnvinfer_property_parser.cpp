@@ -403,6 +403,127 @@ gst_nvinfer_parse_other_attribute (GstNvinfercustom * nvinfer,
           nvinfer->max_input_object_height);
       goto done;
     }
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_TILE_COLUMNS)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_TILE_COLUMNS, &error);
+    CHECK_ERROR (error);
+    if (val <= 0) {
+      g_printerr ("Error: %s(%d) should be > 0\n",
+          CONFIG_GROUP_INFER_TILE_COLUMNS, val);
+      goto done;
+    }
+    nvinfer->tile_columns = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_TILE_ROWS)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_TILE_ROWS, &error);
+    CHECK_ERROR (error);
+    if (val <= 0) {
+      g_printerr ("Error: %s(%d) should be > 0\n",
+          CONFIG_GROUP_INFER_TILE_ROWS, val);
+      goto done;
+    }
+    nvinfer->tile_rows = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_TILE_OVERLAP)) {
+    nvinfer->tile_overlap = g_key_file_get_double (key_file,
+        group_name, CONFIG_GROUP_INFER_TILE_OVERLAP, &error);
+    CHECK_ERROR (error);
+    if (nvinfer->tile_overlap < 0 || nvinfer->tile_overlap >= 1.0) {
+      g_printerr ("Error: %s(%.2f) should be in the range [0, 1)\n",
+          CONFIG_GROUP_INFER_TILE_OVERLAP, nvinfer->tile_overlap);
+      goto done;
+    }
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_TILE_INCLUDE_FULL_FRAME)) {
+    nvinfer->tile_include_full_frame = g_key_file_get_boolean (key_file,
+        group_name, CONFIG_GROUP_INFER_TILE_INCLUDE_FULL_FRAME, &error);
+    CHECK_ERROR (error);
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_TILE_MERGE_THRESHOLD)) {
+    nvinfer->tile_merge_threshold = g_key_file_get_double (key_file,
+        group_name, CONFIG_GROUP_INFER_TILE_MERGE_THRESHOLD, &error);
+    CHECK_ERROR (error);
+    if (nvinfer->tile_merge_threshold <= 0 ||
+        nvinfer->tile_merge_threshold > 1.0) {
+      g_printerr ("Error: %s(%.2f) should be in the range (0, 1]\n",
+          CONFIG_GROUP_INFER_TILE_MERGE_THRESHOLD,
+          nvinfer->tile_merge_threshold);
+      goto done;
+    }
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_MOTION_THRESHOLD)) {
+    nvinfer->motion_threshold = g_key_file_get_double (key_file,
+        group_name, CONFIG_GROUP_INFER_MOTION_THRESHOLD, &error);
+    CHECK_ERROR (error);
+    if (nvinfer->motion_threshold < 0 || nvinfer->motion_threshold > 1.0) {
+      g_printerr ("Error: %s(%.2f) should be in the range [0, 1]\n",
+          CONFIG_GROUP_INFER_MOTION_THRESHOLD, nvinfer->motion_threshold);
+      goto done;
+    }
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_MOTION_PIXEL_DELTA)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_MOTION_PIXEL_DELTA, &error);
+    CHECK_ERROR (error);
+    if (val < 0 || val > 255) {
+      g_printerr ("Error: %s(%d) should be in the range [0, 255]\n",
+          CONFIG_GROUP_INFER_MOTION_PIXEL_DELTA, val);
+      goto done;
+    }
+    nvinfer->motion_pixel_delta = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_MOTION_MAX_STALE_FRAMES)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_MOTION_MAX_STALE_FRAMES, &error);
+    CHECK_ERROR (error);
+    if (val < 0) {
+      g_printerr ("Error: %s(%d) should be >= 0\n",
+          CONFIG_GROUP_INFER_MOTION_MAX_STALE_FRAMES, val);
+      goto done;
+    }
+    nvinfer->motion_max_stale_frames = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_ADAPTIVE_INTERVAL_MAX)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_ADAPTIVE_INTERVAL_MAX, &error);
+    CHECK_ERROR (error);
+    if (val < 0) {
+      g_printerr ("Error: %s(%d) should be >= 0\n",
+          CONFIG_GROUP_INFER_ADAPTIVE_INTERVAL_MAX, val);
+      goto done;
+    }
+    nvinfer->adaptive_interval_max = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_ADAPTIVE_INTERVAL_BUSY_OBJECTS)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_ADAPTIVE_INTERVAL_BUSY_OBJECTS, &error);
+    CHECK_ERROR (error);
+    if (val <= 0) {
+      g_printerr ("Error: %s(%d) should be > 0\n",
+          CONFIG_GROUP_INFER_ADAPTIVE_INTERVAL_BUSY_OBJECTS, val);
+      goto done;
+    }
+    nvinfer->adaptive_interval_busy_objects = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_FALLBACK_ENGINE)) {
+    gchar abs_path[_PATH_MAX];
+    gchar *str = g_key_file_get_string (key_file, group_name,
+        CONFIG_GROUP_INFER_FALLBACK_ENGINE, &error);
+    CHECK_ERROR (error);
+
+    if (!get_absolute_file_path (cfg_file_path, str, abs_path)) {
+      g_printerr ("Error: Could not parse fallback engine file path\n");
+      g_free (str);
+      goto done;
+    }
+    g_free (str);
+    g_free (nvinfer->fallback_engine_file_path);
+    nvinfer->fallback_engine_file_path = g_strdup (abs_path);
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_FALLBACK_BATCH_SIZE)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_FALLBACK_BATCH_SIZE, &error);
+    CHECK_ERROR (error);
+    if (val < 0) {
+      g_printerr ("Error: %s(%d) should be >= 0\n",
+          CONFIG_GROUP_INFER_FALLBACK_BATCH_SIZE, val);
+      goto done;
+    }
+    nvinfer->fallback_batch_size = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_MODEL_UPDATE_KEEP_HISTORY)) {
+    nvinfer->model_update_keep_history = g_key_file_get_boolean (key_file,
+        group_name, CONFIG_GROUP_INFER_MODEL_UPDATE_KEEP_HISTORY, &error);
+    CHECK_ERROR (error);
   } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_GIE_ID_FOR_OPERATION)) {
     if ((*nvinfer->is_prop_set)[PROP_OPERATE_ON_GIE_ID] ||
         (*nvinfer->is_prop_set)[PROP_OPERATE_ON_CLASS_IDS])
@@ -480,6 +601,87 @@ gst_nvinfer_parse_other_attribute (GstNvinfercustom * nvinfer,
         goto done;
     }
     nvinfer->transform_params.transform_filter = (NvBufSurfTransform_Inter) val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_GALLERY_FILE)) {
+    if ((*nvinfer->is_prop_set)[PROP_GALLERY_FILE])
+      return TRUE;
+    gchar abs_path[_PATH_MAX];
+    gchar *str = g_key_file_get_string (key_file, group_name,
+        CONFIG_GROUP_INFER_GALLERY_FILE, &error);
+    CHECK_ERROR (error);
+
+    if (!get_absolute_file_path (cfg_file_path, str, abs_path)) {
+      g_printerr ("Error: Could not parse gallery file path\n");
+      g_free (str);
+      goto done;
+    }
+    g_free (str);
+    g_free (nvinfer->gallery_file_path);
+    nvinfer->gallery_file_path = g_strdup (abs_path);
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_GALLERY_TOP_K)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_GALLERY_TOP_K, &error);
+    CHECK_ERROR (error);
+    if (val <= 0) {
+      g_printerr ("Error: %s(%d) should be > 0\n",
+          CONFIG_GROUP_INFER_GALLERY_TOP_K, val);
+      goto done;
+    }
+    nvinfer->gallery_top_k = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_GALLERY_MATCH_THRESHOLD)) {
+    nvinfer->gallery_match_threshold = g_key_file_get_double (key_file,
+        group_name, CONFIG_GROUP_INFER_GALLERY_MATCH_THRESHOLD, &error);
+    CHECK_ERROR (error);
+    if (nvinfer->gallery_match_threshold < -1.0 ||
+        nvinfer->gallery_match_threshold > 1.0) {
+      g_printerr ("Error: %s(%.2f) should be in the range [-1, 1]\n",
+          CONFIG_GROUP_INFER_GALLERY_MATCH_THRESHOLD,
+          nvinfer->gallery_match_threshold);
+      goto done;
+    }
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_GALLERY_IVF_LISTS)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_GALLERY_IVF_LISTS, &error);
+    CHECK_ERROR (error);
+    if (val < 0) {
+      g_printerr ("Error: %s(%d) should be >= 0\n",
+          CONFIG_GROUP_INFER_GALLERY_IVF_LISTS, val);
+      goto done;
+    }
+    nvinfer->gallery_ivf_lists = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_GALLERY_IVF_PROBES)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_GALLERY_IVF_PROBES, &error);
+    CHECK_ERROR (error);
+    if (val <= 0) {
+      g_printerr ("Error: %s(%d) should be > 0\n",
+          CONFIG_GROUP_INFER_GALLERY_IVF_PROBES, val);
+      goto done;
+    }
+    nvinfer->gallery_ivf_probes = val;
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_GALLERY_INDEX_FILE)) {
+    gchar abs_path[_PATH_MAX];
+    gchar *str = g_key_file_get_string (key_file, group_name,
+        CONFIG_GROUP_INFER_GALLERY_INDEX_FILE, &error);
+    CHECK_ERROR (error);
+
+    if (!get_absolute_file_path (cfg_file_path, str, abs_path)) {
+      g_printerr ("Error: Could not parse gallery index file path\n");
+      g_free (str);
+      goto done;
+    }
+    g_free (str);
+    g_free (nvinfer->gallery_index_file_path);
+    nvinfer->gallery_index_file_path = g_strdup (abs_path);
+  } else if (!g_strcmp0 (key, CONFIG_GROUP_INFER_GALLERY_RELOAD_INTERVAL)) {
+    gint val = g_key_file_get_integer (key_file, group_name,
+        CONFIG_GROUP_INFER_GALLERY_RELOAD_INTERVAL, &error);
+    CHECK_ERROR (error);
+    if (val < 0) {
+      g_printerr ("Error: %s(%d) should be >= 0\n",
+          CONFIG_GROUP_INFER_GALLERY_RELOAD_INTERVAL, val);
+      goto done;
+    }
+    nvinfer->gallery_reload_interval = val;
   }
 
   ret = TRUE;
@@ -638,6 +840,78 @@ gst_nvinfer_parse_props (GstNvinfercustom * nvinfer,
         g_print ("Info: workspace-size is 0, will use default size");
         init_params->workspaceSize = 0;
       }
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_WARMUP_ITERATIONS)) {
+      gint val = g_key_file_get_integer (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_WARMUP_ITERATIONS, &error);
+      CHECK_ERROR (error);
+      if (val < 0) {
+        g_printerr ("Error: %s(%d) should be >= 0\n",
+            CONFIG_GROUP_INFER_WARMUP_ITERATIONS, val);
+        goto done;
+      }
+      init_params->warmupIterations = val;
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_EXECUTION_CONTEXTS)) {
+      gint val = g_key_file_get_integer (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_EXECUTION_CONTEXTS, &error);
+      CHECK_ERROR (error);
+      if (val < 1) {
+        g_printerr ("Error: %s(%d) should be >= 1\n",
+            CONFIG_GROUP_INFER_EXECUTION_CONTEXTS, val);
+        goto done;
+      }
+      init_params->numExecutionContexts = val;
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_PROFILE_BATCH_SIZES)) {
+      gsize length, i;
+      gint *int_list = g_key_file_get_integer_list (key_file,
+          CONFIG_GROUP_PROPERTY, CONFIG_GROUP_INFER_PROFILE_BATCH_SIZES,
+          &length, &error);
+      CHECK_ERROR (error);
+
+      if (length > _MAX_OPT_PROFILES) {
+        g_printerr ("Error. Maximum  length of %d is allowed for '%s'\n",
+            _MAX_OPT_PROFILES, CONFIG_GROUP_INFER_PROFILE_BATCH_SIZES);
+        g_free (int_list);
+        goto done;
+      }
+
+      for (i = 0; i < length; i++) {
+        if (int_list[i] < 1 || (i > 0 && int_list[i] <= int_list[i - 1])) {
+          g_printerr ("Error: '%s' should be increasing batch sizes >= 1\n",
+              CONFIG_GROUP_INFER_PROFILE_BATCH_SIZES);
+          g_free (int_list);
+          goto done;
+        }
+        init_params->profileBatchSizes[i] = int_list[i];
+      }
+      init_params->numProfileBatchSizes = length;
+      g_free (int_list);
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_REPLAY_TENSORS)) {
+      gchar *str = g_key_file_get_string (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_REPLAY_TENSORS, &error);
+      CHECK_ERROR (error);
+
+      if (!get_absolute_file_path (cfg_file_path, str,
+              init_params->replayTensorsFilePath)) {
+        g_printerr ("Error: Could not parse replay tensors file path\n");
+        g_free (str);
+        goto done;
+      }
+      g_free (str);
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_REPLAY_LATENCY_US)) {
+      gint val = g_key_file_get_integer (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_REPLAY_LATENCY_US, &error);
+      CHECK_ERROR (error);
+      if (val < 0) {
+        g_printerr ("Error: %s(%d) should be >= 0\n",
+            CONFIG_GROUP_INFER_REPLAY_LATENCY_US, val);
+        goto done;
+      }
+      init_params->replayLatencyUs = val;
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_CPU_INFERENCE)) {
+      init_params->useCpuInference =
+          g_key_file_get_boolean (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_CPU_INFERENCE, &error);
+      CHECK_ERROR (error);
     } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_INFER_DIMENSIONS)) {
       gsize length;
       gint *int_list = g_key_file_get_integer_list (key_file,
@@ -685,6 +959,21 @@ gst_nvinfer_parse_props (GstNvinfercustom * nvinfer,
         goto done;
       }
       g_free (str);
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_ENGINE_CACHE_DIR)) {
+      gchar *str = g_key_file_get_string (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_ENGINE_CACHE_DIR, &error);
+      CHECK_ERROR (error);
+
+      /* The directory is created on the first build if it does not exist. */
+      if (str[0] == '/') {
+        g_strlcpy (init_params->engineCacheDir, str, _PATH_MAX);
+      } else if (!get_absolute_file_path (cfg_file_path, str,
+              init_params->engineCacheDir)) {
+        g_printerr ("Error: Could not parse engine cache dir path\n");
+        g_free (str);
+        goto done;
+      }
+      g_free (str);
     } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_INT8_CALIBRATION_FILE)) {
       gchar *str = g_key_file_get_string (key_file, CONFIG_GROUP_PROPERTY,
           CONFIG_GROUP_INFER_INT8_CALIBRATION_FILE, &error);
@@ -705,6 +994,18 @@ gst_nvinfer_parse_props (GstNvinfercustom * nvinfer,
       init_params->numOutputLayers = length;
 
       CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_OUTPUT_INT8_SCALE)) {
+      init_params->outputInt8Scale =
+          g_key_file_get_double (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_OUTPUT_INT8_SCALE, &error);
+      CHECK_ERROR (error);
+
+      if (init_params->outputInt8Scale <= 0) {
+        g_printerr ("Error: %s(%f) should be > 0\n",
+            CONFIG_GROUP_INFER_OUTPUT_INT8_SCALE,
+            init_params->outputInt8Scale);
+        goto done;
+      }
     } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_NETWORK_TYPE)) {
       guint val = g_key_file_get_integer (key_file, CONFIG_GROUP_PROPERTY,
           CONFIG_GROUP_INFER_NETWORK_TYPE, &error);
@@ -714,6 +1015,7 @@ gst_nvinfer_parse_props (GstNvinfercustom * nvinfer,
         case NvDsInferNetworkType_Detector:
         case NvDsInferNetworkType_Classifier:
         case NvDsInferNetworkType_Segmentation:
+        case NvDsInferNetworkType_Embedding:
         case NvDsInferNetworkType_Other:
           init_params->networkType = (NvDsInferNetworkType) val;
           break;
@@ -1005,6 +1307,27 @@ gst_nvinfer_parse_props (GstNvinfercustom * nvinfer,
             init_params->segmentationThreshold);
         goto done;
       }
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_SEGMENTATION_CLASS_MAP_U8)) {
+      init_params->segmentationClassMapU8 =
+          g_key_file_get_boolean (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_SEGMENTATION_CLASS_MAP_U8, &error);
+      CHECK_ERROR (error);
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_SEGMENTATION_THREADS)) {
+      gint val = g_key_file_get_integer (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_SEGMENTATION_THREADS, &error);
+      CHECK_ERROR (error);
+
+      if (val < 0) {
+        g_printerr ("Error: Negative value specified for %s(%d)\n",
+            CONFIG_GROUP_INFER_SEGMENTATION_THREADS, val);
+        goto done;
+      }
+      init_params->segmentationThreads = val;
+    } else if (!g_strcmp0 (*key, CONFIG_GROUP_INFER_EMBEDDING_INT8)) {
+      init_params->embeddingInt8 =
+          g_key_file_get_boolean (key_file, CONFIG_GROUP_PROPERTY,
+          CONFIG_GROUP_INFER_EMBEDDING_INT8, &error);
+      CHECK_ERROR (error);
     } else if (nvinfer) {
       if (!gst_nvinfer_parse_other_attribute (
           nvinfer, key_file, CONFIG_GROUP_PROPERTY, *key, cfg_file_path)) {
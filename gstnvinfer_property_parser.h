@@ -46,11 +46,19 @@
 #define CONFIG_GROUP_INFER_BATCH_SIZE "batch-size"
 #define CONFIG_GROUP_INFER_NETWORK_MODE "network-mode"
 #define CONFIG_GROUP_INFER_MODEL_ENGINE "model-engine-file"
+#define CONFIG_GROUP_INFER_ENGINE_CACHE_DIR "engine-cache-dir"
 #define CONFIG_GROUP_INFER_INT8_CALIBRATION_FILE "int8-calib-file"
 #define CONFIG_GROUP_INFER_WORKSPACE_SIZE "workspace-size"
+#define CONFIG_GROUP_INFER_WARMUP_ITERATIONS "warmup-iterations"
+#define CONFIG_GROUP_INFER_EXECUTION_CONTEXTS "execution-contexts"
+#define CONFIG_GROUP_INFER_PROFILE_BATCH_SIZES "profile-batch-sizes"
+#define CONFIG_GROUP_INFER_REPLAY_TENSORS "replay-tensors"
+#define CONFIG_GROUP_INFER_REPLAY_LATENCY_US "replay-latency-us"
+#define CONFIG_GROUP_INFER_CPU_INFERENCE "cpu-inference"
 
 /** Generic model parameters. */
 #define CONFIG_GROUP_INFER_OUTPUT_BLOB_NAMES "output-blob-names"
+#define CONFIG_GROUP_INFER_OUTPUT_INT8_SCALE "output-int8-scale"
 #define CONFIG_GROUP_INFER_IS_CLASSIFIER_LEGACY "is-classifier"
 #define CONFIG_GROUP_INFER_NETWORK_TYPE "network-type"
 #define CONFIG_GROUP_INFER_FORCE_IMPLICIT_BATCH_DIM "force-implicit-batch-dim"
@@ -100,6 +108,18 @@
 
 /** Segmentaion specific parameters. */
 #define CONFIG_GROUP_INFER_SEGMENTATION_THRESHOLD "segmentation-threshold"
+#define CONFIG_GROUP_INFER_SEGMENTATION_CLASS_MAP_U8 "segmentation-class-map-u8"
+#define CONFIG_GROUP_INFER_SEGMENTATION_THREADS "segmentation-threads"
+
+/** Embedding specific parameters. */
+#define CONFIG_GROUP_INFER_EMBEDDING_INT8 "embedding-int8"
+#define CONFIG_GROUP_INFER_GALLERY_FILE "gallery-file"
+#define CONFIG_GROUP_INFER_GALLERY_TOP_K "gallery-top-k"
+#define CONFIG_GROUP_INFER_GALLERY_MATCH_THRESHOLD "gallery-match-threshold"
+#define CONFIG_GROUP_INFER_GALLERY_IVF_LISTS "gallery-ivf-lists"
+#define CONFIG_GROUP_INFER_GALLERY_IVF_PROBES "gallery-ivf-probes"
+#define CONFIG_GROUP_INFER_GALLERY_INDEX_FILE "gallery-index-file"
+#define CONFIG_GROUP_INFER_GALLERY_RELOAD_INTERVAL "gallery-reload-interval"
 
 /** Parameters for filtering objects based min/max size threshold when
     operating in secondary mode. */
@@ -108,6 +128,33 @@
 #define CONFIG_GROUP_INFER_INPUT_OBJECT_MAX_WIDTH "input-object-max-width"
 #define CONFIG_GROUP_INFER_INPUT_OBJECT_MAX_HEIGHT "input-object-max-height"
 
+/** Parameters for slicing full frames into overlapping tiles, each inferred
+    as a separate batch entry. Only used by full-frame detectors. */
+#define CONFIG_GROUP_INFER_TILE_COLUMNS "tile-columns"
+#define CONFIG_GROUP_INFER_TILE_ROWS "tile-rows"
+#define CONFIG_GROUP_INFER_TILE_OVERLAP "tile-overlap"
+#define CONFIG_GROUP_INFER_TILE_INCLUDE_FULL_FRAME "tile-include-full-frame"
+#define CONFIG_GROUP_INFER_TILE_MERGE_THRESHOLD "tile-merge-threshold"
+
+/** Parameters for skipping static frames of a source. Only used by
+    full-frame detectors. */
+#define CONFIG_GROUP_INFER_MOTION_THRESHOLD "motion-threshold"
+#define CONFIG_GROUP_INFER_MOTION_PIXEL_DELTA "motion-pixel-delta"
+#define CONFIG_GROUP_INFER_MOTION_MAX_STALE_FRAMES "motion-max-stale-frames"
+
+/** Parameters for the per-source adaptive interval. Only used by full-frame
+    detectors. */
+#define CONFIG_GROUP_INFER_ADAPTIVE_INTERVAL_MAX "adaptive-interval-max"
+#define CONFIG_GROUP_INFER_ADAPTIVE_INTERVAL_BUSY_OBJECTS "adaptive-interval-busy-objects"
+
+/** Parameters for serving from a fallback engine while the engine for the
+    config is built in the background. */
+#define CONFIG_GROUP_INFER_FALLBACK_ENGINE "fallback-engine-file"
+#define CONFIG_GROUP_INFER_FALLBACK_BATCH_SIZE "fallback-batch-size"
+
+/** Runtime model update parameters. */
+#define CONFIG_GROUP_INFER_MODEL_UPDATE_KEEP_HISTORY "model-update-keep-history"
+
 /** Parameters for filtering objects based on class-id and unique id of the
     detector when operating in secondary mode. */
 #define CONFIG_GROUP_INFER_GIE_ID_FOR_OPERATION "operate-on-gie-id"
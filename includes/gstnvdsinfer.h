@@ -115,8 +115,76 @@ typedef struct
   gfloat *class_probabilities_map;
   /** Private data used for the meta producer's internal memory management. */
   void *priv_data;
+  /** Pointer to the 2D pixel class map with one byte per pixel, used instead
+   * of class_map (which is then NULL) when "segmentation-class-map-u8" is
+   * set. Pixels without a class are 255. */
+  guint8 *class_map_u8;
 } NvDsInferSegmentationMeta;
 
+/**
+ * User meta type of NvDsInferEmbeddingMeta. The type is registered at runtime
+ * through nvds_get_user_meta_type() and requires nvdsmeta.h.
+ */
+#define NVDSINFER_EMBEDDING_META \
+  (nvds_get_user_meta_type ((gchar *) "NVIDIA.NVINFER.EMBEDDING_META"))
+
+/**
+ * Holds the embedding model output for one frame / one object.
+ * The "nvinfer" plugin adds this meta for embedding models. This meta data is
+ * added as NvDsUserMeta to the frame_user_meta_list of the corresponding
+ * frame_meta or object_user_meta_list of the corresponding object with the
+ * meta_type set to NVDSINFER_EMBEDDING_META.
+ */
+typedef struct
+{
+  /** Unique ID of the gst-nvinfer instance which attached this meta. */
+  guint unique_id;
+  /** Number of elements in the embedding. */
+  guint dims;
+  /** Pointer to the L2-normalized embedding. The vector is not copied; it
+   * points into the inference output buffer which is kept alive by
+   * priv_data until the meta is released. */
+  gfloat *embedding;
+  /** L2 norm of the embedding before normalization. */
+  gfloat norm;
+  /** Pointer to the int8 quantized L2-normalized embedding when the
+   * "embedding-int8" config key is set, NULL otherwise. Like embedding, it
+   * points into the batch output kept alive by priv_data. Element i of the
+   * normalized embedding is approximately scale * embedding_int8[i], the
+   * quantization changes cosine similarities by at most about 2e-3. */
+  gint8 *embedding_int8;
+  /** Quantization scale of embedding_int8. */
+  gfloat scale;
+  /** Private data used for the meta producer's internal memory management. */
+  void *priv_data;
+} NvDsInferEmbeddingMeta;
+
+/**
+ * User meta type of NvDsInferLandmarksMeta. The type is registered at runtime
+ * through nvds_get_user_meta_type() and requires nvdsmeta.h.
+ */
+#define NVDSINFER_LANDMARKS_META \
+  (nvds_get_user_meta_type ((gchar *) "NVIDIA.NVINFER.LANDMARKS_META"))
+
+/**
+ * Holds the keypoints of one detected object, e.g. the eyes, nose and mouth
+ * corners of a face.
+ * The "nvinfer" plugin adds this meta for detectors whose custom parser
+ * outputs landmarks (see NvDsInferParseCustomWithLandmarksFunc). This meta
+ * data is added as NvDsUserMeta to the object_user_meta_list of the detected
+ * object with the meta_type set to NVDSINFER_LANDMARKS_META.
+ */
+typedef struct
+{
+  /** Unique ID of the gst-nvinfer instance which attached this meta. */
+  guint unique_id;
+  /** Number of keypoints. */
+  guint num_landmarks;
+  /** Pointer to num_landmarks (x, y) pairs in frame coordinates, i.e. in
+   * the same coordinates as the rect_params of the object. */
+  gfloat *landmarks;
+} NvDsInferLandmarksMeta;
+
 G_END_DECLS
 
 /** @} */
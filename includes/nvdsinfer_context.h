@@ -105,6 +105,10 @@
 /** Defines the maximum batch size supported by nvdsinfer. */
 #define NVDSINFER_MAX_BATCH_SIZE 1024
 
+/** Defines the maximum number of optimization profiles built into an engine
+ for full dimensions networks. */
+#define _MAX_OPT_PROFILES 8
+
 /** Defines the minimum number of sets of output buffers that must be
  allocated. */
 #define NVDSINFER_MIN_OUTPUT_BUFFERPOOL_SIZE 2
@@ -133,6 +137,10 @@ typedef enum
     /** Specifies a segmentation network. A segmentation network classifies
      each pixel into one of several classes. */
     NvDsInferNetworkType_Segmentation,
+    /** Specifies an embedding network. The output layer of an embedding
+     network is a feature vector (e.g. a face descriptor) which is
+     L2-normalized and passed on as-is, without any class parsing. */
+    NvDsInferNetworkType_Embedding,
     /** Specifies other. Output layers of an "other" network are not parsed by
      NvDsInferContext. This is useful for networks that produce custom output.
      Output can be parsed by the NvDsInferContext client or can be combined
@@ -366,6 +374,64 @@ typedef struct _NvDsInferContextInitParams
 
     /** Holds the type of clustering mode */
     NvDsInferClusterMode clusterMode;
+
+    /** Holds a Boolean; true if embeddings are quantized to int8 with a
+     per-vector scale. Valid for embedding networks only. */
+    int embeddingInt8;
+
+    /** Holds a Boolean; true if the segmentation class map is stored with
+     one byte per pixel. Requires fewer than 256 classes. */
+    int segmentationClassMapU8;
+
+    /** Holds the number of host threads computing the segmentation class map,
+     the calling thread included. Defaults to 1, 0 uses every hardware
+     thread. */
+    unsigned int segmentationThreads;
+
+    /** Holds the scale of INT8 output tensors (dynamic range / 127) used by
+     the built-in parsers. 0 means 1.0. */
+    float outputInt8Scale;
+
+    /** Holds the pathname of a directory caching the built engines, keyed by
+     a hash of the model files and of the build parameters. Engines found
+     in it are used without rebuilding. */
+    char engineCacheDir[_PATH_MAX];
+
+    /** Holds a Boolean; true if the context may only be created from a
+     serialized engine (model engine file or engine cache). Initialization
+     fails instead of building the engine from the model files. */
+    int loadEngineOnly;
+
+    /** Holds the number of synthetic batches inferred at each warm-up batch
+     size before the context is reported ready. 0 disables warm-up. */
+    unsigned int warmupIterations;
+
+    /** Holds the number of TensorRT execution contexts created on the engine.
+     Batches are dispatched to the least loaded one so that consecutive
+     batches overlap on the GPU. 0 or 1 uses a single context. */
+    unsigned int numExecutionContexts;
+
+    /** Holds the batch sizes for which optimization profiles are built into
+     full dimensions engines, in increasing order. Each batch is inferred with
+     the smallest profile it fits in. The max batch size always gets a
+     profile. */
+    unsigned int profileBatchSizes[_MAX_OPT_PROFILES];
+    unsigned int numProfileBatchSizes;
+
+    /** Holds the pathname of the layers file written with the raw output
+     tensor dumps of gst-nvinfer (gstnvdsinfer_uid-XX_layers.txt). If set, no
+     model is loaded and the recorded output tensors next to it are replayed
+     round-robin instead of inferring, in host memory without a GPU. */
+    char replayTensorsFilePath[_PATH_MAX];
+
+    /** Holds the simulated inference latency of a replayed batch in
+     microseconds. */
+    unsigned int replayLatencyUs;
+
+    /** Holds a Boolean; true if the ONNX model (onnxFilePath) is to be
+     inferred on the CPU with OpenCV DNN instead of TensorRT. inferInputDims
+     must be set. */
+    int useCpuInference;
 } NvDsInferContextInitParams;
 
 /**
@@ -417,6 +483,12 @@ typedef struct
     char *label;
     /* confidence score of the detected object. */
     float confidence;
+    /** Holds a pointer to @a numLandmarks (x, y) keypoints of the object in
+     network input coordinates, or NULL. Only set by custom parsers which
+     output landmarks. */
+    float *landmarks;
+    /** Holds the number of keypoints in @a landmarks. */
+    unsigned int numLandmarks;
 } NvDsInferObject;
 
 /**
@@ -460,14 +532,43 @@ typedef struct
     /** Holds the number of classes supported by the network. */
     unsigned int classes;
     /** Holds a pointer to an array for the 2D pixel class map.
-     The output for pixel (x,y) is at index (y*width+x). */
+     The output for pixel (x,y) is at index (y*width+x). NULL if
+     @a class_map_u8 is used. */
     int *class_map;
     /** Holds a pointer to an array containing raw probabilities.
      The probability for class @a c and pixel (x,y) is at index
      (c*width*height + y*width+x). */
     float *class_probability_map;
+    /** Holds a pointer to the 2D pixel class map with one byte per pixel if
+     @ref NvDsInferContextInitParams::segmentationClassMapU8 is set, NULL
+     otherwise. Pixels without a class are 255. */
+    uint8_t *class_map_u8;
 } NvDsInferSegmentationOutput;
 
+/**
+ * Holds the embedding vector produced by an embedding network for one frame
+ * or object.
+ */
+typedef struct
+{
+    /** Holds the number of elements in @a embedding. */
+    unsigned int dims;
+    /** Holds a pointer to the L2-normalized embedding. It points into the
+     host output buffer of the batch and is valid until the batch output is
+     released with releaseBatchOutput(). */
+    float *embedding;
+    /** Holds the L2 norm of the raw network output before normalization. */
+    float norm;
+    /** Holds a pointer to the int8 quantized L2-normalized embedding if
+     @ref NvDsInferContextInitParams::embeddingInt8 is set, NULL otherwise.
+     It points into a buffer of the batch, which stays valid like
+     @a embedding. The host output buffers keep the float embedding. */
+    int8_t *embeddingInt8;
+    /** Holds the quantization scale: element i of the normalized embedding
+     is approximately scale * embeddingInt8[i]. */
+    float scale;
+} NvDsInferEmbeddingOutput;
+
 /**
  * Holds the information inferred by the network on one frame.
  */
@@ -490,6 +591,9 @@ typedef struct
         /** Holds classifier output. Valid when @a outputType is
          @ref NvDsInferNetworkType_Classifier. */
         NvDsInferSegmentationOutput segmentationOutput;
+        /** Holds embedding output. Valid when @a outputType is
+         @ref NvDsInferNetworkType_Embedding. */
+        NvDsInferEmbeddingOutput embeddingOutput;
     };
 } NvDsInferFrameOutput;
 
@@ -516,6 +620,10 @@ typedef struct
     /** Holds the number of elements in hostBuffers. */
     unsigned int numHostBuffers;
 
+    /** Holds the index of the engine optimization profile the batch was
+     inferred with. */
+    int profileIndex;
+
     /** Holds a private context pointer for the set of output buffers. */
     void* priv;
 } NvDsInferContextBatchOutput;
@@ -41,6 +41,29 @@
  * You can call the macro CHECK_CUSTOM_PARSE_FUNC_PROTOTYPE() after
  * defining the function to validate the function definition.
  *
+ * A parser which needs state (cached layer indices, lookup tables, scratch
+ * buffers) must not keep it in globals or function-local statics: several
+ * contexts, possibly with different models, can run in one process. Such a
+ * parser can additionally export, for a `parse-bbox-func-name` of `<name>`:
+ * - `<name>CreateContext` of type `NvDsInferParseCustomCreateContextFunc`
+ * - `<name>WithContext` of type `NvDsInferParseCustomWithContextFunc`
+ * - `<name>DestroyContext` of type `NvDsInferParseCustomDestroyContextFunc`
+ *
+ * If all three are exported, Gst-nvinfer creates one parser context per
+ * inference context at initialization, passes it to every `<name>WithContext`
+ * call and destroys it with the inference context; `<name>` itself is then
+ * not called. Contexts are never shared between inference contexts. The
+ * macro CHECK_CUSTOM_PARSE_CONTEXT_FUNC_PROTOTYPES() validates the three
+ * definitions.
+ *
+ * A context parser for models with keypoints (e.g. face detectors with eye,
+ * nose and mouth landmarks) can also export `<name>WithLandmarks` of type
+ * `NvDsInferParseCustomWithLandmarksFunc`, which is then called instead of
+ * `<name>WithContext`. The keypoints of each object are kept through NMS
+ * clustering (or without clustering) and attached by Gst-nvinfer as object
+ * user meta of type NVDSINFER_LANDMARKS_META. They are dropped for the
+ * other cluster modes, which merge boxes.
+ *
  *
  * @section iplugininterface TensorRT Plugin Factory interface for DeepStream
  *
@@ -238,6 +261,89 @@ typedef bool (* NvDsInferParseCustomFunc) (
            NvDsInferParseDetectionParams const &detectionParams, \
            std::vector<NvDsInferObjectDetectionInfo> &objectList);
 
+/**
+ * Type definition for the function creating the per-context state of a
+ * custom bounding box parser. Called once when the inference context is
+ * initialized, output layer buffers are not valid yet.
+ *
+ * @param[in]  outputLayersInfo A vector containing information on the output
+ *                              layers of the model.
+ * @param[in]  networkInfo      Network information.
+ * @param[in]  detectionParams  Detection parameters required for parsing
+ *                              objects.
+ * @param[out] context          Set to the parser state, passed to the parse
+ *                              and destroy functions.
+ * @return true on success. The inference context fails to initialize
+ *         otherwise.
+ */
+typedef bool (* NvDsInferParseCustomCreateContextFunc) (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context);
+
+/**
+ * Type definition for the custom bounding box parsing function with a
+ * per-context state. Same as NvDsInferParseCustomFunc, with the @a context
+ * created by the NvDsInferParseCustomCreateContextFunc of the library.
+ */
+typedef bool (* NvDsInferParseCustomWithContextFunc) (
+        void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+/**
+ * Type definition for the function destroying a custom bounding box parser
+ * context.
+ */
+typedef void (* NvDsInferParseCustomDestroyContextFunc) (void *context);
+
+/**
+ * Type definition for the custom bounding box parsing function with a
+ * per-context state which also outputs keypoints for each object. Same as
+ * NvDsInferParseCustomWithContextFunc, with:
+ *
+ * @param[out] landmarks     A reference to a vector in which the function
+ *                           is to add @a numLandmarks (x, y) keypoints per
+ *                           object, in network input coordinates and in the
+ *                           order of @a objectList.
+ * @param[out] numLandmarks  Set to the number of keypoints per object.
+ */
+typedef bool (* NvDsInferParseCustomWithLandmarksFunc) (
+        void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList,
+        std::vector<float> &landmarks,
+        unsigned int &numLandmarks);
+
+/**
+ * Validates the definitions of the context functions of a custom parser.
+ * Must be called after defining the functions.
+ */
+#define CHECK_CUSTOM_PARSE_CONTEXT_FUNC_PROTOTYPES(customParseFunc) \
+    static void checkFunc_ ## customParseFunc ## CreateContext ( \
+        NvDsInferParseCustomCreateContextFunc func = customParseFunc ## CreateContext) \
+        { checkFunc_ ## customParseFunc ## CreateContext (); }; \
+    static void checkFunc_ ## customParseFunc ## WithContext ( \
+        NvDsInferParseCustomWithContextFunc func = customParseFunc ## WithContext) \
+        { checkFunc_ ## customParseFunc ## WithContext (); }; \
+    static void checkFunc_ ## customParseFunc ## DestroyContext ( \
+        NvDsInferParseCustomDestroyContextFunc func = customParseFunc ## DestroyContext) \
+        { checkFunc_ ## customParseFunc ## DestroyContext (); };
+
+/**
+ * Validates the definition of the landmarks variant of a custom parser.
+ * Must be called after defining the function.
+ */
+#define CHECK_CUSTOM_PARSE_LANDMARKS_FUNC_PROTOTYPE(customParseFunc) \
+    static void checkFunc_ ## customParseFunc ## WithLandmarks ( \
+        NvDsInferParseCustomWithLandmarksFunc func = customParseFunc ## WithLandmarks) \
+        { checkFunc_ ## customParseFunc ## WithLandmarks (); };
+
 /**
  * Type definition for the custom classifier output parsing function.
  *
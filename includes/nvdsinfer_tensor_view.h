@@ -0,0 +1,262 @@
+/**
+ * Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+/**
+ * @file nvdsinfer_tensor_view.h
+ * <b>NVIDIA DeepStream typed views over inference output tensors </b>
+ *
+ * @b Description: This file defines a read-only view over the host buffer of
+ * an output layer which reads FLOAT, HALF, INT8 and INT32 elements as float,
+ * so output parsers can be written once for engines with FP32, FP16 or INT8
+ * outputs. Keeping FP16 outputs halves the device to host copy compared with
+ * adding an FP32 conversion layer to the network.
+ *
+ * Bulk conversions use F16C (x86, enable with -mf16c) or NEON (aarch64)
+ * when available. FLOAT tensors are read in place without conversion.
+ *
+ * It also provides NvDsInferScanThreshold, a SIMD scan of a score plane for
+ * the cells above a threshold, so grid decoders only decode the hits.
+ */
+
+#ifndef __NVDSINFER_TENSOR_VIEW_H__
+#define __NVDSINFER_TENSOR_VIEW_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__F16C__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "nvdsinfer.h"
+
+/**
+ * Converts an IEEE 754 half-precision value to float. The conversion is
+ * exact, including subnormals and infinities, and matches F16C.
+ */
+inline float
+NvDsInferHalfToFloat(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0x1f)
+    {
+        /* NaNs are quieted, as by F16C. */
+        bits = sign | 0x7f800000 | (mantissa << 13);
+        if (mantissa)
+            bits |= 0x00400000;
+    }
+    else if (exponent)
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa)
+    {
+        /* Subnormal half, normal float. */
+        exponent = 113;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    else
+    {
+        bits = sign;
+    }
+
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/**
+ * Converts @a n half-precision values to float.
+ */
+inline void
+NvDsInferHalfToFloatN(const uint16_t* src, float* dst, size_t n)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i h = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= n; i += 4)
+    {
+        float16x4_t h = vreinterpret_f16_u16(vld1_u16(src + i));
+        vst1q_f32(dst + i, vcvt_f32_f16(h));
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] = NvDsInferHalfToFloat(src[i]);
+}
+
+/**
+ * Converts @a n int8 values to float, multiplied by @a scale.
+ */
+inline void
+NvDsInferInt8ToFloatN(const int8_t* src, float* dst, float scale, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256 vscale = _mm256_set1_ps(scale);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i q = _mm_loadl_epi64((const __m128i*)(src + i));
+        __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(q));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(f, vscale));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t vscale = vdupq_n_f32(scale);
+    for (; i + 8 <= n; i += 8)
+    {
+        int16x8_t q = vmovl_s8(vld1_s8(src + i));
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(q)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(q)));
+        vst1q_f32(dst + i, vmulq_f32(lo, vscale));
+        vst1q_f32(dst + i + 4, vmulq_f32(hi, vscale));
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] = src[i] * scale;
+}
+
+/**
+ * Appends to @a hits the indices in [0, @a n) of the elements of @a p which
+ * are greater than or equal to @a threshold, in increasing order. NaNs are
+ * never hits. Returns the number of indices appended.
+ */
+inline size_t
+NvDsInferScanThreshold(const float* p, size_t n, float threshold,
+    std::vector<uint32_t>& hits)
+{
+    size_t start = hits.size();
+    size_t i = 0;
+#if defined(__AVX__)
+    __m256 vt = _mm256_set1_ps(threshold);
+    for (; i + 8 <= n; i += 8)
+    {
+        unsigned int mask = _mm256_movemask_ps(
+            _mm256_cmp_ps(_mm256_loadu_ps(p + i), vt, _CMP_GE_OQ));
+        for (; mask; mask &= mask - 1)
+            hits.push_back(i + __builtin_ctz(mask));
+    }
+#elif defined(__SSE2__)
+    __m128 vt = _mm_set1_ps(threshold);
+    for (; i + 4 <= n; i += 4)
+    {
+        unsigned int mask =
+            _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(p + i), vt));
+        for (; mask; mask &= mask - 1)
+            hits.push_back(i + __builtin_ctz(mask));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t vt = vdupq_n_f32(threshold);
+    for (; i + 4 <= n; i += 4)
+    {
+        /* Most cells are below threshold, skip those vectors quickly. */
+        if (!vmaxvq_u32(vcgeq_f32(vld1q_f32(p + i), vt)))
+            continue;
+        for (size_t j = i; j < i + 4; j++)
+            if (p[j] >= threshold)
+                hits.push_back(j);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        if (p[i] >= threshold)
+            hits.push_back(i);
+    }
+    return hits.size() - start;
+}
+
+/**
+ * Read-only view of an output layer buffer as float elements.
+ *
+ * INT8 elements are multiplied by the int8 scale of the view, i.e. the
+ * dynamic range of the tensor divided by 127. INT32 elements are converted
+ * without scaling.
+ */
+class NvDsInferTensorView
+{
+public:
+    NvDsInferTensorView(const NvDsInferLayerInfo& layer, float int8Scale = 1.0f)
+        : m_Buffer(layer.buffer), m_DataType(layer.dataType),
+          m_Size(layer.inferDims.numElements), m_Int8Scale(int8Scale) {}
+
+    NvDsInferDataType dataType() const { return m_DataType; }
+    size_t size() const { return m_Size; }
+
+    /** Returns true if the elements are stored as float and can be used in
+     * place. */
+    bool isFloat() const { return m_DataType == FLOAT; }
+
+    /** Reads element @a i as float. */
+    float operator[](size_t i) const
+    {
+        switch (m_DataType)
+        {
+            case HALF:
+                return NvDsInferHalfToFloat(((const uint16_t*)m_Buffer)[i]);
+            case INT8:
+                return ((const int8_t*)m_Buffer)[i] * m_Int8Scale;
+            case INT32:
+                return (float)((const int32_t*)m_Buffer)[i];
+            case FLOAT:
+            default:
+                return ((const float*)m_Buffer)[i];
+        }
+    }
+
+    /** Returns elements [offset, offset + n) as float. FLOAT tensors are
+     * returned in place, other types are converted into @a scratch, which
+     * must hold at least n floats. */
+    const float* read(size_t offset, size_t n, float* scratch) const
+    {
+        switch (m_DataType)
+        {
+            case HALF:
+                NvDsInferHalfToFloatN(
+                    (const uint16_t*)m_Buffer + offset, scratch, n);
+                return scratch;
+            case INT8:
+                NvDsInferInt8ToFloatN(
+                    (const int8_t*)m_Buffer + offset, scratch, m_Int8Scale, n);
+                return scratch;
+            case INT32:
+                for (size_t i = 0; i < n; i++)
+                    scratch[i] = (float)((const int32_t*)m_Buffer)[offset + i];
+                return scratch;
+            case FLOAT:
+            default:
+                return (const float*)m_Buffer + offset;
+        }
+    }
+
+private:
+    const void* m_Buffer;
+    NvDsInferDataType m_DataType;
+    size_t m_Size;
+    float m_Int8Scale;
+};
+
+#endif
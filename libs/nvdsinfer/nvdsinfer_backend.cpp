@@ -9,13 +9,18 @@
  *
  */
 
+#include <dirent.h>
 #include <dlfcn.h>
 #include <unistd.h>
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <sstream>
+#include <thread>
 
 #include <NvInfer.h>
 #include <NvInferRuntime.h>
@@ -93,6 +98,18 @@ CudaHostBuffer::~CudaHostBuffer()
     }
 }
 
+SysMemBuffer::SysMemBuffer(size_t size) : CudaBuffer(size)
+{
+    m_Buf = calloc(1, size);
+    if (m_Buf == nullptr)
+        dsInferError("Failed to allocate %zu bytes of system memory", size);
+}
+
+SysMemBuffer::~SysMemBuffer()
+{
+    free(m_Buf);
+}
+
 TrtBackendContext::TrtBackendContext(
     UniquePtrWDestroy<nvinfer1::IExecutionContext>&& ctx,
     std::shared_ptr<TrtEngine> engine)
@@ -121,7 +138,7 @@ TrtBackendContext::getNumBoundLayers()
 {
     assert(m_CudaEngine);
     assert(!m_AllLayers.empty());
-    assert((int)m_AllLayers.size() == (*m_CudaEngine)->getNbBindings());
+    assert((int)m_AllLayers.size() == m_CudaEngine->getNbBindingsPerProfile());
     return m_AllLayers.size();
 }
 
@@ -294,6 +311,18 @@ ImplicitTrtBackendContext::enqueueBuffer(
     return NVDSINFER_SUCCESS;
 }
 
+/* Implicit batch engines can run any number of execution contexts at the same
+ * time. DLA executions are serialized, extra contexts would only add memory. */
+std::unique_ptr<BackendContext>
+ImplicitTrtBackendContext::createConcurrentContext()
+{
+    assert(m_CudaEngine);
+    if (m_CudaEngine->hasDla())
+        return nullptr;
+
+    return createBackendContext(m_CudaEngine);
+}
+
 std::mutex TrtBackendContext::sDLAExecutionMutex;
 
 DlaImplicitTrtBackendContext::DlaImplicitTrtBackendContext(
@@ -358,15 +387,65 @@ FullDimTrtBackendContext::initialize()
         "Failed to get fullDimLayersInfo of profile idx:%d ", m_ProfileIndex);
 
     /* Set optimal dims as binding dims for all input layers. */
-    for (int i = 0; i < (int)(*m_CudaEngine)->getNbBindings(); i++)
+    RETURN_NVINFER_ERROR(setOptBindingDims(*m_Context, m_ProfileIndex),
+        "Failed to initialize fulldim backend of profile idx:%d",
+        m_ProfileIndex);
+
+    int bindingOffset = m_ProfileIndex * m_CudaEngine->getNbBindingsPerProfile();
+    for (int i = 0; i < (int)m_AllLayers.size(); ++i)
+    {
+        NvDsInferBatchDimsLayerInfo& layerInfo = m_AllLayers.at(i);
+
+        nvinfer1::Dims fullInferDims =
+            m_Context->getBindingDimensions(bindingOffset + i);
+        assert(!hasWildcard(fullInferDims));
+
+        NvDsInferDims inferDims = {0};
+        int batchSize = 0;
+
+        /* Split the full dims recieved from getBindingDimensions into batchSize
+         * and rest of the dims. */
+        SplitFullDims(fullInferDims, inferDims, batchSize);
+        layerInfo.inferDims = inferDims;
+    }
+
+    const NvDsInferBatchDimsLayerInfo& input = m_AllLayers[INPUT_LAYER_INDEX];
+    m_Profiles.push_back({m_ProfileIndex,
+        input.profileDims[kSELECTOR_MIN].batchSize,
+        input.profileDims[kSELECTOR_MAX].batchSize, m_Context.get()});
+
+    /* Each other profile of the engine needs its own execution context. DLA
+     * engines always infer at the max batch size, a single profile is used. */
+    if (m_CudaEngine->hasDla())
+        return NVDSINFER_SUCCESS;
+
+    for (int i = 0; i < (*m_CudaEngine)->getNbOptimizationProfiles(); ++i)
+    {
+        if (i == m_ProfileIndex)
+            continue;
+        RETURN_NVINFER_ERROR(addProfileContext(i),
+            "Failed to create context for profile idx:%d", i);
+    }
+
+    return NVDSINFER_SUCCESS;
+}
+
+/* Set optimal dims of the profile as binding dims for all input layers. */
+NvDsInferStatus
+FullDimTrtBackendContext::setOptBindingDims(
+    nvinfer1::IExecutionContext& context, int profileIdx)
+{
+    int numBindings = m_CudaEngine->getNbBindingsPerProfile();
+    int bindingOffset = profileIdx * numBindings;
+    for (int i = 0; i < numBindings; i++)
     {
         if (!(*m_CudaEngine)->bindingIsInput(i))
             continue;
 
         nvinfer1::Dims optDims = (*m_CudaEngine)
-                                     ->getProfileDimensions(i, m_ProfileIndex,
+                                     ->getProfileDimensions(i, profileIdx,
                                          nvinfer1::OptProfileSelector::kOPT);
-        if (!m_Context->setBindingDimensions(i, optDims))
+        if (!context.setBindingDimensions(bindingOffset + i, optDims))
         {
             dsInferError(
                 "Failed to initialize fulldim backend when seting "
@@ -376,7 +455,7 @@ FullDimTrtBackendContext::initialize()
         }
     }
 
-    if (!m_Context->allInputDimensionsSpecified())
+    if (!context.allInputDimensionsSpecified())
     {
         dsInferError(
             "Failed to initialize fulldims context, check any input dims is "
@@ -384,23 +463,80 @@ FullDimTrtBackendContext::initialize()
         return NVDSINFER_TENSORRT_ERROR;
     }
 
+    return NVDSINFER_SUCCESS;
+}
+
+/* Create an execution context for another optimization profile and extend
+ * the batch range of the input layers with the range of that profile. */
+NvDsInferStatus
+FullDimTrtBackendContext::addProfileContext(int profileIdx)
+{
+    UniquePtrWDestroy<nvinfer1::IExecutionContext> context(
+        (*m_CudaEngine)->createExecutionContext());
+    if (!context)
+    {
+        dsInferError("create TRT cuda executionContext failed");
+        return NVDSINFER_TENSORRT_ERROR;
+    }
+    if (!context->setOptimizationProfile(profileIdx))
+    {
+        dsInferError("Failed to setOptimizationProfile with idx:%d ",
+            profileIdx);
+        return NVDSINFER_INVALID_PARAMS;
+    }
+    RETURN_NVINFER_ERROR(setOptBindingDims(*context, profileIdx),
+        "Failed to initialize fulldim backend of profile idx:%d", profileIdx);
+
+    std::vector<NvDsInferBatchDimsLayerInfo> layers;
+    RETURN_NVINFER_ERROR(
+        m_CudaEngine->getFullDimsLayersInfo(profileIdx, layers),
+        "Failed to get fullDimLayersInfo of profile idx:%d ", profileIdx);
+    assert(layers.size() == m_AllLayers.size());
+
     for (int i = 0; i < (int)m_AllLayers.size(); ++i)
     {
-        NvDsInferBatchDimsLayerInfo& layerInfo = m_AllLayers.at(i);
+        if (!m_AllLayers[i].isInput)
+            continue;
+        NvDsInferBatchDims* dims = m_AllLayers[i].profileDims;
+        dims[kSELECTOR_MIN].batchSize =
+            std::min(dims[kSELECTOR_MIN].batchSize,
+                layers[i].profileDims[kSELECTOR_MIN].batchSize);
+        dims[kSELECTOR_MAX].batchSize =
+            std::max(dims[kSELECTOR_MAX].batchSize,
+                layers[i].profileDims[kSELECTOR_MAX].batchSize);
+    }
 
-        nvinfer1::Dims fullInferDims = m_Context->getBindingDimensions(i);
-        assert(!hasWildcard(fullInferDims));
+    const NvDsInferBatchDimsLayerInfo& input = layers[INPUT_LAYER_INDEX];
+    m_Profiles.push_back({profileIdx,
+        input.profileDims[kSELECTOR_MIN].batchSize,
+        input.profileDims[kSELECTOR_MAX].batchSize, context.get()});
+    m_ProfileContexts.emplace_back(std::move(context));
 
-        NvDsInferDims inferDims = {0};
-        int batchSize = 0;
+    return NVDSINFER_SUCCESS;
+}
 
-        /* Split the full dims recieved from getBindingDimensions into batchSize
-         * and rest of the dims. */
-        SplitFullDims(fullInferDims, inferDims, batchSize);
-        layerInfo.inferDims = inferDims;
+/* Find the profile with the smallest max batch size which can infer a batch
+ * of batchSize, since its kernels are tuned closest to that batch size. */
+const FullDimTrtBackendContext::OptProfile*
+FullDimTrtBackendContext::findProfile(int batchSize) const
+{
+    const OptProfile* best = nullptr;
+    for (const OptProfile& profile : m_Profiles)
+    {
+        if (batchSize < profile.minBatchSize ||
+            batchSize > profile.maxBatchSize)
+            continue;
+        if (!best || profile.maxBatchSize < best->maxBatchSize)
+            best = &profile;
     }
+    return best;
+}
 
-    return NVDSINFER_SUCCESS;
+int
+FullDimTrtBackendContext::selectProfile(int batchSize)
+{
+    const OptProfile* profile = findProfile(batchSize);
+    return profile ? profile->index : -1;
 }
 
 NvDsInferStatus
@@ -411,7 +547,25 @@ FullDimTrtBackendContext::enqueueBuffer(
     assert(m_Context);
     assert(stream.ptr());
 
-    std::vector<void*> bindingBuffers = buffer->getDeviceBuffers();
+    const OptProfile* profile =
+        findProfile(buffer->getBatchDims(INPUT_LAYER_INDEX).batchSize);
+    if (!profile)
+    {
+        dsInferError(
+            "Failed to enqueue buffer in fulldims mode because no profile "
+            "supports batchDims: %s",
+            safeStr(batchDims2Str(buffer->getBatchDims(INPUT_LAYER_INDEX))));
+        return NVDSINFER_INVALID_PARAMS;
+    }
+    nvinfer1::IExecutionContext& context = *profile->context;
+
+    /* Bindings of the profile are at an offset in the engine bindings. */
+    const std::vector<void*>& deviceBuffers = buffer->getDeviceBuffers();
+    int bindingOffset =
+        profile->index * m_CudaEngine->getNbBindingsPerProfile();
+    std::vector<void*> bindingBuffers((*m_CudaEngine)->getNbBindings(), nullptr);
+    std::copy(deviceBuffers.begin(), deviceBuffers.end(),
+        bindingBuffers.begin() + bindingOffset);
 
     for (int iL = 0; iL < (int)m_AllLayers.size(); ++iL)
     {
@@ -431,10 +585,11 @@ FullDimTrtBackendContext::enqueueBuffer(
 
         nvinfer1::Dims dimsWBatch =
             CombineDimsBatch(batchDims.dims, batchDims.batchSize);
-        nvinfer1::Dims lastDimsBatch = m_Context->getBindingDimensions(iL);
+        nvinfer1::Dims lastDimsBatch =
+            context.getBindingDimensions(bindingOffset + iL);
         if (dimsWBatch != lastDimsBatch)
         {
-            if (!m_Context->setBindingDimensions(iL, dimsWBatch))
+            if (!context.setBindingDimensions(bindingOffset + iL, dimsWBatch))
             {
                 dsInferError(
                     "Failed to enqueue buffer when setting bindings idx:%d with "
@@ -445,7 +600,7 @@ FullDimTrtBackendContext::enqueueBuffer(
         }
     }
 
-    if (!m_Context->allInputDimensionsSpecified())
+    if (!context.allInputDimensionsSpecified())
     {
         dsInferError(
             "Failed to enqueue buffer because context dims are not specified "
@@ -453,7 +608,7 @@ FullDimTrtBackendContext::enqueueBuffer(
         return NVDSINFER_TENSORRT_ERROR;
     }
 
-    if (!m_Context->enqueueV2(bindingBuffers.data(), stream,
+    if (!context.enqueueV2(bindingBuffers.data(), stream,
             (consumeEvent ? &consumeEvent->ptr() : nullptr)))
     {
         dsInferError("Failed to enqueue trt inference batch");
@@ -527,4 +682,454 @@ DlaFullDimTrtBackendContext::enqueueBuffer(
     return NVDSINFER_SUCCESS;
 }
 
+void
+HostBackendContext::addLayer(
+    NvDsInferBatchDimsLayerInfo layer, const std::string& name)
+{
+    layer.bindingIndex = m_AllLayers.size();
+    m_AllLayers.emplace_back(layer);
+    m_LayerNames.emplace_back(name);
+}
+
+void
+HostBackendContext::finalizeLayers(int maxBatchSize)
+{
+    for (size_t i = 0; i < m_AllLayers.size(); ++i)
+    {
+        NvDsInferBatchDimsLayerInfo& layer = m_AllLayers[i];
+        layer.layerName = m_LayerNames[i].c_str();
+        layer.profileDims[kSELECTOR_MIN] = {1, layer.inferDims};
+        layer.profileDims[kSELECTOR_OPT] = {maxBatchSize, layer.inferDims};
+        layer.profileDims[kSELECTOR_MAX] = {maxBatchSize, layer.inferDims};
+    }
+}
+
+int
+HostBackendContext::getLayerIdx(const std::string& bindingName)
+{
+    auto iter = std::find(m_LayerNames.begin(), m_LayerNames.end(), bindingName);
+    if (iter == m_LayerNames.end())
+        return -1;
+    return iter - m_LayerNames.begin();
+}
+
+bool
+HostBackendContext::canSupportBatchDims(
+    int bindingIdx, const NvDsInferBatchDims& batchDims)
+{
+    assert(bindingIdx < (int)m_AllLayers.size());
+    const NvDsInferBatchDimsLayerInfo& layer = m_AllLayers[bindingIdx];
+
+    return batchDims.dims == layer.inferDims &&
+        batchDims.batchSize >= layer.profileDims[kSELECTOR_MIN].batchSize &&
+        batchDims.batchSize <= layer.profileDims[kSELECTOR_MAX].batchSize;
+}
+
+static const char* const kReplayLayersFileSuffix = "_layers.txt";
+
+/* Path of a raw output tensor dump of gst-nvinfer. `prefix` is the layers file
+ * path without its suffix. '/' in layer names are written as '_'. */
+static std::string
+recordedTensorPath(const std::string& prefix, const std::string& layerName,
+    unsigned long batchNum, int batchSize)
+{
+    std::string name = layerName;
+    std::replace(name.begin(), name.end(), '/', '_');
+
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), "_batch-%010lu_batchsize-%02d.bin",
+        batchNum, batchSize);
+    return prefix + "_layer-" + name + suffix;
+}
+
+ReplayBackendContext::ReplayBackendContext(
+    const std::string& layersFilePath, unsigned int latencyUs)
+    : m_LayersFilePath(layersFilePath), m_LatencyUs(latencyUs) {}
+
+NvDsInferStatus
+ReplayBackendContext::initialize()
+{
+    RETURN_NVINFER_ERROR(parseLayersFile(),
+        "Failed to parse replay tensors layers file: %s",
+        safeStr(m_LayersFilePath));
+    RETURN_NVINFER_ERROR(mapRecordedBatches(),
+        "Failed to map recorded tensors of layers file: %s",
+        safeStr(m_LayersFilePath));
+
+    dsInferInfo("Replaying %d recorded batches of %s with %u us latency",
+        (int)m_RecordedBatches.size(), safeStr(m_LayersFilePath), m_LatencyUs);
+    return NVDSINFER_SUCCESS;
+}
+
+/* Parse the layers file gst-nvinfer writes along with the raw output tensor
+ * dumps. Inputs support batch sizes up to the recorded max batch size. */
+NvDsInferStatus
+ReplayBackendContext::parseLayersFile()
+{
+    std::ifstream file(m_LayersFilePath);
+    if (!file.good())
+    {
+        dsInferError("Could not open file: %s", safeStr(m_LayersFilePath));
+        return NVDSINFER_CONFIG_FAILED;
+    }
+
+    int maxBatchSize = 0;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string key, direction, dims, name;
+        int dataType = 0;
+
+        if (!(fields >> key))
+            continue;
+        if (key == "max-batch-size")
+        {
+            fields >> maxBatchSize;
+            continue;
+        }
+
+        NvDsInferBatchDimsLayerInfo layer{};
+        if (key != "layer" ||
+            !(fields >> layer.bindingIndex >> direction >> dataType >> dims) ||
+            !std::getline(fields >> std::ws, name) ||
+            layer.bindingIndex != (int)m_AllLayers.size())
+        {
+            dsInferError("Invalid layer line: %s", safeStr(line));
+            return NVDSINFER_CONFIG_FAILED;
+        }
+        layer.isInput = (direction == "input");
+        layer.dataType = (NvDsInferDataType)dataType;
+
+        std::istringstream dimsStream(dims);
+        std::string dim;
+        while (std::getline(dimsStream, dim, 'x'))
+        {
+            if (layer.inferDims.numDims == NVDSINFER_MAX_DIMS)
+            {
+                dsInferError("Too many dims for layer: %s", safeStr(name));
+                return NVDSINFER_CONFIG_FAILED;
+            }
+            layer.inferDims.d[layer.inferDims.numDims++] = atoi(dim.c_str());
+        }
+        normalizeDims(layer.inferDims);
+
+        addLayer(layer, name);
+    }
+
+    if (maxBatchSize <= 0 || m_AllLayers.empty() || !m_AllLayers[0].isInput)
+    {
+        dsInferError("Layers file should have a max-batch-size and an input "
+                     "layer first");
+        return NVDSINFER_CONFIG_FAILED;
+    }
+
+    finalizeLayers(maxBatchSize);
+    return NVDSINFER_SUCCESS;
+}
+
+/* Map the tensors of all output layers for every recorded batch found next
+ * to the layers file, in batch number order. */
+NvDsInferStatus
+ReplayBackendContext::mapRecordedBatches()
+{
+    size_t suffixLen = strlen(kReplayLayersFileSuffix);
+    if (m_LayersFilePath.size() <= suffixLen ||
+        m_LayersFilePath.compare(m_LayersFilePath.size() - suffixLen,
+            suffixLen, kReplayLayersFileSuffix))
+    {
+        dsInferError("Layers file name should end with %s",
+            kReplayLayersFileSuffix);
+        return NVDSINFER_CONFIG_FAILED;
+    }
+    std::string prefix =
+        m_LayersFilePath.substr(0, m_LayersFilePath.size() - suffixLen);
+    size_t dirEnd = prefix.rfind('/');
+    std::string dirPath =
+        (dirEnd == std::string::npos) ? "." : prefix.substr(0, dirEnd + 1);
+
+    auto firstOutput = std::find_if(m_AllLayers.begin(), m_AllLayers.end(),
+        [](const NvDsInferBatchDimsLayerInfo& l) { return !l.isInput; });
+    if (firstOutput == m_AllLayers.end())
+    {
+        dsInferError("Layers file has no output layer");
+        return NVDSINFER_CONFIG_FAILED;
+    }
+
+    /* Batches are listed from the files of the first output layer. */
+    std::string pattern =
+        recordedTensorPath(prefix, firstOutput->layerName, 0, 0);
+    pattern =
+        pattern.substr(dirEnd + 1, pattern.rfind("_batch-") - dirEnd - 1);
+    std::vector<std::pair<unsigned long, int>> batches;
+
+    DIR* dir = opendir(dirPath.c_str());
+    if (!dir)
+    {
+        dsInferError("Could not open directory: %s", safeStr(dirPath));
+        return NVDSINFER_CONFIG_FAILED;
+    }
+    while (struct dirent* entry = readdir(dir))
+    {
+        unsigned long batchNum = 0;
+        int batchSize = 0;
+        if (!strncmp(entry->d_name, pattern.c_str(), pattern.size()) &&
+            sscanf(entry->d_name + pattern.size(), "_batch-%lu_batchsize-%d.bin",
+                &batchNum, &batchSize) == 2 && batchSize > 0)
+        {
+            batches.emplace_back(batchNum, batchSize);
+        }
+    }
+    closedir(dir);
+
+    if (batches.empty())
+    {
+        dsInferError("No recorded tensors found for layer: %s",
+            safeStr(firstOutput->layerName));
+        return NVDSINFER_CONFIG_FAILED;
+    }
+    std::sort(batches.begin(), batches.end());
+
+    for (const auto& batch : batches)
+    {
+        RecordedBatch recorded;
+        recorded.batchSize = batch.second;
+        recorded.layers.resize(m_AllLayers.size());
+
+        for (size_t iL = 0; iL < m_AllLayers.size(); ++iL)
+        {
+            const NvDsInferBatchDimsLayerInfo& layer = m_AllLayers[iL];
+            if (layer.isInput)
+                continue;
+
+            std::string path = recordedTensorPath(
+                prefix, layer.layerName, batch.first, batch.second);
+            auto tensor = std::make_unique<MappedFile>(path);
+            size_t bytes = (size_t)layer.inferDims.numElements *
+                getElementSize(layer.dataType) * batch.second;
+            if (!tensor->isValid() || tensor->size() != bytes)
+            {
+                dsInferError("Recorded tensor %s is missing or is not %zu bytes",
+                    safeStr(path), bytes);
+                return NVDSINFER_CONFIG_FAILED;
+            }
+            recorded.layers[iL] = std::move(tensor);
+        }
+        m_RecordedBatches.emplace_back(std::move(recorded));
+    }
+    return NVDSINFER_SUCCESS;
+}
+
+/* Copy the next recorded batch to the output buffers, recorded frames are
+ * repeated for batches larger than the recorded one. Returns after the
+ * simulated latency, the outputs are then ready. */
+NvDsInferStatus
+ReplayBackendContext::enqueueBuffer(
+    const std::shared_ptr<InferBatchBuffer>& buffer, CudaStream& stream,
+    CudaEvent* consumeEvent)
+{
+    int batchSize = buffer->getBatchDims(INPUT_LAYER_INDEX).batchSize;
+    if (!canSupportBatchDims(
+            INPUT_LAYER_INDEX, buffer->getBatchDims(INPUT_LAYER_INDEX)))
+    {
+        dsInferError("Failed to replay batch of batchDims: %s",
+            safeStr(batchDims2Str(buffer->getBatchDims(INPUT_LAYER_INDEX))));
+        return NVDSINFER_INVALID_PARAMS;
+    }
+
+    const RecordedBatch& recorded = m_RecordedBatches[m_NextBatch];
+    m_NextBatch = (m_NextBatch + 1) % m_RecordedBatches.size();
+
+    std::vector<void*>& bindings = buffer->getDeviceBuffers();
+    for (size_t iL = 0; iL < m_AllLayers.size(); ++iL)
+    {
+        if (!recorded.layers[iL])
+            continue;
+        const NvDsInferBatchDimsLayerInfo& layer = m_AllLayers[iL];
+        size_t frameBytes = (size_t)layer.inferDims.numElements *
+            getElementSize(layer.dataType);
+        const uint8_t* src = (const uint8_t*)recorded.layers[iL]->data();
+
+        for (int iF = 0; iF < batchSize; ++iF)
+        {
+            memcpy((uint8_t*)bindings[iL] + iF * frameBytes,
+                src + (iF % recorded.batchSize) * frameBytes, frameBytes);
+        }
+    }
+
+    if (m_LatencyUs)
+        std::this_thread::sleep_for(std::chrono::microseconds(m_LatencyUs));
+
+    return NVDSINFER_SUCCESS;
+}
+
+
+CpuDnnBackendContext::CpuDnnBackendContext(const std::string& onnxFilePath,
+    const NvDsInferDimsCHW& inputDims, int maxBatchSize,
+    const std::vector<std::string>& outputNames)
+    : m_OnnxFilePath(onnxFilePath), m_InputDims(inputDims),
+      m_MaxBatchSize(maxBatchSize),
+      m_OutputNames(outputNames.begin(), outputNames.end())
+{
+}
+
+NvDsInferStatus
+CpuDnnBackendContext::forward(
+    const cv::Mat& input, std::vector<cv::Mat>& outputs)
+{
+    try
+    {
+        m_Net.setInput(input);
+        m_Net.forward(outputs, m_OutputNames);
+    }
+    catch (const cv::Exception& e)
+    {
+        dsInferError("OpenCV DNN failed to infer %s: %s",
+            safeStr(m_OnnxFilePath), e.what());
+        return NVDSINFER_UNKNOWN_ERROR;
+    }
+    return NVDSINFER_SUCCESS;
+}
+
+/* Load the model and bind the input layer to inputDims. OpenCV does not report
+ * the output shapes of an ONNX model before inferring, one zero frame is
+ * inferred to find them. */
+NvDsInferStatus
+CpuDnnBackendContext::initialize()
+{
+    if (m_InputDims.c == 0 || m_InputDims.h == 0 || m_InputDims.w == 0)
+    {
+        dsInferError("infer-dims must be set to infer on the CPU");
+        return NVDSINFER_CONFIG_FAILED;
+    }
+
+    try
+    {
+        m_Net = cv::dnn::readNetFromONNX(m_OnnxFilePath);
+    }
+    catch (const cv::Exception& e)
+    {
+        dsInferError("OpenCV DNN failed to read ONNX model %s: %s",
+            safeStr(m_OnnxFilePath), e.what());
+        return NVDSINFER_CONFIG_FAILED;
+    }
+    if (m_Net.empty())
+    {
+        dsInferError("OpenCV DNN failed to read ONNX model %s",
+            safeStr(m_OnnxFilePath));
+        return NVDSINFER_CONFIG_FAILED;
+    }
+    m_Net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    m_Net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+
+    if (m_OutputNames.empty())
+        m_OutputNames = m_Net.getUnconnectedOutLayersNames();
+
+    NvDsInferBatchDimsLayerInfo input{};
+    input.isInput = 1;
+    input.dataType = FLOAT;
+    input.inferDims.numDims = 3;
+    input.inferDims.d[0] = m_InputDims.c;
+    input.inferDims.d[1] = m_InputDims.h;
+    input.inferDims.d[2] = m_InputDims.w;
+    normalizeDims(input.inferDims);
+    addLayer(input, "input");
+
+    int shape[] = {1, (int)m_InputDims.c, (int)m_InputDims.h, (int)m_InputDims.w};
+    cv::Mat probe(4, shape, CV_32F, cv::Scalar(0));
+    std::vector<cv::Mat> outputs;
+    RETURN_NVINFER_ERROR(forward(probe, outputs),
+        "Failed to infer a frame to get the output dims");
+
+    for (size_t iO = 0; iO < outputs.size(); ++iO)
+    {
+        const cv::Mat& out = outputs[iO];
+        if (out.depth() != CV_32F || out.dims < 2 || out.size[0] != 1 ||
+            out.dims - 1 > NVDSINFER_MAX_DIMS)
+        {
+            dsInferError("Unsupported output layer %s, outputs should be "
+                         "float with the batch as first dim",
+                safeStr(m_OutputNames[iO]));
+            return NVDSINFER_CONFIG_FAILED;
+        }
+
+        NvDsInferBatchDimsLayerInfo layer{};
+        layer.isInput = 0;
+        layer.dataType = FLOAT;
+        for (int iD = 1; iD < out.dims; ++iD)
+            layer.inferDims.d[layer.inferDims.numDims++] = out.size[iD];
+        normalizeDims(layer.inferDims);
+        addLayer(layer, m_OutputNames[iO]);
+    }
+
+    finalizeLayers(m_MaxBatchSize);
+
+    dsInferInfo("Inferring %s on the CPU with OpenCV DNN, %d output layers",
+        safeStr(m_OnnxFilePath), (int)outputs.size());
+    return NVDSINFER_SUCCESS;
+}
+
+/* Infer the batch in place of the input binding and copy the outputs to their
+ * bindings. The batch is inferred at once unless the model failed to, it is
+ * then inferred frame by frame from then on. */
+NvDsInferStatus
+CpuDnnBackendContext::enqueueBuffer(
+    const std::shared_ptr<InferBatchBuffer>& buffer, CudaStream& stream,
+    CudaEvent* consumeEvent)
+{
+    NvDsInferBatchDims batchDims = buffer->getBatchDims(INPUT_LAYER_INDEX);
+    if (!canSupportBatchDims(INPUT_LAYER_INDEX, batchDims))
+    {
+        dsInferError("Failed to infer batch of batchDims: %s on the CPU",
+            safeStr(batchDims2Str(batchDims)));
+        return NVDSINFER_INVALID_PARAMS;
+    }
+
+    std::vector<void*>& bindings = buffer->getDeviceBuffers();
+    size_t inputFrameElems = m_AllLayers[INPUT_LAYER_INDEX].inferDims.numElements;
+    int numFrames = m_FrameByFrame ? 1 : batchDims.batchSize;
+    int numForwards = batchDims.batchSize / numFrames;
+    std::vector<cv::Mat> outputs;
+
+    for (int iF = 0; iF < numForwards; ++iF)
+    {
+        int shape[] = {numFrames, (int)m_InputDims.c, (int)m_InputDims.h,
+            (int)m_InputDims.w};
+        cv::Mat input(4, shape, CV_32F,
+            (float*)bindings[INPUT_LAYER_INDEX] +
+                iF * numFrames * inputFrameElems);
+        NvDsInferStatus status = forward(input, outputs);
+
+        bool sizesMatch = (status == NVDSINFER_SUCCESS);
+        for (size_t iO = 0; sizesMatch && iO < outputs.size(); ++iO)
+        {
+            sizesMatch = (outputs[iO].total() ==
+                m_AllLayers[iO + 1].inferDims.numElements * numFrames);
+        }
+        if (!sizesMatch)
+        {
+            if (numFrames == 1)
+            {
+                dsInferError("Failed to infer a frame of %s on the CPU",
+                    safeStr(m_OnnxFilePath));
+                return NVDSINFER_UNKNOWN_ERROR;
+            }
+            dsInferWarning("Model %s failed to infer a batch of %d frames, "
+                "inferring frame by frame", safeStr(m_OnnxFilePath), numFrames);
+            m_FrameByFrame = true;
+            return enqueueBuffer(buffer, stream, consumeEvent);
+        }
+
+        for (size_t iO = 0; iO < outputs.size(); ++iO)
+        {
+            size_t frameBytes =
+                m_AllLayers[iO + 1].inferDims.numElements * sizeof(float);
+            memcpy((uint8_t*)bindings[iO + 1] + iF * numFrames * frameBytes,
+                outputs[iO].ptr(), numFrames * frameBytes);
+        }
+    }
+
+    return NVDSINFER_SUCCESS;
+}
+
 } // namespace nvdsinfer
@@ -24,6 +24,8 @@
 #include <NvInfer.h>
 #include <NvInferRuntime.h>
 
+#include <opencv2/dnn.hpp>
+
 #include "nvdsinfer_func_utils.h"
 
 /* This file provides backend inference interface for abstracting implementation
@@ -40,6 +42,8 @@ class CudaStream
 {
 public:
     explicit CudaStream(uint flag = cudaStreamDefault, int priority = 0);
+    /* Null stream, not created. For contexts inferring in host memory. */
+    explicit CudaStream(std::nullptr_t) {}
     ~CudaStream();
     operator cudaStream_t() { return m_Stream; }
     cudaStream_t& ptr() { return m_Stream; }
@@ -131,6 +135,16 @@ public:
     ~CudaHostBuffer();
 };
 
+/**
+ * Pageable system memory buffers, for contexts inferring without a GPU.
+ */
+class SysMemBuffer : public CudaBuffer
+{
+public:
+    explicit SysMemBuffer(size_t size);
+    ~SysMemBuffer();
+};
+
 /**
  * Abstract interface to manage a batched buffer for inference.
  */
@@ -195,6 +209,17 @@ public:
         const std::shared_ptr<InferBatchBuffer>& buffer, CudaStream& stream,
         CudaEvent* consumeEvent) = 0;
 
+    /* Create another context on the same engine which can enqueue buffers
+     * concurrently with this one. Returns nullptr if not supported. */
+    virtual std::unique_ptr<BackendContext> createConcurrentContext()
+    {
+        return nullptr;
+    }
+
+    /* Get the index of the optimization profile enqueueBuffer infers a batch
+     * of batchSize with, -1 if no profile supports it. */
+    virtual int selectProfile(int batchSize) { return 0; }
+
 private:
     DISABLE_CLASS_COPY(BackendContext);
 };
@@ -272,6 +297,8 @@ private:
         const std::shared_ptr<InferBatchBuffer>& buffer, CudaStream& stream,
         CudaEvent* consumeEvent) override;
 
+    std::unique_ptr<BackendContext> createConcurrentContext() override;
+
 protected:
     int m_MaxBatchSize = 0;
 };
@@ -293,9 +320,28 @@ private:
         const std::shared_ptr<InferBatchBuffer>& buffer, CudaStream& stream,
         CudaEvent* consumeEvent) override;
 
+    int selectProfile(int batchSize) override;
+
 protected:
-    // Only idx 0 profile supported.
+    /* An execution context bound to an optimization profile of the engine. */
+    struct OptProfile
+    {
+        int index;
+        int minBatchSize;
+        int maxBatchSize;
+        nvinfer1::IExecutionContext* context;
+    };
+
+    NvDsInferStatus setOptBindingDims(
+        nvinfer1::IExecutionContext& context, int profileIdx);
+    NvDsInferStatus addProfileContext(int profileIdx);
+    const OptProfile* findProfile(int batchSize) const;
+
+    /* Profile of m_Context. */
     const int m_ProfileIndex = 0;
+    /* All profiles batches may be inferred with, m_ProfileIndex included. */
+    std::vector<OptProfile> m_Profiles;
+    std::vector<UniquePtrWDestroy<nvinfer1::IExecutionContext>> m_ProfileContexts;
 };
 
 /**
@@ -341,6 +387,116 @@ private:
 std::unique_ptr<TrtBackendContext> createBackendContext(
     const std::shared_ptr<TrtEngine>& engine);
 
+/**
+ * Base class for backend contexts inferring in host memory without a GPU.
+ * Holds the bound layers, every layer supports batch sizes from 1 to the max
+ * batch size. enqueueBuffer completes synchronously.
+ */
+class HostBackendContext : public BackendContext
+{
+protected:
+    int getNumBoundLayers() override { return m_AllLayers.size(); }
+
+    const NvDsInferBatchDimsLayerInfo& getLayerInfo(int bindingIdx) override
+    {
+        assert(bindingIdx < (int)m_AllLayers.size());
+        return m_AllLayers[bindingIdx];
+    }
+    int getLayerIdx(const std::string& bindingName) override;
+
+    bool canSupportBatchDims(
+        int bindingIdx, const NvDsInferBatchDims& batchDims) override;
+
+    NvDsInferBatchDims getMaxBatchDims(int bindingIdx) override
+    {
+        assert(bindingIdx < (int)m_AllLayers.size());
+        return m_AllLayers[bindingIdx].profileDims[kSELECTOR_MAX];
+    }
+    NvDsInferBatchDims getMinBatchDims(int bindingIdx) override
+    {
+        assert(bindingIdx < (int)m_AllLayers.size());
+        return m_AllLayers[bindingIdx].profileDims[kSELECTOR_MIN];
+    }
+    NvDsInferBatchDims getOptBatchDims(int bindingIdx) override
+    {
+        assert(bindingIdx < (int)m_AllLayers.size());
+        return m_AllLayers[bindingIdx].profileDims[kSELECTOR_OPT];
+    }
+
+    /* Add a bound layer, binding indexes follow the order of addition. */
+    void addLayer(NvDsInferBatchDimsLayerInfo layer, const std::string& name);
+    /* Set the layer names and batch dims of all the added layers. */
+    void finalizeLayers(int maxBatchSize);
+
+    std::vector<NvDsInferBatchDimsLayerInfo> m_AllLayers;
+    std::vector<std::string> m_LayerNames;
+};
+
+/**
+ * Backend context replaying output tensors recorded by gst-nvinfer raw output
+ * dumps instead of inferring. Layers are read from the dump's layers file,
+ * batches are replayed round-robin after a simulated latency.
+ */
+class ReplayBackendContext : public HostBackendContext
+{
+public:
+    ReplayBackendContext(const std::string& layersFilePath, unsigned int latencyUs);
+
+private:
+    NvDsInferStatus initialize() override;
+
+    NvDsInferStatus enqueueBuffer(
+        const std::shared_ptr<InferBatchBuffer>& buffer, CudaStream& stream,
+        CudaEvent* consumeEvent) override;
+
+    NvDsInferStatus parseLayersFile();
+    NvDsInferStatus mapRecordedBatches();
+
+    /* Output tensors of a recorded batch, indexed by binding index. Null for
+     * input layers. */
+    struct RecordedBatch
+    {
+        int batchSize;
+        std::vector<std::unique_ptr<MappedFile>> layers;
+    };
+
+    std::string m_LayersFilePath;
+    unsigned int m_LatencyUs = 0;
+    std::vector<RecordedBatch> m_RecordedBatches;
+    size_t m_NextBatch = 0;
+};
+
+/**
+ * Backend context inferring an ONNX model on the CPU with OpenCV DNN. The
+ * single input layer takes planar float CHW frames of inputDims, output dims
+ * are found by inferring one frame at initialization. All layers are FLOAT.
+ */
+class CpuDnnBackendContext : public HostBackendContext
+{
+public:
+    CpuDnnBackendContext(const std::string& onnxFilePath,
+        const NvDsInferDimsCHW& inputDims, int maxBatchSize,
+        const std::vector<std::string>& outputNames);
+
+private:
+    NvDsInferStatus initialize() override;
+
+    NvDsInferStatus enqueueBuffer(
+        const std::shared_ptr<InferBatchBuffer>& buffer, CudaStream& stream,
+        CudaEvent* consumeEvent) override;
+
+    NvDsInferStatus forward(const cv::Mat& input, std::vector<cv::Mat>& outputs);
+
+    std::string m_OnnxFilePath;
+    NvDsInferDimsCHW m_InputDims;
+    int m_MaxBatchSize = 0;
+    std::vector<cv::String> m_OutputNames;
+    cv::dnn::Net m_Net;
+    /* Set if the model failed to infer a whole batch at once, e.g. when it
+     * was exported with a fixed batch size of 1. */
+    bool m_FrameByFrame = false;
+};
+
 } // end of namespace nvdsinfer
 
 #endif
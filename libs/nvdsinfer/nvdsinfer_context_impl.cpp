@@ -10,8 +10,12 @@
  */
 
 #include <dlfcn.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <algorithm>
 #include <array>
+#include <cerrno>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -197,6 +201,12 @@ InferPreprocessor::readMeanImageFile()
     }
 
     assert(m_MeanDataBuffer);
+    if (m_HostMemory)
+    {
+        memcpy(m_MeanDataBuffer->ptr(), tempMeanDataFloat,
+            size * sizeof(float));
+        return NVDSINFER_SUCCESS;
+    }
     cudaReturn = cudaMemcpy(m_MeanDataBuffer->ptr(), tempMeanDataFloat,
         size * sizeof(float), cudaMemcpyHostToDevice);
     if (cudaReturn != cudaSuccess)
@@ -215,10 +225,13 @@ InferPreprocessor::allocateResource()
     if (!m_MeanFile.empty() || m_ChannelMeans.size() > 0)
     {
         /* Mean Image File specified. Allocate the mean image buffer on device
-         * memory. */
-        m_MeanDataBuffer = std::make_unique<CudaDeviceBuffer>(
-               (size_t) m_NetworkInfo.width * m_NetworkInfo.height * m_NetworkInfo.channels *
-                sizeof(float));
+         * memory, or host memory when preprocessing on the CPU. */
+        size_t meanBytes = (size_t) m_NetworkInfo.width * m_NetworkInfo.height *
+            m_NetworkInfo.channels * sizeof(float);
+        if (m_HostMemory)
+            m_MeanDataBuffer = std::make_unique<SysMemBuffer>(meanBytes);
+        else
+            m_MeanDataBuffer = std::make_unique<CudaDeviceBuffer>(meanBytes);
 
         if (!m_MeanDataBuffer || !m_MeanDataBuffer->ptr())
         {
@@ -268,17 +281,29 @@ InferPreprocessor::allocateResource()
                 meanData[j * m_NetworkInfo.channels + i] = m_ChannelMeans[i];
             }
         }
-        cudaError_t cudaReturn =
-            cudaMemcpy(m_MeanDataBuffer->ptr(), meanData.data(),
-                meanData.size() * sizeof(float), cudaMemcpyHostToDevice);
-        if (cudaReturn != cudaSuccess)
+        if (m_HostMemory)
         {
-            printError("Failed to copy mean data to mean data cuda buffer(%s)",
-                cudaGetErrorName(cudaReturn));
-            return NVDSINFER_CUDA_ERROR;
+            memcpy(m_MeanDataBuffer->ptr(), meanData.data(),
+                meanData.size() * sizeof(float));
+        }
+        else
+        {
+            cudaError_t cudaReturn =
+                cudaMemcpy(m_MeanDataBuffer->ptr(), meanData.data(),
+                    meanData.size() * sizeof(float), cudaMemcpyHostToDevice);
+            if (cudaReturn != cudaSuccess)
+            {
+                printError("Failed to copy mean data to mean data cuda buffer(%s)",
+                    cudaGetErrorName(cudaReturn));
+                return NVDSINFER_CUDA_ERROR;
+            }
         }
     }
 
+    /* transformHost converts synchronously, no stream is needed. */
+    if (m_HostMemory)
+        return NVDSINFER_SUCCESS;
+
     /* Create the cuda stream on which pre-processing jobs will be executed. */
     m_PreProcessStream = std::make_unique<CudaStream>(cudaStreamNonBlocking);
     if (!m_PreProcessStream || !m_PreProcessStream->ptr())
@@ -427,6 +452,98 @@ NvDsInferStatus InferPreprocessor::transform(
     return NVDSINFER_SUCCESS;
 }
 
+/* Pixel size of the input frames and whether their channel order is reversed
+ * for the network, matching the conversion kernels transform picks. */
+static bool
+getHostConversion(NvDsInferFormat networkFormat, NvDsInferFormat inputFormat,
+    unsigned int& pixelSize, bool& reverse)
+{
+    if (networkFormat == NvDsInferFormat_GRAY)
+    {
+        pixelSize = 1;
+        reverse = false;
+        return inputFormat == NvDsInferFormat_GRAY;
+    }
+    if (networkFormat != NvDsInferFormat_RGB &&
+        networkFormat != NvDsInferFormat_BGR)
+        return false;
+
+    switch (inputFormat)
+    {
+        case NvDsInferFormat_RGB:
+        case NvDsInferFormat_BGR:
+            pixelSize = 3;
+            break;
+        case NvDsInferFormat_RGBA:
+        case NvDsInferFormat_BGRx:
+            pixelSize = 4;
+            break;
+        default:
+            return false;
+    }
+    bool inputRgb = (inputFormat == NvDsInferFormat_RGB ||
+        inputFormat == NvDsInferFormat_RGBA);
+    reverse = (inputRgb != (networkFormat == NvDsInferFormat_RGB));
+    return true;
+}
+
+/* CPU version of the NvDsInferConvert_* kernels: converts a packed frame to
+ * planar float, out = scale * (in - mean). */
+static void
+convertToPlanarFloatHost(float* outBuffer, const unsigned char* inBuffer,
+    unsigned int width, unsigned int height, unsigned int pitch,
+    unsigned int pixelSize, unsigned int channels, bool reverse,
+    float scaleFactor, const float* meanDataBuffer)
+{
+    for (unsigned int row = 0; row < height; row++)
+    {
+        const unsigned char* inRow = inBuffer + row * pitch;
+        for (unsigned int col = 0; col < width; col++)
+        {
+            const unsigned char* pixel = inRow + col * pixelSize;
+            const float* mean = meanDataBuffer ?
+                meanDataBuffer + (row * width + col) * channels : nullptr;
+            for (unsigned int k = 0; k < channels; k++)
+            {
+                float value = pixel[reverse ? channels - 1 - k : k];
+                if (mean)
+                    value -= mean[k];
+                outBuffer[k * width * height + row * width + col] =
+                    scaleFactor * value;
+            }
+        }
+    }
+}
+
+NvDsInferStatus
+InferPreprocessor::transformHost(
+    NvDsInferContextBatchInput& batchInput, void* hostBuf)
+{
+    unsigned int pixelSize = 0;
+    bool reverse = false;
+
+    if (!getHostConversion(m_NetworkInputFormat, batchInput.inputFormat,
+            pixelSize, reverse))
+    {
+        printError("Input format conversion is not supported");
+        return NVDSINFER_INVALID_PARAMS;
+    }
+
+    for (unsigned int i = 0; i < batchInput.numInputFrames; i++)
+    {
+        float* outPtr =
+            (float*)hostBuf + i * m_NetworkInputLayer.inferDims.numElements;
+
+        convertToPlanarFloatHost(outPtr,
+            (const unsigned char*)batchInput.inputFrames[i],
+            m_NetworkInfo.width, m_NetworkInfo.height, batchInput.inputPitch,
+            pixelSize, m_NetworkInfo.channels, reverse, m_Scale,
+            m_MeanDataBuffer.get() ? m_MeanDataBuffer->ptr<float>() : nullptr);
+    }
+
+    return NVDSINFER_SUCCESS;
+}
+
 /* Parse the labels file and extract the class label strings. For format of
  * the labels file, please refer to the custom models section in the
  * DeepStreamSDK documentation.
@@ -480,6 +597,8 @@ NvDsInferStatus
 InferPostprocessor::initResource(const NvDsInferContextInitParams& initParams)
 {
     m_CopyInputToHostBuffers = initParams.copyInputToHostBuffers;
+    if (initParams.outputInt8Scale > 0)
+        m_OutputInt8Scale = initParams.outputInt8Scale;
 
     if (!string_empty(initParams.labelsFilePath))
     {
@@ -606,6 +725,12 @@ InferPostprocessor::freeBatchOutput(NvDsInferContextBatchOutput& batchOutput)
     delete[] batchOutput.outputDeviceBuffers;
 }
 
+DetectPostprocessor::~DetectPostprocessor()
+{
+    if (m_CustomBBoxDestroyContextFunc && m_CustomBBoxParseContext)
+        m_CustomBBoxDestroyContextFunc(m_CustomBBoxParseContext);
+}
+
 NvDsInferStatus
 DetectPostprocessor::initResource(const NvDsInferContextInitParams& initParams)
 {
@@ -628,6 +753,25 @@ DetectPostprocessor::initResource(const NvDsInferContextInitParams& initParams)
         return NVDSINFER_CONFIG_FAILED;
     }
 
+    /* Precompute the DetectNet grid centers for the network resolution, if
+     * the model has the coverage and bbox layers of the built-in parser. */
+    const NvDsInferLayerInfo* coverageLayer = nullptr;
+    const NvDsInferLayerInfo* bboxLayer = nullptr;
+    for (const NvDsInferLayerInfo& layer : m_OutputLayerInfo)
+    {
+        if (strstr(safeStr(layer.layerName), "bbox"))
+            bboxLayer = &layer;
+        if (strstr(safeStr(layer.layerName), "cov"))
+            coverageLayer = &layer;
+    }
+    if (coverageLayer && bboxLayer)
+    {
+        NvDsInferDimsCHW coverageDims, bboxDims;
+        getDimsCHWFromDims(coverageDims, coverageLayer->inferDims);
+        getDimsCHWFromDims(bboxDims, bboxLayer->inferDims);
+        updateGridCenters(m_NetworkInfo, coverageDims, bboxDims);
+    }
+
     m_PerClassDetectionParams.assign(initParams.perClassDetectionParams,
         initParams.perClassDetectionParams + m_NumDetectedClasses);
     m_DetectionParams.numClassesConfigured = initParams.numDetectedClasses;
@@ -636,6 +780,7 @@ DetectPostprocessor::initResource(const NvDsInferContextInitParams& initParams)
 
     /* Resize the per class vector to the number of detected classes. */
     m_PerClassObjectList.resize(initParams.numDetectedClasses);
+    m_PerClassObjectIndex.resize(initParams.numDetectedClasses);
     if (m_ClusterMode == NVDSINFER_CLUSTER_GROUP_RECTANGLES)
     {
         m_PerClassCvRectList.resize(initParams.numDetectedClasses);
@@ -656,16 +801,52 @@ DetectPostprocessor::initResource(const NvDsInferContextInitParams& initParams)
     if (m_CustomLibHandle &&
         !string_empty(initParams.customBBoxParseFuncName))
     {
-        m_CustomBBoxParseFunc =
-            m_CustomLibHandle->symbol<NvDsInferParseCustomFunc>(
-                initParams.customBBoxParseFuncName);
-        if (!m_CustomBBoxParseFunc)
+        std::string funcName = initParams.customBBoxParseFuncName;
+        auto createContextFunc =
+            m_CustomLibHandle->symbol<NvDsInferParseCustomCreateContextFunc>(
+                funcName + "CreateContext");
+        auto parseWithContextFunc =
+            m_CustomLibHandle->symbol<NvDsInferParseCustomWithContextFunc>(
+                funcName + "WithContext");
+        auto destroyContextFunc =
+            m_CustomLibHandle->symbol<NvDsInferParseCustomDestroyContextFunc>(
+                funcName + "DestroyContext");
+        if (createContextFunc && parseWithContextFunc && destroyContextFunc)
         {
-            printError(
-                "Detect-postprocessor failed to init resource "
-                "because dlsym failed to get func %s pointer",
-                safeStr(initParams.customBBoxParseFuncName));
-            return NVDSINFER_CUSTOM_LIB_FAILED;
+            if (!createContextFunc(m_OutputLayerInfo, m_NetworkInfo,
+                    m_DetectionParams, &m_CustomBBoxParseContext))
+            {
+                printError("Detect-postprocessor failed to create the "
+                    "context of custom parser %s", funcName.c_str());
+                return NVDSINFER_CUSTOM_LIB_FAILED;
+            }
+            m_CustomBBoxParseWithContextFunc = parseWithContextFunc;
+            m_CustomBBoxDestroyContextFunc = destroyContextFunc;
+            m_CustomBBoxParseWithLandmarksFunc =
+                m_CustomLibHandle->symbol<NvDsInferParseCustomWithLandmarksFunc>(
+                    funcName + "WithLandmarks");
+            if (m_CustomBBoxParseWithLandmarksFunc &&
+                m_ClusterMode != NVDSINFER_CLUSTER_NMS &&
+                m_ClusterMode != NVDSINFER_CLUSTER_NONE)
+            {
+                printWarning("Landmarks of custom parser %s are only kept "
+                    "with NMS or no clustering, they will be dropped",
+                    funcName.c_str());
+            }
+        }
+        else
+        {
+            m_CustomBBoxParseFunc =
+                m_CustomLibHandle->symbol<NvDsInferParseCustomFunc>(
+                    initParams.customBBoxParseFuncName);
+            if (!m_CustomBBoxParseFunc)
+            {
+                printError(
+                    "Detect-postprocessor failed to init resource "
+                    "because dlsym failed to get func %s pointer",
+                    safeStr(initParams.customBBoxParseFuncName));
+                return NVDSINFER_CUSTOM_LIB_FAILED;
+            }
         }
     }
 
@@ -741,6 +922,22 @@ SegmentPostprocessor::initResource(const NvDsInferContextInitParams& initParams)
         "init post processing resource failed");
 
     m_SegmentationThreshold = initParams.segmentationThreshold;
+    m_ClassMapU8 = initParams.segmentationClassMapU8;
+    m_NumThreads = initParams.segmentationThreads;
+    if (!m_NumThreads)
+        m_NumThreads = WorkerPool::instance().maxThreads();
+
+    if (m_ClassMapU8 && !m_OutputLayerInfo.empty())
+    {
+        NvDsInferDimsCHW dims;
+        getDimsCHWFromDims(dims, m_OutputLayerInfo[0].inferDims);
+        if (dims.c > 255)
+        {
+            printError("uint8 class map supports at most 255 classes, "
+                "segmentation output has %u", dims.c);
+            return NVDSINFER_CONFIG_FAILED;
+        }
+    }
     return NVDSINFER_SUCCESS;
 }
 
@@ -755,6 +952,66 @@ SegmentPostprocessor::parseEachBatch(
     return NVDSINFER_SUCCESS;
 }
 
+NvDsInferStatus
+EmbeddingPostprocessor::initResource(const NvDsInferContextInitParams& initParams)
+{
+    RETURN_NVINFER_ERROR(InferPostprocessor::initResource(initParams),
+        "init post processing resource failed");
+
+    if (m_OutputLayerInfo.empty())
+    {
+        printError("Embedding-postprocessor needs at least one output layer");
+        return NVDSINFER_CONFIG_FAILED;
+    }
+    if (m_OutputLayerInfo.size() > 1)
+    {
+        printWarning("Embedding-postprocessor uses output layer:%s, "
+            "other output layers are ignored",
+            safeStr(m_OutputLayerInfo[0].layerName));
+    }
+    if (m_OutputLayerInfo[0].dataType != FLOAT)
+    {
+        printError("Embedding output layer:%s must be of FLOAT type",
+            safeStr(m_OutputLayerInfo[0].layerName));
+        return NVDSINFER_CONFIG_FAILED;
+    }
+    m_EmbeddingInt8 = initParams.embeddingInt8;
+    return NVDSINFER_SUCCESS;
+}
+
+NvDsInferStatus
+EmbeddingPostprocessor::parseEachBatch(
+    const std::vector<NvDsInferLayerInfo>& outputLayers,
+    NvDsInferFrameOutput& result)
+{
+    result.outputType = NvDsInferNetworkType_Embedding;
+    fillEmbeddingOutput(outputLayers, result.embeddingOutput);
+
+    return NVDSINFER_SUCCESS;
+}
+
+/* The int8 embeddings go to a buffer owned by the batch rather than over the
+ * host output buffer, which consumers of the raw tensors read as FLOAT. */
+NvDsInferStatus
+EmbeddingPostprocessor::postProcessHost(NvDsInferBatch& batch,
+    NvDsInferContextBatchOutput& batchOutput)
+{
+    RETURN_NVINFER_ERROR(
+        InferPostprocessor::postProcessHost(batch, batchOutput),
+        "Infer context post-processing of embeddings failed");
+    if (!m_EmbeddingInt8)
+        return NVDSINFER_SUCCESS;
+
+    unsigned int dims = m_OutputLayerInfo[0].inferDims.numElements;
+    batch.m_EmbeddingsInt8.resize((size_t)batch.m_BatchSize * dims);
+    for (unsigned int i = 0; i < batchOutput.numFrames; i++)
+    {
+        quantizeEmbeddingOutput(batchOutput.frames[i].embeddingOutput,
+            &batch.m_EmbeddingsInt8[(size_t)i * dims]);
+    }
+    return NVDSINFER_SUCCESS;
+}
+
 NvDsInferStatus
 OtherPostprocessor::initResource(const NvDsInferContextInitParams& initParams)
 {
@@ -824,6 +1081,7 @@ NvDsInferContextImpl::preparePreprocess(const NvDsInferContextInitParams& initPa
         return NVDSINFER_CONFIG_FAILED;
     }
 
+    processor->setHostMemory(m_HostMemory);
     NvDsInferStatus status = processor->allocateResource();
     if (status != NVDSINFER_SUCCESS)
     {
@@ -852,6 +1110,10 @@ NvDsInferContextImpl::preparePostprocess(const NvDsInferContextInitParams& initP
         case NvDsInferNetworkType_Segmentation:
             processor = std::make_unique<SegmentPostprocessor>(m_UniqueID, m_GpuID);
             break;
+        case NvDsInferNetworkType_Embedding:
+            processor =
+                std::make_unique<EmbeddingPostprocessor>(m_UniqueID, m_GpuID);
+            break;
         case NvDsInferNetworkType_Other:
             processor = std::make_unique<OtherPostprocessor>(m_UniqueID, m_GpuID);
             break;
@@ -1001,9 +1263,17 @@ NvDsInferContextImpl::initialize(NvDsInferContextInitParams& initParams,
         return NVDSINFER_CONFIG_FAILED;
     }
 
+    /* Recorded tensors are replayed and CPU inference runs in host memory,
+     * no GPU is used. */
+    m_HostMemory = !string_empty(initParams.replayTensorsFilePath) ||
+        initParams.useCpuInference;
+
     /* Set the cuda device to be used. */
-    RETURN_CUDA_ERR(
-        cudaSetDevice(m_GpuID), "Failed to set cuda device (%d).", m_GpuID);
+    if (!m_HostMemory)
+    {
+        RETURN_CUDA_ERR(cudaSetDevice(m_GpuID),
+            "Failed to set cuda device (%d).", m_GpuID);
+    }
 
     /* Load the custom library if specified. */
     if (!string_empty(initParams.customLibPath))
@@ -1018,20 +1288,49 @@ NvDsInferContextImpl::initialize(NvDsInferContextInitParams& initParams,
         m_CustomLibHandle = std::move(dlHandle);
     }
 
-    m_BackendContext = generateBackendContext(initParams);
-    if (!m_BackendContext)
+    std::unique_ptr<BackendContext> backend =
+        generateBackendContext(initParams);
+    if (!backend)
     {
         printError("generate backend failed, check config file settings");
         return NVDSINFER_CONFIG_FAILED;
     }
 
-    RETURN_NVINFER_ERROR(initInferenceInfo(initParams, *m_BackendContext),
+    RETURN_NVINFER_ERROR(initInferenceInfo(initParams, *backend),
         "Infer context initialize inference info failed");
     assert(m_AllLayerInfo.size());
 
-    RETURN_NVINFER_ERROR(preparePreprocess(initParams),
-        "Infer Context prepare preprocessing resource failed.");
-    assert(m_Preprocessor);
+    /* Additional execution contexts share the engine of the first one. */
+    m_ExecContexts.emplace_back(new NvDsInferExecContext);
+    m_ExecContexts[0]->m_Backend = std::move(backend);
+    for (unsigned int i = 1; i < initParams.numExecutionContexts; i++)
+    {
+        backend = m_ExecContexts[0]->m_Backend->createConcurrentContext();
+        if (!backend)
+        {
+            printWarning("Backend does not support concurrent execution "
+                "contexts, using %u of %u", i, initParams.numExecutionContexts);
+            break;
+        }
+        m_ExecContexts.emplace_back(new NvDsInferExecContext);
+        m_ExecContexts.back()->m_Backend = std::move(backend);
+    }
+
+    m_ExecScheduler.reset(m_ExecContexts.size());
+
+    /* Keep a set of output buffers per context in flight and one more being
+     * parsed, else the extra contexts would wait for free output buffers. */
+    if (m_Batches.size() < m_ExecContexts.size() + 1)
+        m_Batches.resize(m_ExecContexts.size() + 1);
+
+    /* Replayed outputs don't depend on the input, it is not preprocessed.
+     * CPU inference preprocesses in host memory. */
+    if (!m_HostMemory || initParams.useCpuInference)
+    {
+        RETURN_NVINFER_ERROR(preparePreprocess(initParams),
+            "Infer Context prepare preprocessing resource failed.");
+        assert(m_Preprocessor);
+    }
 
     RETURN_NVINFER_ERROR(preparePostprocess(initParams),
         "Infer Context prepare postprocessing resource failed.");
@@ -1048,7 +1347,7 @@ NvDsInferContextImpl::initialize(NvDsInferContextInitParams& initParams,
 
     /* If there are more than one input layers (non-image input) and custom
      * library is specified, try to initialize these layers. */
-    if (m_InputDeviceBuffers.size() > 1)
+    if (m_ExecContexts[0]->m_InputDeviceBuffers.size() > 1 && !m_HostMemory)
     {
         NvDsInferStatus status = initNonImageInputLayers();
         if (status != NVDSINFER_SUCCESS)
@@ -1059,6 +1358,97 @@ NvDsInferContextImpl::initialize(NvDsInferContextInitParams& initParams,
     }
 
     m_Initialized = true;
+
+    if (initParams.warmupIterations && !m_HostMemory)
+    {
+        status = warmUp(initParams);
+        if (status != NVDSINFER_SUCCESS)
+        {
+            printError("Failed to warm up the inference context");
+            m_Initialized = false;
+            return status;
+        }
+    }
+    return NVDSINFER_SUCCESS;
+}
+
+/* Infer synthetic batches so that the lazy allocations and kernel selection
+ * of the backend are done before the first real batch. Every configured
+ * profile batch size is inferred along with the max batch size, so that each
+ * optimization profile of a full dimensions engine gets warmed up. */
+NvDsInferStatus
+NvDsInferContextImpl::warmUp(const NvDsInferContextInitParams& initParams)
+{
+    unsigned int iterations = initParams.warmupIterations;
+
+    /* A black frame in the format the client supplies. RGB/BGR networks take
+     * RGBA frames. */
+    bool gray = (m_NetworkInfo.channels == 1);
+    unsigned int pitch = m_NetworkInfo.width * (gray ? 1 : 4);
+    CudaDeviceBuffer frame(pitch * m_NetworkInfo.height);
+    RETURN_CUDA_ERR(cudaMemset(frame.ptr(), 0, frame.bytes()),
+        "warm-up failed to clear the input frame");
+    std::vector<void*> frames(m_MaxBatchSize, frame.ptr());
+
+    /* Same profile selection as the model builder: DLA engines only have
+     * the max batch size profile. */
+    std::vector<unsigned int> batchSizes;
+    if (initParams.dlaCore < 0 || !initParams.useDLA)
+    {
+        for (unsigned int i = 0; i < initParams.numProfileBatchSizes; i++)
+        {
+            unsigned int b = initParams.profileBatchSizes[i];
+            if (b && b < m_MaxBatchSize)
+                batchSizes.push_back(b);
+        }
+    }
+    batchSizes.push_back(m_MaxBatchSize);
+    std::sort(batchSizes.begin(), batchSizes.end());
+    batchSizes.erase(std::unique(batchSizes.begin(), batchSizes.end()),
+        batchSizes.end());
+
+    using Clock = std::chrono::steady_clock;
+    auto elapsedMs = [](Clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - since)
+            .count();
+    };
+    Clock::time_point start = Clock::now();
+    double firstMs = 0;
+    unsigned int numBatches = 0;
+
+    for (unsigned int batchSize : batchSizes)
+    {
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            /* Queue one batch per execution context before dequeuing so that
+             * each of them gets warmed up. */
+            for (size_t c = 0; c < m_ExecContexts.size(); c++)
+            {
+                NvDsInferContextBatchInput input{};
+                input.inputFrames = frames.data();
+                input.numInputFrames = batchSize;
+                input.inputFormat =
+                    gray ? NvDsInferFormat_GRAY : NvDsInferFormat_RGBA;
+                input.inputPitch = pitch;
+                RETURN_NVINFER_ERROR(queueInputBatch(input),
+                    "warm-up failed to queue a batch of size %u", batchSize);
+            }
+            for (size_t c = 0; c < m_ExecContexts.size(); c++)
+            {
+                NvDsInferContextBatchOutput output{};
+                RETURN_NVINFER_ERROR(dequeueOutputBatch(output),
+                    "warm-up failed to dequeue a batch of size %u", batchSize);
+                releaseBatchOutput(output);
+
+                if (!numBatches++)
+                    firstMs = elapsedMs(start);
+            }
+        }
+    }
+
+    printInfo("Warm-up of %u batches (%zu batch sizes up to %u) took %.1f ms, "
+        "first batch %.1f ms", numBatches, batchSizes.size(), m_MaxBatchSize,
+        elapsedMs(start), firstMs);
     return NVDSINFER_SUCCESS;
 }
 
@@ -1088,78 +1478,30 @@ NvDsInferContextImpl::getNetworkInfo(NvDsInferNetworkInfo &networkInfo)
 NvDsInferStatus
 NvDsInferContextImpl::allocateBuffers()
 {
-    /* Create the cuda stream on which inference jobs will be executed. */
-    m_InferStream = std::make_unique<CudaStream>(cudaStreamNonBlocking);
-    if (!m_InferStream || !m_InferStream->ptr())
-    {
-        printError("Failed to create infer cudaStream");
-        return NVDSINFER_CUDA_ERROR;
-    }
-    std::string nvtx_name = "nvdsinfer_infer_uid=" + std::to_string(m_UniqueID);
-    nvtxNameCudaStreamA(*m_InferStream, nvtx_name.c_str());
-
     /* Create the cuda stream on which post-processing jobs will be
      * executed. */
-    m_PostprocessStream = std::make_unique<CudaStream>(cudaStreamNonBlocking);
-    if (!m_PostprocessStream || !m_PostprocessStream->ptr())
+    if (!m_HostMemory)
     {
-        printError("Failed to create cudaStream");
-        return NVDSINFER_CUDA_ERROR;
-    }
-    nvtx_name = "nvdsinfer_postproc_uid=" + std::to_string(m_UniqueID);
-    nvtxNameCudaStreamA(*m_InferStream, nvtx_name.c_str());
-
-    /* Cuda event to synchronize between consumption of input binding buffer by
-     * the cuda engine and the pre-processing kernel which writes to the input
-     * binding buffer. */
-    m_InputConsumedEvent = std::make_unique<CudaEvent>(cudaEventDisableTiming);
-    if ((cudaEvent_t)(*m_InputConsumedEvent) == nullptr)
-    {
-        printError("Failed to create input consume cuda event");
-        return NVDSINFER_CUDA_ERROR;
+        m_PostprocessStream =
+            std::make_unique<CudaStream>(cudaStreamNonBlocking);
+        if (!m_PostprocessStream || !m_PostprocessStream->ptr())
+        {
+            printError("Failed to create cudaStream");
+            return NVDSINFER_CUDA_ERROR;
+        }
+        std::string nvtx_name =
+            "nvdsinfer_postproc_uid=" + std::to_string(m_UniqueID);
+        nvtxNameCudaStreamA(*m_PostprocessStream, nvtx_name.c_str());
     }
-    nvtx_name =
-        "nvdsinfer_TRT_input_consumed_uid=" + std::to_string(m_UniqueID);
-    nvtxNameCudaEventA(*m_InputConsumedEvent, nvtx_name.c_str());
 
-    /* Cuda event to synchronize between completion of inference on a batch
-     * and copying the output contents from device to host memory. */
-    m_InferCompleteEvent = std::make_unique<CudaEvent>(cudaEventDisableTiming);
-    if ((cudaEvent_t)(*m_InferCompleteEvent) == nullptr)
+    for (auto& exec : m_ExecContexts)
     {
-        printError("Failed to create cuda event");
-        return NVDSINFER_CUDA_ERROR;
+        RETURN_NVINFER_ERROR(allocateExecContext(*exec),
+            "Failed to allocate execution context resources");
     }
-    nvtx_name = "nvdsinfer_infer_complete_uid=" + std::to_string(m_UniqueID);
-    nvtxNameCudaEventA(*m_InferCompleteEvent, nvtx_name.c_str());
-
-    /* Resize the binding buffers vector to the number of bound layers. */
-    m_BindingBuffers.assign(m_AllLayerInfo.size(), nullptr);
-
-    /* allocate input/output layers buffers */
-    for (size_t iL = 0; iL < m_AllLayerInfo.size(); iL++)
-    {
-        const NvDsInferBatchDimsLayerInfo& layerInfo = m_AllLayerInfo[iL];
-        /* Do not allocate device memory for output layers here. */
-        if (!layerInfo.isInput)
-            continue;
 
-        const NvDsInferDims& layerDims = layerInfo.inferDims;
-        assert(layerDims.numElements > 0);
-        size_t size = m_MaxBatchSize * layerDims.numElements *
-                      getElementSize(layerInfo.dataType);
-
-        auto inputBuf = std::make_unique<CudaDeviceBuffer>(size);
-        if (!inputBuf || !inputBuf->ptr())
-        {
-            printError(
-                "Failed to allocate cuda input buffer during context "
-                "initialization");
-            return NVDSINFER_CUDA_ERROR;
-        }
-        m_BindingBuffers[iL] = inputBuf->ptr();
-        m_InputDeviceBuffers.emplace_back(std::move(inputBuf));
-    }
+    m_FreeBatchQueue.setCapacity(m_Batches.size());
+    m_ProcessBatchQueue.setCapacity(m_Batches.size());
 
     /* Initialize the batch vector, allocate host memory for the layers,
      * add all the free indexes to the free queue. */
@@ -1181,10 +1523,11 @@ NvDsInferContextImpl::allocateBuffers()
 
             if (layerInfo.isInput)
             {
-                /* Reuse input binding buffer pointers. */
-                batch.m_DeviceBuffers[jL] = m_BindingBuffers[jL];
+                /* Reuse input binding buffer pointers. Reassigned to the
+                 * buffers of the execution context the batch is queued to. */
+                batch.m_DeviceBuffers[jL] = m_ExecContexts[0]->m_BindingBuffers[jL];
             }
-            else
+            else if (!m_HostMemory)
             {
                 /* Allocate device memory for output layers here. */
                 auto outputBuf = std::make_unique<CudaDeviceBuffer>(size);
@@ -1204,7 +1547,7 @@ NvDsInferContextImpl::allocateBuffers()
             if (layerInfo.isInput && !m_Postprocessor->needInputCopy())
                 continue;
 
-            auto hostBuf = std::make_unique<CudaHostBuffer>(size);
+            auto hostBuf = allocHostBuffer(size);
             if (!hostBuf || !hostBuf->ptr())
             {
                 printError(
@@ -1212,15 +1555,22 @@ NvDsInferContextImpl::allocateBuffers()
                     "initialization");
                 return NVDSINFER_CUDA_ERROR;
             }
+            /* In host memory, outputs are written to the host buffers. */
+            if (m_HostMemory && !layerInfo.isInput)
+                batch.m_DeviceBuffers[jL] = hostBuf->ptr();
             batch.m_HostBuffers[jL] = std::move(hostBuf);
         }
 
-        batch.m_OutputCopyDoneEvent = std::make_unique<CudaEvent>(
-            cudaEventDisableTiming | cudaEventBlockingSync);
-        if (!batch.m_OutputCopyDoneEvent || !batch.m_OutputCopyDoneEvent->ptr())
+        if (!m_HostMemory)
         {
-            printError("Failed to create cuda event");
-            return NVDSINFER_CUDA_ERROR;
+            batch.m_OutputCopyDoneEvent = std::make_unique<CudaEvent>(
+                cudaEventDisableTiming | cudaEventBlockingSync);
+            if (!batch.m_OutputCopyDoneEvent ||
+                !batch.m_OutputCopyDoneEvent->ptr())
+            {
+                printError("Failed to create cuda event");
+                return NVDSINFER_CUDA_ERROR;
+            }
         }
 
         /* Add all the indexes to the free queue initially. */
@@ -1230,6 +1580,106 @@ NvDsInferContextImpl::allocateBuffers()
     return NVDSINFER_SUCCESS;
 }
 
+/* Create the stream and events of an execution context and allocate its input
+ * binding buffers. */
+NvDsInferStatus
+NvDsInferContextImpl::allocateExecContext(NvDsInferExecContext& exec)
+{
+    /* Batches are inferred synchronously in host memory, without streams
+     * or events. */
+    if (!m_HostMemory)
+    {
+        /* Create the cuda stream on which inference jobs will be executed. */
+        exec.m_InferStream =
+            std::make_unique<CudaStream>(cudaStreamNonBlocking);
+        if (!exec.m_InferStream || !exec.m_InferStream->ptr())
+        {
+            printError("Failed to create infer cudaStream");
+            return NVDSINFER_CUDA_ERROR;
+        }
+        std::string nvtx_name =
+            "nvdsinfer_infer_uid=" + std::to_string(m_UniqueID);
+        nvtxNameCudaStreamA(*exec.m_InferStream, nvtx_name.c_str());
+
+        /* Cuda event to synchronize between consumption of input binding
+         * buffer by the cuda engine and the pre-processing kernel which writes
+         * to the input binding buffer. */
+        exec.m_InputConsumedEvent =
+            std::make_unique<CudaEvent>(cudaEventDisableTiming);
+        if ((cudaEvent_t)(*exec.m_InputConsumedEvent) == nullptr)
+        {
+            printError("Failed to create input consume cuda event");
+            return NVDSINFER_CUDA_ERROR;
+        }
+        nvtx_name =
+            "nvdsinfer_TRT_input_consumed_uid=" + std::to_string(m_UniqueID);
+        nvtxNameCudaEventA(*exec.m_InputConsumedEvent, nvtx_name.c_str());
+
+        /* Cuda event to synchronize between completion of inference on a
+         * batch and copying the output contents from device to host memory. */
+        exec.m_InferCompleteEvent =
+            std::make_unique<CudaEvent>(cudaEventDisableTiming);
+        if ((cudaEvent_t)(*exec.m_InferCompleteEvent) == nullptr)
+        {
+            printError("Failed to create cuda event");
+            return NVDSINFER_CUDA_ERROR;
+        }
+        nvtx_name =
+            "nvdsinfer_infer_complete_uid=" + std::to_string(m_UniqueID);
+        nvtxNameCudaEventA(*exec.m_InferCompleteEvent, nvtx_name.c_str());
+    }
+
+    /* Resize the binding buffers vector to the number of bound layers. */
+    exec.m_BindingBuffers.assign(m_AllLayerInfo.size(), nullptr);
+
+    /* allocate input layers buffers */
+    for (size_t iL = 0; iL < m_AllLayerInfo.size(); iL++)
+    {
+        const NvDsInferBatchDimsLayerInfo& layerInfo = m_AllLayerInfo[iL];
+        /* Do not allocate device memory for output layers here. */
+        if (!layerInfo.isInput)
+            continue;
+
+        const NvDsInferDims& layerDims = layerInfo.inferDims;
+        assert(layerDims.numElements > 0);
+        size_t size = m_MaxBatchSize * layerDims.numElements *
+                      getElementSize(layerInfo.dataType);
+
+        auto inputBuf = allocDeviceBuffer(size);
+        if (!inputBuf || !inputBuf->ptr())
+        {
+            printError(
+                "Failed to allocate cuda input buffer during context "
+                "initialization");
+            return NVDSINFER_CUDA_ERROR;
+        }
+        exec.m_BindingBuffers[iL] = inputBuf->ptr();
+        exec.m_InputDeviceBuffers.emplace_back(std::move(inputBuf));
+    }
+
+    return NVDSINFER_SUCCESS;
+}
+
+/* Allocate a buffer the backend binds, in system memory in host memory
+ * mode. */
+std::unique_ptr<CudaBuffer>
+NvDsInferContextImpl::allocDeviceBuffer(size_t size)
+{
+    if (m_HostMemory)
+        return std::make_unique<SysMemBuffer>(size);
+    return std::make_unique<CudaDeviceBuffer>(size);
+}
+
+/* Allocate a buffer outputs are parsed from, pageable in host memory mode
+ * since nothing is copied to it asynchronously. */
+std::unique_ptr<CudaBuffer>
+NvDsInferContextImpl::allocHostBuffer(size_t size)
+{
+    if (m_HostMemory)
+        return std::make_unique<SysMemBuffer>(size);
+    return std::make_unique<CudaHostBuffer>(size);
+}
+
 /* Initialize non-image input layers if the custom library has implemented
  * the interface. */
 NvDsInferStatus
@@ -1289,18 +1739,21 @@ NvDsInferContextImpl::initNonImageInputLayers()
     }
 
     /* Memcpy the initialized contents from the host memory to device memory for
-     * layer binding buffers. */
+     * layer binding buffers of every execution context. */
     for (size_t i = 0; i < inputLayers.size(); i++)
     {
-        cudaReturn =
-            cudaMemcpyAsync(m_BindingBuffers[inputLayers[i].bindingIndex],
-                initBuffers[i].data(), initBuffers[i].size(),
-                cudaMemcpyHostToDevice, *m_InferStream);
-        if (cudaReturn != cudaSuccess)
+        for (auto& exec : m_ExecContexts)
         {
-            printError("Failed to copy from host to device memory (%s)",
-                    cudaGetErrorName(cudaReturn));
-            return NVDSINFER_CUDA_ERROR;
+            cudaReturn = cudaMemcpyAsync(
+                exec->m_BindingBuffers[inputLayers[i].bindingIndex],
+                initBuffers[i].data(), initBuffers[i].size(),
+                cudaMemcpyHostToDevice, *exec->m_InferStream);
+            if (cudaReturn != cudaSuccess)
+            {
+                printError("Failed to copy from host to device memory (%s)",
+                        cudaGetErrorName(cudaReturn));
+                return NVDSINFER_CUDA_ERROR;
+            }
         }
 
         /* Application has requested access to the bound buffer contents. Copy
@@ -1316,12 +1769,15 @@ NvDsInferContextImpl::initNonImageInputLayers()
             }
         }
     }
-    cudaReturn = cudaStreamSynchronize(*m_InferStream);
-    if (cudaReturn != cudaSuccess)
+    for (auto& exec : m_ExecContexts)
     {
-        printError("Failed to synchronize cuda stream(%s)",
-                cudaGetErrorName(cudaReturn));
-        return NVDSINFER_CUDA_ERROR;
+        cudaReturn = cudaStreamSynchronize(*exec->m_InferStream);
+        if (cudaReturn != cudaSuccess)
+        {
+            printError("Failed to synchronize cuda stream(%s)",
+                    cudaGetErrorName(cudaReturn));
+            return NVDSINFER_CUDA_ERROR;
+        }
     }
 
     return NVDSINFER_SUCCESS;
@@ -1371,16 +1827,24 @@ NvDsInferContextImpl::queueInputBatch(NvDsInferContextBatchInput &batchInput)
         return NVDSINFER_INVALID_PARAMS;
     }
 
+    if (m_HostMemory)
+        return queueHostInputBatch(batchInput);
+
     /* Set the cuda device to be used. */
     RETURN_CUDA_ERR(cudaSetDevice(m_GpuID),
         "queue buffer failed to set cuda device(%s)", m_GpuID);
 
-    std::shared_ptr<CudaEvent> preprocWaitEvent = m_InputConsumedEvent;
+    /* Batches are only queued from a single thread, the in-flight counts can
+     * only drop between selection and use. */
+    unsigned int execIdx = m_ExecScheduler.select();
+    NvDsInferExecContext& exec = *m_ExecContexts[execIdx];
 
-    assert(m_Preprocessor && m_InputConsumedEvent);
+    std::shared_ptr<CudaEvent> preprocWaitEvent = exec.m_InputConsumedEvent;
+
+    assert(m_Preprocessor && exec.m_InputConsumedEvent);
     RETURN_NVINFER_ERROR(m_Preprocessor->transform(batchInput,
-                             m_BindingBuffers[INPUT_LAYER_INDEX],
-                             *m_InferStream, preprocWaitEvent.get()),
+                             exec.m_BindingBuffers[INPUT_LAYER_INDEX],
+                             *exec.m_InferStream, preprocWaitEvent.get()),
         "Preprocessor transform input data failed.");
 
     /* We may use multiple sets of the output device and host buffers since
@@ -1395,33 +1859,118 @@ NvDsInferContextImpl::queueInputBatch(NvDsInferContextBatchInput &batchInput)
         m_FreeBatchQueue.pop(), recyleFunc);
     assert(safeRecyleBatch);
     safeRecyleBatch->m_BatchSize = batchSize;
+    safeRecyleBatch->m_ExecContextIdx = execIdx;
+    safeRecyleBatch->m_ProfileIdx = exec.m_Backend->selectProfile(batchSize);
 
-    /* Fill the array of binding buffers for the current batch. */
+    /* Fill the array of binding buffers for the current batch. Input layers
+     * are bound to the buffers of the selected execution context. */
     std::vector<void*>& bindings = safeRecyleBatch->m_DeviceBuffers;
+    for (size_t iL = 0; iL < m_AllLayerInfo.size(); iL++)
+    {
+        if (m_AllLayerInfo[iL].isInput)
+            bindings[iL] = exec.m_BindingBuffers[iL];
+    }
     auto backendBuffer = std::make_shared<BackendBatchBuffer>(
         bindings, m_AllLayerInfo, batchSize);
-    assert(m_BackendContext && backendBuffer);
-    assert(m_InferStream && m_InputConsumedEvent && m_InferCompleteEvent);
+    assert(exec.m_Backend && backendBuffer);
+    assert(exec.m_InferStream && exec.m_InputConsumedEvent &&
+        exec.m_InferCompleteEvent);
 
-    RETURN_NVINFER_ERROR(m_BackendContext->enqueueBuffer(backendBuffer,
-                             *m_InferStream, m_InputConsumedEvent.get()),
+    RETURN_NVINFER_ERROR(exec.m_Backend->enqueueBuffer(backendBuffer,
+                             *exec.m_InferStream,
+                             exec.m_InputConsumedEvent.get()),
         "Infer context enqueue buffer failed");
 
-    /* Record event on m_InferStream to indicate completion of inference on the
-     * current batch. */
-    RETURN_CUDA_ERR(cudaEventRecord(*m_InferCompleteEvent, *m_InferStream),
+    /* Record event on the infer stream to indicate completion of inference on
+     * the current batch. */
+    RETURN_CUDA_ERR(
+        cudaEventRecord(*exec.m_InferCompleteEvent, *exec.m_InferStream),
         "Failed to record cuda infer-complete-event ");
 
-    assert(m_PostprocessStream && m_InferCompleteEvent);
+    assert(m_PostprocessStream && exec.m_InferCompleteEvent);
     /* Make future jobs on the postprocessing stream wait on the infer
      * completion event. */
-    RETURN_CUDA_ERR(
-        cudaStreamWaitEvent(*m_PostprocessStream, *m_InferCompleteEvent, 0),
+    RETURN_CUDA_ERR(cudaStreamWaitEvent(
+                        *m_PostprocessStream, *exec.m_InferCompleteEvent, 0),
         "postprocessing cuda waiting event failed ");
     RETURN_NVINFER_ERROR(m_Postprocessor->copyBuffersToHostMemory(
                              *safeRecyleBatch, *m_PostprocessStream),
         "post cuda process failed.");
 
+    /* The process queue is FIFO, outputs are dequeued in the order batches
+     * were queued whichever execution context finishes first. */
+    m_ExecScheduler.acquire(safeRecyleBatch->m_ExecContextIdx);
+    int profileIdx = safeRecyleBatch->m_ProfileIdx;
+    if (profileIdx >= (int)m_ProfileBatchCounts.size())
+        m_ProfileBatchCounts.resize(profileIdx + 1, 0);
+    m_ProfileBatchCounts[profileIdx]++;
+
+    m_ProcessBatchQueue.push(safeRecyleBatch.release());
+    return NVDSINFER_SUCCESS;
+}
+
+/* Queue a batch in host memory mode. Input frames are preprocessed on the CPU
+ * if a preprocessor exists (CPU inference), they are not read otherwise
+ * (replayed tensors). The backend writes the outputs to the host buffers
+ * before returning and the input frames are returned right away. */
+NvDsInferStatus
+NvDsInferContextImpl::queueHostInputBatch(NvDsInferContextBatchInput& batchInput)
+{
+    uint32_t batchSize = batchInput.numInputFrames;
+    NvDsInferExecContext& exec = *m_ExecContexts[0];
+
+    auto recyleFunc = [this](NvDsInferBatch* batch) {
+        if (batch)
+            m_FreeBatchQueue.push(batch);
+    };
+    std::unique_ptr<NvDsInferBatch, decltype(recyleFunc)> safeRecyleBatch(
+        m_FreeBatchQueue.pop(), recyleFunc);
+    assert(safeRecyleBatch);
+    safeRecyleBatch->m_BatchSize = batchSize;
+    safeRecyleBatch->m_ExecContextIdx = 0;
+    safeRecyleBatch->m_ProfileIdx = exec.m_Backend->selectProfile(batchSize);
+
+    std::vector<void*>& bindings = safeRecyleBatch->m_DeviceBuffers;
+    for (size_t iL = 0; iL < m_AllLayerInfo.size(); iL++)
+    {
+        if (m_AllLayerInfo[iL].isInput)
+            bindings[iL] = exec.m_BindingBuffers[iL];
+    }
+    auto backendBuffer = std::make_shared<BackendBatchBuffer>(
+        bindings, m_AllLayerInfo, batchSize);
+
+    if (m_Preprocessor)
+    {
+        RETURN_NVINFER_ERROR(m_Preprocessor->transformHost(
+                                 batchInput, bindings[INPUT_LAYER_INDEX]),
+            "Preprocessor transform input data failed.");
+    }
+
+    CudaStream noStream(nullptr);
+    RETURN_NVINFER_ERROR(
+        exec.m_Backend->enqueueBuffer(backendBuffer, noStream, nullptr),
+        "Infer context enqueue buffer failed");
+
+    if (batchInput.returnInputFunc)
+        batchInput.returnInputFunc(batchInput.returnFuncData);
+
+    /* Input host buffers are only allocated if the application reads them. */
+    for (size_t iL = 0; iL < m_AllLayerInfo.size(); iL++)
+    {
+        const NvDsInferBatchDimsLayerInfo& info = m_AllLayerInfo[iL];
+        if (!info.isInput || !safeRecyleBatch->m_HostBuffers[iL])
+            continue;
+        memcpy(safeRecyleBatch->m_HostBuffers[iL]->ptr(), bindings[iL],
+            getElementSize(info.dataType) * info.inferDims.numElements *
+                batchSize);
+    }
+
+    m_ExecScheduler.acquire(safeRecyleBatch->m_ExecContextIdx);
+    int profileIdx = safeRecyleBatch->m_ProfileIdx;
+    if (profileIdx >= (int)m_ProfileBatchCounts.size())
+        m_ProfileBatchCounts.resize(profileIdx + 1, 0);
+    m_ProfileBatchCounts[profileIdx]++;
+
     m_ProcessBatchQueue.push(safeRecyleBatch.release());
     return NVDSINFER_SUCCESS;
 }
@@ -1439,19 +1988,27 @@ NvDsInferContextImpl::dequeueOutputBatch(NvDsInferContextBatchOutput &batchOutpu
         m_ProcessBatchQueue.pop(), recyleFunc);
     assert(recyleBatch);
 
-    /* Set the cuda device */
-    RETURN_CUDA_ERR(cudaSetDevice(m_GpuID),
-        "dequeue buffer failed to set cuda device(%s)", m_GpuID);
+    /* Outputs of batches queued in host memory are already written. */
+    if (!m_HostMemory)
+    {
+        /* Set the cuda device */
+        RETURN_CUDA_ERR(cudaSetDevice(m_GpuID),
+            "dequeue buffer failed to set cuda device(%s)", m_GpuID);
 
-    /* Wait for the copy to the current set of host buffers to complete. */
-    RETURN_CUDA_ERR(cudaEventSynchronize(*recyleBatch->m_OutputCopyDoneEvent),
-        "Failed to synchronize on cuda copy-coplete-event");
+        /* Wait for the copy to the current set of host buffers to
+         * complete. */
+        RETURN_CUDA_ERR(
+            cudaEventSynchronize(*recyleBatch->m_OutputCopyDoneEvent),
+            "Failed to synchronize on cuda copy-coplete-event");
+    }
+    m_ExecScheduler.release(recyleBatch->m_ExecContextIdx);
 
     assert(m_Postprocessor);
     /* Fill the host buffers information in the output. */
     RETURN_NVINFER_ERROR(
         m_Postprocessor->postProcessHost(*recyleBatch, batchOutput),
         "postprocessing host buffers failed.");
+    batchOutput.profileIndex = recyleBatch->m_ProfileIdx;
 
     /* Hold batch private data */
     batchOutput.priv = (void*)recyleBatch.release();
@@ -1483,7 +2040,12 @@ NvDsInferContextImpl::releaseBatchOutput(NvDsInferContextBatchOutput &batchOutpu
         return;
     }
     batch->m_BuffersWithContext = true;
-    m_FreeBatchQueue.push(batch);
+    if (!m_FreeBatchQueue.push(batch))
+    {
+        printWarning("Free batch queue is full, outputBatchID not released");
+        batch->m_BuffersWithContext = false;
+        return;
+    }
 
     assert(m_Postprocessor);
     m_Postprocessor->freeBatchOutput(batchOutput);
@@ -1558,8 +2120,13 @@ NvDsInferContextImpl::deserializeEngineAndBackend(const std::string enginePath,
         m_GpuID, *gTrtLogger, m_CustomLibHandle);
     assert(builder);
 
-    std::shared_ptr<TrtEngine> newEngine =
-        builder->deserializeEngine(enginePath, dla);
+    /* Other contexts of the process may have deserialized the engine already,
+     * only the execution context is created then. */
+    bool shared = false;
+    std::shared_ptr<TrtEngine> newEngine = TrtEngineRegistry::instance().acquire(
+        TrtEngineRegistry::engineKey(enginePath, m_GpuID, dla,
+            m_CustomLibHandle ? m_CustomLibHandle->getPath() : ""),
+        [&]() { return builder->deserializeEngine(enginePath, dla); }, shared);
     if (!newEngine)
     {
         printWarning(
@@ -1574,8 +2141,16 @@ NvDsInferContextImpl::deserializeEngineAndBackend(const std::string enginePath,
         return false;
     }
 
-    printInfo("deserialized trt engine from :%s", safeStr(enginePath));
-    newEngine->printEngineInfo();
+    if (shared)
+    {
+        printInfo("shared trt engine of :%s with other contexts",
+            safeStr(enginePath));
+    }
+    else
+    {
+        printInfo("deserialized trt engine from :%s", safeStr(enginePath));
+        newEngine->printEngineInfo();
+    }
 
     engine = std::move(newEngine);
     backend = std::move(newBackend);
@@ -1584,9 +2159,11 @@ NvDsInferContextImpl::deserializeEngineAndBackend(const std::string enginePath,
 
 /* Create engine and backend context for the model from the init params
  * (caffemodel & prototxt/uff/onnx, int8 calibration tables, etc) and return the
- * backend */
+ * backend. The engine is serialized to cachePath if set, otherwise to the
+ * path suggested by the builder. */
 std::unique_ptr<BackendContext>
-NvDsInferContextImpl::buildModel(NvDsInferContextInitParams& initParams)
+NvDsInferContextImpl::buildModel(NvDsInferContextInitParams& initParams,
+    const std::string& cachePath)
 {
     printInfo("Trying to create engine from model files");
 
@@ -1595,8 +2172,10 @@ NvDsInferContextImpl::buildModel(NvDsInferContextInitParams& initParams)
             initParams.gpuID, *gTrtLogger, m_CustomLibHandle);
     assert(builder);
 
-    if (!string_empty(initParams.int8CalibrationFilePath) &&
-        file_accessible(initParams.int8CalibrationFilePath))
+    bool calibrationTableExists =
+        !string_empty(initParams.int8CalibrationFilePath) &&
+        file_accessible(initParams.int8CalibrationFilePath);
+    if (calibrationTableExists)
     {
         auto calibrator = std::make_unique<NvDsInferInt8Calibrator>(
             initParams.int8CalibrationFilePath);
@@ -1612,6 +2191,24 @@ NvDsInferContextImpl::buildModel(NvDsInferContextInitParams& initParams)
         return nullptr;
     }
 
+    if (!cachePath.empty())
+    {
+        enginePath = cachePath;
+        /* A calibration table generated by the build is part of the key the
+         * next start computes, store the engine under that key. */
+        if (!calibrationTableExists &&
+            !string_empty(initParams.int8CalibrationFilePath) &&
+            file_accessible(initParams.int8CalibrationFilePath))
+        {
+            std::string builtPath = getEngineCachePath(initParams);
+            if (!builtPath.empty())
+                enginePath = builtPath;
+        }
+        if (mkdir(initParams.engineCacheDir, 0755) != 0 && errno != EEXIST)
+            printWarning("failed to create engine cache dir: %s",
+                safeStr(initParams.engineCacheDir));
+    }
+
     if (builder->serializeEngine(enginePath, engine->engine()) !=
         NVDSINFER_SUCCESS)
     {
@@ -1622,6 +2219,16 @@ NvDsInferContextImpl::buildModel(NvDsInferContextInitParams& initParams)
     {
         printInfo("serialize cuda engine to file: %s successfully",
             safeStr(enginePath));
+
+        /* Register the built engine so that contexts loading the serialized
+         * file later share it. */
+        bool shared = false;
+        int dla = (initParams.useDLA && initParams.dlaCore >= 0) ?
+            initParams.dlaCore : -1;
+        engine = TrtEngineRegistry::instance().acquire(
+            TrtEngineRegistry::engineKey(enginePath, initParams.gpuID, dla,
+                m_CustomLibHandle ? m_CustomLibHandle->getPath() : ""),
+            [&]() { return engine; }, shared);
     }
 
     std::unique_ptr<BackendContext> backend;
@@ -1662,6 +2269,40 @@ NvDsInferContextImpl::generateBackendContext(NvDsInferContextInitParams& initPar
 
     std::shared_ptr<TrtEngine> engine;
     std::unique_ptr<BackendContext> backend;
+    if (!string_empty(initParams.replayTensorsFilePath))
+    {
+        backend = std::make_unique<ReplayBackendContext>(
+            initParams.replayTensorsFilePath, initParams.replayLatencyUs);
+        if (backend->initialize() != NVDSINFER_SUCCESS)
+        {
+            printError("Failed to initialize tensor replay from: %s",
+                safeStr(initParams.replayTensorsFilePath));
+            return nullptr;
+        }
+        return backend;
+    }
+
+    if (initParams.useCpuInference)
+    {
+        if (string_empty(initParams.onnxFilePath))
+        {
+            printError("CPU inference needs an ONNX model (onnx-file)");
+            return nullptr;
+        }
+        std::vector<std::string> outputNames(initParams.outputLayerNames,
+            initParams.outputLayerNames + initParams.numOutputLayers);
+        backend = std::make_unique<CpuDnnBackendContext>(
+            initParams.onnxFilePath, initParams.inferInputDims,
+            initParams.maxBatchSize, outputNames);
+        if (backend->initialize() != NVDSINFER_SUCCESS)
+        {
+            printError("Failed to initialize CPU inference of: %s",
+                safeStr(initParams.onnxFilePath));
+            return nullptr;
+        }
+        return backend;
+    }
+
     if (!string_empty(initParams.modelEngineFilePath))
     {
         if (!deserializeEngineAndBackend(
@@ -1691,7 +2332,38 @@ NvDsInferContextImpl::generateBackendContext(NvDsInferContextInitParams& initPar
         engine.reset();
     }
 
-    backend = buildModel(initParams);
+    /* Look up the engine cache before building. */
+    std::string cachePath;
+    if (!string_empty(initParams.engineCacheDir))
+    {
+        cachePath = getEngineCachePath(initParams);
+        if (cachePath.empty())
+        {
+            printWarning("failed to compute engine cache key, not caching");
+        }
+        else if (file_accessible(cachePath) &&
+            deserializeEngineAndBackend(cachePath, dla, engine, backend))
+        {
+            if (checkBackendParams(*backend, initParams) == NVDSINFER_SUCCESS)
+            {
+                printInfo("Use cached engine model: %s", safeStr(cachePath));
+                return backend;
+            }
+            printWarning(
+                "cached engine :%s failed to match config params, trying "
+                "rebuild", safeStr(cachePath));
+            backend.reset();
+            engine.reset();
+        }
+    }
+
+    if (initParams.loadEngineOnly)
+    {
+        printInfo("No usable engine found, building is disabled");
+        return nullptr;
+    }
+
+    backend = buildModel(initParams, cachePath);
     if (!backend)
     {
         printError("build backend context failed");
@@ -1707,7 +2379,8 @@ NvDsInferContextImpl::generateBackendContext(NvDsInferContextInitParams& initPar
 NvDsInferContextImpl::~NvDsInferContextImpl()
 {
     /* Set the cuda device to be used. */
-    cudaError_t cudaReturn = cudaSetDevice(m_GpuID);
+    cudaError_t cudaReturn =
+        m_HostMemory ? cudaSuccess : cudaSetDevice(m_GpuID);
     if (cudaReturn != cudaSuccess)
     {
         printError("Failed to set cuda device %d (%s).", m_GpuID,
@@ -1719,21 +2392,31 @@ NvDsInferContextImpl::~NvDsInferContextImpl()
         m_Preprocessor->syncStream();
 
     /* Clean up other cuda resources. */
-    if (m_InferStream)
+    for (auto& exec : m_ExecContexts)
     {
-        cudaStreamSynchronize(*m_InferStream);
+        if (exec->m_InferStream)
+            cudaStreamSynchronize(*exec->m_InferStream);
     }
     if (m_PostprocessStream)
     {
         cudaStreamSynchronize(*m_PostprocessStream);
     }
 
-    m_BackendContext.reset();
+    m_ExecContexts.clear();
 
-    m_InferStream.reset();
     m_PostprocessStream.reset();
-    m_InputConsumedEvent.reset();
-    m_InferCompleteEvent.reset();
+
+    if (m_ProfileBatchCounts.size() > 1)
+    {
+        std::string counts;
+        for (size_t i = 0; i < m_ProfileBatchCounts.size(); i++)
+        {
+            counts += " " + std::to_string(i) + ":" +
+                std::to_string(m_ProfileBatchCounts[i]);
+        }
+        printInfo("Batches inferred per optimization profile:%s",
+            counts.c_str());
+    }
 
     m_Preprocessor.reset();
     m_Postprocessor.reset();
@@ -1758,7 +2441,6 @@ NvDsInferContextImpl::~NvDsInferContextImpl()
         batch.m_HostBuffers.clear();
     }
     m_Batches.clear();
-    m_InputDeviceBuffers.clear();
     m_CustomLibHandle.reset();
 }
 
@@ -1821,6 +2503,7 @@ NvDsInferContext_ResetInitParams (NvDsInferContextInitParams *initParams)
     initParams->networkScaleFactor = 1.0;
     initParams->networkType = NvDsInferNetworkType_Detector;
     initParams->outputBufferPoolSize = NVDSINFER_MIN_OUTPUT_BUFFERPOOL_SIZE;
+    initParams->segmentationThreads = 1;
 }
 
 const char *
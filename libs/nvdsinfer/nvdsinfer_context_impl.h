@@ -13,6 +13,8 @@
 #define __NVDSINFER_CONTEXT_IMPL_H__
 
 #include <stdarg.h>
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <list>
@@ -28,6 +30,7 @@
 
 #include <nvdsinfer_context.h>
 #include <nvdsinfer_custom_impl.h>
+#include <nvdsinfer_tensor_view.h>
 #include <nvdsinfer_utils.h>
 
 #include "nvdsinfer_backend.h"
@@ -43,16 +46,43 @@ using NvDsInferLoggingFunc =
 typedef struct
 {
     std::vector<void*> m_DeviceBuffers;
-    std::vector<std::unique_ptr<CudaHostBuffer>> m_HostBuffers;
+    std::vector<std::unique_ptr<CudaBuffer>> m_HostBuffers;
 
     std::vector<std::unique_ptr<CudaDeviceBuffer>> m_OutputDeviceBuffers;
 
     unsigned int m_BatchSize = 0;
     std::unique_ptr<CudaEvent> m_OutputCopyDoneEvent = nullptr;
     bool m_BuffersWithContext = true;
+    /* Index of the execution context the batch has been queued to. */
+    unsigned int m_ExecContextIdx = 0;
+    /* Optimization profile the batch is inferred with. */
+    int m_ProfileIdx = 0;
+    /* Int8 quantized embeddings of the frames, kept apart from the FLOAT
+     * host output buffers. Embedding networks only. */
+    std::vector<int8_t> m_EmbeddingsInt8;
 
 } NvDsInferBatch;
 
+/**
+ * Holds a backend execution context and the resources it uses exclusively.
+ * Batches queued to different execution contexts of an engine run
+ * concurrently on the GPU.
+ */
+struct NvDsInferExecContext
+{
+    std::unique_ptr<BackendContext> m_Backend;
+    std::unique_ptr<CudaStream> m_InferStream;
+
+    /* Input binding buffers, output binding buffers are held by batches. */
+    std::vector<void*> m_BindingBuffers;
+    std::vector<std::unique_ptr<CudaBuffer>> m_InputDeviceBuffers;
+
+    /* Cuda Event for synchronizing input consumption by TensorRT CUDA engine. */
+    std::shared_ptr<CudaEvent> m_InputConsumedEvent;
+    /* Cuda Event for synchronizing infer completion by TensorRT CUDA engine. */
+    std::shared_ptr<CudaEvent> m_InferCompleteEvent;
+};
+
 /**
  * Provides pre-processing functionality like mean subtraction and normalization.
  */
@@ -69,12 +99,18 @@ public:
     }
     bool setScaleOffsets(float scale, const std::vector<float>& offsets = {});
     bool setMeanFile(const std::string& file);
+    /* Preprocess in host memory on the CPU, set before allocateResource. */
+    void setHostMemory(bool hostMemory) { m_HostMemory = hostMemory; }
 
     NvDsInferStatus allocateResource();
     NvDsInferStatus syncStream();
 
     NvDsInferStatus transform(NvDsInferContextBatchInput& batchInput,
         void* devBuf, CudaStream& mainStream, CudaEvent* waitingEvent);
+    /* CPU counterpart of transform, converts the batch synchronously into the
+     * host buffer hostBuf. */
+    NvDsInferStatus transformHost(
+        NvDsInferContextBatchInput& batchInput, void* hostBuf);
 
 private:
     NvDsInferStatus readMeanImageFile();
@@ -95,7 +131,8 @@ private:
     std::unique_ptr<CudaStream> m_PreProcessStream;
     /* Cuda Event for synchronizing completion of pre-processing. */
     std::shared_ptr<CudaEvent> m_PreProcessCompleteEvent;
-    std::unique_ptr<CudaDeviceBuffer> m_MeanDataBuffer;
+    std::unique_ptr<CudaBuffer> m_MeanDataBuffer;
+    bool m_HostMemory = false;
 };
 
 /**
@@ -174,6 +211,8 @@ protected:
     /* Custom library implementation. */
     std::shared_ptr<DlLibHandle> m_CustomLibHandle;
     bool m_CopyInputToHostBuffers = false;
+    /* Scale of INT8 output tensors. */
+    float m_OutputInt8Scale = 1.0f;
     /* Network input information. */
     NvDsInferNetworkInfo m_NetworkInfo = {0};
     std::vector<NvDsInferLayerInfo> m_AllLayerInfo;
@@ -189,7 +228,7 @@ class DetectPostprocessor : public InferPostprocessor
 public:
     DetectPostprocessor(int id, int gpuId = 0)
         : InferPostprocessor(NvDsInferNetworkType_Detector, id, gpuId) {}
-    ~DetectPostprocessor() override = default;
+    ~DetectPostprocessor() override;
 
     NvDsInferStatus initResource(
         const NvDsInferContextInitParams& initParams) override;
@@ -204,6 +243,8 @@ private:
         NvDsInferNetworkInfo const& networkInfo,
         NvDsInferParseDetectionParams const& detectionParams,
         std::vector<NvDsInferObjectDetectionInfo>& objectList);
+    void updateGridCenters(NvDsInferNetworkInfo const& networkInfo,
+        NvDsInferDimsCHW const& coverageDims, NvDsInferDimsCHW const& bboxDims);
 
     std::vector<int> nonMaximumSuppression
                      (std::vector<std::pair<float, int>>& scoreIndex,
@@ -219,6 +260,7 @@ private:
         NvDsInferDetectionOutput& output);
     void preClusteringThreshold(NvDsInferParseDetectionParams const &detectionParams,
             std::vector<NvDsInferObjectDetectionInfo> &objectList);
+    void fillObjectLandmarks(NvDsInferObject& object, size_t objectIndex);
 
 private:
     _DS_DEPRECATED_("Use m_ClusterMode instead")
@@ -241,6 +283,31 @@ private:
     std::vector<std::vector<NvDsInferObjectDetectionInfo>> m_PerClassObjectList;
 
     NvDsInferParseCustomFunc m_CustomBBoxParseFunc = nullptr;
+    /* Per-context variant of the custom parser, preferred when the custom
+     * library exports it. */
+    NvDsInferParseCustomWithContextFunc m_CustomBBoxParseWithContextFunc =
+        nullptr;
+    NvDsInferParseCustomDestroyContextFunc m_CustomBBoxDestroyContextFunc =
+        nullptr;
+    void* m_CustomBBoxParseContext = nullptr;
+    /* Landmarks variant of the per-context parser, may be null. */
+    NvDsInferParseCustomWithLandmarksFunc m_CustomBBoxParseWithLandmarksFunc =
+        nullptr;
+
+    /* Keypoints of the objects in m_ObjectList, m_NumObjectLandmarks (x, y)
+     * pairs per object, and the m_ObjectList index of each object in
+     * m_PerClassObjectList. Only filled by the landmarks parser. */
+    std::vector<float> m_ObjectLandmarks;
+    unsigned int m_NumObjectLandmarks = 0;
+    std::vector<std::vector<uint32_t>> m_PerClassObjectIndex;
+
+    /* Normalized DetectNet grid cell centers along x and y, computed for the
+     * network resolution and grid size in m_GridCentersKey. */
+    std::vector<float> m_GridCentersX;
+    std::vector<float> m_GridCentersY;
+    std::array<uint32_t, 6> m_GridCentersKey = {{0, 0, 0, 0, 0, 0}};
+    /* Grid cells of the current class above the pre-cluster threshold. */
+    std::vector<uint32_t> m_GridHits;
 };
 
 /** Implementation of post-processing class for classification networks. */
@@ -293,6 +360,35 @@ private:
 
 private:
     float m_SegmentationThreshold = 0.0f;
+    bool m_ClassMapU8 = false;
+    uint32_t m_NumThreads = 1;
+};
+
+/** Implementation of post-processing class for embedding networks. */
+class EmbeddingPostprocessor : public InferPostprocessor
+{
+public:
+    EmbeddingPostprocessor(int id, int gpuId = 0)
+        : InferPostprocessor(NvDsInferNetworkType_Embedding, id, gpuId) {}
+
+    NvDsInferStatus initResource(
+        const NvDsInferContextInitParams& initParams) override;
+
+    NvDsInferStatus postProcessHost(
+        NvDsInferBatch& buffer, NvDsInferContextBatchOutput& output) override;
+
+private:
+    NvDsInferStatus parseEachBatch(
+        const std::vector<NvDsInferLayerInfo>& outputLayers,
+        NvDsInferFrameOutput& result) override;
+
+    NvDsInferStatus fillEmbeddingOutput(
+        const std::vector<NvDsInferLayerInfo>& outputLayers,
+        NvDsInferEmbeddingOutput& output);
+    void quantizeEmbeddingOutput(
+        NvDsInferEmbeddingOutput& output, int8_t* dst);
+
+    bool m_EmbeddingInt8 = false;
 };
 
 class OtherPostprocessor : public InferPostprocessor
@@ -358,7 +454,8 @@ private:
     std::unique_ptr<BackendContext> generateBackendContext(
         NvDsInferContextInitParams& initParams);
     std::unique_ptr<BackendContext> buildModel(
-        NvDsInferContextInitParams& initParams);
+        NvDsInferContextInitParams& initParams,
+        const std::string& cachePath = "");
     bool deserializeEngineAndBackend(const std::string enginePath, int dla,
         std::shared_ptr<TrtEngine>& engine,
         std::unique_ptr<BackendContext>& backend);
@@ -368,6 +465,11 @@ private:
     NvDsInferStatus getBoundLayersInfo();
     NvDsInferStatus allocateBuffers();
     NvDsInferStatus initNonImageInputLayers();
+    NvDsInferStatus allocateExecContext(NvDsInferExecContext& exec);
+    std::unique_ptr<CudaBuffer> allocDeviceBuffer(size_t size);
+    std::unique_ptr<CudaBuffer> allocHostBuffer(size_t size);
+    NvDsInferStatus queueHostInputBatch(NvDsInferContextBatchInput& batchInput);
+    NvDsInferStatus warmUp(const NvDsInferContextInitParams& initParams);
 
     /* Input layer has a binding index of 0 */
     static const int INPUT_LAYER_INDEX = 0;
@@ -379,7 +481,9 @@ private:
 
     /* Custom unique_ptrs. These TensorRT objects will get deleted automatically
      * when the NvDsInferContext object is deleted. */
-    std::unique_ptr<BackendContext> m_BackendContext;
+    std::vector<std::unique_ptr<NvDsInferExecContext>> m_ExecContexts;
+    /* Batches in flight on each of m_ExecContexts. */
+    LeastLoadedScheduler m_ExecScheduler;
     std::shared_ptr<DlLibHandle> m_CustomLibHandle;
 
     std::unique_ptr<InferPreprocessor> m_Preprocessor;
@@ -394,29 +498,27 @@ private:
     std::vector<NvDsInferBatchDimsLayerInfo> m_OutputLayerInfo;
     NvDsInferBatchDimsLayerInfo m_InputImageLayerInfo;
 
-    std::vector<void *> m_BindingBuffers;
-    std::vector<std::unique_ptr<CudaDeviceBuffer>> m_InputDeviceBuffers;
-
     uint32_t m_OutputBufferPoolSize = NVDSINFER_MIN_OUTPUT_BUFFERPOOL_SIZE;
     std::vector<NvDsInferBatch> m_Batches;
 
     /* Queues and synchronization members for processing multiple batches
-     * in parallel.
+     * in parallel. A batch is in at most one queue at a time, the queues hold
+     * all of m_Batches and pushes can't overflow.
      */
-    GuardQueue<std::list<NvDsInferBatch*>> m_FreeBatchQueue;
-    GuardQueue<std::list<NvDsInferBatch*>> m_ProcessBatchQueue;
+    BoundedGuardQueue<NvDsInferBatch*> m_FreeBatchQueue;
+    BoundedGuardQueue<NvDsInferBatch*> m_ProcessBatchQueue;
 
-    std::unique_ptr<CudaStream> m_InferStream;
     std::unique_ptr<CudaStream> m_PostprocessStream;
 
-    /* Cuda Event for synchronizing input consumption by TensorRT CUDA engine. */
-    std::shared_ptr<CudaEvent> m_InputConsumedEvent;
-
-    /* Cuda Event for synchronizing infer completion by TensorRT CUDA engine. */
-    std::shared_ptr<CudaEvent> m_InferCompleteEvent;
+    /* Number of batches inferred with each optimization profile. */
+    std::vector<uint64_t> m_ProfileBatchCounts;
 
     NvDsInferLoggingFunc m_LoggingFunc;
 
+    /* Buffers are in system memory and batches are inferred synchronously
+     * without CUDA, when replaying recorded tensors. */
+    bool m_HostMemory = false;
+
     bool m_Initialized = false;
 };
 
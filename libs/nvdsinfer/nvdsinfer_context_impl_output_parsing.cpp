@@ -12,6 +12,7 @@
 #include <cassert>
 
 #include "nvdsinfer_context_impl.h"
+#include "nvdsinfer_simd.h"
 
 #include <algorithm>
 
@@ -65,10 +66,10 @@ DetectPostprocessor::parseBoundingBox(vector<NvDsInferLayerInfo> const& outputLa
         return false;
     }
 
-    float *outputCoverageBuffer =
-        (float *)outputLayersInfo[outputCoverageLayerIndex].buffer;
-    float *outputBboxBuffer =
-        (float *)outputLayersInfo[outputBBoxLayerIndex].buffer;
+    NvDsInferTensorView outputCoverage(
+        outputLayersInfo[outputCoverageLayerIndex], m_OutputInt8Scale);
+    NvDsInferTensorView outputBbox(
+        outputLayersInfo[outputBBoxLayerIndex], m_OutputInt8Scale);
 
     NvDsInferDimsCHW outputCoverageDims;
     NvDsInferDimsCHW outputBBoxDims;
@@ -78,100 +79,116 @@ DetectPostprocessor::parseBoundingBox(vector<NvDsInferLayerInfo> const& outputLa
     getDimsCHWFromDims(
         outputBBoxDims, outputLayersInfo[outputBBoxLayerIndex].inferDims);
 
-    unsigned int targetShape[2] = { outputCoverageDims.w, outputCoverageDims.h };
+    updateGridCenters(networkInfo, outputCoverageDims, outputBBoxDims);
+
     float bboxNorm[2] = { 35.0, 35.0 };
-    float gcCenters0[targetShape[0]];
-    float gcCenters1[targetShape[1]];
     int gridSize = outputCoverageDims.w * outputCoverageDims.h;
-    int strideX = DIVIDE_AND_ROUND_UP(networkInfo.width, outputBBoxDims.w);
-    int strideY = DIVIDE_AND_ROUND_UP(networkInfo.height, outputBBoxDims.h);
-
-    for (unsigned int i = 0; i < targetShape[0]; i++)
-    {
-        gcCenters0[i] = (float)(i * strideX + 0.5);
-        gcCenters0[i] /= (float)bboxNorm[0];
-    }
-    for (unsigned int i = 0; i < targetShape[1]; i++)
-    {
-        gcCenters1[i] = (float)(i * strideY + 0.5);
-        gcCenters1[i] /= (float)bboxNorm[1];
-    }
+    std::vector<float> coverageScratch(
+        outputCoverage.isFloat() ? 0 : gridSize);
 
     unsigned int numClasses =
         MIN(outputCoverageDims.c, detectionParams.numClassesConfigured);
     for (unsigned int classIndex = 0; classIndex < numClasses; classIndex++)
     {
 
-        /* Pointers to memory regions containing the (x1,y1) and (x2,y2) coordinates
-         * of rectangles in the output bounding box layer. */
-        float *outputX1 = outputBboxBuffer
-            + classIndex * sizeof (float) * outputBBoxDims.h * outputBBoxDims.w;
-
-        float *outputY1 = outputX1 + gridSize;
-        float *outputX2 = outputY1 + gridSize;
-        float *outputY2 = outputX2 + gridSize;
-
-        /* Iterate through each point in the grid and check if the rectangle at that
-         * point meets the minimum threshold criteria. */
-        for (unsigned int h = 0; h < outputCoverageDims.h; h++)
+        /* Offsets of the planes containing the (x1,y1) and (x2,y2) coordinates
+         * of rectangles in the output bounding box layer, 4 per class. */
+        size_t outputX1 = classIndex * 4 * outputBBoxDims.h * outputBBoxDims.w;
+        size_t outputY1 = outputX1 + gridSize;
+        size_t outputX2 = outputY1 + gridSize;
+        size_t outputY2 = outputX2 + gridSize;
+
+        /* Scan the coverage plane for the grid cells which meet the minimum
+         * threshold criteria, then decode the rectangles of those cells
+         * only. Box coordinates of the other cells are never read. */
+        const float *outputCoverageBuffer = outputCoverage.read(
+            classIndex * gridSize, gridSize, coverageScratch.data());
+        m_GridHits.clear();
+        NvDsInferScanThreshold(outputCoverageBuffer, gridSize,
+            detectionParams.perClassPreclusterThreshold[classIndex],
+            m_GridHits);
+        objectList.reserve(objectList.size() + m_GridHits.size());
+
+        for (uint32_t i : m_GridHits)
         {
-            for (unsigned int w = 0; w < outputCoverageDims.w; w++)
-            {
-                int i = w + h * outputCoverageDims.w;
-                float confidence = outputCoverageBuffer[classIndex * gridSize + i];
-
-                if (confidence < detectionParams.perClassPreclusterThreshold[classIndex])
-                    continue;
-
-                float rectX1Float, rectY1Float, rectX2Float, rectY2Float;
-
-                /* Centering and normalization of the rectangle. */
-                rectX1Float =
-                    outputX1[w + h * outputCoverageDims.w] - gcCenters0[w];
-                rectY1Float =
-                    outputY1[w + h * outputCoverageDims.w] - gcCenters1[h];
-                rectX2Float =
-                    outputX2[w + h * outputCoverageDims.w] + gcCenters0[w];
-                rectY2Float =
-                    outputY2[w + h * outputCoverageDims.w] + gcCenters1[h];
-
-                rectX1Float *= -bboxNorm[0];
-                rectY1Float *= -bboxNorm[1];
-                rectX2Float *= bboxNorm[0];
-                rectY2Float *= bboxNorm[1];
-
-                /* Clip parsed rectangles to frame bounds. */
-                if (rectX1Float >= (int)m_NetworkInfo.width)
-                    rectX1Float = m_NetworkInfo.width - 1;
-                if (rectX2Float >= (int)m_NetworkInfo.width)
-                    rectX2Float = m_NetworkInfo.width - 1;
-                if (rectY1Float >= (int)m_NetworkInfo.height)
-                    rectY1Float = m_NetworkInfo.height - 1;
-                if (rectY2Float >= (int)m_NetworkInfo.height)
-                    rectY2Float = m_NetworkInfo.height - 1;
-
-                if (rectX1Float < 0)
-                    rectX1Float = 0;
-                if (rectX2Float < 0)
-                    rectX2Float = 0;
-                if (rectY1Float < 0)
-                    rectY1Float = 0;
-                if (rectY2Float < 0)
-                    rectY2Float = 0;
-
-                //Prevent underflows
-                if(((rectX2Float - rectX1Float) < 0) || ((rectY2Float - rectY1Float) < 0))
-                    continue;
-
-                objectList.push_back({ classIndex, rectX1Float,
-                         rectY1Float, (rectX2Float - rectX1Float),
-                         (rectY2Float - rectY1Float), confidence});
-            }
+            unsigned int h = i / outputCoverageDims.w;
+            unsigned int w = i - h * outputCoverageDims.w;
+            float confidence = outputCoverageBuffer[i];
+            float rectX1Float, rectY1Float, rectX2Float, rectY2Float;
+
+            /* Centering and normalization of the rectangle. */
+            rectX1Float = outputBbox[outputX1 + i] - m_GridCentersX[w];
+            rectY1Float = outputBbox[outputY1 + i] - m_GridCentersY[h];
+            rectX2Float = outputBbox[outputX2 + i] + m_GridCentersX[w];
+            rectY2Float = outputBbox[outputY2 + i] + m_GridCentersY[h];
+
+            rectX1Float *= -bboxNorm[0];
+            rectY1Float *= -bboxNorm[1];
+            rectX2Float *= bboxNorm[0];
+            rectY2Float *= bboxNorm[1];
+
+            /* Clip parsed rectangles to frame bounds. */
+            if (rectX1Float >= (int)m_NetworkInfo.width)
+                rectX1Float = m_NetworkInfo.width - 1;
+            if (rectX2Float >= (int)m_NetworkInfo.width)
+                rectX2Float = m_NetworkInfo.width - 1;
+            if (rectY1Float >= (int)m_NetworkInfo.height)
+                rectY1Float = m_NetworkInfo.height - 1;
+            if (rectY2Float >= (int)m_NetworkInfo.height)
+                rectY2Float = m_NetworkInfo.height - 1;
+
+            if (rectX1Float < 0)
+                rectX1Float = 0;
+            if (rectX2Float < 0)
+                rectX2Float = 0;
+            if (rectY1Float < 0)
+                rectY1Float = 0;
+            if (rectY2Float < 0)
+                rectY2Float = 0;
+
+            //Prevent underflows
+            if(((rectX2Float - rectX1Float) < 0) || ((rectY2Float - rectY1Float) < 0))
+                continue;
+
+            objectList.push_back({ classIndex, rectX1Float,
+                     rectY1Float, (rectX2Float - rectX1Float),
+                     (rectY2Float - rectY1Float), confidence});
         }
     }
     return true;
 }
 
+/* Precompute the normalized centers of the DetectNet grid cells. They only
+ * depend on the network resolution and the grid size, so they are computed
+ * at init and again only if those change. */
+void
+DetectPostprocessor::updateGridCenters(NvDsInferNetworkInfo const& networkInfo,
+    NvDsInferDimsCHW const& coverageDims, NvDsInferDimsCHW const& bboxDims)
+{
+    std::array<uint32_t, 6> key = {{networkInfo.width, networkInfo.height,
+        coverageDims.w, coverageDims.h, bboxDims.w, bboxDims.h}};
+    if (key == m_GridCentersKey && !m_GridCentersX.empty())
+        return;
+
+    float bboxNorm[2] = { 35.0, 35.0 };
+    int strideX = DIVIDE_AND_ROUND_UP(networkInfo.width, bboxDims.w);
+    int strideY = DIVIDE_AND_ROUND_UP(networkInfo.height, bboxDims.h);
+
+    m_GridCentersX.resize(coverageDims.w);
+    m_GridCentersY.resize(coverageDims.h);
+    for (unsigned int i = 0; i < coverageDims.w; i++)
+    {
+        m_GridCentersX[i] = (float)(i * strideX + 0.5);
+        m_GridCentersX[i] /= (float)bboxNorm[0];
+    }
+    for (unsigned int i = 0; i < coverageDims.h; i++)
+    {
+        m_GridCentersY[i] = (float)(i * strideY + 0.5);
+        m_GridCentersY[i] /= (float)bboxNorm[1];
+    }
+    m_GridCentersKey = key;
+}
+
 /**
  * Filter out objects which have been specificed to be removed from the metadata
  * prior to clustering operation
@@ -180,6 +197,32 @@ void DetectPostprocessor::preClusteringThreshold(
                            NvDsInferParseDetectionParams const &detectionParams,
                            std::vector<NvDsInferObjectDetectionInfo> &objectList)
 {
+    if (m_NumObjectLandmarks)
+    {
+        /* Compact the landmarks along with their objects. */
+        size_t stride = m_NumObjectLandmarks * 2;
+        size_t numKept = 0;
+        for (size_t i = 0; i < objectList.size(); i++)
+        {
+            const NvDsInferObjectDetectionInfo& obj = objectList[i];
+            if (obj.classId >= detectionParams.numClassesConfigured ||
+                obj.detectionConfidence <
+                    detectionParams.perClassPreclusterThreshold[obj.classId])
+                continue;
+            if (numKept != i)
+            {
+                objectList[numKept] = obj;
+                std::copy(m_ObjectLandmarks.begin() + i * stride,
+                    m_ObjectLandmarks.begin() + (i + 1) * stride,
+                    m_ObjectLandmarks.begin() + numKept * stride);
+            }
+            numKept++;
+        }
+        objectList.resize(numKept);
+        m_ObjectLandmarks.resize(numKept * stride);
+        return;
+    }
+
     objectList.erase(std::remove_if(objectList.begin(), objectList.end(),
                [detectionParams](const NvDsInferObjectDetectionInfo& obj)
                { return (obj.classId >= detectionParams.numClassesConfigured) ||
@@ -252,6 +295,10 @@ DetectPostprocessor::clusterAndFillDetectionOutputNMS(NvDsInferDetectionOutput &
     size_t totalObjects = 0;
     std::vector<std::pair<float, int>> scoreIndex;
     std::vector<NvDsInferObjectDetectionInfo> clusteredBboxes;
+    /* m_ObjectList index of each clustered box, for its landmarks. */
+    std::vector<uint32_t> clusteredIndices;
+    bool withLandmarks = m_NumObjectLandmarks &&
+        m_ClusterMode == NVDSINFER_CLUSTER_NMS;
     auto maxElement = *std::max_element(m_PerClassObjectList.begin(),
                             m_PerClassObjectList.end(), maxComp);
     clusteredBboxes.reserve(maxElement.size() * m_NumDetectedClasses);
@@ -279,13 +326,15 @@ DetectPostprocessor::clusterAndFillDetectionOutputNMS(NvDsInferDetectionOutput &
                 m_PerClassDetectionParams[c].postClusterThreshold)
                 {
                     clusteredBboxes.emplace_back(m_PerClassObjectList[c][idx]);
+                    if (withLandmarks)
+                        clusteredIndices.push_back(m_PerClassObjectIndex[c][idx]);
                     ++totalObjects;
                 }
             }
         }
     }
 
-    output.objects = new NvDsInferObject[totalObjects];
+    output.objects = new NvDsInferObject[totalObjects]();
     output.numObjects = 0;
 
     for(uint i=0; i < clusteredBboxes.size(); ++i)
@@ -300,6 +349,8 @@ DetectPostprocessor::clusterAndFillDetectionOutputNMS(NvDsInferDetectionOutput &
         if (object.classIndex < static_cast<int>(m_Labels.size()) && m_Labels[object.classIndex].size() > 0)
                 object.label = strdup(m_Labels[object.classIndex][0].c_str());
         object.confidence = clusteredBboxes[i].detectionConfidence;
+        if (withLandmarks)
+            fillObjectLandmarks(object, clusteredIndices[i]);
         output.numObjects++;
     }
 }
@@ -335,7 +386,7 @@ DetectPostprocessor::clusterAndFillDetectionOutputCV(NvDsInferDetectionOutput& o
         totalObjects += m_PerClassCvRectList[c].size();
     }
 
-    output.objects = new NvDsInferObject[totalObjects];
+    output.objects = new NvDsInferObject[totalObjects]();
     output.numObjects = 0;
 
     for (unsigned int c = 0; c < m_NumDetectedClasses; c++)
@@ -398,7 +449,7 @@ DetectPostprocessor::clusterAndFillDetectionOutputDBSCAN(NvDsInferDetectionOutpu
         totalObjects += m_PerClassObjectList[c].size();
     }
 
-    output.objects = new NvDsInferObject[totalObjects];
+    output.objects = new NvDsInferObject[totalObjects]();
     output.numObjects = 0;
 
     for (unsigned int c = 0; c < m_NumDetectedClasses; c++)
@@ -456,6 +507,20 @@ DetectPostprocessor::clusterAndFillDetectionOutputHybrid(NvDsInferDetectionOutpu
     return clusterAndFillDetectionOutputNMS(output);
 }
 
+/**
+ * Copy the landmarks of m_ObjectList[objectIndex] to the output object.
+ */
+void
+DetectPostprocessor::fillObjectLandmarks(NvDsInferObject& object,
+    size_t objectIndex)
+{
+    size_t stride = m_NumObjectLandmarks * 2;
+    const float* src = m_ObjectLandmarks.data() + objectIndex * stride;
+    object.landmarks = new float[stride];
+    std::copy(src, src + stride, object.landmarks);
+    object.numLandmarks = m_NumObjectLandmarks;
+}
+
 /**
  * full the output structure without performing any clustering operations
  */
@@ -463,7 +528,7 @@ DetectPostprocessor::clusterAndFillDetectionOutputHybrid(NvDsInferDetectionOutpu
 void
 DetectPostprocessor::fillUnclusteredOutput(NvDsInferDetectionOutput& output)
 {
-    output.objects = new NvDsInferObject[m_ObjectList.size()];
+    output.objects = new NvDsInferObject[m_ObjectList.size()]();
     output.numObjects = 0;
     for(const auto& obj : m_ObjectList)
     {
@@ -477,6 +542,8 @@ DetectPostprocessor::fillUnclusteredOutput(NvDsInferDetectionOutput& output)
         if(obj.classId < m_Labels.size() && m_Labels[obj.classId].size() > 0)
             object.label = strdup(m_Labels[obj.classId][0].c_str());
         object.confidence = obj.detectionConfidence;
+        if (m_NumObjectLandmarks)
+            fillObjectLandmarks(object, output.numObjects);
         ++output.numObjects;
     }
 }
@@ -503,8 +570,11 @@ ClassifyPostprocessor::parseAttributesFromSoftmaxLayers(
 
         getDimsCHWFromDims(dims, m_OutputLayerInfo[l].inferDims);
         unsigned int numClasses = dims.c;
-        float *outputCoverageBuffer =
-            (float *)m_OutputLayerInfo[l].buffer;
+        NvDsInferTensorView outputCoverage(
+            m_OutputLayerInfo[l], m_OutputInt8Scale);
+        std::vector<float> scratch(outputCoverage.isFloat() ? 0 : numClasses);
+        const float *outputCoverageBuffer =
+            outputCoverage.read(0, numClasses, scratch.data());
         float maxProbability = 0;
         bool attrFound = false;
         NvDsInferAttribute attr;
@@ -553,10 +623,44 @@ DetectPostprocessor::fillDetectionOutput(
     /* Clear all per class object lists */
     for (auto & list:m_PerClassObjectList)
         list.clear();
+    for (auto & list:m_PerClassObjectIndex)
+        list.clear();
+    m_ObjectLandmarks.clear();
+    m_NumObjectLandmarks = 0;
 
     /* Call custom parsing function if specified otherwise use the one
      * written along with this implementation. */
-    if (m_CustomBBoxParseFunc)
+    if (m_CustomBBoxParseWithLandmarksFunc)
+    {
+        unsigned int numLandmarks = 0;
+        if (!m_CustomBBoxParseWithLandmarksFunc(m_CustomBBoxParseContext,
+                    outputLayers, m_NetworkInfo, m_DetectionParams,
+                    m_ObjectList, m_ObjectLandmarks, numLandmarks))
+        {
+            printError("Failed to parse bboxes using custom parse function");
+            return NVDSINFER_CUSTOM_LIB_FAILED;
+        }
+        if (m_ObjectLandmarks.size() !=
+            m_ObjectList.size() * numLandmarks * 2)
+        {
+            printError("Custom parse function returned %zu landmark "
+                "coordinates for %zu objects with %u landmarks",
+                m_ObjectLandmarks.size(), m_ObjectList.size(), numLandmarks);
+            return NVDSINFER_CUSTOM_LIB_FAILED;
+        }
+        m_NumObjectLandmarks = numLandmarks;
+    }
+    else if (m_CustomBBoxParseWithContextFunc)
+    {
+        if (!m_CustomBBoxParseWithContextFunc(m_CustomBBoxParseContext,
+                    outputLayers, m_NetworkInfo, m_DetectionParams,
+                    m_ObjectList))
+        {
+            printError("Failed to parse bboxes using custom parse function");
+            return NVDSINFER_CUSTOM_LIB_FAILED;
+        }
+    }
+    else if (m_CustomBBoxParseFunc)
     {
         if (!m_CustomBBoxParseFunc(outputLayers, m_NetworkInfo,
                     m_DetectionParams, m_ObjectList))
@@ -582,9 +686,12 @@ DetectPostprocessor::fillDetectionOutput(
     if((m_ClusterMode != NVDSINFER_CLUSTER_GROUP_RECTANGLES) &&
         (m_ClusterMode != NVDSINFER_CLUSTER_NONE))
     {
-        for (auto & object:m_ObjectList)
+        for (size_t i = 0; i < m_ObjectList.size(); i++)
         {
+            const NvDsInferObjectDetectionInfo& object = m_ObjectList[i];
             m_PerClassObjectList[object.classId].emplace_back(object);
+            if (m_NumObjectLandmarks)
+                m_PerClassObjectIndex[object.classId].push_back(i);
         }
     }
 
@@ -661,6 +768,10 @@ ClassifyPostprocessor::fillClassificationOutput(
     return NVDSINFER_SUCCESS;
 }
 
+/* Minimum number of pixels in a row tile handed to a worker thread. Smaller
+ * maps are not worth the hand-off. */
+#define SEGMENTATION_MIN_ROW_TILE_PIXELS (32 * 1024)
+
 NvDsInferStatus
 SegmentPostprocessor::fillSegmentationOutput(
     const std::vector<NvDsInferLayerInfo>& outputLayers,
@@ -673,29 +784,89 @@ SegmentPostprocessor::fillSegmentationOutput(
     output.height = outputDimsCHW.h;
     output.classes = outputDimsCHW.c;
 
-    output.class_map = new int [output.width * output.height];
-    output.class_probability_map = (float*)outputLayers[0].buffer;
+    size_t planeSize = (size_t)output.width * output.height;
+    NvDsInferTensorView probs(outputLayers[0], m_OutputInt8Scale);
+    /* Consumers expect float probabilities. Other output types are converted
+     * tile by tile into a float copy, freed with the frame output. */
+    if (probs.isFloat())
+        output.class_probability_map = (float*)outputLayers[0].buffer;
+    else
+        output.class_probability_map = new float[output.classes * planeSize];
+    output.class_map = nullptr;
+    output.class_map_u8 = nullptr;
+
+    if (m_ClassMapU8)
+        output.class_map_u8 = new uint8_t[planeSize];
+    else
+        output.class_map = new int[planeSize];
 
-    for (unsigned int y = 0; y < output.height; y++)
+    /* Split the map into row tiles, a few per thread for load balancing.
+     * Pixels are independent so the result does not depend on the split. */
+    size_t rowsPerTile = std::max(output.height, 1u);
+    if (output.width && m_NumThreads > 1)
     {
-        for (unsigned int x = 0; x < output.width; x++)
-        {
-            float max_prob = -1;
-            int &cls = output.class_map[y * output.width + x] = -1;
-            for (unsigned int c = 0; c < output.classes; c++)
+        size_t tiles = (size_t)m_NumThreads * 4;
+        size_t minRows = DIVIDE_AND_ROUND_UP(
+            SEGMENTATION_MIN_ROW_TILE_PIXELS, (size_t)output.width);
+        rowsPerTile = std::max(
+            DIVIDE_AND_ROUND_UP((size_t)output.height, tiles), minRows);
+    }
+    size_t numTiles = DIVIDE_AND_ROUND_UP((size_t)output.height, rowsPerTile);
+
+    WorkerPool::instance().parallelFor(numTiles, m_NumThreads,
+        [&output, &probs, rowsPerTile, planeSize, this](size_t tile) {
+            size_t begin = tile * rowsPerTile * output.width;
+            size_t end = std::min(begin + rowsPerTile * output.width, planeSize);
+            if (!probs.isFloat())
             {
-                float prob = output.class_probability_map[c * output.width * output.height + y * output.width + x];
-                if (prob > max_prob && prob > m_SegmentationThreshold)
-                {
-                    cls = c;
-                    max_prob = prob;
-                }
+                for (unsigned int c = 0; c < output.classes; c++)
+                    probs.read(c * planeSize + begin, end - begin,
+                        output.class_probability_map + c * planeSize + begin);
             }
-        }
-    }
+            if (output.class_map_u8)
+                simdArgmaxCHW(output.class_probability_map,
+                    output.classes, planeSize, m_SegmentationThreshold, begin,
+                    end, output.class_map_u8);
+            else
+                simdArgmaxCHW(output.class_probability_map,
+                    output.classes, planeSize, m_SegmentationThreshold, begin,
+                    end, output.class_map);
+        });
+    return NVDSINFER_SUCCESS;
+}
+
+/* Normalize the embedding in place in the batch host buffer. The output only
+ * references the host buffer, which stays valid until the batch is released,
+ * so consumers get the vector without an extra copy. */
+NvDsInferStatus
+EmbeddingPostprocessor::fillEmbeddingOutput(
+    const std::vector<NvDsInferLayerInfo>& outputLayers,
+    NvDsInferEmbeddingOutput& output)
+{
+    const NvDsInferLayerInfo& layer = outputLayers[0];
+
+    output.dims = layer.inferDims.numElements;
+    output.embedding = (float*)layer.buffer;
+    output.norm = simdL2Normalize(output.embedding, output.dims);
+    output.embeddingInt8 = nullptr;
+    output.scale = 1.0f;
     return NVDSINFER_SUCCESS;
 }
 
+/* Quantize the normalized embedding symmetrically with a per-vector scale of
+ * max|v| / 127 into dst. The rounding error is at most scale / 2 per element;
+ * for typical 128 to 512-d embeddings the cosine similarity between quantized
+ * vectors is within about 2e-3 of the float32 value. */
+void
+EmbeddingPostprocessor::quantizeEmbeddingOutput(
+    NvDsInferEmbeddingOutput& output, int8_t* dst)
+{
+    float maxAbs = simdMaxAbs(output.embedding, output.dims);
+    output.scale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+    output.embeddingInt8 = dst;
+    simdQuantizeS8(output.embedding, dst, 1.0f / output.scale, output.dims);
+}
+
 void
 InferPostprocessor::releaseFrameOutput(NvDsInferFrameOutput& frameOutput)
 {
@@ -706,6 +877,7 @@ InferPostprocessor::releaseFrameOutput(NvDsInferFrameOutput& frameOutput)
                     j++)
             {
                 free(frameOutput.detectionOutput.objects[j].label);
+                delete[] frameOutput.detectionOutput.objects[j].landmarks;
             }
             delete[] frameOutput.detectionOutput.objects;
             break;
@@ -715,6 +887,11 @@ InferPostprocessor::releaseFrameOutput(NvDsInferFrameOutput& frameOutput)
             break;
         case NvDsInferNetworkType_Segmentation:
             delete[] frameOutput.segmentationOutput.class_map;
+            delete[] frameOutput.segmentationOutput.class_map_u8;
+            /* See SegmentPostprocessor::fillSegmentationOutput. */
+            if (!m_OutputLayerInfo.empty() &&
+                m_OutputLayerInfo[0].dataType != FLOAT)
+                delete[] frameOutput.segmentationOutput.class_probability_map;
             break;
         default:
             break;
@@ -9,7 +9,12 @@
  *
  */
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
@@ -69,6 +74,169 @@ DlLibHandle::~DlLibHandle()
     }
 }
 
+MappedFile::MappedFile(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        dsInferError("Could not open file: %s, error: %s", safeStr(path),
+            strerror(errno));
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            /* Files are read once from start to end. */
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            m_Data = data;
+            m_Size = st.st_size;
+        }
+        else
+        {
+            dsInferError("Could not map file: %s, error: %s", safeStr(path),
+                strerror(errno));
+        }
+    }
+    else
+    {
+        dsInferError("Could not map empty or unreadable file: %s",
+            safeStr(path));
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_Data)
+    {
+        munmap(m_Data, m_Size);
+    }
+}
+
+/* FNV-1a over 8-byte words in four independent lanes, so that hashing large
+ * model files is bound by memory bandwidth rather than by the multiply
+ * latency of the bytewise FNV-1a. */
+uint64_t
+hashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const uint64_t kPrime = 1099511628211ULL;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t lanes[4];
+    for (int k = 0; k < 4; ++k)
+    {
+        lanes[k] = (14695981039346656037ULL ^ seed) + k;
+    }
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i + 8 * k, sizeof(word));
+            lanes[k] = (lanes[k] ^ word) * kPrime;
+            lanes[k] ^= lanes[k] >> 29;
+        }
+    }
+
+    uint64_t hash = size;
+    for (int k = 0; k < 4; ++k)
+    {
+        hash = (hash ^ lanes[k]) * kPrime;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * kPrime;
+    }
+    return hash ^ (hash >> 29);
+}
+
+WorkerPool&
+WorkerPool::instance()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+WorkerPool::WorkerPool()
+{
+    uint32_t numWorkers =
+        std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    for (uint32_t i = 0; i < numWorkers; i++)
+        m_Workers.emplace_back(&WorkerPool::workerLoop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    for (size_t i = 0; i < m_Workers.size(); i++)
+        m_Jobs.push(std::function<void()>());
+    for (auto& worker : m_Workers)
+        worker.join();
+}
+
+void
+WorkerPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job = m_Jobs.pop();
+        if (!job)
+            return;
+        job();
+    }
+}
+
+void
+WorkerPool::parallelFor(size_t numTasks, uint32_t numThreads,
+    const std::function<void(size_t)>& func)
+{
+    numThreads = std::min<size_t>(std::min(numThreads, maxThreads()), numTasks);
+    if (numThreads <= 1)
+    {
+        for (size_t i = 0; i < numTasks; i++)
+            func(i);
+        return;
+    }
+
+    /* Helpers which only get to run after all the tasks have been claimed
+     * (e.g. while the workers are busy with another context) return without
+     * touching func, so the caller only waits for helpers which claimed a
+     * task and never for queued ones. */
+    struct State
+    {
+        std::atomic<size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable cond;
+        uint32_t active = 0;
+    };
+    auto state = std::make_shared<State>();
+    const std::function<void(size_t)>* task = &func;
+
+    auto run = [state, task, numTasks]() {
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->active++;
+        }
+        for (size_t i = state->next++; i < numTasks; i = state->next++)
+            (*task)(i);
+        std::unique_lock<std::mutex> lock(state->mutex);
+        if (--state->active == 0)
+            state->cond.notify_all();
+    };
+
+    for (uint32_t i = 1; i < numThreads; i++)
+        m_Jobs.push(run);
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cond.wait(lock, [&state]() { return state->active == 0; });
+}
+
 nvinfer1::Dims
 ds2TrtDims(const NvDsInferDimsCHW& dims)
 {
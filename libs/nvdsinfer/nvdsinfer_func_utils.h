@@ -16,11 +16,17 @@
 #include <stdarg.h>
 #include <string.h>
 #include <unistd.h>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <condition_variable>
+#include <functional>
+#include <list>
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <NvInferRuntime.h>
 #include <nvdsinfer.h>
@@ -195,6 +201,28 @@ private:
     const std::string m_LibPath;
 };
 
+/* Read-only memory mapping of a whole file. */
+class MappedFile
+{
+public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    bool isValid() const { return m_Data; }
+    const void* data() const { return m_Data; }
+    size_t size() const { return m_Size; }
+
+private:
+    DISABLE_CLASS_COPY(MappedFile);
+
+    void* m_Data{nullptr};
+    size_t m_Size{0};
+};
+
+/* Fast non-cryptographic 64-bit hash of a buffer, used to content-address
+ * files. Not stable across endianness. */
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
 template <typename Container>
 class GuardQueue
 {
@@ -227,6 +255,179 @@ private:
     Container m_Queue;
 };
 
+/* Fixed-capacity variant of GuardQueue on a ring buffer. Nothing is allocated
+ * after setCapacity, push reports overflow instead of growing the queue. */
+template <typename T>
+class BoundedGuardQueue
+{
+public:
+    explicit BoundedGuardQueue(size_t capacity = 0) { setCapacity(capacity); }
+
+    /* Set the max number of queued items, the queued items are dropped. */
+    void setCapacity(size_t capacity)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Ring.clear();
+        m_Ring.resize(capacity);
+        m_Head = 0;
+        m_Size = 0;
+    }
+    /* Returns false and does not queue data if the queue is full. */
+    bool push(T data)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        if (m_Size == m_Ring.size())
+            return false;
+        size_t tail = m_Head + m_Size;
+        if (tail >= m_Ring.size())
+            tail -= m_Ring.size();
+        m_Ring[tail] = std::move(data);
+        m_Size++;
+        lock.unlock();
+        m_Cond.notify_one();
+        return true;
+    }
+    T pop()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Cond.wait(lock, [this]() { return m_Size > 0; });
+        return popLocked();
+    }
+    /* Returns false if the queue is empty. */
+    bool try_pop(T& data)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        if (!m_Size)
+            return false;
+        data = popLocked();
+        return true;
+    }
+    /* Returns false if the queue is still empty after timeout. */
+    template <typename Rep, typename Period>
+    bool pop_for(T& data, const std::chrono::duration<Rep, Period>& timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        if (!m_Cond.wait_for(lock, timeout, [this]() { return m_Size > 0; }))
+            return false;
+        data = popLocked();
+        return true;
+    }
+    /* Append all the queued items to out in order without waiting, returns
+     * the number of items popped. */
+    size_t pop_all(std::vector<T>& out)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        size_t num = m_Size;
+        while (m_Size)
+            out.emplace_back(popLocked());
+        return num;
+    }
+    void clear()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (m_Size)
+            popLocked();
+    }
+    size_t size()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        return m_Size;
+    }
+
+private:
+    T popLocked()
+    {
+        assert(m_Size > 0);
+        T ret = std::move(m_Ring[m_Head]);
+        if (++m_Head == m_Ring.size())
+            m_Head = 0;
+        m_Size--;
+        return ret;
+    }
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Cond;
+    std::vector<T> m_Ring;
+    size_t m_Head = 0;
+    size_t m_Size = 0;
+};
+
+/* Counts the batches in flight on each of a set of execution contexts and
+ * picks the least loaded one. Batches are acquired from the input thread
+ * only, so a count can only drop between select and acquire; they are
+ * released from the output thread. */
+class LeastLoadedScheduler
+{
+public:
+    explicit LeastLoadedScheduler(unsigned int numContexts = 1)
+    {
+        reset(numContexts);
+    }
+
+    /* Set the number of contexts, nothing may be in flight. */
+    void reset(unsigned int numContexts)
+    {
+        m_InFlight = std::vector<std::atomic<unsigned int>>(numContexts);
+        for (auto& count : m_InFlight)
+            count = 0;
+    }
+    unsigned int size() const { return m_InFlight.size(); }
+    unsigned int inFlight(unsigned int idx) const { return m_InFlight[idx]; }
+
+    /* The context with the fewest batches in flight, the first one on ties
+     * so that a lightly loaded stream keeps using a single context. */
+    unsigned int select() const
+    {
+        unsigned int idx = 0;
+        for (unsigned int i = 1; i < m_InFlight.size(); i++)
+        {
+            if (m_InFlight[i] < m_InFlight[idx])
+                idx = i;
+        }
+        return idx;
+    }
+    void acquire(unsigned int idx) { m_InFlight[idx]++; }
+    void release(unsigned int idx)
+    {
+        assert(m_InFlight[idx] > 0);
+        m_InFlight[idx]--;
+    }
+
+private:
+    std::vector<std::atomic<unsigned int>> m_InFlight;
+};
+
+/**
+ * Process-wide pool of worker threads for host post-processing, shared by all
+ * the contexts of the process so that several instances do not oversubscribe
+ * the CPU. The workers are created on first use.
+ */
+class WorkerPool
+{
+public:
+    static WorkerPool& instance();
+
+    /* Number of threads a parallelFor call can use, including the caller. */
+    uint32_t maxThreads() const { return m_Workers.size() + 1; }
+
+    /* Run func(i) for every i in [0, numTasks) on up to numThreads threads,
+     * the calling thread included, and return once all the tasks are done.
+     * Tasks are claimed in order by whichever thread is free. */
+    void parallelFor(size_t numTasks, uint32_t numThreads,
+        const std::function<void(size_t)>& func);
+
+private:
+    WorkerPool();
+    ~WorkerPool();
+    DISABLE_CLASS_COPY(WorkerPool);
+
+    void workerLoop();
+
+    std::vector<std::thread> m_Workers;
+    /* An empty job stops the worker which pops it. */
+    GuardQueue<std::list<std::function<void()>>> m_Jobs;
+};
+
 /**
  * Get the size of the element from the data type
  */
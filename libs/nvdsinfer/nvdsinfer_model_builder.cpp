@@ -10,8 +10,11 @@
  */
 
 #include <dlfcn.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <array>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -19,6 +22,7 @@
 #include <memory>
 #include <sstream>
 
+#include <cuda_runtime_api.h>
 #include <NvInferPlugin.h>
 #include <NvOnnxParser.h>
 #include <NvUffParser.h>
@@ -470,6 +474,15 @@ ExplicitBuildParams::sanityCheck() const
     if (minBatchSize > optBatchSize || optBatchSize > maxBatchSize)
         return false;
 
+    /* Extra profiles are increasing and below the max batch size. */
+    int lastBatchSize = minBatchSize - 1;
+    for (int batchSize : extraProfileBatchSizes)
+    {
+        if (batchSize <= lastBatchSize || batchSize >= maxBatchSize)
+            return false;
+        lastBatchSize = batchSize;
+    }
+
     for (auto& layer : inputProfileDims)
     {
         int nd = -1;
@@ -599,13 +612,15 @@ TrtEngine::getImplicitLayersInfo(std::vector<NvDsInferBatchDimsLayerInfo>& layer
     return NVDSINFER_SUCCESS;
 }
 
-/* Get information for all layers for full dimensions network. */
+/* Get information for all layers for full dimensions network. Layers are
+ * indexed as the bindings of profile 0, profiles > 0 bind them at an offset of
+ * profileIdx * getNbBindingsPerProfile(). */
 NvDsInferStatus
 TrtEngine::getFullDimsLayersInfo(int profileIdx,
         std::vector<NvDsInferBatchDimsLayerInfo>& layersInfo)
 {
     layersInfo.clear();
-    for (int i = 0; i < (int)m_Engine->getNbBindings(); i++)
+    for (int i = 0; i < getNbBindingsPerProfile(); i++)
     {
         NvDsInferBatchDimsLayerInfo layerInfo;
         RETURN_NVINFER_ERROR(getLayerInfo(i, layerInfo),
@@ -637,6 +652,13 @@ TrtEngine::getFullDimsLayersInfo(int profileIdx,
     return NVDSINFER_SUCCESS;
 }
 
+int
+TrtEngine::getNbBindingsPerProfile()
+{
+    assert(m_Engine->getNbOptimizationProfiles() > 0);
+    return m_Engine->getNbBindings() / m_Engine->getNbOptimizationProfiles();
+}
+
 /* Print engine details. */
 void
 TrtEngine::printEngineInfo()
@@ -682,6 +704,18 @@ TrtEngine::printEngineInfo()
         }
         s << "\n";
     }
+
+    /* Input batch range of the other profiles, dims are the same. */
+    for (int iP = 1; isFullDims && iP < m_Engine->getNbOptimizationProfiles();
+         ++iP)
+    {
+        getFullDimsLayersInfo(iP, layersInfo);
+        s << "profile " << iP << ": batch min: "
+          << layersInfo[0].profileDims[kSELECTOR_MIN].batchSize
+          << " opt: " << layersInfo[0].profileDims[kSELECTOR_OPT].batchSize
+          << " Max: " << layersInfo[0].profileDims[kSELECTOR_MAX].batchSize
+          << "\n";
+    }
     dsInferInfo("%s", s.str().c_str());
 }
 
@@ -1026,6 +1060,17 @@ TrtModelBuilder::createDynamicParams(const NvDsInferContextInitParams& initParam
     params->optBatchSize = initParams.maxBatchSize;
     params->maxBatchSize = initParams.maxBatchSize;
 
+    /* DLA runs at the max batch size only, smaller profiles are of no use. */
+    if (initParams.dlaCore < 0 || !initParams.useDLA)
+    {
+        for (unsigned int i = 0; i < initParams.numProfileBatchSizes; ++i)
+        {
+            int batchSize = initParams.profileBatchSizes[i];
+            if (batchSize < params->maxBatchSize)
+                params->extraProfileBatchSizes.push_back(batchSize);
+        }
+    }
+
     if (initParams.inferInputDims.c && initParams.inferInputDims.h &&
         initParams.inferInputDims.w)
     {
@@ -1267,6 +1312,38 @@ TrtModelBuilder::configExplicitOptions(ExplicitBuildParams& params)
         return NVDSINFER_CONFIG_FAILED;
     }
 
+    /* One profile per extra batch size, each tuned for (opt) and limited to
+     * (max) that batch size, then the profile up to the max batch size. */
+    struct ProfileBatch
+    {
+        int opt;
+        int max;
+    };
+    std::vector<ProfileBatch> profileBatches;
+    for (int batchSize : params.extraProfileBatchSizes)
+        profileBatches.push_back({batchSize, batchSize});
+    profileBatches.push_back({params.optBatchSize, params.maxBatchSize});
+
+    for (const ProfileBatch& batch : profileBatches)
+    {
+        RETURN_NVINFER_ERROR(addOptimizationProfile(params, batch.opt,
+                                 batch.max),
+            "failed to add optimization profile for batch-size %d", batch.max);
+    }
+
+    return NVDSINFER_SUCCESS;
+}
+
+/* Add an optimization profile for the batch sizes [params.minBatchSize,
+ * maxBatchSize] tuned for optBatchSize. */
+NvDsInferStatus
+TrtModelBuilder::addOptimizationProfile(
+    ExplicitBuildParams& params, int optBatchSize, int maxBatchSize)
+{
+    nvinfer1::IBuilder& builder = *m_Builder;
+    nvinfer1::INetworkDefinition& network = *m_Network;
+    nvinfer1::IBuilderConfig& builderConfig = *m_BuilderConfig;
+
     nvinfer1::IOptimizationProfile* profile = builder.createOptimizationProfile();
     assert(profile);
     assert((int)params.inputProfileDims.size() <= network.getNbInputs());
@@ -1302,7 +1379,7 @@ TrtModelBuilder::configExplicitOptions(ExplicitBuildParams& params)
         assert(optDims.nbDims + 1 == modelDims.nbDims);
         std::move_backward(optDims.d, optDims.d + modelDims.nbDims - 1,
             optDims.d + modelDims.nbDims);
-        optDims.d[0] = params.optBatchSize;
+        optDims.d[0] = optBatchSize;
         optDims.nbDims = modelDims.nbDims;
         assert(std::none_of(optDims.d, optDims.d + optDims.nbDims,
             [](int d) { return d < 0; }));
@@ -1314,7 +1391,7 @@ TrtModelBuilder::configExplicitOptions(ExplicitBuildParams& params)
         assert(maxDims.nbDims + 1 == modelDims.nbDims);
         std::move_backward(maxDims.d, maxDims.d + modelDims.nbDims - 1,
             maxDims.d + modelDims.nbDims);
-        maxDims.d[0] = params.maxBatchSize;
+        maxDims.d[0] = maxBatchSize;
         maxDims.nbDims = modelDims.nbDims;
         assert(std::none_of(maxDims.d, maxDims.d + maxDims.nbDims,
             [](int d) { return d < 0; }));
@@ -1337,11 +1414,11 @@ TrtModelBuilder::configExplicitOptions(ExplicitBuildParams& params)
         profile->setDimensions(
             input->getName(), nvinfer1::OptProfileSelector::kMIN, dims);
 
-        dims.d[0] = params.optBatchSize;
+        dims.d[0] = optBatchSize;
         profile->setDimensions(
             input->getName(), nvinfer1::OptProfileSelector::kOPT, dims);
 
-        dims.d[0] = params.maxBatchSize;
+        dims.d[0] = maxBatchSize;
         profile->setDimensions(
             input->getName(), nvinfer1::OptProfileSelector::kMAX, dims);
 
@@ -1367,17 +1444,29 @@ TrtModelBuilder::configExplicitOptions(ExplicitBuildParams& params)
     return NVDSINFER_SUCCESS;
 }
 
-/* Serialize engine and write to file.*/
+/* Serialize engine and write to file. The engine is written to a uniquely
+ * named temporary file renamed to path once complete, so that other threads
+ * and processes sharing an engine cache never read a partially written
+ * engine. */
 NvDsInferStatus
 TrtModelBuilder::serializeEngine(const std::string& path,
         nvinfer1::ICudaEngine& engine)
 {
-    std::ofstream fileOut(path, std::ios::binary);
-    if (!fileOut.is_open())
+    std::string tmpPath = path + ".XXXXXX";
+    int fd = mkstemp(&tmpPath[0]);
+    /* mkstemp creates the file private, engine files are shared. */
+    FILE* fileOut = (fd >= 0 && fchmod(fd, 0644) == 0) ? fdopen(fd, "wb")
+                                                        : nullptr;
+    if (!fileOut)
     {
         dsInferError(
             "Serialize engine failed because of file path: %s opened error",
-            safeStr(path));
+            safeStr(tmpPath));
+        if (fd >= 0)
+        {
+            close(fd);
+            std::remove(tmpPath.c_str());
+        }
         return NVDSINFER_TENSORRT_ERROR;
     }
 
@@ -1385,12 +1474,17 @@ TrtModelBuilder::serializeEngine(const std::string& path,
     if (!memEngine)
     {
         dsInferError("Serialize engine failed to file: %s", safeStr(path));
+        fclose(fileOut);
+        std::remove(tmpPath.c_str());
         return NVDSINFER_TENSORRT_ERROR;
     }
 
-    fileOut.write(static_cast<char*>(memEngine->data()), memEngine->size());
-    if (fileOut.fail())
+    bool written = fwrite(memEngine->data(), 1, memEngine->size(), fileOut) ==
+        memEngine->size();
+    if (fclose(fileOut) != 0 || !written ||
+        std::rename(tmpPath.c_str(), path.c_str()) != 0)
     {
+        std::remove(tmpPath.c_str());
         return NVDSINFER_TENSORRT_ERROR;
     }
     return NVDSINFER_SUCCESS;
@@ -1400,8 +1494,9 @@ TrtModelBuilder::serializeEngine(const std::string& path,
 std::unique_ptr<TrtEngine>
 TrtModelBuilder::deserializeEngine(const std::string& path, int dla)
 {
-    std::ifstream fileIn(path, std::ios::binary);
-    if (!fileIn.is_open())
+    /* The engine is deserialized straight from the page cache. */
+    MappedFile data(path);
+    if (!data.isValid())
     {
         dsInferError(
             "Deserialize engine failed because file path: %s open error",
@@ -1409,18 +1504,6 @@ TrtModelBuilder::deserializeEngine(const std::string& path, int dla)
         return nullptr;
     }
 
-    fileIn.seekg(0, std::ios::end);
-    size_t size = fileIn.tellg();
-    fileIn.seekg(0, std::ios::beg);
-
-    std::vector<char> data(size);
-    fileIn.read(data.data(), size);
-    if (fileIn.fail())
-    {
-        dsInferError("Deserialize engine failed, file path: %s", safeStr(path));
-        return nullptr;
-    }
-
     SharedPtrWDestroy<nvinfer1::IRuntime> runtime(
             nvinfer1::createInferRuntime(m_Logger));
     assert(runtime);
@@ -1445,7 +1528,7 @@ TrtModelBuilder::deserializeEngine(const std::string& path, int dla)
     }
 
     UniquePtrWDestroy<nvinfer1::ICudaEngine> engine =
-        runtime->deserializeCudaEngine(data.data(), size, factory);
+        runtime->deserializeCudaEngine(data.data(), data.size(), factory);
 
     if (!engine)
     {
@@ -1456,4 +1539,182 @@ TrtModelBuilder::deserializeEngine(const std::string& path, int dla)
         std::move(engine), runtime, dla, m_DlLib, factory);
 }
 
+std::string
+getEngineCachePath(const NvDsInferContextInitParams& initParams)
+{
+    std::ostringstream manifest;
+    std::string modelName;
+
+    /* Model files. The INT8 calibration table may not exist yet, in which case
+     * the build generates it and the engine is stored under the key computed
+     * with the generated table. The custom library may hold plugins or the
+     * engine creation function. */
+    struct KeyFile
+    {
+        const char* path;
+        bool isModel;
+        bool optional;
+    };
+    const KeyFile files[] = {
+        {initParams.protoFilePath, true, false},
+        {initParams.modelFilePath, true, false},
+        {initParams.uffFilePath, true, false},
+        {initParams.onnxFilePath, true, false},
+        {initParams.tltEncodedModelFilePath, true, false},
+        {initParams.customLibPath, false, false},
+        {initParams.customNetworkConfigFilePath, false, false},
+        {initParams.int8CalibrationFilePath, false, true},
+    };
+    for (const KeyFile& file : files)
+    {
+        if (string_empty(file.path))
+        {
+            manifest << "-;";
+            continue;
+        }
+        if (file.optional && !file_accessible(file.path))
+        {
+            manifest << "absent;";
+            continue;
+        }
+        MappedFile data(file.path);
+        if (!data.isValid())
+            return "";
+        manifest << std::hex << hashBytes(data.data(), data.size()) << std::dec
+                 << ";";
+        if (file.isModel && modelName.empty())
+        {
+            const char* base = strrchr(file.path, '/');
+            modelName = base ? base + 1 : file.path;
+        }
+    }
+
+    /* Init params the engine is built from. */
+    manifest << initParams.networkMode << ";" << initParams.maxBatchSize << ";"
+             << initParams.workspaceSize << ";"
+             << initParams.forceImplicitBatchDimension << ";"
+             << initParams.inferInputDims.c << "x" << initParams.inferInputDims.h
+             << "x" << initParams.inferInputDims.w << ";"
+             << initParams.inputDims.c << "x" << initParams.inputDims.h << "x"
+             << initParams.inputDims.w << ";" << initParams.uffInputOrder << ";"
+             << safeStr(initParams.uffInputBlobName) << ";"
+             << safeStr(initParams.tltModelKey) << ";"
+             << safeStr(initParams.customEngineCreateFuncName) << ";";
+    for (unsigned int i = 0; i < initParams.numOutputLayers; ++i)
+    {
+        manifest << safeStr(initParams.outputLayerNames[i]) << ",";
+    }
+    if (initParams.numProfileBatchSizes)
+    {
+        manifest << ";profiles:";
+        for (unsigned int i = 0; i < initParams.numProfileBatchSizes; ++i)
+        {
+            manifest << initParams.profileBatchSizes[i] << ",";
+        }
+    }
+
+    /* Builder and device. */
+    manifest << ";trt" << getInferLibVersion() << ";";
+    if (initParams.useDLA && initParams.dlaCore >= 0)
+    {
+        manifest << "dla" << initParams.dlaCore << ";";
+    }
+    cudaDeviceProp prop;
+    if (cudaGetDeviceProperties(&prop, initParams.gpuID) != cudaSuccess)
+        return "";
+    manifest << prop.name << ";sm" << prop.major << prop.minor << ";";
+
+    std::string key = manifest.str();
+    std::ostringstream path;
+    path << safeStr(initParams.engineCacheDir) << "/"
+         << (modelName.empty() ? "model" : modelName) << "_" << std::hex
+         << std::setw(16) << std::setfill('0')
+         << hashBytes(key.data(), key.size()) << ".engine";
+    return path.str();
+}
+
+
+TrtEngineRegistry&
+TrtEngineRegistry::instance()
+{
+    static TrtEngineRegistry registry;
+    return registry;
+}
+
+std::string
+TrtEngineRegistry::engineKey(const std::string& enginePath, int gpuId,
+    int dlaCore, const std::string& customLibPath)
+{
+    struct stat st;
+    if (stat(enginePath.c_str(), &st) != 0)
+        return "";
+
+    std::ostringstream key;
+    key << st.st_dev << ":" << st.st_ino << ":" << st.st_size << ":"
+        << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec << ";gpu" << gpuId
+        << ";dla" << dlaCore << ";" << customLibPath;
+    return key.str();
+}
+
+std::shared_ptr<TrtEngine>
+TrtEngineRegistry::acquire(
+    const std::string& key, const EngineCreator& create, bool& shared)
+{
+    shared = false;
+    if (key.empty())
+        return create();
+
+    std::unique_lock<std::mutex> locker(m_Mutex);
+    for (auto iter = m_Engines.find(key); iter != m_Engines.end();
+         iter = m_Engines.find(key))
+    {
+        std::shared_ptr<TrtEngine> engine;
+        if (iter->second.loading.valid())
+        {
+            /* Wait without the lock for the caller creating the engine. If it
+             * failed or the engine can't be shared the entry is gone. */
+            auto loading = iter->second.loading;
+            locker.unlock();
+            engine = loading.get();
+            locker.lock();
+        }
+        else
+        {
+            engine = iter->second.engine.lock();
+            if (!engine)
+            {
+                m_Engines.erase(iter);
+                break;
+            }
+        }
+        if (engine)
+        {
+            shared = true;
+            return engine;
+        }
+    }
+
+    std::promise<std::shared_ptr<TrtEngine>> promise;
+    m_Engines[key].loading = promise.get_future().share();
+    locker.unlock();
+
+    std::shared_ptr<TrtEngine> engine = create();
+    bool shareable = engine && engine->engine().hasImplicitBatchDimension();
+
+    locker.lock();
+    if (shareable)
+    {
+        Entry& entry = m_Engines[key];
+        entry.engine = engine;
+        entry.loading = {};
+    }
+    else
+    {
+        m_Engines.erase(key);
+    }
+    locker.unlock();
+    promise.set_value(shareable ? engine : nullptr);
+    return engine;
+}
+
 } // namespace nvdsinfer
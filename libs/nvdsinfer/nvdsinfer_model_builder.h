@@ -15,6 +15,8 @@
 #include <stdarg.h>
 #include <algorithm>
 #include <condition_variable>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -236,12 +238,14 @@ using ProfileDims = std::array<nvinfer1::Dims,
 struct ExplicitBuildParams : public BuildParams
 {
     // profileSelector, dims without batchSize
-    // each input must have 3 selector MIN/OPT/MAX for profile0,
-    // doesn't support multiple profiles
+    // each input must have 3 selector MIN/OPT/MAX, shared by all profiles
     std::vector<ProfileDims> inputProfileDims;
     int minBatchSize = 1;
     int optBatchSize = 1;
     int maxBatchSize = 1;
+    // opt/max batch size of each additional profile, increasing and smaller
+    // than maxBatchSize. The last profile is [minBatchSize, maxBatchSize].
+    std::vector<int> extraProfileBatchSizes;
 
 private:
     NvDsInferStatus configBuilder(TrtModelBuilder& builder) override;
@@ -271,6 +275,8 @@ public:
         std::vector<NvDsInferBatchDimsLayerInfo>& layersInfo);
     NvDsInferStatus getFullDimsLayersInfo(
         int profileIdx, std::vector<NvDsInferBatchDimsLayerInfo>& layersInfo);
+    /* Bindings are replicated for each optimization profile. */
+    int getNbBindingsPerProfile();
     NvDsInferStatus getLayerInfo(int idx, NvDsInferLayerInfo& layer);
 
     void printEngineInfo();
@@ -375,6 +381,8 @@ private:
     NvDsInferStatus configCommonOptions(BuildParams& params);
     NvDsInferStatus configImplicitOptions(ImplicitBuildParams& params);
     NvDsInferStatus configExplicitOptions(ExplicitBuildParams& params);
+    NvDsInferStatus addOptimizationProfile(
+        ExplicitBuildParams& params, int optBatchSize, int maxBatchSize);
 
     std::unique_ptr<BuildParams> createImplicitParams(
         const NvDsInferContextInitParams& initParams);
@@ -405,6 +413,63 @@ private:
         nvinfer1::ICudaEngine *& cudaEngine);
 };
 
+/* Returns the path of the engine buildModel() would build for the init params
+ * in initParams.engineCacheDir. The file name holds a hash of the model files,
+ * the init params affecting the build, the TensorRT version and the GPU, so
+ * that an engine found at that path can be used as is. Returns an empty
+ * string if a model file cannot be read. */
+std::string getEngineCachePath(const NvDsInferContextInitParams& initParams);
+
+/**
+ * Process-wide registry of the engines deserialized from engine files, so
+ * that all the contexts of a process inferring the same engine file share one
+ * TrtEngine (weights, plugin factory and custom lib handle). Each context
+ * still creates its own execution contexts and buffers on it. Engines are
+ * held weakly and freed along with their last context.
+ *
+ * Only implicit batch engines are shared. An optimization profile of a full
+ * dims engine can be bound to a single execution context, and each context
+ * binds all the profiles.
+ */
+class TrtEngineRegistry
+{
+public:
+    using EngineCreator = std::function<std::shared_ptr<TrtEngine>()>;
+
+    static TrtEngineRegistry& instance();
+
+    /* Identity of the engine file at enginePath as deserialized on gpuId and
+     * dlaCore with the custom lib customLibPath. The file is identified by
+     * its inode, size and modification time so that an engine rewritten in
+     * place is not mistaken for the one loaded before. Returns an empty
+     * string if the file can't be stat'ed. */
+    static std::string engineKey(const std::string& enginePath, int gpuId,
+        int dlaCore, const std::string& customLibPath);
+
+    /* Returns the engine registered for key if any, sets shared. Otherwise
+     * returns the engine created by create and registers it if it can be
+     * shared. Callers acquiring a key being created wait for that creation
+     * so that contexts starting together don't deserialize the same engine
+     * twice, other keys are not blocked. An empty key only calls create. */
+    std::shared_ptr<TrtEngine> acquire(
+        const std::string& key, const EngineCreator& create, bool& shared);
+
+private:
+    TrtEngineRegistry() = default;
+    DISABLE_CLASS_COPY(TrtEngineRegistry);
+
+    struct Entry
+    {
+        std::weak_ptr<TrtEngine> engine;
+        /* Valid while the engine is being created, set to the engine if it
+         * can be shared, to nullptr otherwise. */
+        std::shared_future<std::shared_ptr<TrtEngine>> loading;
+    };
+
+    std::mutex m_Mutex;
+    std::map<std::string, Entry> m_Engines;
+};
+
 } // end of namespace nvdsinfer
 
 #endif
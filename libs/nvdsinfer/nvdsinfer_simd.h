@@ -0,0 +1,572 @@
+/**
+ * Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+#ifndef __NVDSINFER_SIMD_H__
+#define __NVDSINFER_SIMD_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* This file provides small vectorized kernels used by the host side
+ * post-processing. The instruction set is selected at compile time; SSE2 is
+ * the baseline on x86_64 and NEON on aarch64. Build with SIMD_FLAGS set
+ * (e.g. "-mavx2 -mfma" or "-mavx512f") to enable the wider x86 paths. Every
+ * kernel has a scalar tail / fallback so results do not depend on the vector
+ * width beyond float summation order. */
+
+namespace nvdsinfer {
+
+#if defined(__AVX2__)
+inline float
+simdHsum(__m256 v)
+{
+    __m128 lo = _mm256_castps256_ps128(v);
+    __m128 hi = _mm256_extractf128_ps(v, 1);
+    lo = _mm_add_ps(lo, hi);
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 0x55));
+    return _mm_cvtss_f32(lo);
+}
+#endif
+
+#if defined(__SSE2__)
+inline float
+simdHsum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 0x55));
+    return _mm_cvtss_f32(v);
+}
+#endif
+
+/* Dot product of two float vectors of length n. */
+inline float
+simdDot(const float* a, const float* b, size_t n)
+{
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__AVX2__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16)
+    {
+#if defined(__FMA__)
+        acc0 = _mm256_fmadd_ps(
+            _mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(
+            _mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+#else
+        acc0 = _mm256_add_ps(acc0,
+            _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1,
+            _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+#endif
+    }
+    sum = simdHsum(_mm256_add_ps(acc0, acc1));
+#elif defined(__SSE2__)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = _mm_add_ps(acc0,
+            _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1,
+            _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    sum = simdHsum(_mm_add_ps(acc0, acc1));
+#elif defined(__ARM_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(s, s), 0);
+#endif
+    for (; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+/* Dot products of one vector b against four vectors a[0..3] of length n.
+ * Each element of b is loaded once for all four products, which is the inner
+ * kernel of a blocked matrix product. */
+inline void
+simdDot4(const float* b, const float* const a[4], size_t n, float out[4])
+{
+    size_t i = 0;
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+#if defined(__AVX512F__)
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps();
+    __m512 acc3 = _mm512_setzero_ps();
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512 vb = _mm512_loadu_ps(b + i);
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a[0] + i), vb, acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a[1] + i), vb, acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(a[2] + i), vb, acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(a[3] + i), vb, acc3);
+    }
+    s0 = _mm512_reduce_add_ps(acc0);
+    s1 = _mm512_reduce_add_ps(acc1);
+    s2 = _mm512_reduce_add_ps(acc2);
+    s3 = _mm512_reduce_add_ps(acc3);
+#elif defined(__AVX2__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 vb = _mm256_loadu_ps(b + i);
+#if defined(__FMA__)
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a[0] + i), vb, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a[1] + i), vb, acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a[2] + i), vb, acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a[3] + i), vb, acc3);
+#else
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a[0] + i), vb));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a[1] + i), vb));
+        acc2 = _mm256_add_ps(acc2, _mm256_mul_ps(_mm256_loadu_ps(a[2] + i), vb));
+        acc3 = _mm256_add_ps(acc3, _mm256_mul_ps(_mm256_loadu_ps(a[3] + i), vb));
+#endif
+    }
+    s0 = simdHsum(acc0);
+    s1 = simdHsum(acc1);
+    s2 = simdHsum(acc2);
+    s3 = simdHsum(acc3);
+#elif defined(__SSE2__)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 vb = _mm_loadu_ps(b + i);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a[0] + i), vb));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a[1] + i), vb));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(a[2] + i), vb));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(a[3] + i), vb));
+    }
+    s0 = simdHsum(acc0);
+    s1 = simdHsum(acc1);
+    s2 = simdHsum(acc2);
+    s3 = simdHsum(acc3);
+#elif defined(__ARM_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    float32x4_t acc2 = vdupq_n_f32(0.0f);
+    float32x4_t acc3 = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4)
+    {
+        float32x4_t vb = vld1q_f32(b + i);
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a[0] + i), vb);
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a[1] + i), vb);
+        acc2 = vmlaq_f32(acc2, vld1q_f32(a[2] + i), vb);
+        acc3 = vmlaq_f32(acc3, vld1q_f32(a[3] + i), vb);
+    }
+    s0 = vaddvq_f32(acc0);
+    s1 = vaddvq_f32(acc1);
+    s2 = vaddvq_f32(acc2);
+    s3 = vaddvq_f32(acc3);
+#endif
+    for (; i < n; i++)
+    {
+        s0 += a[0][i] * b[i];
+        s1 += a[1][i] * b[i];
+        s2 += a[2][i] * b[i];
+        s3 += a[3][i] * b[i];
+    }
+    out[0] = s0;
+    out[1] = s1;
+    out[2] = s2;
+    out[3] = s3;
+}
+
+/* Same as simdDot4 for an int8 vector b. The elements of b are widened to
+ * float, the caller applies the quantization scale to the results. */
+inline void
+simdDot4S8(const int8_t* b, const float* const a[4], size_t n, float out[4])
+{
+    size_t i = 0;
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+#if defined(__AVX2__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 vb = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+            _mm_loadl_epi64((const __m128i*)(b + i))));
+#if defined(__FMA__)
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a[0] + i), vb, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a[1] + i), vb, acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a[2] + i), vb, acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a[3] + i), vb, acc3);
+#else
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a[0] + i), vb));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a[1] + i), vb));
+        acc2 = _mm256_add_ps(acc2, _mm256_mul_ps(_mm256_loadu_ps(a[2] + i), vb));
+        acc3 = _mm256_add_ps(acc3, _mm256_mul_ps(_mm256_loadu_ps(a[3] + i), vb));
+#endif
+    }
+    s0 = simdHsum(acc0);
+    s1 = simdHsum(acc1);
+    s2 = simdHsum(acc2);
+    s3 = simdHsum(acc3);
+#elif defined(__SSE2__)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+    {
+        /* Sign extend 4 int8 to int32: replicate each byte to the top of its
+         * lane and shift it back down arithmetically. */
+        int32_t packed;
+        std::memcpy(&packed, b + i, sizeof(packed));
+        __m128i vi = _mm_cvtsi32_si128(packed);
+        vi = _mm_unpacklo_epi8(vi, vi);
+        vi = _mm_unpacklo_epi16(vi, vi);
+        __m128 vb = _mm_cvtepi32_ps(_mm_srai_epi32(vi, 24));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a[0] + i), vb));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a[1] + i), vb));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(a[2] + i), vb));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(a[3] + i), vb));
+    }
+    s0 = simdHsum(acc0);
+    s1 = simdHsum(acc1);
+    s2 = simdHsum(acc2);
+    s3 = simdHsum(acc3);
+#elif defined(__ARM_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    float32x4_t acc2 = vdupq_n_f32(0.0f);
+    float32x4_t acc3 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8)
+    {
+        int16x8_t w = vmovl_s8(vld1_s8(b + i));
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(w)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(w)));
+        acc0 = vmlaq_f32(vmlaq_f32(acc0, vld1q_f32(a[0] + i), lo),
+            vld1q_f32(a[0] + i + 4), hi);
+        acc1 = vmlaq_f32(vmlaq_f32(acc1, vld1q_f32(a[1] + i), lo),
+            vld1q_f32(a[1] + i + 4), hi);
+        acc2 = vmlaq_f32(vmlaq_f32(acc2, vld1q_f32(a[2] + i), lo),
+            vld1q_f32(a[2] + i + 4), hi);
+        acc3 = vmlaq_f32(vmlaq_f32(acc3, vld1q_f32(a[3] + i), lo),
+            vld1q_f32(a[3] + i + 4), hi);
+    }
+    s0 = vaddvq_f32(acc0);
+    s1 = vaddvq_f32(acc1);
+    s2 = vaddvq_f32(acc2);
+    s3 = vaddvq_f32(acc3);
+#endif
+    for (; i < n; i++)
+    {
+        s0 += a[0][i] * b[i];
+        s1 += a[1][i] * b[i];
+        s2 += a[2][i] * b[i];
+        s3 += a[3][i] * b[i];
+    }
+    out[0] = s0;
+    out[1] = s1;
+    out[2] = s2;
+    out[3] = s3;
+}
+
+/* Multiply all n elements of v by s in place. */
+inline void
+simdScale(float* v, float s, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256 vs = _mm256_set1_ps(s);
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(v + i, _mm256_mul_ps(_mm256_loadu_ps(v + i), vs));
+#elif defined(__SSE2__)
+    __m128 vs = _mm_set1_ps(s);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(v + i, _mm_mul_ps(_mm_loadu_ps(v + i), vs));
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(v + i, vmulq_n_f32(vld1q_f32(v + i), s));
+#endif
+    for (; i < n; i++)
+        v[i] *= s;
+}
+
+/* Largest absolute value of the n elements of v. */
+inline float
+simdMaxAbs(const float* v, size_t n)
+{
+    size_t i = 0;
+    float m = 0.0f;
+#if defined(__SSE2__)
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 vm = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+        vm = _mm_max_ps(vm, _mm_and_ps(_mm_loadu_ps(v + i), absMask));
+    vm = _mm_max_ps(vm, _mm_movehl_ps(vm, vm));
+    vm = _mm_max_ss(vm, _mm_shuffle_ps(vm, vm, 0x55));
+    m = _mm_cvtss_f32(vm);
+#elif defined(__ARM_NEON)
+    float32x4_t vm = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4)
+        vm = vmaxq_f32(vm, vabsq_f32(vld1q_f32(v + i)));
+    m = vmaxvq_f32(vm);
+#endif
+    for (; i < n; i++)
+        m = std::max(m, std::fabs(v[i]));
+    return m;
+}
+
+/* Symmetric int8 quantization: dst[i] = round(src[i] * invScale) saturated
+ * to [-127, 127], the range simdDotS8 requires. dst may alias src: each block
+ * is loaded before anything at or past its first float is stored. */
+inline void
+simdQuantizeS8(const float* src, int8_t* dst, float invScale, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 vs = _mm_set1_ps(invScale);
+    const __m128i lo = _mm_set1_epi16(-127);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i q0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i), vs));
+        __m128i q1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 4), vs));
+        __m128i q2 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 8), vs));
+        __m128i q3 = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(src + i + 12), vs));
+        /* SSE2 has no int8 max, clamp the int16 values before packing. */
+        __m128i q = _mm_packs_epi16(
+            _mm_max_epi16(_mm_packs_epi32(q0, q1), lo),
+            _mm_max_epi16(_mm_packs_epi32(q2, q3), lo));
+        _mm_storeu_si128((__m128i*)(dst + i), q);
+    }
+#elif defined(__ARM_NEON)
+    float32x4_t vs = vdupq_n_f32(invScale);
+    const int8x8_t lo = vdup_n_s8(-127);
+    for (; i + 8 <= n; i += 8)
+    {
+        int32x4_t q0 = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src + i), vs));
+        int32x4_t q1 = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src + i + 4), vs));
+        int8x8_t q = vqmovn_s16(vcombine_s16(vqmovn_s32(q0), vqmovn_s32(q1)));
+        vst1_s8(dst + i, vmax_s8(q, lo));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        float q = std::nearbyint(src[i] * invScale);
+        dst[i] = (int8_t)std::min(127.0f, std::max(-127.0f, q));
+    }
+}
+
+#if defined(__AVX2__)
+inline int32_t
+simdHsumEpi32(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+        _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+}
+#endif
+
+/* Dot product of two int8 vectors of length n, accumulated in int32. The
+ * elements must be in [-127, 127] as produced by symmetric quantization. On
+ * x86 the products are computed as |a| * sign(b, a), an unsigned by signed
+ * multiply, which maps to a single VNNI instruction (AVX512-VNNI or
+ * AVX-VNNI) per 64/32 elements when available. */
+inline int32_t
+simdDotS8(const int8_t* a, const int8_t* b, size_t n)
+{
+    size_t i = 0;
+    int32_t sum = 0;
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i acc = _mm512_setzero_si512();
+    for (; i + 64 <= n; i += 64)
+    {
+        __m512i va = _mm512_loadu_si512(a + i);
+        __m512i vb = _mm512_loadu_si512(b + i);
+        __mmask64 neg = _mm512_movepi8_mask(va);
+        acc = _mm512_dpbusd_epi32(acc, _mm512_abs_epi8(va),
+            _mm512_mask_sub_epi8(vb, neg, zero, vb));
+    }
+    sum = _mm512_reduce_add_epi32(acc);
+#endif
+#if defined(__AVX2__)
+    __m256i acc2 = _mm256_setzero_si256();
+#if !defined(__AVXVNNI__)
+    const __m256i ones = _mm256_set1_epi16(1);
+#endif
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i ua = _mm256_abs_epi8(va);
+        __m256i sb = _mm256_sign_epi8(vb, va);
+#if defined(__AVXVNNI__)
+        acc2 = _mm256_dpbusd_avx_epi32(acc2, ua, sb);
+#else
+        /* Pairs of products fit in int16 since |a|, |b| <= 127. */
+        acc2 = _mm256_add_epi32(acc2,
+            _mm256_madd_epi16(_mm256_maddubs_epi16(ua, sb), ones));
+#endif
+    }
+    sum += simdHsumEpi32(acc2);
+#elif defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        /* Sign extend to int16 by placing each byte in the high half. */
+        __m128i alo = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8);
+        __m128i ahi = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+        __m128i blo = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+        __m128i bhi = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(alo, blo));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(ahi, bhi));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0x4e));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, 0xb1));
+    sum = _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 16 <= n; i += 16)
+    {
+        int8x16_t va = vld1q_s8(a + i);
+        int8x16_t vb = vld1q_s8(b + i);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(va), vget_high_s8(vb)));
+    }
+    sum = vaddvq_s32(acc);
+#endif
+    for (; i < n; i++)
+        sum += (int32_t)a[i] * b[i];
+    return sum;
+}
+
+/* One channel step of a channel-outer argmax over n pixels: where
+ * p[i] > maxv[i], set maxv[i] = p[i] and cls[i] = c. Strict comparison keeps
+ * the lowest class on ties and ignores NaN, like the scalar loop. */
+inline void
+simdArgmaxUpdate(const float* p, float* maxv, int32_t* cls, int32_t c, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256 vc = _mm256_castsi256_ps(_mm256_set1_epi32(c));
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 vp = _mm256_loadu_ps(p + i);
+        __m256 vm = _mm256_loadu_ps(maxv + i);
+        __m256 gt = _mm256_cmp_ps(vp, vm, _CMP_GT_OQ);
+        _mm256_storeu_ps(maxv + i, _mm256_blendv_ps(vm, vp, gt));
+        __m256 vcls = _mm256_loadu_ps((const float*)(cls + i));
+        _mm256_storeu_ps((float*)(cls + i), _mm256_blendv_ps(vcls, vc, gt));
+    }
+#elif defined(__SSE2__)
+    __m128i vc = _mm_set1_epi32(c);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 vp = _mm_loadu_ps(p + i);
+        __m128 vm = _mm_loadu_ps(maxv + i);
+        __m128 gt = _mm_cmpgt_ps(vp, vm);
+        _mm_storeu_ps(maxv + i,
+            _mm_or_ps(_mm_and_ps(gt, vp), _mm_andnot_ps(gt, vm)));
+        __m128i gti = _mm_castps_si128(gt);
+        __m128i vcls = _mm_loadu_si128((const __m128i*)(cls + i));
+        _mm_storeu_si128((__m128i*)(cls + i),
+            _mm_or_si128(_mm_and_si128(gti, vc), _mm_andnot_si128(gti, vcls)));
+    }
+#elif defined(__ARM_NEON)
+    int32x4_t vc = vdupq_n_s32(c);
+    for (; i + 4 <= n; i += 4)
+    {
+        float32x4_t vp = vld1q_f32(p + i);
+        float32x4_t vm = vld1q_f32(maxv + i);
+        uint32x4_t gt = vcgtq_f32(vp, vm);
+        vst1q_f32(maxv + i, vbslq_f32(gt, vp, vm));
+        vst1q_s32(cls + i, vbslq_s32(gt, vc, vld1q_s32(cls + i)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        if (p[i] > maxv[i])
+        {
+            maxv[i] = p[i];
+            cls[i] = c;
+        }
+    }
+}
+
+/* Pixels per simdArgmaxCHW tile. The running max and argmax of one tile
+ * (2KB) stay in L1 while the tile is swept over all the class planes. */
+#define SIMD_ARGMAX_TILE 256
+
+/* Channel-outer argmax of pixels [begin, end) of a CHW probability map. Each
+ * class plane is read sequentially instead of striding across all the planes
+ * for every pixel. A pixel gets the first class with the highest probability
+ * above threshold, -1 (255 in a uint8 map) if there is none. */
+template <typename T>
+inline void
+simdArgmaxCHW(const float* probs, unsigned int classes, size_t planeSize,
+    float threshold, size_t begin, size_t end, T* classMap)
+{
+    float maxv[SIMD_ARGMAX_TILE];
+    int32_t cls[SIMD_ARGMAX_TILE];
+    /* Probabilities must beat both the threshold and the -1 start value of
+     * the original per-pixel loop. */
+    float start = std::max(threshold, -1.0f);
+
+    for (size_t i = begin; i < end; i += SIMD_ARGMAX_TILE)
+    {
+        size_t n = std::min((size_t)SIMD_ARGMAX_TILE, end - i);
+        std::fill(maxv, maxv + n, start);
+        std::fill(cls, cls + n, -1);
+        for (unsigned int c = 0; c < classes; c++)
+            simdArgmaxUpdate(probs + c * planeSize + i, maxv, cls, c, n);
+        for (size_t j = 0; j < n; j++)
+            classMap[i + j] = (T)cls[j];
+    }
+}
+
+/* L2-normalize v in place. Returns the norm of the input vector. A zero
+ * vector is left untouched. */
+inline float
+simdL2Normalize(float* v, size_t n)
+{
+    float norm = std::sqrt(simdDot(v, v, n));
+    if (norm > 0.0f)
+        simdScale(v, 1.0f / norm, n);
+    return norm;
+}
+
+} // namespace nvdsinfer
+
+#endif
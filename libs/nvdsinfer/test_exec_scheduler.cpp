@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+/* Exercises LeastLoadedScheduler, the execution context choice of
+ * NvDsInferContextImpl: least loaded selection, ties, the in-flight counts,
+ * and batches acquired by an input thread while an output thread releases
+ * them in FIFO order through the process queue.
+ *
+ * Usage: test_exec_scheduler [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include "nvdsinfer_func_utils.h"
+
+using namespace nvdsinfer;
+
+#define CHECK(cond)                                                 \
+    do                                                              \
+    {                                                               \
+        if (!(cond))                                                \
+        {                                                           \
+            printf("FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            return false;                                           \
+        }                                                           \
+    } while (0)
+
+static bool
+testSelect()
+{
+    LeastLoadedScheduler scheduler(3);
+    CHECK(scheduler.size() == 3);
+
+    /* Ties go to the first context, so a single batch in flight at a time
+     * always uses context 0. */
+    for (int i = 0; i < 5; i++)
+    {
+        unsigned int idx = scheduler.select();
+        CHECK(idx == 0);
+        scheduler.acquire(idx);
+        scheduler.release(idx);
+    }
+
+    /* Batches queued back to back spread over the contexts in order. */
+    for (unsigned int i = 0; i < 6; i++)
+    {
+        unsigned int idx = scheduler.select();
+        CHECK(idx == i % 3);
+        scheduler.acquire(idx);
+    }
+    CHECK(scheduler.inFlight(0) == 2 && scheduler.inFlight(1) == 2 &&
+        scheduler.inFlight(2) == 2);
+
+    /* A context finishing first is picked next. */
+    scheduler.release(2);
+    CHECK(scheduler.select() == 2);
+    scheduler.release(1);
+    scheduler.release(1);
+    CHECK(scheduler.select() == 1);
+    scheduler.acquire(1);
+    CHECK(scheduler.select() == 1);
+    scheduler.acquire(1);
+    CHECK(scheduler.select() == 2);
+
+    /* reset drops the counts. */
+    scheduler.reset(2);
+    CHECK(scheduler.size() == 2 && scheduler.inFlight(0) == 0 &&
+        scheduler.inFlight(1) == 0 && scheduler.select() == 0);
+
+    /* A single context is always selected. */
+    LeastLoadedScheduler single;
+    single.acquire(single.select());
+    CHECK(single.select() == 0 && single.inFlight(0) == 1);
+    return true;
+}
+
+/* Input and output threads as in NvDsInferContextImpl: batches from a pool
+ * are queued to the least loaded context and dequeued in FIFO order by the
+ * output thread, which releases the context. */
+static bool
+testThreads(unsigned int numContexts, int iterations)
+{
+    struct Batch
+    {
+        int seq = 0;
+        unsigned int execIdx = 0;
+    };
+    const unsigned int kPoolSize = numContexts + 1;
+    std::vector<Batch> pool(kPoolSize);
+    BoundedGuardQueue<Batch*> freeQueue(kPoolSize), processQueue(kPoolSize);
+    for (Batch& batch : pool)
+        freeQueue.push(&batch);
+
+    LeastLoadedScheduler scheduler(numContexts);
+    std::vector<int> used(numContexts, 0);
+    bool inOrder = true;
+    bool inRange = true;
+
+    std::thread output([&]() {
+        for (int i = 0; i < iterations; i++)
+        {
+            Batch* batch = processQueue.pop();
+            inOrder = inOrder && batch->seq == i;
+            scheduler.release(batch->execIdx);
+            freeQueue.push(batch);
+        }
+    });
+    for (int i = 0; i < iterations; i++)
+    {
+        Batch* batch = freeQueue.pop();
+        batch->seq = i;
+        batch->execIdx = scheduler.select();
+        inRange = inRange && batch->execIdx < numContexts &&
+            scheduler.inFlight(batch->execIdx) < kPoolSize;
+        used[batch->execIdx]++;
+        scheduler.acquire(batch->execIdx);
+        processQueue.push(batch);
+    }
+    output.join();
+
+    CHECK(inOrder);
+    CHECK(inRange);
+    for (unsigned int i = 0; i < numContexts; i++)
+        CHECK(scheduler.inFlight(i) == 0);
+    printf("%u contexts:", numContexts);
+    for (unsigned int i = 0; i < numContexts; i++)
+        printf(" %d", used[i]);
+    printf(" batches\n");
+    return true;
+}
+
+int
+main(int argc, char* argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+
+    bool ok = testSelect() && testThreads(1, iterations) &&
+        testThreads(2, iterations) && testThreads(4, iterations);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
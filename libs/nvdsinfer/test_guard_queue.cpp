@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+/* Exercises BoundedGuardQueue (overflow, FIFO order, try_pop, pop_all,
+ * pop_for) and benchmarks it against the list based GuardQueue under
+ * contention:
+ *  - pingpong: a pool of batches cycled between a free and a process queue
+ *    by two threads, as the context input and output threads do.
+ *  - mpmc: several producers and consumers on one queue.
+ *
+ * Usage: test_guard_queue [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <list>
+#include <thread>
+#include <vector>
+
+#include "nvdsinfer_func_utils.h"
+
+using namespace nvdsinfer;
+using Clock = std::chrono::steady_clock;
+
+#define CHECK(cond)                                                 \
+    do                                                              \
+    {                                                               \
+        if (!(cond))                                                \
+        {                                                           \
+            printf("FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            return false;                                           \
+        }                                                           \
+    } while (0)
+
+using ListQueue = GuardQueue<std::list<int*>>;
+using RingQueue = BoundedGuardQueue<int*>;
+
+static bool
+push(ListQueue& queue, int* item)
+{
+    queue.push(item);
+    return true;
+}
+
+static bool
+push(RingQueue& queue, int* item)
+{
+    return queue.push(item);
+}
+
+static bool
+testApi()
+{
+    BoundedGuardQueue<int> queue(3);
+    int item = 0;
+
+    /* Overflow is reported and leaves the queue unchanged. */
+    CHECK(queue.push(1) && queue.push(2) && queue.push(3));
+    CHECK(!queue.push(4));
+    CHECK(queue.size() == 3);
+
+    /* FIFO order across the ring wrap-around. */
+    for (int i = 1; i <= 10; i++)
+    {
+        CHECK(queue.try_pop(item) && item == i);
+        CHECK(queue.push(i + 3));
+    }
+    std::vector<int> all;
+    CHECK(queue.pop_all(all) == 3);
+    CHECK(all.size() == 3 && all[0] == 11 && all[1] == 12 && all[2] == 13);
+    CHECK(!queue.try_pop(item) && queue.size() == 0);
+
+    /* pop_for times out on an empty queue and wakes up on a push. */
+    auto start = Clock::now();
+    CHECK(!queue.pop_for(item, std::chrono::milliseconds(20)));
+    CHECK(Clock::now() - start >= std::chrono::milliseconds(20));
+    std::thread pusher([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        queue.push(7);
+    });
+    CHECK(queue.pop_for(item, std::chrono::seconds(5)) && item == 7);
+    pusher.join();
+
+    /* clear and setCapacity drop the queued items. */
+    CHECK(queue.push(1) && queue.push(2));
+    queue.clear();
+    CHECK(queue.size() == 0 && queue.push(3));
+    queue.setCapacity(1);
+    CHECK(queue.size() == 0 && queue.push(4) && !queue.push(5));
+    return true;
+}
+
+template <typename Queue>
+static double
+pingpong(Queue& freeQueue, Queue& processQueue, int poolSize, int iterations)
+{
+    std::vector<int> pool(poolSize);
+    for (int& item : pool)
+        push(freeQueue, &item);
+
+    auto start = Clock::now();
+    std::thread output([&]() {
+        for (int i = 0; i < iterations; i++)
+            push(freeQueue, processQueue.pop());
+    });
+    for (int i = 0; i < iterations; i++)
+        push(processQueue, freeQueue.pop());
+    output.join();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start)
+               .count() /
+        iterations;
+}
+
+template <typename Queue>
+static double
+mpmc(Queue& queue, int numThreads, int iterations)
+{
+    std::vector<std::thread> threads;
+    int item = 0;
+    auto start = Clock::now();
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < iterations; i++)
+                while (!push(queue, &item))
+                    std::this_thread::yield();
+        });
+        threads.emplace_back([&]() {
+            for (int i = 0; i < iterations; i++)
+                queue.pop();
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start)
+               .count() /
+        ((double)iterations * numThreads);
+}
+
+int
+main(int argc, char* argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    const int kPoolSize = 8;
+    const int kThreads = 4;
+
+    if (!testApi())
+    {
+        printf("FAIL\n");
+        return 1;
+    }
+
+    {
+        ListQueue freeQueue, processQueue;
+        double list = pingpong(freeQueue, processQueue, kPoolSize, iterations);
+        RingQueue freeRing(kPoolSize), processRing(kPoolSize);
+        double ring = pingpong(freeRing, processRing, kPoolSize, iterations);
+        printf("pingpong pool %d: list %7.1f ns/op ring %7.1f ns/op\n",
+            kPoolSize, list, ring);
+    }
+    {
+        /* The ring holds every item so that producers never spin on a full
+         * queue, as the context queues are sized to the batch pool. */
+        ListQueue queue;
+        double list = mpmc(queue, kThreads, iterations / kThreads);
+        RingQueue ring(iterations);
+        double ringTime = mpmc(ring, kThreads, iterations / kThreads);
+        printf("mpmc %dx%d: list %7.1f ns/op ring %7.1f ns/op\n", kThreads,
+            kThreads, list, ringTime);
+    }
+
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+/* Benchmarks the channel-outer segmentation argmax (simdArgmaxCHW) against
+ * the per-pixel loop it replaced on a synthetic CHW probability map, and
+ * checks that both give the same int and uint8 class maps.
+ *
+ * Usage: test_segmentation_argmax [width] [height] [classes] [threshold]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "nvdsinfer_simd.h"
+
+using namespace nvdsinfer;
+using Clock = std::chrono::steady_clock;
+
+/* Per-pixel argmax striding across the class planes. */
+static void
+referenceArgmax(const float* probs, unsigned int classes, size_t planeSize,
+    float threshold, int* classMap)
+{
+    for (size_t i = 0; i < planeSize; i++)
+    {
+        float maxProb = -1.0f;
+        int cls = -1;
+        for (unsigned int c = 0; c < classes; c++)
+        {
+            float prob = probs[c * planeSize + i];
+            if (prob > maxProb && prob > threshold)
+            {
+                maxProb = prob;
+                cls = c;
+            }
+        }
+        classMap[i] = cls;
+    }
+}
+
+/* Returns the best time in ms of repeats runs of fn. */
+template <typename Fn>
+static double
+bestOf(int repeats, Fn fn)
+{
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++)
+    {
+        auto start = Clock::now();
+        fn();
+        best = std::min(best,
+            std::chrono::duration<double, std::milli>(Clock::now() - start)
+                .count());
+    }
+    return best;
+}
+
+int
+main(int argc, char* argv[])
+{
+    unsigned int width = argc > 1 ? atoi(argv[1]) : 512;
+    unsigned int height = argc > 2 ? atoi(argv[2]) : 512;
+    unsigned int classes = argc > 3 ? atoi(argv[3]) : 21;
+    float threshold = argc > 4 ? atof(argv[4]) : 0.1f;
+    const int kRepeats = 20;
+
+    /* Softmax-like maps: one dominant class per region plus noise, with
+     * some pixels below the threshold everywhere. */
+    size_t planeSize = (size_t)width * height;
+    std::vector<float> probs(planeSize * classes);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> noise(0.0f, 1.0f);
+    for (size_t i = 0; i < planeSize; i++)
+    {
+        unsigned int dominant = ((i / width) / 32 * 7 + (i % width) / 32) %
+            classes;
+        float sum = 0.0f;
+        for (unsigned int c = 0; c < classes; c++)
+        {
+            float v = noise(rng) * (c == dominant ? 4.0f : 1.0f);
+            probs[c * planeSize + i] = v;
+            sum += v;
+        }
+        for (unsigned int c = 0; c < classes; c++)
+            probs[c * planeSize + i] /= sum;
+    }
+
+    std::vector<int> expected(planeSize), classMap(planeSize);
+    std::vector<uint8_t> classMapU8(planeSize);
+    double reference = bestOf(kRepeats, [&]() {
+        referenceArgmax(
+            probs.data(), classes, planeSize, threshold, expected.data());
+    });
+    double channelOuter = bestOf(kRepeats, [&]() {
+        simdArgmaxCHW(probs.data(), classes, planeSize, threshold, 0,
+            planeSize, classMap.data());
+    });
+    double channelOuterU8 = bestOf(kRepeats, [&]() {
+        simdArgmaxCHW(probs.data(), classes, planeSize, threshold, 0,
+            planeSize, classMapU8.data());
+    });
+
+    bool ok = true;
+    size_t unassigned = 0;
+    for (size_t i = 0; i < planeSize; i++)
+    {
+        unassigned += (expected[i] < 0);
+        if (classMap[i] != expected[i] ||
+            classMapU8[i] != (uint8_t)expected[i])
+        {
+            printf("FAIL: pixel %zu class %d / %d, expected %d\n", i,
+                classMap[i], classMapU8[i], expected[i]);
+            ok = false;
+            break;
+        }
+    }
+
+    printf("%ux%ux%u threshold %.2f, %zu pixels below threshold\n", width,
+        height, classes, threshold, unassigned);
+    printf("per-pixel           %7.3f ms\n", reference);
+    printf("channel-outer int   %7.3f ms %5.2fx\n", channelOuter,
+        reference / channelOuter);
+    printf("channel-outer uint8 %7.3f ms %5.2fx\n", channelOuterU8,
+        reference / channelOuterU8);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+/* Checks that simdQuantizeS8 saturates to [-127, 127] on the vector paths and
+ * the scalar tail, then benchmarks int8 against float32 dot products over a
+ * synthetic gallery of L2-normalized rows.
+ *
+ * Usage: test_simd_int8 [rows] [dims]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "nvdsinfer_simd.h"
+
+using namespace nvdsinfer;
+
+static bool
+testQuantizeRange()
+{
+    bool ok = true;
+    /* Lengths cover full vector blocks and every scalar tail length. */
+    for (size_t n = 1; n <= 67; n++)
+    {
+        std::vector<float> src(n);
+        for (size_t i = 0; i < n; i++)
+            src[i] = (i % 3 == 0) ? -1000.0f : (i % 3 == 1 ? 1000.0f : -1.0f);
+        std::vector<int8_t> dst(n);
+        simdQuantizeS8(src.data(), dst.data(), 127.0f, n);
+        for (size_t i = 0; i < n; i++)
+        {
+            int expected = (i % 3 == 0) ? -127 : (i % 3 == 1 ? 127 : -127);
+            if (dst[i] != expected)
+            {
+                printf("FAIL: quantize n %zu element %zu: %d, expected %d\n",
+                    n, i, dst[i], expected);
+                ok = false;
+                break;
+            }
+        }
+
+        /* In place, over the start of the float buffer. */
+        int8_t* inPlace = reinterpret_cast<int8_t*>(src.data());
+        simdQuantizeS8(src.data(), inPlace, 127.0f, n);
+        if (memcmp(inPlace, dst.data(), n) != 0)
+        {
+            printf("FAIL: in-place quantize n %zu differs\n", n);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int
+main(int argc, char* argv[])
+{
+    size_t numRows = argc > 1 ? atoi(argv[1]) : 100000;
+    size_t dims = argc > 2 ? atoi(argv[2]) : 256;
+    const int kRepeats = 10;
+
+    bool ok = testQuantizeRange();
+
+    std::mt19937 rng(42);
+    std::normal_distribution<float> gauss(0.0f, 1.0f);
+    auto normalized = [&](float* v) {
+        for (size_t d = 0; d < dims; d++)
+            v[d] = gauss(rng);
+        float norm = std::sqrt(simdDot(v, v, dims));
+        simdScale(v, 1.0f / norm, dims);
+    };
+
+    std::vector<float> rows(numRows * dims);
+    std::vector<int8_t> rowsS8(numRows * dims);
+    std::vector<float> scales(numRows);
+    for (size_t r = 0; r < numRows; r++)
+    {
+        float* row = &rows[r * dims];
+        normalized(row);
+        float maxAbs = simdMaxAbs(row, dims);
+        scales[r] = maxAbs / 127.0f;
+        simdQuantizeS8(row, &rowsS8[r * dims], 127.0f / maxAbs, dims);
+    }
+    std::vector<float> query(dims);
+    normalized(query.data());
+    std::vector<int8_t> queryS8(dims);
+    float queryMaxAbs = simdMaxAbs(query.data(), dims);
+    simdQuantizeS8(query.data(), queryS8.data(), 127.0f / queryMaxAbs, dims);
+    float queryScale = queryMaxAbs / 127.0f;
+
+    std::vector<float> scoresF32(numRows), scoresS8(numRows);
+    auto start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < kRepeats; rep++)
+        for (size_t r = 0; r < numRows; r++)
+            scoresF32[r] = simdDot(query.data(), &rows[r * dims], dims);
+    std::chrono::duration<double> f32Time =
+        std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int rep = 0; rep < kRepeats; rep++)
+        for (size_t r = 0; r < numRows; r++)
+            scoresS8[r] = queryScale * scales[r] *
+                simdDotS8(queryS8.data(), &rowsS8[r * dims], dims);
+    std::chrono::duration<double> s8Time =
+        std::chrono::steady_clock::now() - start;
+
+    float maxError = 0.0f;
+    for (size_t r = 0; r < numRows; r++)
+        maxError = std::max(maxError, std::fabs(scoresF32[r] - scoresS8[r]));
+
+    double f32Rate = numRows * kRepeats / f32Time.count();
+    double s8Rate = numRows * kRepeats / s8Time.count();
+    printf("rows %zu dims %zu\n", numRows, dims);
+    printf("float32 %8.1f Mrows/sec\n", f32Rate / 1e6);
+    printf("int8    %8.1f Mrows/sec %5.2fx, max score error %.4f\n",
+        s8Rate / 1e6, s8Rate / f32Rate, maxError);
+    if (maxError > 0.05f)
+    {
+        printf("FAIL: int8 scores diverge from float32\n");
+        ok = false;
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -20,9 +20,12 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include "nvdsinfer_custom_impl.h"
+#include "nvdsinfer_tensor_view.h"
 
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
@@ -30,7 +33,9 @@
 #define DIVIDE_AND_ROUND_UP(a, b) ((a + b - 1) / b)
 
 /* This is a sample bounding box parsing function for the sample Resnet10
- * detector model provided with the SDK. */
+ * detector model provided with the SDK. The WithContext variant keeps the
+ * layer lookup and the grid center tables in a per-context state, the plain
+ * variant rebuilds them on every call. */
 
 /* C-linkage to prevent name-mangling */
 extern "C"
@@ -39,6 +44,23 @@ bool NvDsInferParseCustomResnet (std::vector<NvDsInferLayerInfo> const &outputLa
         NvDsInferParseDetectionParams const &detectionParams,
         std::vector<NvDsInferObjectDetectionInfo> &objectList);
 
+extern "C"
+bool NvDsInferParseCustomResnetCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context);
+
+extern "C"
+bool NvDsInferParseCustomResnetWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+void NvDsInferParseCustomResnetDestroyContext (void *context);
+
 /* This is a sample bounding box parsing function for the tensorflow SSD models
  * detector model provided with the SDK. */
 
@@ -49,161 +71,285 @@ bool NvDsInferParseCustomTfSSD (std::vector<NvDsInferLayerInfo> const &outputLay
         NvDsInferParseDetectionParams const &detectionParams,
         std::vector<NvDsInferObjectDetectionInfo> &objectList);
 
+extern "C"
+bool NvDsInferParseCustomTfSSDCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context);
 
 extern "C"
-bool NvDsInferParseCustomResnet (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+bool NvDsInferParseCustomTfSSDWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
         NvDsInferNetworkInfo  const &networkInfo,
         NvDsInferParseDetectionParams const &detectionParams,
-        std::vector<NvDsInferObjectDetectionInfo> &objectList)
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+void NvDsInferParseCustomTfSSDDestroyContext (void *context);
+
+/* Per-context state of the Resnet10 parser. */
+struct ResnetParseContext
 {
-  static NvDsInferDimsCHW covLayerDims;
-  static NvDsInferDimsCHW bboxLayerDims;
-  static int bboxLayerIndex = -1;
-  static int covLayerIndex = -1;
-  static bool classMismatchWarn = false;
-  int numClassesToParse;
+  int bboxLayerIndex = -1;
+  int covLayerIndex = -1;
+  NvDsInferDimsCHW covLayerDims;
+  NvDsInferDimsCHW bboxLayerDims;
+  /* Normalized grid cell centers for the network resolution below. */
+  unsigned int networkWidth = 0;
+  unsigned int networkHeight = 0;
+  std::vector<float> gcCentersX;
+  std::vector<float> gcCentersY;
+  /* Scratch buffers reused across frames. */
+  std::vector<float> covScratch;
+  std::vector<uint32_t> hits;
+};
+
+/* The legacy entry point has no context to remember the warning in. */
+static std::atomic_flag resnetLegacyMismatchWarned = ATOMIC_FLAG_INIT;
 
+static bool
+resnetFindLayers (ResnetParseContext &ctx,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+    NvDsInferParseDetectionParams const &detectionParams, bool warnMismatch)
+{
   /* Find the bbox layer */
-  if (bboxLayerIndex == -1) {
-    for (unsigned int i = 0; i < outputLayersInfo.size(); i++) {
-      if (strcmp(outputLayersInfo[i].layerName, "conv2d_bbox") == 0) {
-        bboxLayerIndex = i;
-        getDimsCHWFromDims(bboxLayerDims, outputLayersInfo[i].inferDims);
-        break;
-      }
+  for (unsigned int i = 0; i < outputLayersInfo.size(); i++) {
+    if (strcmp(outputLayersInfo[i].layerName, "conv2d_bbox") == 0) {
+      ctx.bboxLayerIndex = i;
+      getDimsCHWFromDims(ctx.bboxLayerDims, outputLayersInfo[i].inferDims);
+      break;
     }
-    if (bboxLayerIndex == -1) {
+  }
+  if (ctx.bboxLayerIndex == -1) {
     std::cerr << "Could not find bbox layer buffer while parsing" << std::endl;
     return false;
-    }
   }
 
   /* Find the cov layer */
-  if (covLayerIndex == -1) {
-    for (unsigned int i = 0; i < outputLayersInfo.size(); i++) {
-      if (strcmp(outputLayersInfo[i].layerName, "conv2d_cov/Sigmoid") == 0) {
-        covLayerIndex = i;
-        getDimsCHWFromDims(covLayerDims, outputLayersInfo[i].inferDims);
-        break;
-      }
+  for (unsigned int i = 0; i < outputLayersInfo.size(); i++) {
+    if (strcmp(outputLayersInfo[i].layerName, "conv2d_cov/Sigmoid") == 0) {
+      ctx.covLayerIndex = i;
+      getDimsCHWFromDims(ctx.covLayerDims, outputLayersInfo[i].inferDims);
+      break;
     }
-    if (covLayerIndex == -1) {
+  }
+  if (ctx.covLayerIndex == -1) {
     std::cerr << "Could not find bbox layer buffer while parsing" << std::endl;
     return false;
-    }
   }
 
   /* Warn in case of mismatch in number of classes */
-  if (!classMismatchWarn) {
-    if (covLayerDims.c != detectionParams.numClassesConfigured) {
-      std::cerr << "WARNING: Num classes mismatch. Configured:" <<
-        detectionParams.numClassesConfigured << ", detected by network: " <<
-        covLayerDims.c << std::endl;
-    }
-    classMismatchWarn = true;
+  if (warnMismatch &&
+      ctx.covLayerDims.c != detectionParams.numClassesConfigured) {
+    std::cerr << "WARNING: Num classes mismatch. Configured:" <<
+      detectionParams.numClassesConfigured << ", detected by network: " <<
+      ctx.covLayerDims.c << std::endl;
   }
+  return true;
+}
 
-  /* Calculate the number of classes to parse */
-  numClassesToParse = MIN (covLayerDims.c, detectionParams.numClassesConfigured);
+/* Fill the grid center tables, they only change with the network
+ * resolution. */
+static void
+resnetUpdateGridCenters (ResnetParseContext &ctx,
+    NvDsInferNetworkInfo const &networkInfo)
+{
+  if (!ctx.gcCentersX.empty() && ctx.networkWidth == networkInfo.width &&
+      ctx.networkHeight == networkInfo.height)
+    return;
 
-  int gridW = covLayerDims.w;
-  int gridH = covLayerDims.h;
-  int gridSize = gridW * gridH;
-  float gcCentersX[gridW];
-  float gcCentersY[gridH];
+  int gridW = ctx.covLayerDims.w;
+  int gridH = ctx.covLayerDims.h;
   float bboxNormX = 35.0;
   float bboxNormY = 35.0;
-  float *outputCovBuf = (float *) outputLayersInfo[covLayerIndex].buffer;
-  float *outputBboxBuf = (float *) outputLayersInfo[bboxLayerIndex].buffer;
-  int strideX = DIVIDE_AND_ROUND_UP(networkInfo.width, bboxLayerDims.w);
-  int strideY = DIVIDE_AND_ROUND_UP(networkInfo.height, bboxLayerDims.h);
+  int strideX = DIVIDE_AND_ROUND_UP(networkInfo.width, ctx.bboxLayerDims.w);
+  int strideY = DIVIDE_AND_ROUND_UP(networkInfo.height, ctx.bboxLayerDims.h);
 
+  ctx.gcCentersX.resize(gridW);
+  ctx.gcCentersY.resize(gridH);
   for (int i = 0; i < gridW; i++)
   {
-    gcCentersX[i] = (float)(i * strideX + 0.5);
-    gcCentersX[i] /= (float)bboxNormX;
-
+    ctx.gcCentersX[i] = (float)(i * strideX + 0.5);
+    ctx.gcCentersX[i] /= (float)bboxNormX;
   }
   for (int i = 0; i < gridH; i++)
   {
-    gcCentersY[i] = (float)(i * strideY + 0.5);
-    gcCentersY[i] /= (float)bboxNormY;
-
+    ctx.gcCentersY[i] = (float)(i * strideY + 0.5);
+    ctx.gcCentersY[i] /= (float)bboxNormY;
   }
+  ctx.networkWidth = networkInfo.width;
+  ctx.networkHeight = networkInfo.height;
+}
+
+static bool
+resnetParse (ResnetParseContext &ctx,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+    NvDsInferNetworkInfo  const &networkInfo,
+    NvDsInferParseDetectionParams const &detectionParams,
+    std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+  resnetUpdateGridCenters (ctx, networkInfo);
+
+  /* Calculate the number of classes to parse */
+  int numClassesToParse =
+      MIN (ctx.covLayerDims.c, detectionParams.numClassesConfigured);
+
+  int gridW = ctx.covLayerDims.w;
+  int gridSize = gridW * ctx.covLayerDims.h;
+  float bboxNormX = 35.0;
+  float bboxNormY = 35.0;
+  NvDsInferTensorView outputCov(outputLayersInfo[ctx.covLayerIndex]);
+  NvDsInferTensorView outputBbox(outputLayersInfo[ctx.bboxLayerIndex]);
+  if (!outputCov.isFloat())
+    ctx.covScratch.resize(gridSize);
 
   for (int c = 0; c < numClassesToParse; c++)
   {
-    float *outputX1 = outputBboxBuf + (c * 4 * bboxLayerDims.h * bboxLayerDims.w);
-
-    float *outputY1 = outputX1 + gridSize;
-    float *outputX2 = outputY1 + gridSize;
-    float *outputY2 = outputX2 + gridSize;
+    size_t outputX1 = c * 4 * ctx.bboxLayerDims.h * ctx.bboxLayerDims.w;
+    size_t outputY1 = outputX1 + gridSize;
+    size_t outputX2 = outputY1 + gridSize;
+    size_t outputY2 = outputX2 + gridSize;
+    const float *outputCovBuf =
+        outputCov.read(c * gridSize, gridSize, ctx.covScratch.data());
 
+    /* Find the grid cells above threshold first, only those are decoded. */
     float threshold = detectionParams.perClassPreclusterThreshold[c];
-    for (int h = 0; h < gridH; h++)
+    ctx.hits.clear();
+    NvDsInferScanThreshold(outputCovBuf, gridSize, threshold, ctx.hits);
+    objectList.reserve(objectList.size() + ctx.hits.size());
+
+    for (uint32_t i : ctx.hits)
     {
-      for (int w = 0; w < gridW; w++)
-      {
-        int i = w + h * gridW;
-        if (outputCovBuf[c * gridSize + i] >= threshold)
-        {
-          NvDsInferObjectDetectionInfo object;
-          float rectX1f, rectY1f, rectX2f, rectY2f;
-
-          rectX1f = (outputX1[w + h * gridW] - gcCentersX[w]) * -bboxNormX;
-          rectY1f = (outputY1[w + h * gridW] - gcCentersY[h]) * -bboxNormY;
-          rectX2f = (outputX2[w + h * gridW] + gcCentersX[w]) * bboxNormX;
-          rectY2f = (outputY2[w + h * gridW] + gcCentersY[h]) * bboxNormY;
-
-          object.classId = c;
-          object.detectionConfidence = outputCovBuf[c * gridSize + i];
-
-          /* Clip object box co-ordinates to network resolution */
-          object.left = CLIP(rectX1f, 0, networkInfo.width - 1);
-          object.top = CLIP(rectY1f, 0, networkInfo.height - 1);
-          object.width = CLIP(rectX2f, 0, networkInfo.width - 1) -
-                             object.left + 1;
-          object.height = CLIP(rectY2f, 0, networkInfo.height - 1) -
-                             object.top + 1;
-
-          objectList.push_back(object);
-        }
-      }
+      int h = i / gridW;
+      int w = i - h * gridW;
+      NvDsInferObjectDetectionInfo object;
+      float rectX1f, rectY1f, rectX2f, rectY2f;
+
+      rectX1f = (outputBbox[outputX1 + i] - ctx.gcCentersX[w]) * -bboxNormX;
+      rectY1f = (outputBbox[outputY1 + i] - ctx.gcCentersY[h]) * -bboxNormY;
+      rectX2f = (outputBbox[outputX2 + i] + ctx.gcCentersX[w]) * bboxNormX;
+      rectY2f = (outputBbox[outputY2 + i] + ctx.gcCentersY[h]) * bboxNormY;
+
+      object.classId = c;
+      object.detectionConfidence = outputCovBuf[i];
+
+      /* Clip object box co-ordinates to network resolution */
+      object.left = CLIP(rectX1f, 0, networkInfo.width - 1);
+      object.top = CLIP(rectY1f, 0, networkInfo.height - 1);
+      object.width = CLIP(rectX2f, 0, networkInfo.width - 1) -
+                         object.left + 1;
+      object.height = CLIP(rectY2f, 0, networkInfo.height - 1) -
+                         object.top + 1;
+
+      objectList.push_back(object);
     }
   }
   return true;
 }
 
 extern "C"
-bool NvDsInferParseCustomTfSSD (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
-    NvDsInferNetworkInfo  const &networkInfo,
-    NvDsInferParseDetectionParams const &detectionParams,
-    std::vector<NvDsInferObjectDetectionInfo> &objectList)
+bool NvDsInferParseCustomResnet (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList)
 {
-    auto layerFinder = [&outputLayersInfo](const std::string &name)
-        -> const NvDsInferLayerInfo *{
-        for (auto &layer : outputLayersInfo) {
-            if (layer.dataType == FLOAT &&
-              (layer.layerName && name == layer.layerName)) {
-                return &layer;
+  ResnetParseContext ctx;
+  bool warnMismatch = !resnetLegacyMismatchWarned.test_and_set ();
+  if (!resnetFindLayers (ctx, outputLayersInfo, detectionParams, warnMismatch))
+    return false;
+  return resnetParse (ctx, outputLayersInfo, networkInfo, detectionParams,
+      objectList);
+}
+
+extern "C"
+bool NvDsInferParseCustomResnetCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context)
+{
+  std::unique_ptr<ResnetParseContext> ctx (new ResnetParseContext);
+  if (!resnetFindLayers (*ctx, outputLayersInfo, detectionParams, true))
+    return false;
+  resnetUpdateGridCenters (*ctx, networkInfo);
+  *context = ctx.release ();
+  return true;
+}
+
+extern "C"
+bool NvDsInferParseCustomResnetWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+  return resnetParse (*(ResnetParseContext *) context, outputLayersInfo,
+      networkInfo, detectionParams, objectList);
+}
+
+extern "C"
+void NvDsInferParseCustomResnetDestroyContext (void *context)
+{
+  delete (ResnetParseContext *) context;
+}
+
+/* Per-context state of the TF SSD parser: indices of the output layers. */
+struct TfSSDParseContext
+{
+    int numDetectionLayer = -1;
+    int scoreLayer = -1;
+    int classLayer = -1;
+    int boxLayer = -1;
+};
+
+static bool
+tfSSDFindLayers (TfSSDParseContext &ctx,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo)
+{
+    auto layerFinder = [&outputLayersInfo](const std::string &name) -> int {
+        for (unsigned int i = 0; i < outputLayersInfo.size(); i++) {
+            const NvDsInferLayerInfo &layer = outputLayersInfo[i];
+            if (layer.layerName && name == layer.layerName) {
+                return i;
             }
         }
-        return nullptr;
+        return -1;
     };
 
-    const NvDsInferLayerInfo *numDetectionLayer = layerFinder("num_detections");
-    const NvDsInferLayerInfo *scoreLayer = layerFinder("detection_scores");
-    const NvDsInferLayerInfo *classLayer = layerFinder("detection_classes");
-    const NvDsInferLayerInfo *boxLayer = layerFinder("detection_boxes");
-    if (!numDetectionLayer || !scoreLayer || !classLayer || !boxLayer) {
+    ctx.numDetectionLayer = layerFinder("num_detections");
+    ctx.scoreLayer = layerFinder("detection_scores");
+    ctx.classLayer = layerFinder("detection_classes");
+    ctx.boxLayer = layerFinder("detection_boxes");
+    if (ctx.numDetectionLayer < 0 || ctx.scoreLayer < 0 ||
+        ctx.classLayer < 0 || ctx.boxLayer < 0) {
         std::cerr << "ERROR: some layers missing or unsupported data types "
                   << "in output tensors" << std::endl;
         return false;
     }
+    return true;
+}
+
+static bool
+tfSSDParse (TfSSDParseContext const &ctx,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+    NvDsInferNetworkInfo  const &networkInfo,
+    NvDsInferParseDetectionParams const &detectionParams,
+    std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    const NvDsInferLayerInfo *numDetectionLayer =
+        &outputLayersInfo[ctx.numDetectionLayer];
+    const NvDsInferLayerInfo *scoreLayer = &outputLayersInfo[ctx.scoreLayer];
+    const NvDsInferLayerInfo *classLayer = &outputLayersInfo[ctx.classLayer];
+    const NvDsInferLayerInfo *boxLayer = &outputLayersInfo[ctx.boxLayer];
+
+    NvDsInferTensorView scores(*scoreLayer);
+    NvDsInferTensorView classes(*classLayer);
+    NvDsInferTensorView boxes(*boxLayer);
 
     unsigned int numDetections = 0;
     if (numDetectionLayer->buffer) {
-        numDetections = (int)((float*)numDetectionLayer->buffer)[0];
+        numDetections = (int)NvDsInferTensorView(*numDetectionLayer)[0];
     }
     if (numDetections > classLayer->inferDims.d[0]) {
         numDetections = classLayer->inferDims.d[0];
@@ -211,8 +357,8 @@ bool NvDsInferParseCustomTfSSD (std::vector<NvDsInferLayerInfo> const &outputLay
     numDetections = std::max<int>(0, numDetections);
     for (unsigned int i = 0; i < numDetections; ++i) {
         NvDsInferObjectDetectionInfo res;
-        res.detectionConfidence = ((float*)scoreLayer->buffer)[i];
-        res.classId = ((float*)classLayer->buffer)[i];
+        res.detectionConfidence = scores[i];
+        res.classId = classes[i];
         if (res.classId >= detectionParams.perClassPreclusterThreshold.size() ||
             res.detectionConfidence <
             detectionParams.perClassPreclusterThreshold[res.classId]) {
@@ -220,10 +366,10 @@ bool NvDsInferParseCustomTfSSD (std::vector<NvDsInferLayerInfo> const &outputLay
         }
         enum {y1, x1, y2, x2};
         float rectX1f, rectY1f, rectX2f, rectY2f;
-        rectX1f = ((float*)boxLayer->buffer)[i *4 + x1] * networkInfo.width;
-        rectY1f = ((float*)boxLayer->buffer)[i *4 + y1] * networkInfo.height;
-        rectX2f = ((float*)boxLayer->buffer)[i *4 + x2] * networkInfo.width;;
-        rectY2f = ((float*)boxLayer->buffer)[i *4 + y2] * networkInfo.height;
+        rectX1f = boxes[i *4 + x1] * networkInfo.width;
+        rectY1f = boxes[i *4 + y1] * networkInfo.height;
+        rectX2f = boxes[i *4 + x2] * networkInfo.width;
+        rectY2f = boxes[i *4 + y2] * networkInfo.height;
         rectX1f = CLIP(rectX1f, 0.0f, networkInfo.width - 1);
         rectX2f = CLIP(rectX2f, 0.0f, networkInfo.width - 1);
         rectY1f = CLIP(rectY1f, 0.0f, networkInfo.height - 1);
@@ -243,6 +389,52 @@ bool NvDsInferParseCustomTfSSD (std::vector<NvDsInferLayerInfo> const &outputLay
     return true;
 }
 
+extern "C"
+bool NvDsInferParseCustomTfSSD (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+    NvDsInferNetworkInfo  const &networkInfo,
+    NvDsInferParseDetectionParams const &detectionParams,
+    std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    TfSSDParseContext ctx;
+    if (!tfSSDFindLayers(ctx, outputLayersInfo))
+        return false;
+    return tfSSDParse(ctx, outputLayersInfo, networkInfo, detectionParams,
+        objectList);
+}
+
+extern "C"
+bool NvDsInferParseCustomTfSSDCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context)
+{
+    std::unique_ptr<TfSSDParseContext> ctx(new TfSSDParseContext);
+    if (!tfSSDFindLayers(*ctx, outputLayersInfo))
+        return false;
+    *context = ctx.release();
+    return true;
+}
+
+extern "C"
+bool NvDsInferParseCustomTfSSDWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    return tfSSDParse(*(TfSSDParseContext *) context, outputLayersInfo,
+        networkInfo, detectionParams, objectList);
+}
+
+extern "C"
+void NvDsInferParseCustomTfSSDDestroyContext (void *context)
+{
+    delete (TfSSDParseContext *) context;
+}
+
 /* Check that the custom function has been defined correctly */
 CHECK_CUSTOM_PARSE_FUNC_PROTOTYPE(NvDsInferParseCustomResnet);
 CHECK_CUSTOM_PARSE_FUNC_PROTOTYPE(NvDsInferParseCustomTfSSD);
+CHECK_CUSTOM_PARSE_CONTEXT_FUNC_PROTOTYPES(NvDsInferParseCustomResnet);
+CHECK_CUSTOM_PARSE_CONTEXT_FUNC_PROTOTYPES(NvDsInferParseCustomTfSSD);
@@ -23,6 +23,7 @@
 #include <cstring>
 #include <iostream>
 #include "nvdsinfer_custom_impl.h"
+#include "nvdsinfer_tensor_view.h"
 
 /* This is a sample classifier output parsing function from softmax layers for
  * the vehicle type classifier model provided with the SDK. */
@@ -61,7 +62,10 @@ bool NvDsInferClassiferParseCustomSoftmax (std::vector<NvDsInferLayerInfo> const
 
         getDimsCHWFromDims(dims, outputLayersInfo[l].inferDims);
         unsigned int numClasses = dims.c;
-        float *outputCoverageBuffer = (float *)outputLayersInfo[l].buffer;
+        NvDsInferTensorView outputCoverage(outputLayersInfo[l]);
+        std::vector<float> scratch(outputCoverage.isFloat() ? 0 : numClasses);
+        const float *outputCoverageBuffer =
+            outputCoverage.read(0, numClasses, scratch.data());
         float maxProbability = 0;
         bool attrFound = false;
         NvDsInferAttribute attr;
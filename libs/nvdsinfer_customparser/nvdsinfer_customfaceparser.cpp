@@ -0,0 +1,527 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include "nvdsinfer_custom_impl.h"
+#include "nvdsinfer_tensor_view.h"
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define CLIP(a,min,max) (MAX(MIN(a, max), min))
+
+/* These are sample bounding box parsing functions for anchor based face
+ * detectors with 5 landmarks (eyes, nose tip and mouth corners) per face:
+ *
+ * - NvDsInferParseCustomRetinaFace: RetinaFace models with the three output
+ *   layers of all anchors, boxes [N, 4] as SSD offsets with variances
+ *   (0.1, 0.2), scores [N, 2] after softmax and landmarks [N, 10].
+ * - NvDsInferParseCustomSCRFD: SCRFD models with score [N, 1], box [N, 4]
+ *   (distances to the left, top, right and bottom edges) and keypoint
+ *   [N, 10] output layers for each of the strides 8, 16 and 32.
+ *
+ * Both use anchors on strides 8, 16 and 32 with two anchors per cell. The
+ * anchor table is computed once per context for the network resolution, a
+ * SIMD pass selects the anchors above the threshold and only those are
+ * decoded. Use cluster-mode=2 (NMS) to keep the landmarks through
+ * clustering. */
+
+/* C-linkage to prevent name-mangling */
+extern "C"
+bool NvDsInferParseCustomRetinaFace (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+bool NvDsInferParseCustomRetinaFaceCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context);
+
+extern "C"
+bool NvDsInferParseCustomRetinaFaceWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+bool NvDsInferParseCustomRetinaFaceWithLandmarks (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList,
+        std::vector<float> &landmarks,
+        unsigned int &numLandmarks);
+
+extern "C"
+void NvDsInferParseCustomRetinaFaceDestroyContext (void *context);
+
+extern "C"
+bool NvDsInferParseCustomSCRFD (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+bool NvDsInferParseCustomSCRFDCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context);
+
+extern "C"
+bool NvDsInferParseCustomSCRFDWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+bool NvDsInferParseCustomSCRFDWithLandmarks (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList,
+        std::vector<float> &landmarks,
+        unsigned int &numLandmarks);
+
+extern "C"
+void NvDsInferParseCustomSCRFDDestroyContext (void *context);
+
+enum FaceModel
+{
+    FACE_MODEL_RETINAFACE,
+    FACE_MODEL_SCRFD
+};
+
+static const unsigned int kFaceNumStrides = 3;
+static const unsigned int kFaceStrides[kFaceNumStrides] = {8, 16, 32};
+static const unsigned int kFaceAnchorsPerCell = 2;
+static const unsigned int kFaceNumLandmarks = 5;
+/* RetinaFace anchor sizes in pixels for each stride. */
+static const float kRetinaFaceMinSizes[kFaceNumStrides][kFaceAnchorsPerCell] =
+    {{16, 32}, {64, 128}, {256, 512}};
+static const float kRetinaFaceCenterVariance = 0.1f;
+static const float kRetinaFaceSizeVariance = 0.2f;
+
+/* Output layers of the anchors [anchorOffset, anchorOffset + numAnchors). */
+struct FaceLevel
+{
+    int scoreLayer = -1;
+    int boxLayer = -1;
+    int landmarkLayer = -1;
+    unsigned int anchorOffset = 0;
+    unsigned int numAnchors = 0;
+};
+
+/* Per-context state of the face parsers: anchor table for the network
+ * resolution, output layers and scratch buffers. */
+struct FaceParseContext
+{
+    FaceModel model;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    /* One level for RetinaFace, one per stride for SCRFD. */
+    std::vector<FaceLevel> levels;
+    /* Anchor centers in network pixels and anchor scale: the anchor size for
+     * RetinaFace, the stride for SCRFD. */
+    std::vector<float> anchorCx;
+    std::vector<float> anchorCy;
+    std::vector<float> anchorScale;
+    std::vector<float> scores;
+    std::vector<float> scratch;
+    std::vector<uint32_t> hits;
+};
+
+static void
+faceBuildAnchors (FaceParseContext &ctx, NvDsInferNetworkInfo const &networkInfo)
+{
+    ctx.width = networkInfo.width;
+    ctx.height = networkInfo.height;
+    ctx.anchorCx.clear();
+    ctx.anchorCy.clear();
+    ctx.anchorScale.clear();
+    ctx.levels.clear();
+
+    for (unsigned int s = 0; s < kFaceNumStrides; s++) {
+        unsigned int stride = kFaceStrides[s];
+        unsigned int gridW = (networkInfo.width + stride - 1) / stride;
+        unsigned int gridH = (networkInfo.height + stride - 1) / stride;
+        /* RetinaFace priors are at the cell centers, SCRFD anchor points at
+         * the cell corners. */
+        float offset = ctx.model == FACE_MODEL_RETINAFACE ? 0.5f : 0.0f;
+
+        FaceLevel level;
+        level.anchorOffset = ctx.anchorCx.size();
+        level.numAnchors = gridW * gridH * kFaceAnchorsPerCell;
+        for (unsigned int y = 0; y < gridH; y++) {
+            for (unsigned int x = 0; x < gridW; x++) {
+                for (unsigned int a = 0; a < kFaceAnchorsPerCell; a++) {
+                    ctx.anchorCx.push_back((x + offset) * stride);
+                    ctx.anchorCy.push_back((y + offset) * stride);
+                    ctx.anchorScale.push_back(
+                        ctx.model == FACE_MODEL_RETINAFACE ?
+                            kRetinaFaceMinSizes[s][a] : (float)stride);
+                }
+            }
+        }
+        ctx.levels.push_back(level);
+    }
+
+    if (ctx.model == FACE_MODEL_RETINAFACE) {
+        /* All the anchors are in the same output layers. */
+        FaceLevel level;
+        level.numAnchors = ctx.anchorCx.size();
+        ctx.levels.assign(1, level);
+    }
+}
+
+/* Returns the number of rows of a [rows, cols] output layer, 0 if the layer
+ * does not have @a cols columns. */
+static unsigned int
+faceLayerRows (NvDsInferLayerInfo const &layer, unsigned int cols)
+{
+    const NvDsInferDims &dims = layer.inferDims;
+    unsigned int lastDim = dims.numDims > 1 ? dims.d[dims.numDims - 1] : 1;
+    if (lastDim != cols || dims.numElements % cols)
+        return 0;
+    return dims.numElements / cols;
+}
+
+static bool
+faceFindLayers (FaceParseContext &ctx,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo)
+{
+    unsigned int scoreCols = ctx.model == FACE_MODEL_RETINAFACE ? 2 : 1;
+
+    for (FaceLevel &level : ctx.levels) {
+        for (unsigned int i = 0; i < outputLayersInfo.size(); i++) {
+            const NvDsInferLayerInfo &layer = outputLayersInfo[i];
+            if (faceLayerRows(layer, scoreCols) == level.numAnchors)
+                level.scoreLayer = i;
+            else if (faceLayerRows(layer, 4) == level.numAnchors)
+                level.boxLayer = i;
+            else if (faceLayerRows(layer, kFaceNumLandmarks * 2) ==
+                level.numAnchors)
+                level.landmarkLayer = i;
+        }
+        if (level.scoreLayer < 0 || level.boxLayer < 0 ||
+            level.landmarkLayer < 0) {
+            std::cerr << "ERROR: could not find the score, box and landmark "
+                      << "layers of " << level.numAnchors << " anchors for a "
+                      << ctx.width << "x" << ctx.height << " network"
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool
+faceInitContext (FaceParseContext &ctx,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+    NvDsInferNetworkInfo const &networkInfo)
+{
+    faceBuildAnchors(ctx, networkInfo);
+    return faceFindLayers(ctx, outputLayersInfo);
+}
+
+/* Copies the second column of the [n, 2] RetinaFace scores. */
+static void
+faceDeinterleaveScores (const float *src, float *dst, size_t n)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128 lo = _mm_loadu_ps(src + i * 2);
+        __m128 hi = _mm_loadu_ps(src + i * 2 + 4);
+        _mm_storeu_ps(dst + i, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(dst + i, vld2q_f32(src + i * 2).val[1]);
+#endif
+    for (; i < n; i++)
+        dst[i] = src[i * 2 + 1];
+}
+
+/* Decodes the 5 landmarks of an anchor: dst[k] = center + src[k] * scale
+ * for interleaved x and y. */
+static inline void
+faceDecodeLandmarks (const float *src, float cx, float cy, float scale,
+    float *dst)
+{
+    unsigned int k = 0;
+#if defined(__SSE2__)
+    __m128 center = _mm_setr_ps(cx, cy, cx, cy);
+    __m128 vscale = _mm_set1_ps(scale);
+    for (; k + 4 <= kFaceNumLandmarks * 2; k += 4) {
+        _mm_storeu_ps(dst + k, _mm_add_ps(center,
+            _mm_mul_ps(_mm_loadu_ps(src + k), vscale)));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t center = {cx, cy, cx, cy};
+    for (; k + 4 <= kFaceNumLandmarks * 2; k += 4) {
+        vst1q_f32(dst + k, vaddq_f32(center,
+            vmulq_n_f32(vld1q_f32(src + k), scale)));
+    }
+#endif
+    for (; k < kFaceNumLandmarks * 2; k += 2) {
+        dst[k] = cx + src[k] * scale;
+        dst[k + 1] = cy + src[k + 1] * scale;
+    }
+}
+
+static bool
+faceParse (FaceParseContext &ctx,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+    NvDsInferNetworkInfo  const &networkInfo,
+    NvDsInferParseDetectionParams const &detectionParams,
+    std::vector<NvDsInferObjectDetectionInfo> &objectList,
+    std::vector<float> *landmarks)
+{
+    if (networkInfo.width != ctx.width || networkInfo.height != ctx.height) {
+        if (!faceInitContext(ctx, outputLayersInfo, networkInfo))
+            return false;
+    }
+
+    float threshold = detectionParams.perClassPreclusterThreshold.empty() ?
+        0.5f : detectionParams.perClassPreclusterThreshold[0];
+    bool retinaFace = ctx.model == FACE_MODEL_RETINAFACE;
+    float maxX = networkInfo.width - 1;
+    float maxY = networkInfo.height - 1;
+
+    for (const FaceLevel &level : ctx.levels) {
+        NvDsInferTensorView scoreView(outputLayersInfo[level.scoreLayer]);
+        NvDsInferTensorView boxView(outputLayersInfo[level.boxLayer]);
+        NvDsInferTensorView landmarkView(outputLayersInfo[level.landmarkLayer]);
+        size_t n = level.numAnchors;
+
+        /* Select the anchors above the threshold. */
+        const float *scores;
+        if (retinaFace) {
+            ctx.scratch.resize(scoreView.isFloat() ? 0 : n * 2);
+            ctx.scores.resize(n);
+            faceDeinterleaveScores(scoreView.read(0, n * 2, ctx.scratch.data()),
+                ctx.scores.data(), n);
+            scores = ctx.scores.data();
+        } else {
+            ctx.scores.resize(scoreView.isFloat() ? 0 : n);
+            scores = scoreView.read(0, n, ctx.scores.data());
+        }
+        ctx.hits.clear();
+        NvDsInferScanThreshold(scores, n, threshold, ctx.hits);
+
+        for (uint32_t i : ctx.hits) {
+            uint32_t a = level.anchorOffset + i;
+            float cx = ctx.anchorCx[a];
+            float cy = ctx.anchorCy[a];
+            float scale = ctx.anchorScale[a];
+            float boxScratch[4];
+            float landmarkScratch[kFaceNumLandmarks * 2];
+            const float *box = boxView.read((size_t)i * 4, 4, boxScratch);
+
+            float x1, y1, x2, y2;
+            if (retinaFace) {
+                float bx = cx + box[0] * kRetinaFaceCenterVariance * scale;
+                float by = cy + box[1] * kRetinaFaceCenterVariance * scale;
+                float bw = scale * expf(box[2] * kRetinaFaceSizeVariance);
+                float bh = scale * expf(box[3] * kRetinaFaceSizeVariance);
+                x1 = bx - bw / 2;
+                y1 = by - bh / 2;
+                x2 = bx + bw / 2;
+                y2 = by + bh / 2;
+            } else {
+                x1 = cx - box[0] * scale;
+                y1 = cy - box[1] * scale;
+                x2 = cx + box[2] * scale;
+                y2 = cy + box[3] * scale;
+            }
+            x1 = CLIP(x1, 0.0f, maxX);
+            y1 = CLIP(y1, 0.0f, maxY);
+            x2 = CLIP(x2, 0.0f, maxX);
+            y2 = CLIP(y2, 0.0f, maxY);
+            if (x2 <= x1 || y2 <= y1)
+                continue;
+
+            NvDsInferObjectDetectionInfo res;
+            res.classId = 0;
+            res.detectionConfidence = scores[i];
+            res.left = x1;
+            res.top = y1;
+            res.width = x2 - x1;
+            res.height = y2 - y1;
+            objectList.emplace_back(res);
+
+            if (landmarks) {
+                const float *src = landmarkView.read(
+                    (size_t)i * kFaceNumLandmarks * 2, kFaceNumLandmarks * 2,
+                    landmarkScratch);
+                size_t offset = landmarks->size();
+                landmarks->resize(offset + kFaceNumLandmarks * 2);
+                faceDecodeLandmarks(src, cx, cy,
+                    retinaFace ? kRetinaFaceCenterVariance * scale : scale,
+                    landmarks->data() + offset);
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool
+faceCreateContext (FaceModel model,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+    NvDsInferNetworkInfo const &networkInfo, void **context)
+{
+    std::unique_ptr<FaceParseContext> ctx(new FaceParseContext);
+    ctx->model = model;
+    if (!faceInitContext(*ctx, outputLayersInfo, networkInfo))
+        return false;
+    *context = ctx.release();
+    return true;
+}
+
+extern "C"
+bool NvDsInferParseCustomRetinaFace (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    FaceParseContext ctx;
+    ctx.model = FACE_MODEL_RETINAFACE;
+    if (!faceInitContext(ctx, outputLayersInfo, networkInfo))
+        return false;
+    return faceParse(ctx, outputLayersInfo, networkInfo, detectionParams,
+        objectList, nullptr);
+}
+
+extern "C"
+bool NvDsInferParseCustomRetinaFaceCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context)
+{
+    return faceCreateContext(FACE_MODEL_RETINAFACE, outputLayersInfo,
+        networkInfo, context);
+}
+
+extern "C"
+bool NvDsInferParseCustomRetinaFaceWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    return faceParse(*(FaceParseContext *) context, outputLayersInfo,
+        networkInfo, detectionParams, objectList, nullptr);
+}
+
+extern "C"
+bool NvDsInferParseCustomRetinaFaceWithLandmarks (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList,
+        std::vector<float> &landmarks,
+        unsigned int &numLandmarks)
+{
+    numLandmarks = kFaceNumLandmarks;
+    return faceParse(*(FaceParseContext *) context, outputLayersInfo,
+        networkInfo, detectionParams, objectList, &landmarks);
+}
+
+extern "C"
+void NvDsInferParseCustomRetinaFaceDestroyContext (void *context)
+{
+    delete (FaceParseContext *) context;
+}
+
+extern "C"
+bool NvDsInferParseCustomSCRFD (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    FaceParseContext ctx;
+    ctx.model = FACE_MODEL_SCRFD;
+    if (!faceInitContext(ctx, outputLayersInfo, networkInfo))
+        return false;
+    return faceParse(ctx, outputLayersInfo, networkInfo, detectionParams,
+        objectList, nullptr);
+}
+
+extern "C"
+bool NvDsInferParseCustomSCRFDCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context)
+{
+    return faceCreateContext(FACE_MODEL_SCRFD, outputLayersInfo, networkInfo,
+        context);
+}
+
+extern "C"
+bool NvDsInferParseCustomSCRFDWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    return faceParse(*(FaceParseContext *) context, outputLayersInfo,
+        networkInfo, detectionParams, objectList, nullptr);
+}
+
+extern "C"
+bool NvDsInferParseCustomSCRFDWithLandmarks (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList,
+        std::vector<float> &landmarks,
+        unsigned int &numLandmarks)
+{
+    numLandmarks = kFaceNumLandmarks;
+    return faceParse(*(FaceParseContext *) context, outputLayersInfo,
+        networkInfo, detectionParams, objectList, &landmarks);
+}
+
+extern "C"
+void NvDsInferParseCustomSCRFDDestroyContext (void *context)
+{
+    delete (FaceParseContext *) context;
+}
+
+/* Check that the custom function has been defined correctly */
+CHECK_CUSTOM_PARSE_FUNC_PROTOTYPE(NvDsInferParseCustomRetinaFace);
+CHECK_CUSTOM_PARSE_FUNC_PROTOTYPE(NvDsInferParseCustomSCRFD);
+CHECK_CUSTOM_PARSE_CONTEXT_FUNC_PROTOTYPES(NvDsInferParseCustomRetinaFace);
+CHECK_CUSTOM_PARSE_CONTEXT_FUNC_PROTOTYPES(NvDsInferParseCustomSCRFD);
+CHECK_CUSTOM_PARSE_LANDMARKS_FUNC_PROTOTYPE(NvDsInferParseCustomRetinaFace);
+CHECK_CUSTOM_PARSE_LANDMARKS_FUNC_PROTOTYPE(NvDsInferParseCustomSCRFD);
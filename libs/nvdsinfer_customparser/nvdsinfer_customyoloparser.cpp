@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include "nvdsinfer_custom_impl.h"
+#include "nvdsinfer_tensor_view.h"
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define CLIP(a,min,max) (MAX(MIN(a, max), min))
+
+/* This is a sample bounding box parsing function for YOLO family detectors
+ * (YOLOv5, YOLOv7 and similar exports) with one [N, 5 + C] output layer:
+ * per candidate row the box center x, y, width and height in network
+ * pixels, the objectness and the C class probabilities. The confidence of a
+ * row is objectness * max class probability.
+ *
+ * The objectness column is scanned first with SIMD compares: since the
+ * confidence cannot exceed the objectness, rows with an objectness below the
+ * lowest pre-cluster threshold are rejected without reading their class
+ * scores. The class max is only computed for the surviving rows, and the
+ * boxes are decoded into the reserved object list. */
+
+/* C-linkage to prevent name-mangling */
+extern "C"
+bool NvDsInferParseCustomYolo (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+bool NvDsInferParseCustomYoloCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context);
+
+extern "C"
+bool NvDsInferParseCustomYoloWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+void NvDsInferParseCustomYoloDestroyContext (void *context);
+
+/* Number of leading box and objectness columns of a row. */
+static const unsigned int kYoloBoxColumns = 5;
+/* Rows whose objectness is gathered per scan block. */
+static const unsigned int kYoloScanBlock = 256;
+
+/* Per-context state of the YOLO parser: output layer, its shape and scratch
+ * buffers. */
+struct YoloParseContext
+{
+    int layer = -1;
+    unsigned int numRows = 0;
+    unsigned int rowSize = 0;
+    std::vector<float> objectness;
+    std::vector<float> row;
+    std::vector<uint32_t> hits;
+};
+
+static bool
+yoloFindLayer (YoloParseContext &ctx,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo)
+{
+    /* Use the largest layer with at least one class column. */
+    ctx.layer = -1;
+    for (unsigned int i = 0; i < outputLayersInfo.size(); i++) {
+        const NvDsInferDims &dims = outputLayersInfo[i].inferDims;
+        if (dims.numDims < 2)
+            continue;
+        unsigned int rowSize = dims.d[dims.numDims - 1];
+        if (rowSize <= kYoloBoxColumns || dims.numElements % rowSize)
+            continue;
+        if (ctx.layer < 0 || dims.numElements >
+            outputLayersInfo[ctx.layer].inferDims.numElements) {
+            ctx.layer = i;
+            ctx.rowSize = rowSize;
+            ctx.numRows = dims.numElements / rowSize;
+        }
+    }
+    if (ctx.layer < 0) {
+        std::cerr << "ERROR: could not find a [N, 5 + classes] YOLO output "
+                  << "layer" << std::endl;
+        return false;
+    }
+    ctx.objectness.resize(kYoloScanBlock);
+    ctx.row.resize(ctx.rowSize);
+    return true;
+}
+
+/* Appends to @a hits the rows in [0, n) of the row-major @a rows whose
+ * objectness (column 4) is not below @a threshold. */
+static void
+yoloScanObjectness (YoloParseContext &ctx, const float *rows, size_t n,
+    float threshold, std::vector<uint32_t> &hits)
+{
+    size_t rowSize = ctx.rowSize;
+    const float *objectness = rows + 4;
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+        _mm256_set1_epi32(rowSize));
+    __m256 vt = _mm256_set1_ps(threshold);
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_i32gather_ps(objectness + i * rowSize, offsets, 4);
+        unsigned int mask =
+            _mm256_movemask_ps(_mm256_cmp_ps(v, vt, _CMP_NLT_UQ));
+        for (; mask; mask &= mask - 1)
+            hits.push_back(i + __builtin_ctz(mask));
+    }
+#endif
+    /* Gather the objectness of a block of rows and scan it. */
+    for (; i < n; i += kYoloScanBlock) {
+        size_t count = MIN(n - i, (size_t)kYoloScanBlock);
+        for (size_t r = 0; r < count; r++)
+            ctx.objectness[r] = objectness[(i + r) * rowSize];
+        size_t start = hits.size();
+        NvDsInferScanThreshold(ctx.objectness.data(), count, threshold, hits);
+        for (size_t h = start; h < hits.size(); h++)
+            hits[h] += i;
+    }
+}
+
+/* Returns the index of the first maximum of @a p[0, n), n > 0, and sets
+ * @a maxValue to it. */
+static inline unsigned int
+yoloClassMax (const float *p, unsigned int n, float &maxValue)
+{
+    unsigned int c = 1;
+    float m = p[0];
+#if defined(__AVX__)
+    if (n >= 8) {
+        __m256 vm = _mm256_loadu_ps(p);
+        for (c = 8; c + 8 <= n; c += 8)
+            vm = _mm256_max_ps(vm, _mm256_loadu_ps(p + c));
+        __m128 v4 = _mm_max_ps(_mm256_castps256_ps128(vm),
+            _mm256_extractf128_ps(vm, 1));
+        v4 = _mm_max_ps(v4, _mm_movehl_ps(v4, v4));
+        v4 = _mm_max_ss(v4, _mm_shuffle_ps(v4, v4, 1));
+        m = _mm_cvtss_f32(v4);
+    }
+#elif defined(__SSE2__)
+    if (n >= 4) {
+        __m128 v4 = _mm_loadu_ps(p);
+        for (c = 4; c + 4 <= n; c += 4)
+            v4 = _mm_max_ps(v4, _mm_loadu_ps(p + c));
+        v4 = _mm_max_ps(v4, _mm_movehl_ps(v4, v4));
+        v4 = _mm_max_ss(v4, _mm_shuffle_ps(v4, v4, 1));
+        m = _mm_cvtss_f32(v4);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (n >= 4) {
+        float32x4_t v4 = vld1q_f32(p);
+        for (c = 4; c + 4 <= n; c += 4)
+            v4 = vmaxq_f32(v4, vld1q_f32(p + c));
+        m = vmaxvq_f32(v4);
+    }
+#endif
+    for (; c < n; c++)
+        m = MAX(m, p[c]);
+
+    unsigned int best = 0;
+    while (best < n && !(p[best] == m))
+        best++;
+    if (best == n) {
+        /* Only NaNs compared unequal. */
+        best = 0;
+        m = p[0];
+    }
+    maxValue = m;
+    return best;
+}
+
+static bool
+yoloParse (YoloParseContext &ctx,
+    std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+    NvDsInferNetworkInfo  const &networkInfo,
+    NvDsInferParseDetectionParams const &detectionParams,
+    std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    const std::vector<float> &thresholds =
+        detectionParams.perClassPreclusterThreshold;
+    unsigned int numClasses = ctx.rowSize - kYoloBoxColumns;
+    unsigned int numThresholds = MIN(numClasses, (unsigned int)thresholds.size());
+    if (!numThresholds)
+        return true;
+    float minThreshold =
+        *std::min_element(thresholds.begin(), thresholds.begin() + numThresholds);
+
+    NvDsInferTensorView view(outputLayersInfo[ctx.layer]);
+    ctx.hits.clear();
+    if (view.isFloat()) {
+        yoloScanObjectness(ctx, view.read(0, 0, nullptr), ctx.numRows,
+            minThreshold, ctx.hits);
+    } else {
+        for (unsigned int i = 0; i < ctx.numRows; i++) {
+            if (!(view[(size_t)i * ctx.rowSize + 4] < minThreshold))
+                ctx.hits.push_back(i);
+        }
+    }
+
+    float maxX = networkInfo.width - 1;
+    float maxY = networkInfo.height - 1;
+    objectList.reserve(objectList.size() + ctx.hits.size());
+    for (uint32_t i : ctx.hits) {
+        const float *row =
+            view.read((size_t)i * ctx.rowSize, ctx.rowSize, ctx.row.data());
+        float classProb;
+        unsigned int classId = yoloClassMax(row + kYoloBoxColumns,
+            numClasses, classProb);
+        float confidence = row[4] * classProb;
+        if (classId >= numThresholds || confidence < thresholds[classId])
+            continue;
+
+        float x1 = CLIP(row[0] - row[2] / 2, 0.0f, maxX);
+        float y1 = CLIP(row[1] - row[3] / 2, 0.0f, maxY);
+        float x2 = CLIP(row[0] + row[2] / 2, 0.0f, maxX);
+        float y2 = CLIP(row[1] + row[3] / 2, 0.0f, maxY);
+        if (x2 <= x1 || y2 <= y1)
+            continue;
+
+        objectList.emplace_back();
+        NvDsInferObjectDetectionInfo &res = objectList.back();
+        res.classId = classId;
+        res.detectionConfidence = confidence;
+        res.left = x1;
+        res.top = y1;
+        res.width = x2 - x1;
+        res.height = y2 - y1;
+    }
+
+    return true;
+}
+
+extern "C"
+bool NvDsInferParseCustomYolo (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    YoloParseContext ctx;
+    if (!yoloFindLayer(ctx, outputLayersInfo))
+        return false;
+    return yoloParse(ctx, outputLayersInfo, networkInfo, detectionParams,
+        objectList);
+}
+
+extern "C"
+bool NvDsInferParseCustomYoloCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context)
+{
+    std::unique_ptr<YoloParseContext> ctx(new YoloParseContext);
+    if (!yoloFindLayer(*ctx, outputLayersInfo))
+        return false;
+    *context = ctx.release();
+    return true;
+}
+
+extern "C"
+bool NvDsInferParseCustomYoloWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    return yoloParse(*(YoloParseContext *) context, outputLayersInfo,
+        networkInfo, detectionParams, objectList);
+}
+
+extern "C"
+void NvDsInferParseCustomYoloDestroyContext (void *context)
+{
+    delete (YoloParseContext *) context;
+}
+
+/* Check that the custom function has been defined correctly */
+CHECK_CUSTOM_PARSE_FUNC_PROTOTYPE(NvDsInferParseCustomYolo);
+CHECK_CUSTOM_PARSE_CONTEXT_FUNC_PROTOTYPES(NvDsInferParseCustomYolo);
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Benchmarks NvDsInferParseCustomYolo on synthetic [N, 5 + C] outputs of 25k
+ * and 100k candidate rows against a row by row reference parser, and checks
+ * that both return the same objects.
+ *
+ * Usage: test_yolo_parser [classes] [objectness hit rate]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "nvdsinfer_custom_impl.h"
+
+extern "C"
+bool NvDsInferParseCustomYolo (std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+bool NvDsInferParseCustomYoloCreateContext (
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        void **context);
+
+extern "C"
+bool NvDsInferParseCustomYoloWithContext (void *context,
+        std::vector<NvDsInferLayerInfo> const &outputLayersInfo,
+        NvDsInferNetworkInfo  const &networkInfo,
+        NvDsInferParseDetectionParams const &detectionParams,
+        std::vector<NvDsInferObjectDetectionInfo> &objectList);
+
+extern "C"
+void NvDsInferParseCustomYoloDestroyContext (void *context);
+
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define CLIP(a,min,max) (MAX(MIN(a, max), min))
+
+typedef std::chrono::steady_clock Clock;
+
+/* Reads every class score of every row. */
+static void
+referenceParse (const float *rows, unsigned int numRows, unsigned int rowSize,
+    NvDsInferNetworkInfo const &networkInfo,
+    std::vector<float> const &thresholds,
+    std::vector<NvDsInferObjectDetectionInfo> &objectList)
+{
+    float maxX = networkInfo.width - 1;
+    float maxY = networkInfo.height - 1;
+    for (unsigned int i = 0; i < numRows; i++) {
+        const float *row = rows + (size_t)i * rowSize;
+        unsigned int classId = 0;
+        for (unsigned int c = 1; c < rowSize - 5; c++) {
+            if (row[5 + c] > row[5 + classId])
+                classId = c;
+        }
+        float confidence = row[4] * row[5 + classId];
+        if (classId >= thresholds.size() || confidence < thresholds[classId])
+            continue;
+
+        float x1 = CLIP(row[0] - row[2] / 2, 0.0f, maxX);
+        float y1 = CLIP(row[1] - row[3] / 2, 0.0f, maxY);
+        float x2 = CLIP(row[0] + row[2] / 2, 0.0f, maxX);
+        float y2 = CLIP(row[1] + row[3] / 2, 0.0f, maxY);
+        if (x2 <= x1 || y2 <= y1)
+            continue;
+
+        NvDsInferObjectDetectionInfo res;
+        res.classId = classId;
+        res.detectionConfidence = confidence;
+        res.left = x1;
+        res.top = y1;
+        res.width = x2 - x1;
+        res.height = y2 - y1;
+        objectList.push_back(res);
+    }
+}
+
+static bool
+sameObjects (std::vector<NvDsInferObjectDetectionInfo> const &a,
+    std::vector<NvDsInferObjectDetectionInfo> const &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].classId != b[i].classId ||
+            a[i].detectionConfidence != b[i].detectionConfidence ||
+            a[i].left != b[i].left || a[i].top != b[i].top ||
+            a[i].width != b[i].width || a[i].height != b[i].height)
+            return false;
+    }
+    return true;
+}
+
+/* Returns the best time in us of repeats runs of fn. */
+template <typename Fn>
+static double
+bestOf (int repeats, Fn fn)
+{
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++) {
+        auto start = Clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double, std::micro>(
+            Clock::now() - start).count());
+    }
+    return best;
+}
+
+static bool
+benchmark (unsigned int numRows, unsigned int numClasses, float hitRate)
+{
+    const int kRepeats = 20;
+    unsigned int rowSize = 5 + numClasses;
+    NvDsInferNetworkInfo networkInfo = {640, 640, 3};
+
+    /* Boxes all over the network input, a fraction hitRate of the rows has
+     * an objectness above the threshold. */
+    std::vector<float> rows((size_t)numRows * rowSize);
+    std::mt19937 rng(numRows);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    for (unsigned int i = 0; i < numRows; i++) {
+        float *row = &rows[(size_t)i * rowSize];
+        row[0] = uniform(rng) * networkInfo.width;
+        row[1] = uniform(rng) * networkInfo.height;
+        row[2] = 8.0f + uniform(rng) * 200.0f;
+        row[3] = 8.0f + uniform(rng) * 200.0f;
+        row[4] = uniform(rng) < hitRate ? 0.3f + 0.7f * uniform(rng)
+                                        : 0.2f * uniform(rng);
+        for (unsigned int c = 0; c < numClasses; c++)
+            row[5 + c] = uniform(rng) * uniform(rng);
+    }
+
+    NvDsInferLayerInfo layer;
+    memset(&layer, 0, sizeof(layer));
+    layer.dataType = FLOAT;
+    layer.inferDims.numDims = 2;
+    layer.inferDims.d[0] = numRows;
+    layer.inferDims.d[1] = rowSize;
+    layer.inferDims.numElements = numRows * rowSize;
+    layer.buffer = rows.data();
+    layer.layerName = "output";
+    std::vector<NvDsInferLayerInfo> layers(1, layer);
+
+    NvDsInferParseDetectionParams params;
+    params.numClassesConfigured = numClasses;
+    params.perClassPreclusterThreshold.assign(numClasses, 0.25f);
+
+    std::vector<NvDsInferObjectDetectionInfo> expected, objects, contextObjects;
+    double reference = bestOf(kRepeats, [&]() {
+        expected.clear();
+        referenceParse(rows.data(), numRows, rowSize, networkInfo,
+            params.perClassPreclusterThreshold, expected);
+    });
+    double parse = bestOf(kRepeats, [&]() {
+        objects.clear();
+        NvDsInferParseCustomYolo(layers, networkInfo, params, objects);
+    });
+    void *context = nullptr;
+    if (!NvDsInferParseCustomYoloCreateContext(layers, networkInfo, params,
+            &context)) {
+        printf("FAIL: could not create a parse context\n");
+        return false;
+    }
+    double parseWithContext = bestOf(kRepeats, [&]() {
+        contextObjects.clear();
+        NvDsInferParseCustomYoloWithContext(context, layers, networkInfo,
+            params, contextObjects);
+    });
+    NvDsInferParseCustomYoloDestroyContext(context);
+
+    printf("%6u rows x %u classes, %zu objects\n", numRows, numClasses,
+        expected.size());
+    printf("  reference     %8.1f us\n", reference);
+    printf("  parse         %8.1f us %5.2fx\n", parse, reference / parse);
+    printf("  with context  %8.1f us %5.2fx\n", parseWithContext,
+        reference / parseWithContext);
+    if (!sameObjects(expected, objects) || !sameObjects(expected, contextObjects)) {
+        printf("FAIL: parsed objects differ from the reference\n");
+        return false;
+    }
+    return true;
+}
+
+int
+main (int argc, char *argv[])
+{
+    unsigned int numClasses = argc > 1 ? atoi(argv[1]) : 80;
+    float hitRate = argc > 2 ? atof(argv[2]) : 0.01f;
+
+    bool ok = benchmark(25200, numClasses, hitRate) &&
+        benchmark(100800, numClasses, hitRate);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2020, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ *
+ */
+
+/* Benchmark of the IVF gallery index against exhaustive search on synthetic
+ * clustered embeddings. Reports recall@k and queries/sec for a range of
+ * probes, then checks that a corrupt index file is rebuilt instead of used.
+ *
+ * Usage: test_gallery_ivf [rows] [dims] [lists] [queries] [k]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gstnvinfer_gallery.h"
+
+using namespace gstnvinfer;
+
+#define NUM_CLUSTERS 1000
+#define CLUSTER_NOISE 0.35f
+#define QUERY_NOISE 0.15f
+#define QUERY_BATCH 16
+
+static void
+normalize (float *v, uint32_t dims)
+{
+  float norm = 0.0f;
+  for (uint32_t d = 0; d < dims; d++)
+    norm += v[d] * v[d];
+  norm = 1.0f / sqrtf (norm);
+  for (uint32_t d = 0; d < dims; d++)
+    v[d] *= norm;
+}
+
+static uint64_t
+align_up (uint64_t offset)
+{
+  return (offset + GALLERY_FILE_ALIGNMENT - 1) / GALLERY_FILE_ALIGNMENT *
+      GALLERY_FILE_ALIGNMENT;
+}
+
+/* Write a float binary gallery file, labels are the row numbers. */
+static bool
+write_gallery (const std::string &path, const std::vector<float> &rows,
+    uint32_t numRows, uint32_t dims)
+{
+  std::vector<uint32_t> offsets (numRows + 1, 0);
+  std::string table;
+  for (uint32_t i = 0; i < numRows; i++) {
+    table += "id" + std::to_string (i);
+    table += '\0';
+    offsets[i + 1] = table.size ();
+  }
+
+  GalleryFileHeader header;
+  memset (&header, 0, sizeof (header));
+  strncpy (header.magic, GALLERY_FILE_MAGIC, sizeof (header.magic));
+  header.version = GALLERY_FILE_VERSION;
+  header.dataType = GALLERY_DATA_FLOAT;
+  header.dims = dims;
+  header.numRows = numRows;
+  header.labelOffsetsOffset = align_up (sizeof (header));
+  header.labelTableOffset =
+      align_up (header.labelOffsetsOffset + offsets.size () * sizeof (uint32_t));
+  header.labelTableSize = table.size ();
+  header.matrixOffset = align_up (header.labelTableOffset + table.size ());
+
+  std::vector<char> file (header.matrixOffset + rows.size () * sizeof (float));
+  memcpy (file.data (), &header, sizeof (header));
+  memcpy (&file[header.labelOffsetsOffset], offsets.data (),
+      offsets.size () * sizeof (uint32_t));
+  memcpy (&file[header.labelTableOffset], table.data (), table.size ());
+  memcpy (&file[header.matrixOffset], rows.data (),
+      rows.size () * sizeof (float));
+
+  std::ofstream out (path, std::ios::binary | std::ios::trunc);
+  out.write (file.data (), file.size ());
+  return out.good ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t num_rows = argc > 1 ? atoi (argv[1]) : 100000;
+  uint32_t dims = argc > 2 ? atoi (argv[2]) : 128;
+  uint32_t num_lists = argc > 3 ? atoi (argv[3]) : 256;
+  uint32_t num_queries = argc > 4 ? atoi (argv[4]) : 2000;
+  uint32_t k = argc > 5 ? atoi (argv[5]) : 10;
+  std::string gallery_path =
+      "/tmp/test_gallery_ivf_" + std::to_string (getpid ()) + ".bin";
+  std::string index_path = gallery_path + ".ivf";
+
+  /* Rows are noisy copies of random cluster centers, queries are noisy
+   * copies of random rows. */
+  std::mt19937 rng (42);
+  std::normal_distribution<float> gauss (0.0f, 1.0f);
+  std::vector<float> centers ((size_t) NUM_CLUSTERS * dims);
+  for (auto & v : centers)
+    v = gauss (rng);
+  for (uint32_t c = 0; c < NUM_CLUSTERS; c++)
+    normalize (&centers[(size_t) c * dims], dims);
+
+  std::vector<float> rows ((size_t) num_rows * dims);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    const float *center = &centers[(size_t) (rng () % NUM_CLUSTERS) * dims];
+    float *r = &rows[(size_t) i * dims];
+    for (uint32_t d = 0; d < dims; d++)
+      r[d] = center[d] + CLUSTER_NOISE * gauss (rng) / sqrtf (dims);
+    normalize (r, dims);
+  }
+  std::vector<float> queries ((size_t) num_queries * dims);
+  std::vector<const float *> query_ptrs (num_queries);
+  for (uint32_t q = 0; q < num_queries; q++) {
+    const float *src = &rows[(size_t) (rng () % num_rows) * dims];
+    float *dst = &queries[(size_t) q * dims];
+    for (uint32_t d = 0; d < dims; d++)
+      dst[d] = src[d] + QUERY_NOISE * gauss (rng) / sqrtf (dims);
+    normalize (dst, dims);
+    query_ptrs[q] = dst;
+  }
+
+  if (!write_gallery (gallery_path, rows, num_rows, dims)) {
+    printf ("Could not write %s\n", gallery_path.c_str ());
+    return 1;
+  }
+  unlink (index_path.c_str ());
+
+  /* Runs search over all the queries in batches, returns queries/sec. */
+  auto run = [&] (const Gallery & gallery, std::vector<GalleryMatch> &all) {
+    std::vector<GalleryMatch> matches;
+    all.resize ((size_t) num_queries * k);
+    auto start = std::chrono::steady_clock::now ();
+    for (uint32_t q = 0; q < num_queries; q += QUERY_BATCH) {
+      uint32_t n = std::min<uint32_t> (QUERY_BATCH, num_queries - q);
+      gallery.search (&query_ptrs[q], n, k, matches);
+      std::copy (matches.begin (), matches.end (), all.begin () + q * k);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now () - start;
+    return num_queries / elapsed.count ();
+  };
+
+  std::shared_ptr<Gallery> exact = Gallery::load (gallery_path);
+  if (!exact) {
+    printf ("Could not load %s\n", gallery_path.c_str ());
+    return 1;
+  }
+  std::vector<GalleryMatch> truth;
+  double exact_qps = run (*exact, truth);
+  printf ("rows %u dims %u lists %u queries %u k %u\n", num_rows, dims,
+      num_lists, num_queries, k);
+  printf ("%-12s recall@%-3u %10.0f queries/sec\n", "exhaustive", k, exact_qps);
+
+  bool ok = true;
+  for (uint32_t probes = 1; probes <= num_lists; probes *= 2) {
+    std::shared_ptr<Gallery> base = Gallery::load (gallery_path);
+    auto start = std::chrono::steady_clock::now ();
+    std::shared_ptr<Gallery> ivf = IvfGallery::create (std::move (*base),
+        num_lists, probes, index_path);
+    std::chrono::duration<double> create_time =
+        std::chrono::steady_clock::now () - start;
+    if (!ivf) {
+      printf ("IVF index creation failed\n");
+      return 1;
+    }
+
+    std::vector<GalleryMatch> found;
+    double qps = run (*ivf, found);
+    uint64_t hits = 0;
+    for (uint32_t q = 0; q < num_queries; q++) {
+      std::set<int32_t> expected;
+      for (uint32_t i = 0; i < k; i++)
+        expected.insert (truth[q * k + i].index);
+      for (uint32_t i = 0; i < k; i++)
+        hits += expected.count (found[q * k + i].index);
+    }
+    double recall = (double) hits / ((uint64_t) num_queries * k);
+    printf ("probes %-5u recall %.4f %10.0f queries/sec %6.2fx "
+        "(create %.2fs)\n", probes, recall, qps, qps / exact_qps,
+        create_time.count ());
+    /* Exhaustive probing must find the exact top-k. */
+    if (probes == num_lists && recall < 0.999) {
+      printf ("FAIL: exhaustive probing recall %.4f\n", recall);
+      ok = false;
+    }
+  }
+
+  /* A corrupt index must be rebuilt, not used: point the last row id out
+   * of the gallery. */
+  {
+    std::fstream index (index_path,
+        std::ios::binary | std::ios::in | std::ios::out);
+    index.seekp (0, std::ios::end);
+    uint32_t bad_row = num_rows + 1000;
+    index.seekp ((std::streamoff) index.tellp () - sizeof (bad_row));
+    index.write ((const char *) &bad_row, sizeof (bad_row));
+  }
+  std::shared_ptr<Gallery> base = Gallery::load (gallery_path);
+  std::shared_ptr<Gallery> ivf = IvfGallery::create (std::move (*base),
+      num_lists, num_lists, index_path);
+  std::vector<GalleryMatch> found;
+  run (*ivf, found);
+  for (uint32_t i = 0; i < found.size (); i++) {
+    if (found[i].index != truth[i].index) {
+      printf ("FAIL: search with a rebuilt corrupt index differs\n");
+      ok = false;
+      break;
+    }
+  }
+
+  unlink (index_path.c_str ());
+  unlink (gallery_path.c_str ());
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}